@@ -0,0 +1,1615 @@
+// DIPBatch.cpp: command line front end of the image processing library.
+//
+// MFCBMPļִһʱܷ
+//
+//   dipbatch <> <.bmp> <.bmp> [ظ]
+//   dipbatch <> <.bmp> <.bmp> -t <ԤMB>    ִʽд
+//   ÷ -j <߳> ָ߳ĬϰCPU
+//    -k <KB> ָȴִֿʱÿдĴС0Ϊֿ
+//
+//   dipbatch selftest    ع飬ȫͨʱ0
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "ImgProcess.h"
+#include "ImgParallel.h"
+#include "ImgConv.h"
+#include <stdio.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+
+// 33ṹԪأȫΪ1
+static int s_se[3][3] = {{1, 1, 1}, {1, 1, 1}, {1, 1, 1}};
+
+// 55ƽ̹ṹԪأҶ̬ѧ
+static int s_nGraySe[5][5] = {{1, 1, 1, 1, 1}, {1, 1, 1, 1, 1}, {1, 1, 1, 1, 1}, {1, 1, 1, 1, 1}, {1, 1, 1, 1, 1}};
+static int* s_pGraySe[5] = {s_nGraySe[0], s_nGraySe[1], s_nGraySe[2], s_nGraySe[3], s_nGraySe[4]};
+
+// 뾶20Բ̽ṹԪأֵ̬ѧãԲΪ-1ģ
+#define DISC_RADIUS	20
+#define DISC_SIZE	(2 * DISC_RADIUS + 1)
+static int s_nDiscSe[DISC_SIZE][DISC_SIZE];
+static int* s_pDiscSe[DISC_SIZE];
+
+static void InitDisc()
+{
+	for (int k = 0; k < DISC_SIZE; k++)
+	{
+		for (int l = 0; l < DISC_SIZE; l++)
+		{
+			int dy = k - DISC_RADIUS, dx = l - DISC_RADIUS;
+			s_nDiscSe[k][l] = (dy * dy + dx * dx <= DISC_RADIUS * DISC_RADIUS) ? 1 : -1;
+		}
+		s_pDiscSe[k] = s_nDiscSe[k];
+	}
+}
+
+// 77ʽƸ˹ģ壬ϵ1/4096
+static float s_fGauss7[49];
+
+static void InitGauss7()
+{
+	static const float s_fBinom[7] = {1, 6, 15, 20, 15, 6, 1};
+	for (int k = 0; k < 7; k++)
+		for (int l = 0; l < 7; l++)
+			s_fGauss7[k * 7 + l] = s_fBinom[k] * s_fBinom[l];
+}
+
+// ִһδʱFALSE
+static BOOL RunCommand(const char* pszCmd, CImgProcess& imgIn, CImgProcess& imgOut)
+{
+	if (!strcmp(pszCmd, "threshold"))
+		imgIn.Threshold(&imgOut, 128);
+	else if (!strcmp(pszCmd, "autothreshold"))
+		imgIn.AutoThreshold(&imgOut);
+	else if (!strcmp(pszCmd, "adaptthreshold"))
+		imgIn.AdaptiveThreshold(&imgOut, 31, 5);
+	else if (!strcmp(pszCmd, "histeq"))
+		imgIn.Histeq(&imgOut);
+	else if (!strcmp(pszCmd, "invert"))
+		imgIn.LinTran(&imgOut, -1, 255);
+	else if (!strcmp(pszCmd, "smooth"))
+		imgIn.Template(&imgOut, 3, 3, 1, 1, Template_Smooth_Avg, 1.0f / 9);
+	else if (!strcmp(pszCmd, "gauss"))
+		imgIn.Template(&imgOut, 3, 3, 1, 1, Template_Smooth_Gauss, 1.0f / 16);
+	else if (!strcmp(pszCmd, "gauss7"))
+		imgIn.Template(&imgOut, 7, 7, 3, 3, s_fGauss7, 1.0f / 4096);
+	else if (!strcmp(pszCmd, "box"))
+		imgIn.BoxFilter(&imgOut, 31, 31, 15, 15);
+	else if (!strcmp(pszCmd, "median"))
+		imgIn.MedianFilter(&imgOut, 3, 3, 1, 1);
+	else if (!strcmp(pszCmd, "median15"))
+		imgIn.MedianFilter(&imgOut, 15, 15, 7, 7);
+	else if (!strcmp(pszCmd, "adaptmedian"))
+		imgIn.AdaptiveMedianFilter(&imgOut, 3, 3, 1, 1, 0);
+	else if (!strcmp(pszCmd, "enhance"))
+		imgIn.EnhanceFilter(&imgOut, 1.8, 3, 3, 1, 1, Template_Laplacian2, 1);
+	else if (!strcmp(pszCmd, "roberts"))
+		imgIn.EdgeRoberts(&imgOut);
+	else if (!strcmp(pszCmd, "sobel"))
+		imgIn.EdgeSobel(&imgOut);
+	else if (!strcmp(pszCmd, "prewitt"))
+		imgIn.EdgePrewitt(&imgOut);
+	else if (!strcmp(pszCmd, "log"))
+		imgIn.EdgeLoG(&imgOut);
+	else if (!strcmp(pszCmd, "log2"))
+		imgIn.EdgeLoG(&imgOut, 2.0);
+	else if (!strcmp(pszCmd, "dog2"))
+		imgIn.EdgeLoG(&imgOut, 2.0, LOG_DOG);
+	else if (!strcmp(pszCmd, "canny"))
+		imgIn.EdgeCanny(&imgOut);
+	else if (!strcmp(pszCmd, "erode"))
+		imgIn.Erode(&imgOut, s_se);
+	else if (!strcmp(pszCmd, "dilate"))
+		imgIn.Dilate(&imgOut, s_se);
+	else if (!strcmp(pszCmd, "open"))
+		imgIn.Open(&imgOut, s_se);
+	else if (!strcmp(pszCmd, "close"))
+		imgIn.Close(&imgOut, s_se);
+	else if (!strcmp(pszCmd, "open20"))
+		imgIn.Open(&imgOut, DISC_SIZE, DISC_SIZE, DISC_RADIUS, DISC_RADIUS, s_pDiscSe);
+	else if (!strcmp(pszCmd, "close20"))
+		imgIn.Close(&imgOut, DISC_SIZE, DISC_SIZE, DISC_RADIUS, DISC_RADIUS, s_pDiscSe);
+	else if (!strcmp(pszCmd, "gopen"))
+		imgIn.GrayOpen(&imgOut, 5, 5, 2, 2, s_pGraySe);
+	else if (!strcmp(pszCmd, "gclose"))
+		imgIn.GrayClose(&imgOut, 5, 5, 2, 2, s_pGraySe);
+	else if (!strcmp(pszCmd, "tophat"))
+		imgIn.Tophat(&imgOut, 5, 5, 2, 2, s_pGraySe);
+	else if (!strcmp(pszCmd, "label"))
+		imgIn.LabelConnRgn(&imgOut);
+	else
+		return FALSE;
+
+	return TRUE;
+}
+
+// ִʱȫͼ-1
+// enhanceȫͼĻҶȷΧһhisteqcannyһִܷ
+static int GetBandHalo(const char* pszCmd)
+{
+	static const char* s_pszPoint[] = {"threshold", "invert"};
+	static const char* s_pszLocal[] = {"smooth", "gauss", "median", "erode", "dilate"};
+	static const char* s_pszLocal2[] = {"open", "close"};
+	static const char* s_pszLocal3[] = {"gauss7"};
+	static const char* s_pszLocal4[] = {"gopen", "gclose"};
+	static const char* s_pszLocal7[] = {"median15"};
+	static const char* s_pszLocal15[] = {"box", "adaptthreshold"};
+	static const char* s_pszLocal40[] = {"open20", "close20"};
+
+	for (size_t i = 0; i < sizeof(s_pszPoint) / sizeof(s_pszPoint[0]); i++)
+		if (!strcmp(pszCmd, s_pszPoint[i]))
+			return 0;
+	for (size_t i = 0; i < sizeof(s_pszLocal) / sizeof(s_pszLocal[0]); i++)
+		if (!strcmp(pszCmd, s_pszLocal[i]))
+			return 1;
+	for (size_t i = 0; i < sizeof(s_pszLocal2) / sizeof(s_pszLocal2[0]); i++)
+		if (!strcmp(pszCmd, s_pszLocal2[i]))
+			return 2;
+	for (size_t i = 0; i < sizeof(s_pszLocal3) / sizeof(s_pszLocal3[0]); i++)
+		if (!strcmp(pszCmd, s_pszLocal3[i]))
+			return 3;
+	for (size_t i = 0; i < sizeof(s_pszLocal4) / sizeof(s_pszLocal4[0]); i++)
+		if (!strcmp(pszCmd, s_pszLocal4[i]))
+			return 4;
+	for (size_t i = 0; i < sizeof(s_pszLocal7) / sizeof(s_pszLocal7[0]); i++)
+		if (!strcmp(pszCmd, s_pszLocal7[i]))
+			return 7;
+	for (size_t i = 0; i < sizeof(s_pszLocal15) / sizeof(s_pszLocal15[0]); i++)
+		if (!strcmp(pszCmd, s_pszLocal15[i]))
+			return 15;
+	for (size_t i = 0; i < sizeof(s_pszLocal40) / sizeof(s_pszLocal40[0]); i++)
+		if (!strcmp(pszCmd, s_pszLocal40[i]))
+			return 40;
+
+	return -1;
+}
+
+static void BandProc(CImgProcess* pIn, CImgProcess* pOut, LPVOID pParam)
+{
+	RunCommand((const char*)pParam, *pIn, *pOut);
+}
+
+// ִʽдͼڴ
+static int RunStreaming(const char* pszCmd, const char* pszIn, const char* pszOut, double dBudgetMB)
+{
+	int nHalo = GetBandHalo(pszCmd);
+	if (nHalo < 0)
+	{
+		fprintf(stderr, "dipbatch: %s cannot be processed in bands\n", pszCmd);
+		return 2;
+	}
+
+	CImgProcess imgIn;
+	if (!imgIn.AttachFromFile(pszIn, TRUE))
+	{
+		fprintf(stderr, "dipbatch: cannot read %s\n", pszIn);
+		return 1;
+	}
+
+	CImgWriter writer;
+	writer.SetTileBudget((size_t)(dBudgetMB * 1024 * 1024));
+	if (!writer.Open(pszOut, imgIn, imgIn.GetWidthPixel(), imgIn.GetHeight()))
+	{
+		fprintf(stderr, "dipbatch: cannot write %s\n", pszOut);
+		return 1;
+	}
+
+	std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+	BOOL bSuc = imgIn.ProcessToWriter(writer, nHalo, BandProc, (LPVOID)pszCmd);
+	bSuc = writer.Close() && bSuc;
+	double dMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tStart).count();
+
+	if (!bSuc)
+	{
+		fprintf(stderr, "dipbatch: cannot write %s\n", pszOut);
+		return 1;
+	}
+
+	printf("%s %dx%d %.2f ms (streamed)\n", pszCmd, imgIn.GetWidthPixel(), imgIn.GetHeight(), dMs);
+	return 0;
+}
+
+// ˲Ļع飨dipbatch selftestԭ㸡㷨
+// EnhanceFilterĶдʵֱȽϡָ߳½
+// 1ҶȼҲָͬ֮λͬ
+static void EnhanceReference(const CImgProcess& imgSrc, CImgProcess* pTo, double dProportion,
+	int nTempH, int nTempW, int nTempMY, int nTempMX, const FLOAT* pfArray, FLOAT fCoef)
+{
+	int nHeight = imgSrc.GetHeight();
+	int nWidth = imgSrc.GetWidthPixel();
+	*pTo = imgSrc;
+
+	std::vector<int> vecSum((size_t)nWidth * nHeight, 0);
+	int nMax = 0, nMin = 65535;
+	for (int i = nTempMY; i < nHeight - (nTempH - nTempMY) + 1; i++)
+	{
+		for (int j = nTempMX; j < nWidth - (nTempW - nTempMX) + 1; j++)
+		{
+			float fResult = 0;
+			for (int k = 0; k < nTempH; k++)
+				for (int l = 0; l < nTempW; l++)
+					fResult += imgSrc.GetGray(j + l - nTempMX, i + k - nTempMY) * pfArray[k * nTempW + l];
+
+			fResult *= fCoef;
+			if (fResult > 255)
+				fResult = 255;
+			if (fResult < -255)
+				fResult = -255;
+
+			int nSum = (int)(dProportion * imgSrc.GetGray(j, i) + fResult + 0.5);
+			vecSum[(size_t)i * nWidth + j] = nSum;
+			nMax = max(nMax, nSum);
+			nMin = min(nMin, nSum);
+		}
+	}
+
+	int nSpan = nMax - nMin;
+	for (int i = nTempMY; i < nHeight - (nTempH - nTempMY) + 1; i++)
+	{
+		for (int j = nTempMX; j < nWidth - (nTempW - nTempMX) + 1; j++)
+		{
+			int nSum = vecSum[(size_t)i * nWidth + j];
+			BYTE bt;
+			if (nSpan > 0)
+				bt = (BYTE)((nSum - nMin) * 255 / nSpan);
+			else if (nSum <= 255)
+				bt = (BYTE)nSum;
+			else
+				bt = 255;
+			pTo->SetPixel(j, i, RGB(bt, bt, bt));
+		}
+	}
+}
+
+// ͼظֵ֮
+static int MaxPixelDiff(const CImgProcess& img1, const CImgProcess& img2)
+{
+	if (img1.GetHeight() != img2.GetHeight() || img1.GetWidthPixel() != img2.GetWidthPixel())
+		return 256;
+
+	int nDiff = 0;
+	for (int i = 0; i < img1.GetHeight(); i++)
+	{
+		for (int j = 0; j < img1.GetWidthPixel(); j++)
+		{
+			COLORREF c1 = img1.GetPixel(j, i), c2 = img2.GetPixel(j, i);
+			nDiff = max(nDiff, abs((int)GetRValue(c1) - (int)GetRValue(c2)));
+			nDiff = max(nDiff, abs((int)GetGValue(c1) - (int)GetGValue(c2)));
+			nDiff = max(nDiff, abs((int)GetBValue(c1) - (int)GetBValue(c2)));
+		}
+	}
+	return nDiff;
+}
+
+// ȷĲͼ񣺽αbFlatʱΪһҶ
+static void MakeTestImage(CImgProcess* pImg, int nHeight, int nWidth, int nFormat, BOOL bFlat)
+{
+	pImg->Create(nHeight, nWidth, nFormat);
+	unsigned nSeed = 12345;
+	for (int i = 0; i < nHeight; i++)
+	{
+		for (int j = 0; j < nWidth; j++)
+		{
+			nSeed = nSeed * 1103515245 + 12345;
+			int nNoise = (int)((nSeed >> 16) % 96);
+			BYTE r = bFlat ? 100 : (BYTE)((j * 160 / nWidth + nNoise) % 256);
+			BYTE g = bFlat ? 100 : (BYTE)((i * 160 / nHeight + nNoise) % 256);
+			BYTE b = bFlat ? 100 : (BYTE)(nNoise * 2);
+			pImg->SetPixel(j, i, nFormat == IMG_FMT_GRAY8 ? RGB(r, r, r) : RGB(r, g, b));
+		}
+	}
+}
+
+// عڵ̺߳ȫ߳¸һ
+static const int s_nTestThreads[] = {1, 0};
+#define TEST_THREAD_COUNTS	((int)(sizeof(s_nTestThreads) / sizeof(s_nTestThreads[0])))
+
+static int SelfTestEnhance()
+{
+	static FLOAT s_fLap[9] = {-1, -1, -1, -1, 8, -1, -1, -1, -1};
+	static FLOAT s_fGauss[9] = {1, 2, 1, 2, 4, 2, 1, 2, 1};
+	static FLOAT s_fAsym[15] = {1.5f, -2.25f, 0.75f, 3, -1, -0.5f, 2.5f, 1, -3.5f, 0.25f, -1.75f, 2, 0.5f, -2.5f, 1.25f};
+	static FLOAT s_fHuge[9] = {-6e5f, -6e5f, -6e5f, -6e5f, 5e6f, -6e5f, -6e5f, -6e5f, -6e5f}; //㷶Χ߸·
+
+	struct SCase
+	{
+		double dProportion;
+		int nTempH, nTempW, nTempMY, nTempMX;
+		FLOAT* pfArray;
+		FLOAT fCoef;
+	};
+	static const SCase s_cases[] = {
+		{1.8, 3, 3, 1, 1, Template_Laplacian2, 1},
+		{1.8, 3, 3, 1, 1, s_fLap, 1},
+		{0.5, 3, 3, 1, 1, s_fGauss, 1.0f / 16},
+		{-0.7, 3, 5, 2, 1, s_fAsym, 0.3f},
+		{2.3, 3, 3, 1, 1, s_fHuge, 1},
+		{1.0, 3, 3, 0, 2, s_fLap, 0.25f},
+	};
+
+	CImgProcess imgs[3];
+	MakeTestImage(&imgs[0], 211, 333, IMG_FMT_GRAY8, FALSE);
+	MakeTestImage(&imgs[1], 67, 101, IMG_FMT_RGB24, FALSE);
+	MakeTestImage(&imgs[2], 40, 50, IMG_FMT_GRAY8, TRUE);
+
+	int nFailed = 0, nChecked = 0;
+
+	for (size_t n = 0; n < sizeof(imgs) / sizeof(imgs[0]); n++)
+	{
+		for (size_t c = 0; c < sizeof(s_cases) / sizeof(s_cases[0]); c++)
+		{
+			const SCase& tc = s_cases[c];
+			CImgProcess imgRef, imgScalar;
+			EnhanceReference(imgs[n], &imgRef, tc.dProportion, tc.nTempH, tc.nTempW, tc.nTempMY, tc.nTempMX, tc.pfArray, tc.fCoef);
+
+			for (int nLevel = IMG_SIMD_NONE; nLevel <= IMG_SIMD_AVX2; nLevel++)
+			{
+				CImgConv::SetSimdLevel(nLevel);
+				for (int t = 0; t < TEST_THREAD_COUNTS; t++)
+				{
+					CImgParallel::SetThreadCount(s_nTestThreads[t]);
+
+					CImgProcess imgOut;
+					imgs[n].EnhanceFilter(&imgOut, tc.dProportion, tc.nTempH, tc.nTempW, tc.nTempMY, tc.nTempMX, tc.pfArray, tc.fCoef);
+					if (nLevel == IMG_SIMD_NONE && t == 0)
+						imgScalar = imgOut;
+
+					int nDiff = MaxPixelDiff(imgOut, imgRef);
+					int nSimdDiff = MaxPixelDiff(imgOut, imgScalar);
+					nChecked++;
+					if (nDiff > 1 || nSimdDiff != 0)
+					{
+						fprintf(stderr, "selftest: enhance image %d case %d simd %d threads %d: diff %d from reference, %d from scalar\n",
+							(int)n, (int)c, CImgConv::GetSimdLevel(), s_nTestThreads[t], nDiff, nSimdDiff);
+						nFailed++;
+					}
+				}
+			}
+		}
+	}
+
+	CImgConv::SetSimdLevel(IMG_SIMD_AVX2);
+	CImgParallel::SetThreadCount(0);
+
+	printf("selftest: enhance %d/%d passed\n", nChecked - nFailed, nChecked);
+	return nFailed;
+}
+
+// ģĲʵ֣ԭĴкУۼӷģԪأ
+// ϵȡֵضϵ255롣ģ岻ȫͼıԵΪ0
+static void TemplateReference(const CImgProcess& imgSrc, CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX,
+	const FLOAT* pfArray, FLOAT fCoef)
+{
+	int nHeight = imgSrc.GetHeight();
+	int nWidth = imgSrc.GetWidthPixel();
+	*pTo = imgSrc;
+	pTo->InitPixels(0);
+
+	for (int i = nTempMY; i < nHeight - (nTempH - nTempMY) + 1; i++)
+	{
+		for (int j = nTempMX; j < nWidth - (nTempW - nTempMX) + 1; j++)
+		{
+			float fSum = 0;
+			for (int k = 0; k < nTempH; k++)
+				for (int l = 0; l < nTempW; l++)
+					if (pfArray[k * nTempW + l] != 0)
+						fSum += (float)imgSrc.GetGray(j + l - nTempMX, i + k - nTempMY) * pfArray[k * nTempW + l];
+
+			float fResult = (float)fabs(fSum * fCoef);
+			BYTE bt = fResult > 255 ? 255 : (BYTE)(fResult + 0.5);
+			pTo->SetPixel(j, i, RGB(bt, bt, bt));
+		}
+	}
+}
+
+// ģĻع飺ɷģCImgConvֽΪСһάά
+// ģ壨Ƿɷ룩ͲɷģάĲʵλͬ
+// ĿɷģıۼӴ1Ҷȼ
+// ָ߳µĽʵλͬ
+static int SelfTestTemplate()
+{
+	static FLOAT s_fGauss[9] = {1, 2, 1, 2, 4, 2, 1, 2, 1};
+	static FLOAT s_fLap[9] = {-1, -1, -1, -1, 8, -1, -1, -1, -1};
+	static FLOAT s_fAsym[15] = {1.5f, -2.25f, 0.75f, 3, -1, -0.5f, 2.5f, 1, -3.5f, 0.25f, -1.75f, 2, 0.5f, -2.5f, 1.25f};
+	static FLOAT s_fIntSep[15];		// 35(1, -2, 3)(2, 0, 1, 1, -1)֮
+	static FLOAT s_fFracSep[15];	// 35(0.25, 0.5, 0.25)(0.1, 0.2, 0.4, 0.2, 0.1)֮
+	static const int s_nU[3] = {1, -2, 3};
+	static const int s_nV[5] = {2, 0, 1, 1, -1};
+	static const float s_fU[3] = {0.25f, 0.5f, 0.25f};
+	static const float s_fV[5] = {0.1f, 0.2f, 0.4f, 0.2f, 0.1f};
+	for (int k = 0; k < 3; k++)
+	{
+		for (int l = 0; l < 5; l++)
+		{
+			s_fIntSep[k * 5 + l] = (FLOAT)(s_nU[k] * s_nV[l]);
+			s_fFracSep[k * 5 + l] = s_fU[k] * s_fV[l];
+		}
+	}
+	InitGauss7();
+
+	struct SCase
+	{
+		int nTempH, nTempW, nTempMY, nTempMX;
+		FLOAT* pfArray;
+		FLOAT fCoef;
+		int nTolerance;
+	};
+	static const SCase s_cases[] = {
+		{3, 3, 1, 1, s_fGauss, 1.0f / 16, 0},
+		{7, 7, 3, 3, s_fGauss7, 1.0f / 4096, 0},
+		{3, 5, 2, 1, s_fIntSep, 0.1f, 0},
+		{3, 5, 1, 2, s_fFracSep, 1.7f, 1},
+		{3, 3, 1, 1, s_fLap, 1, 0},
+		{3, 5, 0, 4, s_fAsym, 0.3f, 0},
+	};
+
+	CImgProcess imgs[2];
+	MakeTestImage(&imgs[0], 211, 333, IMG_FMT_GRAY8, FALSE);
+	MakeTestImage(&imgs[1], 67, 101, IMG_FMT_RGB24, FALSE);
+
+	int nFailed = 0, nChecked = 0;
+	for (size_t n = 0; n < sizeof(imgs) / sizeof(imgs[0]); n++)
+	{
+		for (size_t c = 0; c < sizeof(s_cases) / sizeof(s_cases[0]); c++)
+		{
+			const SCase& tc = s_cases[c];
+			CImgProcess imgRef, imgScalar;
+			TemplateReference(imgs[n], &imgRef, tc.nTempH, tc.nTempW, tc.nTempMY, tc.nTempMX, tc.pfArray, tc.fCoef);
+
+			for (int nLevel = IMG_SIMD_NONE; nLevel <= IMG_SIMD_AVX2; nLevel++)
+			{
+				CImgConv::SetSimdLevel(nLevel);
+				for (int t = 0; t < TEST_THREAD_COUNTS; t++)
+				{
+					CImgParallel::SetThreadCount(s_nTestThreads[t]);
+
+					CImgProcess imgOut = imgs[n];
+					imgs[n].Template(&imgOut, tc.nTempH, tc.nTempW, tc.nTempMY, tc.nTempMX, tc.pfArray, tc.fCoef);
+					if (nLevel == IMG_SIMD_NONE && t == 0)
+						imgScalar = imgOut;
+
+					int nDiff = MaxPixelDiff(imgOut, imgRef);
+					int nSimdDiff = MaxPixelDiff(imgOut, imgScalar);
+					nChecked++;
+					if (nDiff > tc.nTolerance || nSimdDiff != 0)
+					{
+						fprintf(stderr, "selftest: template image %d case %d simd %d threads %d: diff %d from reference, %d from scalar\n",
+							(int)n, (int)c, CImgConv::GetSimdLevel(), s_nTestThreads[t], nDiff, nSimdDiff);
+						nFailed++;
+					}
+				}
+			}
+		}
+	}
+
+	CImgConv::SetSimdLevel(IMG_SIMD_AVX2);
+	CImgParallel::SetThreadCount(0);
+
+	printf("selftest: template %d/%d passed\n", nChecked - nFailed, nChecked);
+	return nFailed;
+}
+
+// ֵ˲Ĳʵ֣ڽȡͼڵĲ֣ۼֵȡΪʱΪ0
+static void BoxFilterReference(const CImgProcess& imgSrc, int nFilterH, int nFilterW, int nFilterMY, int nFilterMX,
+	std::vector<double>& vecMean)
+{
+	int nHeight = imgSrc.GetHeight();
+	int nWidth = imgSrc.GetWidthPixel();
+	vecMean.assign((size_t)nWidth * nHeight, 0);
+
+	for (int i = 0; i < nHeight; i++)
+	{
+		int y0 = max(i - nFilterMY, 0), y1 = min(i - nFilterMY + nFilterH, nHeight);
+		for (int j = 0; j < nWidth; j++)
+		{
+			int x0 = max(j - nFilterMX, 0), x1 = min(j - nFilterMX + nFilterW, nWidth);
+			long long nSum = 0;
+			for (int y = y0; y < y1; y++)
+				for (int x = x0; x < x1; x++)
+					nSum += imgSrc.GetGray(x, y);
+
+			int nArea = max(x1 - x0, 0) * max(y1 - y0, 0);
+			vecMean[(size_t)i * nWidth + j] = nArea > 0 ? (double)nSum / nArea : 0;
+		}
+	}
+}
+
+// ֵ˲ͼĻع飺BoxFilter8λĽȡھֵ
+// ֵ֮ͬfloatڣڿԴͼ
+// Ŀڴ֮⡣ͼΣվκͼϲѯĺ͡
+// ֱֵӼһ
+static int SelfTestBoxFilter()
+{
+	static const int s_nBoxThreads[] = {1, 0, 4};
+
+	struct SCase
+	{
+		int nFilterH, nFilterW, nFilterMY, nFilterMX;
+	};
+	static const SCase s_cases[] = {
+		{3, 3, 1, 1},
+		{15, 9, 7, 4},
+		{4, 6, 0, 5},
+		{5, 5, 4, 0},
+		{301, 401, 150, 200},
+		{90, 7, 95, 3},
+	};
+
+	CImgProcess imgs[2];
+	MakeTestImage(&imgs[0], 83, 141, IMG_FMT_GRAY8, FALSE);
+	MakeTestImage(&imgs[1], 37, 59, IMG_FMT_RGB24, FALSE);
+
+	int nFailed = 0, nChecked = 0;
+	for (size_t n = 0; n < sizeof(imgs) / sizeof(imgs[0]); n++)
+	{
+		int nHeight = imgs[n].GetHeight(), nWidth = imgs[n].GetWidthPixel();
+		for (size_t c = 0; c < sizeof(s_cases) / sizeof(s_cases[0]); c++)
+		{
+			const SCase& tc = s_cases[c];
+			std::vector<double> vecMean;
+			BoxFilterReference(imgs[n], tc.nFilterH, tc.nFilterW, tc.nFilterMY, tc.nFilterMX, vecMean);
+
+			CImgProcess imgRef = imgs[n];
+			imgRef.MakeUnique();
+			for (int i = 0; i < nHeight; i++)
+			{
+				for (int j = 0; j < nWidth; j++)
+				{
+					BYTE bt = (BYTE)(vecMean[(size_t)i * nWidth + j] + 0.5);
+					imgRef.SetPixel(j, i, RGB(bt, bt, bt));
+				}
+			}
+
+			for (size_t t = 0; t < sizeof(s_nBoxThreads) / sizeof(s_nBoxThreads[0]); t++)
+			{
+				CImgParallel::SetThreadCount(s_nBoxThreads[t]);
+
+				CImgProcess imgOut = imgs[n];
+				imgs[n].BoxFilter(&imgOut, tc.nFilterH, tc.nFilterW, tc.nFilterMY, tc.nFilterMX);
+				int nDiff = MaxPixelDiff(imgOut, imgRef);
+
+				CImgProcess imgFloat;
+				imgFloat.Create(nHeight, nWidth, IMG_FMT_FLOAT32);
+				imgs[n].BoxFilter(&imgFloat, tc.nFilterH, tc.nFilterW, tc.nFilterMY, tc.nFilterMX);
+				double dMaxErr = 0;
+				std::vector<float> vecRow(nWidth);
+				for (int i = 0; i < nHeight; i++)
+				{
+					const float* pRow = imgFloat.GetFloatRow(i, &vecRow[0]);
+					for (int j = 0; j < nWidth; j++)
+						dMaxErr = max(dMaxErr, fabs(pRow[j] - vecMean[(size_t)i * nWidth + j]));
+				}
+
+				nChecked++;
+				if (nDiff != 0 || dMaxErr > 1e-3)
+				{
+					fprintf(stderr, "selftest: boxfilter image %d window %dx%d threads %d: diff %d, float error %g\n",
+						(int)n, tc.nFilterH, tc.nFilterW, s_nBoxThreads[t], nDiff, dMaxErr);
+					nFailed++;
+				}
+			}
+		}
+
+		// ͼΣ˵ͬվΣһΪͼ
+		SIntegralImage integral;
+		BOOL bSuc = imgs[n].GenIntegral(&integral, TRUE);
+		unsigned nSeed = 4321;
+		int nWrong = 0;
+		for (int r = 0; bSuc && r < 200; r++)
+		{
+			int nX[2], nY[2];
+			for (int e = 0; e < 2; e++)
+			{
+				nSeed = nSeed * 1103515245 + 12345;
+				nX[e] = (int)((nSeed >> 16) % (nWidth + 1));
+				nSeed = nSeed * 1103515245 + 12345;
+				nY[e] = (int)((nSeed >> 16) % (nHeight + 1));
+			}
+			int x0 = min(nX[0], nX[1]), x1 = max(nX[0], nX[1]);
+			int y0 = min(nY[0], nY[1]), y1 = max(nY[0], nY[1]);
+			if (r == 0)
+			{
+				x0 = y0 = 0;
+				x1 = nWidth;
+				y1 = nHeight;
+			}
+
+			double dSum = 0, dSqSum = 0;
+			for (int y = y0; y < y1; y++)
+			{
+				for (int x = x0; x < x1; x++)
+				{
+					int nGray = imgs[n].GetGray(x, y);
+					dSum += nGray;
+					dSqSum += (double)nGray * nGray;
+				}
+			}
+			int nArea = (x1 - x0) * (y1 - y0);
+			double dMean = nArea > 0 ? dSum / nArea : 0;
+			double dVar = nArea > 0 ? dSqSum / nArea - dMean * dMean : 0;
+
+			if (integral.GetSum(x0, y0, x1, y1) != dSum || fabs(integral.GetMean(x0, y0, x1, y1) - dMean) > 1e-9
+				|| fabs(integral.GetVariance(x0, y0, x1, y1) - dVar) > 1e-6)
+				nWrong++;
+		}
+
+		nChecked++;
+		if (!bSuc || nWrong)
+		{
+			fprintf(stderr, "selftest: integral image %d: %d rectangles differ from direct sums\n", (int)n, nWrong);
+			nFailed++;
+		}
+	}
+
+	CImgParallel::SetThreadCount(0);
+
+	printf("selftest: boxfilter %d/%d passed\n", nChecked - nFailed, nChecked);
+	return nFailed;
+}
+
+// ֵ˲Ļع飺ȡڵĻҶֵżʱȡмƽֵ
+// MedianFilterıȽϽ硢ֱͼʵֱȽϣλͬ
+// ڲȫͼıԵΪ0
+static void MedianReference(const CImgProcess& imgSrc, CImgProcess* pTo, int nFilterH, int nFilterW, int nFilterMY, int nFilterMX)
+{
+	int nHeight = imgSrc.GetHeight();
+	int nWidth = imgSrc.GetWidthPixel();
+	*pTo = imgSrc;
+	pTo->InitPixels(0);
+
+	std::vector<int> vecWindow((size_t)nFilterH * nFilterW);
+	int nLen = (int)vecWindow.size();
+	for (int i = nFilterMY; i < nHeight - nFilterH + nFilterMY + 1; i++)
+	{
+		for (int j = nFilterMX; j < nWidth - nFilterW + nFilterMX + 1; j++)
+		{
+			for (int k = 0; k < nFilterH; k++)
+				for (int l = 0; l < nFilterW; l++)
+					vecWindow[k * nFilterW + l] = imgSrc.GetGray(j + l - nFilterMX, i + k - nFilterMY);
+
+			std::sort(vecWindow.begin(), vecWindow.end());
+			int nGray = (nLen & 1) ? vecWindow[nLen / 2] : (vecWindow[nLen / 2 - 1] + vecWindow[nLen / 2]) / 2;
+			pTo->SetPixel(j, i, RGB(nGray, nGray, nGray));
+		}
+	}
+}
+
+static int SelfTestMedian()
+{
+	// 3355߱ȽϽ磬ֱͼǶԳƴΪż
+	struct SCase
+	{
+		int nFilterH, nFilterW, nFilterMY, nFilterMX;
+	};
+	static const SCase s_cases[] = {
+		{3, 3, 1, 1},
+		{5, 5, 2, 2},
+		{9, 9, 4, 4},
+		{15, 15, 7, 7},
+		{4, 7, 1, 5},
+	};
+
+	// ȴֱͼȣ256УĽӷ
+	CImgProcess imgs[2];
+	MakeTestImage(&imgs[0], 41, 300, IMG_FMT_GRAY8, FALSE);
+	MakeTestImage(&imgs[1], 29, 283, IMG_FMT_RGB24, FALSE);
+
+	int nFailed = 0, nChecked = 0;
+	for (size_t n = 0; n < sizeof(imgs) / sizeof(imgs[0]); n++)
+	{
+		for (size_t c = 0; c < sizeof(s_cases) / sizeof(s_cases[0]); c++)
+		{
+			const SCase& tc = s_cases[c];
+			CImgProcess imgRef;
+			MedianReference(imgs[n], &imgRef, tc.nFilterH, tc.nFilterW, tc.nFilterMY, tc.nFilterMX);
+
+			for (int t = 0; t < TEST_THREAD_COUNTS; t++)
+			{
+				CImgParallel::SetThreadCount(s_nTestThreads[t]);
+
+				CImgProcess imgOut = imgs[n];
+				imgs[n].MedianFilter(&imgOut, tc.nFilterH, tc.nFilterW, tc.nFilterMY, tc.nFilterMX);
+
+				int nDiff = MaxPixelDiff(imgOut, imgRef);
+				nChecked++;
+				if (nDiff != 0)
+				{
+					fprintf(stderr, "selftest: median image %d window %dx%d threads %d: diff %d from reference\n",
+						(int)n, tc.nFilterH, tc.nFilterW, s_nTestThreads[t], nDiff);
+					nFailed++;
+				}
+			}
+		}
+	}
+
+	CImgParallel::SetThreadCount(0);
+
+	printf("selftest: median %d/%d passed\n", nChecked - nFailed, nChecked);
+	return nFailed;
+}
+
+// ɱͼͳƸӾκģpLabel->vecStatȽ
+static BOOL RgnStatMatches(const SConnRgnLabel& label)
+{
+	if ((int)label.vecStat.size() != label.nCount || label.vecLabel.size() != (size_t)label.nWidth * label.nHeight)
+		return FALSE;
+
+	std::vector<int> vecArea(label.nCount, 0);
+	std::vector<int> vecLeft(label.nCount, label.nWidth), vecTop(label.nCount, label.nHeight);
+	std::vector<int> vecRight(label.nCount, -1), vecBottom(label.nCount, -1);
+	std::vector<double> vecSumX(label.nCount, 0), vecSumY(label.nCount, 0);
+	for (int i = 0; i < label.nHeight; i++)
+	{
+		for (int j = 0; j < label.nWidth; j++)
+		{
+			int n = label.GetLabel(i)[j] - 1;
+			if (n < 0)
+				continue;
+			if (n >= label.nCount)
+				return FALSE;
+			vecArea[n]++;
+			vecLeft[n] = min(vecLeft[n], j);
+			vecTop[n] = min(vecTop[n], i);
+			vecRight[n] = max(vecRight[n], j);
+			vecBottom[n] = max(vecBottom[n], i);
+			vecSumX[n] += j;
+			vecSumY[n] += i;
+		}
+	}
+
+	for (int n = 0; n < label.nCount; n++)
+	{
+		const SConnRgnStat& stat = label.vecStat[n];
+		if (stat.nArea != vecArea[n])
+			return FALSE;
+		if (vecArea[n] == 0)
+			continue;
+		if (stat.nLeft != vecLeft[n] || stat.nTop != vecTop[n] || stat.nRight != vecRight[n] || stat.nBottom != vecBottom[n])
+			return FALSE;
+		if (fabs(stat.dCenterX - vecSumX[n] / vecArea[n]) > 1e-9 || fabs(stat.dCenterY - vecSumY[n] / vecArea[n]) > 1e-9)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+// ˮĻع飺ֻһʱ뵥ӵRegionGrowͬ
+// ظֻеһЧΪ0ͼ֮ʱFALSE
+// ˮ׶صͼϼ飺ÿ㶼ţӵ˳ţ
+// ˮԶĵڵ
+static int SelfTestSeedGrow()
+{
+	int nFailed = 0, nChecked = 0;
+
+	CImgProcess img;
+	MakeTestImage(&img, 53, 71, IMG_FMT_GRAY8, FALSE);
+	int nHeight = img.GetHeight(), nWidth = img.GetWidthPixel();
+
+	static const POINT s_ptSeeds[] = {{0, 0}, {35, 26}, {70, 52}, {12, 40}};
+	static const BYTE s_bThres[] = {15, 40, 70};
+	for (size_t s = 0; s < sizeof(s_ptSeeds) / sizeof(s_ptSeeds[0]); s++)
+	{
+		for (size_t t = 0; t < sizeof(s_bThres) / sizeof(s_bThres[0]); t++)
+		{
+			CImgProcess imgSingle = img;
+			SConnRgnLabel label;
+			BOOL bSuc = img.RegionGrow(&imgSingle, s_ptSeeds[s].x, s_ptSeeds[s].y, s_bThres[t])
+				&& img.RegionGrow(&label, &s_ptSeeds[s], 1, s_bThres[t]);
+
+			int nMismatch = 0;
+			for (int i = 0; bSuc && i < nHeight; i++)
+				for (int j = 0; j < nWidth; j++)
+					nMismatch += (label.GetLabel(i)[j] == 1) != (imgSingle.GetGray(j, i) == 255);
+
+			nChecked++;
+			if (!bSuc || nMismatch || label.nCount != 1 || !RgnStatMatches(label))
+			{
+				fprintf(stderr, "selftest: seedgrow seed (%d, %d) threshold %d: %d pixels differ from single-seed RegionGrow\n",
+					(int)s_ptSeeds[s].x, (int)s_ptSeeds[s].y, s_bThres[t], nMismatch);
+				nFailed++;
+			}
+		}
+	}
+
+	// ظӣȥظͬΪ0
+	{
+		POINT ptUnique[2] = {s_ptSeeds[1], s_ptSeeds[3]};
+		POINT ptDup[4] = {s_ptSeeds[1], s_ptSeeds[3], s_ptSeeds[1], s_ptSeeds[3]};
+		SConnRgnLabel labelUnique, labelDup;
+		BOOL bSuc = img.RegionGrow(&labelUnique, ptUnique, 2, 40) && img.RegionGrow(&labelDup, ptDup, 4, 40);
+
+		nChecked++;
+		if (!bSuc || labelDup.nCount != 4 || labelDup.vecLabel != labelUnique.vecLabel || !RgnStatMatches(labelDup)
+			|| labelDup.vecStat[2].nArea != 0 || labelDup.vecStat[3].nArea != 0)
+		{
+			fprintf(stderr, "selftest: seedgrow duplicate seeds: result differs from unique seeds\n");
+			nFailed++;
+		}
+	}
+
+	// ͼ֮
+	{
+		POINT ptOut[4][2] = {{{1, 1}, {-1, 5}}, {{1, 1}, {nWidth, 5}}, {{1, 1}, {5, -1}}, {{1, 1}, {5, nHeight}}};
+		for (int k = 0; k < 4; k++)
+		{
+			SConnRgnLabel label;
+			nChecked++;
+			if (img.RegionGrow(&label, ptOut[k], 2, 40) || img.Watershed(&label, ptOut[k], 2))
+			{
+				fprintf(stderr, "selftest: seedgrow seed (%d, %d) outside the image accepted\n",
+					(int)ptOut[k][1].x, (int)ptOut[k][1].y);
+				nFailed++;
+			}
+		}
+	}
+
+	// ˮ룺׶أҶΪϽ׵ľ룬Ӱҵ˳
+	{
+		CImgProcess imgBasin;
+		imgBasin.Create(48, 90, IMG_FMT_GRAY8);
+		POINT ptBasin[3] = {{65, 30}, {20, 18}, {65, 30}};
+		for (int i = 0; i < 48; i++)
+		{
+			for (int j = 0; j < 90; j++)
+			{
+				double d0 = sqrt((double)(j - ptBasin[0].x) * (j - ptBasin[0].x) + (double)(i - ptBasin[0].y) * (i - ptBasin[0].y));
+				double d1 = sqrt((double)(j - ptBasin[1].x) * (j - ptBasin[1].x) + (double)(i - ptBasin[1].y) * (i - ptBasin[1].y));
+				BYTE bGray = (BYTE)min(4 * min(d0, d1), 255.0);
+				imgBasin.SetPixel(j, i, RGB(bGray, bGray, bGray));
+			}
+		}
+
+		SConnRgnLabel label;
+		BOOL bSuc = imgBasin.Watershed(&label, ptBasin, 3);
+		int nUnlabelled = 0, nWrongBasin = 0;
+		for (int i = 0; bSuc && i < 48; i++)
+		{
+			for (int j = 0; j < 90; j++)
+			{
+				int nLabel = label.GetLabel(i)[j];
+				nUnlabelled += nLabel <= 0;
+
+				double d0 = sqrt((double)(j - ptBasin[0].x) * (j - ptBasin[0].x) + (double)(i - ptBasin[0].y) * (i - ptBasin[0].y));
+				double d1 = sqrt((double)(j - ptBasin[1].x) * (j - ptBasin[1].x) + (double)(i - ptBasin[1].y) * (i - ptBasin[1].y));
+				if (fabs(d0 - d1) > 3)
+					nWrongBasin += nLabel != (d0 < d1 ? 1 : 2);
+			}
+		}
+
+		nChecked++;
+		if (!bSuc || label.nCount != 3 || nUnlabelled || nWrongBasin || !RgnStatMatches(label)
+			|| label.vecStat[0].nArea + label.vecStat[1].nArea != 48 * 90 || label.vecStat[2].nArea != 0)
+		{
+			fprintf(stderr, "selftest: watershed two basins: %d pixels unlabelled, %d in the wrong basin\n",
+				nUnlabelled, nWrongBasin);
+			nFailed++;
+		}
+	}
+
+	printf("selftest: seedgrow %d/%d passed\n", nChecked - nFailed, nChecked);
+	return nFailed;
+}
+
+// ͨŵĲʵ֣դ˳ҵδŵǰأҶΪ0
+// bSkipBorderʱͼһȦ
+static void ConnRgnReference(const CImgProcess& img, int nConn, BOOL bSkipBorder, std::vector<int>& vecLabel, int& nCount)
+{
+	static const int s_nDX[8] = {0, -1, 1, 0, -1, 1, -1, 1};
+	static const int s_nDY[8] = {-1, 0, 0, 1, -1, -1, 1, 1};
+
+	int nHeight = img.GetHeight(), nWidth = img.GetWidthPixel();
+	int nBorder = bSkipBorder ? 1 : 0;
+	vecLabel.assign((size_t)nWidth * nHeight, 0);
+	nCount = 0;
+
+	std::vector<int> vecQueue;
+	for (int i = nBorder; i < nHeight - nBorder; i++)
+	{
+		for (int j = nBorder; j < nWidth - nBorder; j++)
+		{
+			if (img.GetGray(j, i) != 0 || vecLabel[(size_t)i * nWidth + j])
+				continue;
+
+			nCount++;
+			vecLabel[(size_t)i * nWidth + j] = nCount;
+			vecQueue.assign(1, i * nWidth + j);
+			for (size_t h = 0; h < vecQueue.size(); h++)
+			{
+				int x = vecQueue[h] % nWidth, y = vecQueue[h] / nWidth;
+				for (int k = 0; k < nConn; k++)
+				{
+					int nx = x + s_nDX[k], ny = y + s_nDY[k];
+					if (nx < nBorder || nx >= nWidth - nBorder || ny < nBorder || ny >= nHeight - nBorder)
+						continue;
+					if (img.GetGray(nx, ny) != 0 || vecLabel[(size_t)ny * nWidth + nx])
+						continue;
+					vecLabel[(size_t)ny * nWidth + nx] = nCount;
+					vecQueue.push_back(ny * nWidth + nx);
+				}
+			}
+		}
+	}
+}
+
+// ȷĶֵͼԼnPercent%ΪǰҶ0
+static void MakeBinaryImage(CImgProcess* pImg, int nHeight, int nWidth, int nPercent, unsigned nSeed)
+{
+	pImg->Create(nHeight, nWidth, IMG_FMT_GRAY8);
+	for (int i = 0; i < nHeight; i++)
+	{
+		for (int j = 0; j < nWidth; j++)
+		{
+			nSeed = nSeed * 1103515245 + 12345;
+			BYTE bGray = (int)((nSeed >> 16) % 100) < nPercent ? 0 : 255;
+			pImg->SetPixel(j, i, RGB(bGray, bGray, bGray));
+		}
+	}
+}
+
+// ͨŵĻع飺GenConnRgnıšĲʵͬ
+// ͳͼһ£LabelConnRgnձдɵĻҶͬ
+// ̺߳ȫ߳4̣֤߳ʹֻһCPUҲֳɼд
+// д֮ĺϲ
+static int SelfTestConnRgn()
+{
+	static const int s_nConnThreads[] = {1, 0, 4};
+
+	CImgProcess imgs[3];
+	MakeBinaryImage(&imgs[0], 300, 123, 45, 1);
+	MakeBinaryImage(&imgs[1], 260, 64, 60, 2);
+	MakeBinaryImage(&imgs[2], 32, 48, 15, 3);
+
+	int nFailed = 0, nChecked = 0;
+	for (size_t n = 0; n < sizeof(imgs) / sizeof(imgs[0]); n++)
+	{
+		for (int nConn = 4; nConn <= 8; nConn += 4)
+		{
+			std::vector<int> vecRef, vecRefSkip;
+			int nRefCount, nRefSkipCount;
+			ConnRgnReference(imgs[n], nConn, FALSE, vecRef, nRefCount);
+			ConnRgnReference(imgs[n], nConn, TRUE, vecRefSkip, nRefSkipCount);
+
+			// LabelConnRgnΪɫǰ255ΪŵĻҶȣౣԭ
+			CImgProcess imgLabelRef = imgs[n];
+			int nHeight = imgs[n].GetHeight(), nWidth = imgs[n].GetWidthPixel();
+			for (int i = 0; i < nHeight; i++)
+			{
+				for (int j = 0; j < nWidth; j++)
+				{
+					int nLabel = vecRefSkip[(size_t)i * nWidth + j];
+					if (i == 0 || j == 0 || i == nHeight - 1 || j == nWidth - 1)
+						imgLabelRef.SetPixel(j, i, RGB(255, 255, 255));
+					else if (nLabel > 0 && nLabel <= 255)
+						imgLabelRef.SetPixel(j, i, RGB(nLabel, nLabel, nLabel));
+				}
+			}
+
+			for (size_t t = 0; t < sizeof(s_nConnThreads) / sizeof(s_nConnThreads[0]); t++)
+			{
+				CImgParallel::SetThreadCount(s_nConnThreads[t]);
+
+				SConnRgnLabel label;
+				BOOL bSuc = imgs[n].GenConnRgn(&label, nConn);
+				nChecked++;
+				if (!bSuc || label.nCount != nRefCount || label.vecLabel != vecRef || !RgnStatMatches(label))
+				{
+					fprintf(stderr, "selftest: connrgn image %d conn %d threads %d: %d components, reference %d\n",
+						(int)n, nConn, s_nConnThreads[t], label.nCount, nRefCount);
+					nFailed++;
+				}
+
+				if (nRefSkipCount > 255)
+					continue; //LabelConnRgnֻܱע255
+
+				CImgProcess imgLabel;
+				imgs[n].LabelConnRgn(&imgLabel, nConn);
+				int nDiff = MaxPixelDiff(imgLabel, imgLabelRef);
+				nChecked++;
+				if (nDiff != 0)
+				{
+					fprintf(stderr, "selftest: labelconnrgn image %d conn %d threads %d: diff %d from reference\n",
+						(int)n, nConn, s_nConnThreads[t], nDiff);
+					nFailed++;
+				}
+			}
+		}
+	}
+
+	CImgParallel::SetThreadCount(0);
+
+	printf("selftest: connrgn %d/%d passed\n", nChecked - nFailed, nChecked);
+	return nFailed;
+}
+
+// ֵʴ͵Ĳʵ֣ṹԪظǵأǰΪҶ0
+// ͰṹԪعĵĶԳƼ㣻ṹԪزȫͼڵΪ
+static void BinMorphReference(const CImgProcess& imgSrc, CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX,
+	int** se, BOOL bErode)
+{
+	int nHeight = imgSrc.GetHeight();
+	int nWidth = imgSrc.GetWidthPixel();
+	*pTo = imgSrc;
+	pTo->InitPixels(255);
+
+	int nOffY0 = bErode ? -nTempMY : nTempMY - (nTempH - 1);
+	int nOffX0 = bErode ? -nTempMX : nTempMX - (nTempW - 1);
+	for (int i = -nOffY0; i < nHeight - (nOffY0 + nTempH - 1); i++)
+	{
+		for (int j = -nOffX0; j < nWidth - (nOffX0 + nTempW - 1); j++)
+		{
+			BOOL bFg = bErode;
+			for (int k = 0; k < nTempH; k++)
+			{
+				for (int l = 0; l < nTempW; l++)
+				{
+					if (se[k][l] == -1)
+						continue;
+					if (bErode)
+					{
+						BOOL bSrcFg = imgSrc.GetGray(j + l - nTempMX, i + k - nTempMY) == 0;
+						bFg = bFg && (bSrcFg == (se[k][l] == 1));
+					}
+					else
+						bFg = bFg || imgSrc.GetGray(j + nTempMX - l, i + nTempMY - k) == 0;
+				}
+			}
+			if (bFg)
+				pTo->SetPixel(j, i, RGB(0, 0, 0));
+		}
+	}
+}
+
+// ֵ̬ѧĻع飺ṹԪصErodeDilateĲʵֱȽϣ
+// ṹԪزǾΡĲУͼȲ64ıλѹĩβһֵĲ
+static int SelfTestBinMorph()
+{
+	static const int s_nMorphThreads[] = {1, 0, 4};
+
+	// 57ڵ1е5У0ֻڸʴлУ
+	static int s_nSe1[5][7] = {
+		{-1, 1, 1, 1, -1, -1, -1},
+		{1, 1, -1, 1, 1, 1, -1},
+		{-1, 1, 1, 1, 1, 1, 1},
+		{-1, -1, 1, -1, 1, -1, -1},
+		{-1, -1, -1, 1, 1, 1, -1},
+	};
+	// 46½ǣΪҲΪǰֱԵ
+	static int s_nSe2[4][6] = {
+		{0, 1, 1, -1, -1, -1},
+		{0, 1, 1, 1, -1, -1},
+		{0, -1, 1, 1, 1, -1},
+		{-1, -1, -1, 1, 1, 1},
+	};
+	// 77Σڵ2е5
+	static int s_nSe3[7][7] = {
+		{-1, -1, -1, 1, -1, -1, -1},
+		{-1, -1, 1, 1, 1, -1, -1},
+		{-1, 1, 1, 1, 1, 1, -1},
+		{1, 1, 1, 1, 1, 1, 1},
+		{-1, 1, 1, 1, 1, 1, -1},
+		{-1, -1, 1, 1, 1, -1, -1},
+		{-1, -1, -1, 1, -1, -1, -1},
+	};
+	static int* s_pSe1[5] = {s_nSe1[0], s_nSe1[1], s_nSe1[2], s_nSe1[3], s_nSe1[4]};
+	static int* s_pSe2[4] = {s_nSe2[0], s_nSe2[1], s_nSe2[2], s_nSe2[3]};
+	static int* s_pSe3[7] = {s_nSe3[0], s_nSe3[1], s_nSe3[2], s_nSe3[3], s_nSe3[4], s_nSe3[5], s_nSe3[6]};
+
+	struct SCase
+	{
+		int nTempH, nTempW, nTempMY, nTempMX;
+		int** se;
+		BOOL bErode;
+	};
+	static const SCase s_cases[] = {
+		{5, 7, 1, 5, s_pSe1, TRUE},
+		{5, 7, 1, 5, s_pSe1, FALSE},
+		{4, 6, 3, 0, s_pSe2, TRUE},
+		{7, 7, 2, 5, s_pSe3, TRUE},
+		{7, 7, 2, 5, s_pSe3, FALSE},
+		{DISC_SIZE, DISC_SIZE, DISC_RADIUS, DISC_RADIUS, s_pDiscSe, FALSE},
+	};
+	InitDisc();
+
+	// бƵǰдƬ
+	CImgProcess imgs[2];
+	static const int s_nSize[2][2] = {{70, 130}, {83, 201}};
+	for (int n = 0; n < 2; n++)
+	{
+		int nHeight = s_nSize[n][0], nWidth = s_nSize[n][1];
+		imgs[n].Create(nHeight, nWidth, IMG_FMT_GRAY8);
+		unsigned nSeed = 777 + n;
+		for (int i = 0; i < nHeight; i++)
+		{
+			for (int j = 0; j < nWidth; j++)
+			{
+				nSeed = nSeed * 1103515245 + 12345;
+				BOOL bFg = ((j / 9 + i / 7) % 3 != 0) != ((nSeed >> 16) % 100 < 3);
+				BYTE bGray = bFg ? 0 : 255;
+				imgs[n].SetPixel(j, i, RGB(bGray, bGray, bGray));
+			}
+		}
+	}
+
+	int nFailed = 0, nChecked = 0;
+	for (size_t n = 0; n < sizeof(imgs) / sizeof(imgs[0]); n++)
+	{
+		for (size_t c = 0; c < sizeof(s_cases) / sizeof(s_cases[0]); c++)
+		{
+			const SCase& tc = s_cases[c];
+			CImgProcess imgRef;
+			BinMorphReference(imgs[n], &imgRef, tc.nTempH, tc.nTempW, tc.nTempMY, tc.nTempMX, tc.se, tc.bErode);
+
+			for (size_t t = 0; t < sizeof(s_nMorphThreads) / sizeof(s_nMorphThreads[0]); t++)
+			{
+				CImgParallel::SetThreadCount(s_nMorphThreads[t]);
+
+				CImgProcess imgOut = imgs[n];
+				if (tc.bErode)
+					imgs[n].Erode(&imgOut, tc.nTempH, tc.nTempW, tc.nTempMY, tc.nTempMX, tc.se);
+				else
+					imgs[n].Dilate(&imgOut, tc.nTempH, tc.nTempW, tc.nTempMY, tc.nTempMX, tc.se);
+
+				int nDiff = MaxPixelDiff(imgOut, imgRef);
+				nChecked++;
+				if (nDiff != 0)
+				{
+					fprintf(stderr, "selftest: binmorph image %d case %d (%s) threads %d: differs from reference\n",
+						(int)n, (int)c, tc.bErode ? "erode" : "dilate", s_nMorphThreads[t]);
+					nFailed++;
+				}
+			}
+		}
+	}
+
+	CImgParallel::SetThreadCount(0);
+
+	printf("selftest: binmorph %d/%d passed\n", nChecked - nFailed, nChecked);
+	return nFailed;
+}
+
+// Ҷȸʴ͵Ĳʵ֣ȡṹԪΪ1ԪظǵСҶȡ
+// ģ岻ȫͼڵرԭֵ
+static void GrayMorphReference(const CImgProcess& imgSrc, CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX,
+	int** se, BOOL bDilate)
+{
+	int nHeight = imgSrc.GetHeight();
+	int nWidth = imgSrc.GetWidthPixel();
+	*pTo = imgSrc;
+	pTo->MakeUnique();
+
+	for (int i = nTempMY; i < nHeight - nTempH + nTempMY + 1; i++)
+	{
+		for (int j = nTempMX; j < nWidth - nTempW + nTempMX + 1; j++)
+		{
+			int nGray = bDilate ? 0 : 255;
+			for (int k = 0; k < nTempH; k++)
+			{
+				for (int l = 0; l < nTempW; l++)
+				{
+					if (se[k][l] != 1)
+						continue;
+					int nIn = imgSrc.GetGray(j + l - nTempMX, i + k - nTempMY);
+					nGray = bDilate ? max(nGray, nIn) : min(nGray, nIn);
+				}
+			}
+			pTo->SetPixel(j, i, RGB(nGray, nGray, nGray));
+		}
+	}
+}
+
+// νṹԪػҶ̬ѧĻع飺32Ԫصľvan Herk/Gil-Werman㷨
+// ȡСֵĲʵֱȽϣλͬοֻռģһ֣
+// ĲУͼܱԭֵĲҲһȽ
+static int SelfTestGrayMorph()
+{
+	static const int s_nMorphThreads[] = {1, 0, 4};
+
+	// 910ģе17С28Ϊ1Ϊ-1
+	static int s_nPadded[9][10];
+	static int* s_pPadded[9];
+	for (int k = 0; k < 9; k++)
+	{
+		for (int l = 0; l < 10; l++)
+			s_nPadded[k][l] = (k >= 1 && k <= 7 && l >= 2 && l <= 8) ? 1 : -1;
+		s_pPadded[k] = s_nPadded[k];
+	}
+
+	// ȫΪ1ľģ壬нs_nOnes
+	static int s_nOnes[21];
+	static int* s_pOnes[21];
+	for (int k = 0; k < 21; k++)
+	{
+		s_nOnes[k] = 1;
+		s_pOnes[k] = s_nOnes;
+	}
+
+	struct SCase
+	{
+		int nTempH, nTempW, nTempMY, nTempMX;
+		int** se;
+	};
+	static const SCase s_cases[] = {
+		{7, 7, 3, 3, s_pOnes},
+		{21, 3, 17, 0, s_pOnes},
+		{3, 21, 1, 12, s_pOnes},
+		{9, 10, 2, 7, s_pPadded},
+	};
+
+	CImgProcess imgs[2];
+	MakeTestImage(&imgs[0], 80, 97, IMG_FMT_GRAY8, FALSE);
+	MakeTestImage(&imgs[1], 61, 75, IMG_FMT_RGB24, FALSE);
+
+	int nFailed = 0, nChecked = 0;
+	for (size_t n = 0; n < sizeof(imgs) / sizeof(imgs[0]); n++)
+	{
+		for (size_t c = 0; c < sizeof(s_cases) / sizeof(s_cases[0]); c++)
+		{
+			const SCase& tc = s_cases[c];
+			for (int bDilate = 0; bDilate < 2; bDilate++)
+			{
+				CImgProcess imgRef;
+				GrayMorphReference(imgs[n], &imgRef, tc.nTempH, tc.nTempW, tc.nTempMY, tc.nTempMX, tc.se, bDilate);
+
+				for (size_t t = 0; t < sizeof(s_nMorphThreads) / sizeof(s_nMorphThreads[0]); t++)
+				{
+					CImgParallel::SetThreadCount(s_nMorphThreads[t]);
+
+					CImgProcess imgOut = imgs[n];
+					if (bDilate)
+						imgs[n].GrayDilate(&imgOut, tc.nTempH, tc.nTempW, tc.nTempMY, tc.nTempMX, tc.se);
+					else
+						imgs[n].GrayErode(&imgOut, tc.nTempH, tc.nTempW, tc.nTempMY, tc.nTempMX, tc.se);
+
+					int nDiff = MaxPixelDiff(imgOut, imgRef);
+					nChecked++;
+					if (nDiff != 0)
+					{
+						fprintf(stderr, "selftest: graymorph image %d template %dx%d (%s) threads %d: diff %d from reference\n",
+							(int)n, tc.nTempH, tc.nTempW, bDilate ? "dilate" : "erode", s_nMorphThreads[t], nDiff);
+						nFailed++;
+					}
+				}
+			}
+		}
+	}
+
+	CImgParallel::SetThreadCount(0);
+
+	printf("selftest: graymorph %d/%d passed\n", nChecked - nFailed, nChecked);
+	return nFailed;
+}
+
+// FillRgnĲʵ֣ӣǱ߽ػͼһȦʱΪĸ4ڵ㣩
+// 0أ4ͨ䣬ͼһȦ䡣Ϊԭ߽Ĳ
+static void FillRgnReference(const CImgProcess& imgSrc, CImgProcess* pTo, POINT ptStart)
+{
+	static const int s_nDX[5] = {0, 0, -1, 1, 0};
+	static const int s_nDY[5] = {0, -1, 0, 0, 1};
+
+	int nHeight = imgSrc.GetHeight(), nWidth = imgSrc.GetWidthPixel();
+	std::vector<BYTE> vecFilled((size_t)nWidth * nHeight, 0);
+	std::vector<int> vecQueue;
+
+	for (int k = 0; k < 5; k++)
+	{
+		int x = ptStart.x + s_nDX[k], y = ptStart.y + s_nDY[k];
+		if (x < 1 || x >= nWidth - 1 || y < 1 || y >= nHeight - 1 || imgSrc.GetGray(x, y) == 0)
+			continue;
+		vecQueue.push_back(y * nWidth + x);
+		if (k == 0)
+			break;
+	}
+
+	for (size_t h = 0; h < vecQueue.size(); h++)
+	{
+		int x = vecQueue[h] % nWidth, y = vecQueue[h] / nWidth;
+		if (vecFilled[vecQueue[h]])
+			continue;
+		vecFilled[vecQueue[h]] = 1;
+		for (int k = 1; k < 5; k++)
+		{
+			int nx = x + s_nDX[k], ny = y + s_nDY[k];
+			if (nx >= 1 && nx < nWidth - 1 && ny >= 1 && ny < nHeight - 1
+				&& imgSrc.GetGray(nx, ny) != 0 && !vecFilled[(size_t)ny * nWidth + nx])
+				vecQueue.push_back(ny * nWidth + nx);
+		}
+	}
+
+	*pTo = imgSrc;
+	for (int i = 0; i < nHeight; i++)
+	{
+		for (int j = 0; j < nWidth; j++)
+		{
+			BYTE bGray = (imgSrc.GetGray(j, i) == 0 || vecFilled[(size_t)i * nWidth + j]) ? 0 : 255;
+			pTo->SetPixel(j, i, RGB(bGray, bGray, bGray));
+		}
+	}
+}
+
+// RegionGrowĲʵ֣ɨ赽㣺ӻҶȹ̶ʱ8ڽӡ
+// ӻҶ֮ֵĵ㲢ֱûµĵ㣻ٰӻҶȻ
+// ƽҶȣֱƽҶȲٱ仯vecInΪı
+static void RegionGrowReference(const CImgProcess& img, int nSeedX, int nSeedY, int nThre, std::vector<BYTE>& vecIn)
+{
+	int nHeight = img.GetHeight(), nWidth = img.GetWidthPixel();
+	vecIn.assign((size_t)nWidth * nHeight, 0);
+	vecIn[(size_t)nSeedY * nWidth + nSeedX] = 1;
+
+	int nSeed = img.GetGray(nSeedX, nSeedY);
+	long long nSum = nSeed, nCount = 1;
+	for (;;)
+	{
+		BOOL bChanged = TRUE;
+		while (bChanged)
+		{
+			bChanged = FALSE;
+			for (int i = 0; i < nHeight; i++)
+			{
+				for (int j = 0; j < nWidth; j++)
+				{
+					int nGray = img.GetGray(j, i);
+					if (vecIn[(size_t)i * nWidth + j] || abs(nGray - nSeed) > nThre)
+						continue;
+
+					BOOL bAdjacent = FALSE;
+					for (int m = max(i - 1, 0); m <= min(i + 1, nHeight - 1); m++)
+						for (int n = max(j - 1, 0); n <= min(j + 1, nWidth - 1); n++)
+							bAdjacent = bAdjacent || vecIn[(size_t)m * nWidth + n];
+					if (!bAdjacent)
+						continue;
+
+					vecIn[(size_t)i * nWidth + j] = 1;
+					nSum += nGray;
+					nCount++;
+					bChanged = TRUE;
+				}
+			}
+		}
+
+		int nMean = (int)(nSum / nCount);
+		if (nMean == nSeed)
+			break;
+		nSeed = nMean;
+	}
+}
+
+// FillRgnRegionGrowPixelImageĻع飬ĲʵֱȽϡ
+// FillRgnӰڲ߽ءͼһȦϵĵ㣻
+// PixelImageͼг1000صͨԭݹͳƵޣ
+static int SelfTestFill()
+{
+	int nFailed = 0, nChecked = 0;
+
+	// αֻ߽б4ͨ䲻ܴб©ͼ±
+	CImgProcess imgBound;
+	imgBound.Create(60, 80, IMG_FMT_GRAY8);
+	for (int i = 0; i < 60; i++)
+	{
+		for (int j = 0; j < 80; j++)
+		{
+			BOOL bEdge = abs(j - 25) + abs(i - 30) == 15
+				|| ((j == 50 || j == 75) && i >= 10 && i <= 45) || ((i == 10 || i == 45) && j >= 50 && j <= 75)
+				|| (j == 62 && i >= 50);
+			imgBound.SetPixel(j, i, bEdge ? RGB(0, 0, 0) : RGB(255, 255, 255));
+		}
+	}
+
+	static const POINT s_ptFill[] = {{25, 30}, {25, 15}, {44, 30}, {62, 20}, {75, 30}, {0, 40}, {0, 0}, {62, 59}, {79, 52}};
+	for (size_t s = 0; s < sizeof(s_ptFill) / sizeof(s_ptFill[0]); s++)
+	{
+		CImgProcess imgRef, imgOut = imgBound;
+		FillRgnReference(imgBound, &imgRef, s_ptFill[s]);
+		imgBound.FillRgn(&imgOut, s_ptFill[s]);
+
+		int nDiff = MaxPixelDiff(imgOut, imgRef);
+		nChecked++;
+		if (nDiff != 0)
+		{
+			fprintf(stderr, "selftest: fillrgn seed (%d, %d): differs from reference\n", (int)s_ptFill[s].x, (int)s_ptFill[s].y);
+			nFailed++;
+		}
+	}
+
+	// ͼϵĲƽͼƽҶȶα仯
+	CImgProcess imgGrow[2];
+	MakeTestImage(&imgGrow[0], 53, 71, IMG_FMT_GRAY8, FALSE);
+	imgGrow[1].Create(40, 64, IMG_FMT_GRAY8);
+	for (int i = 0; i < 40; i++)
+	{
+		for (int j = 0; j < 64; j++)
+		{
+			BYTE bGray = (BYTE)(j * 3 + i + ((i * 7 + j * 13) % 5));
+			imgGrow[1].SetPixel(j, i, RGB(bGray, bGray, bGray));
+		}
+	}
+
+	static const POINT s_ptGrow[] = {{0, 0}, {35, 26}, {63, 39}};
+	static const BYTE s_bThres[] = {10, 40, 70};
+	for (int n = 0; n < 2; n++)
+	{
+		int nHeight = imgGrow[n].GetHeight(), nWidth = imgGrow[n].GetWidthPixel();
+		for (size_t s = 0; s < sizeof(s_ptGrow) / sizeof(s_ptGrow[0]); s++)
+		{
+			for (size_t t = 0; t < sizeof(s_bThres) / sizeof(s_bThres[0]); t++)
+			{
+				std::vector<BYTE> vecIn;
+				RegionGrowReference(imgGrow[n], s_ptGrow[s].x, s_ptGrow[s].y, s_bThres[t], vecIn);
+
+				CImgProcess imgOut = imgGrow[n];
+				BOOL bSuc = imgGrow[n].RegionGrow(&imgOut, s_ptGrow[s].x, s_ptGrow[s].y, s_bThres[t]);
+				int nMismatch = 0;
+				for (int i = 0; bSuc && i < nHeight; i++)
+					for (int j = 0; j < nWidth; j++)
+						nMismatch += (imgOut.GetGray(j, i) == 255) != (vecIn[(size_t)i * nWidth + j] != 0);
+
+				nChecked++;
+				if (!bSuc || nMismatch)
+				{
+					fprintf(stderr, "selftest: regiongrow image %d seed (%d, %d) threshold %d: %d pixels differ from reference\n",
+						n, (int)s_ptGrow[s].x, (int)s_ptGrow[s].y, s_bThres[t], nMismatch);
+					nFailed++;
+				}
+			}
+		}
+	}
+
+	// ػһԼ2800صʵԲС͹
+	CImgProcess imgBlob;
+	imgBlob.Create(90, 120, IMG_FMT_GRAY8);
+	for (int i = 0; i < 90; i++)
+	{
+		for (int j = 0; j < 120; j++)
+		{
+			BOOL bFg = (j - 45) * (j - 45) + (i - 40) * (i - 40) <= 30 * 30
+				|| (j >= 95 && j < 105 && i >= 10 && i < 14) || (j >= 100 && i >= 60 && i < 70 && j + i < 175)
+				|| (j % 17 == 3 && i % 13 == 5);
+			imgBlob.SetPixel(j, i, bFg ? RGB(0, 0, 0) : RGB(255, 255, 255));
+		}
+	}
+
+	std::vector<int> vecLabel;
+	int nCount;
+	ConnRgnReference(imgBlob, 8, FALSE, vecLabel, nCount);
+	std::vector<long long> vecArea(nCount, 0), vecSumX(nCount, 0), vecSumY(nCount, 0);
+	for (int i = 0; i < 90; i++)
+	{
+		for (int j = 0; j < 120; j++)
+		{
+			int n = vecLabel[(size_t)i * 120 + j] - 1;
+			if (n < 0)
+				continue;
+			vecArea[n]++;
+			vecSumX[n] += j;
+			vecSumY[n] += i;
+		}
+	}
+
+	static const int s_nPixelThres[][2] = {{0, 100000}, {2, 1000}, {30, 5000}, {1000, 3000}};
+	for (size_t t = 0; t < sizeof(s_nPixelThres) / sizeof(s_nPixelThres[0]); t++)
+	{
+		CImgProcess imgRef = imgBlob, imgOut = imgBlob;
+		imgRef.InitPixels(255);
+		for (int n = 0; n < nCount; n++)
+		{
+			if (vecArea[n] >= s_nPixelThres[t][0] && vecArea[n] <= s_nPixelThres[t][1])
+				imgRef.SetPixel((int)(vecSumX[n] / vecArea[n]), (int)(vecSumY[n] / vecArea[n]), RGB(0, 0, 0));
+		}
+		imgBlob.PixelImage(&imgOut, s_nPixelThres[t][0], s_nPixelThres[t][1]);
+
+		int nDiff = MaxPixelDiff(imgOut, imgRef);
+		nChecked++;
+		if (nDiff != 0)
+		{
+			fprintf(stderr, "selftest: pixelimage thresholds %d-%d: differs from reference\n", s_nPixelThres[t][0], s_nPixelThres[t][1]);
+			nFailed++;
+		}
+	}
+
+	printf("selftest: fill %d/%d passed\n", nChecked - nFailed, nChecked);
+	return nFailed;
+}
+
+static int SelfTest()
+{
+	int nFailed = SelfTestEnhance();
+	nFailed += SelfTestTemplate();
+	nFailed += SelfTestBoxFilter();
+	nFailed += SelfTestMedian();
+	nFailed += SelfTestSeedGrow();
+	nFailed += SelfTestConnRgn();
+	nFailed += SelfTestBinMorph();
+	nFailed += SelfTestGrayMorph();
+	nFailed += SelfTestFill();
+	return nFailed ? 1 : 0;
+}
+
+static void Usage()
+{
+	fprintf(stderr,
+		"usage: dipbatch <command> <input.bmp> <output.bmp> [repeat] [-j threads] [-k tileKB]\n"
+		"       dipbatch <command> <input.bmp> <output.bmp> -t <budgetMB> [-j threads] [-k tileKB]\n"
+		"       dipbatch selftest\n"
+		"commands: threshold autothreshold adaptthreshold histeq invert smooth gauss gauss7 box\n"
+		"          median median15 adaptmedian enhance roberts sobel prewitt log log2 dog2 canny\n"
+		"          erode dilate open close open20 close20 gopen gclose tophat label\n");
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc == 2 && !strcmp(argv[1], "selftest"))
+		return SelfTest();
+
+	if (argc < 4)
+	{
+		Usage();
+		return 2;
+	}
+
+	InitGauss7();
+	InitDisc();
+
+	// ĩβ -j <߳>-k <дKB>
+	while (argc > 5)
+	{
+		if (!strcmp(argv[argc - 2], "-j"))
+			CImgParallel::SetThreadCount(atoi(argv[argc - 1]));
+		else if (!strcmp(argv[argc - 2], "-k"))
+		{
+			int nKB = atoi(argv[argc - 1]);
+			CImgProcess::SetTileMode(nKB > 0 ? IMG_TILE_ON : IMG_TILE_OFF);
+			CImgProcess::SetTileBytes((size_t)nKB * 1024);
+		}
+		else
+			break;
+		argc -= 2;
+	}
+
+	if (argc > 5 && !strcmp(argv[4], "-t"))
+		return RunStreaming(argv[1], argv[2], argv[3], atof(argv[5]));
+
+	int nRepeat = (argc > 4) ? atoi(argv[4]) : 1;
+	if (nRepeat < 1)
+		nRepeat = 1;
+
+	// ͼֻڴӳ䷽ʽ
+	CImgProcess imgIn, imgOut;
+	if (!imgIn.AttachFromFile(argv[2], TRUE))
+	{
+		fprintf(stderr, "dipbatch: cannot read %s\n", argv[2]);
+		return 1;
+	}
+	imgOut = imgIn;
+
+	double dBest = 0;
+	for (int i = 0; i < nRepeat; i++)
+	{
+		std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+		if (!RunCommand(argv[1], imgIn, imgOut))
+		{
+			Usage();
+			return 2;
+		}
+		double dMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tStart).count();
+		if (i == 0 || dMs < dBest)
+			dBest = dMs;
+	}
+
+	printf("%s %dx%d %.2f ms\n", argv[1], imgIn.GetWidthPixel(), imgIn.GetHeight(), dBest);
+
+	SImgPoolStats stats;
+	CImg::GetBufferPoolStats(&stats);
+	printf("pool: %llu hits, %llu misses, peak %.1f MB\n", stats.nHits, stats.nMisses,
+		stats.nPeakBytes / (1024.0 * 1024.0));
+
+	if (!imgOut.SaveToFile(argv[3]))
+	{
+		fprintf(stderr, "dipbatch: cannot write %s\n", argv[3]);
+		return 1;
+	}
+	return 0;
+}
@@ -2,27 +2,102 @@
 //
 //////////////////////////////////////////////////////////////////////
 
-#include "stdafx.h"
+#include "ImgPlatform.h"
 #include "Img.h"
 
 #include "Vector2D.h"
 #include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
-#ifdef _DEBUG
+#if defined(_DEBUG) && !defined(DIP_NO_MFC)
 #undef THIS_FILE
 static char THIS_FILE[]=__FILE__;
 #define new DEBUG_NEW
 #endif
 
-CImg::CImg()
+// ͼʱǷػ
+static BOOL g_bCopyOnWrite = TRUE;
+
+// λѹĩЧλ
+static inline uint64_t PackedTailMask(int nWidth)
+{
+	int nRest = nWidth % 64;
+	return nRest ? ~(uint64_t)0 << (64 - nRest) : ~(uint64_t)0;
+}
+
+// ʾϢĴNULLʾĬϴ
+static PFN_IMGMESSAGE g_pfnImgMessage = NULL;
+
+PFN_IMGMESSAGE ImgSetMessageHandler(PFN_IMGMESSAGE pfnHandler)
+{
+	PFN_IMGMESSAGE pfnOld = g_pfnImgMessage;
+	g_pfnImgMessage = pfnHandler;
+	return pfnOld;
+}
+
+void ImgMessage(LPCTSTR lpszMsg)
+{
+	if(g_pfnImgMessage != NULL)
+	{
+		g_pfnImgMessage(lpszMsg);
+		return;
+	}
+
+#ifndef DIP_NO_MFC
+	AfxMessageBox(lpszMsg);
+#else
+	fprintf(stderr, "%s\n", lpszMsg);
+#endif
+}
+
+// CпFILE*ֽڰ·дλͼ
+class CImgFileStream : public CImgStream
+{
+public:
+	CImgFileStream() : m_fp(NULL) {}
+	virtual ~CImgFileStream() { Close(); }
+
+	BOOL Open(LPCTSTR lpcPathName, BOOL bWrite)
+	{
+		m_fp = fopen(lpcPathName, bWrite ? "wb" : "rb");
+		return m_fp != NULL;
+	}
+	void Close()
+	{
+		if(m_fp != NULL)
+			fclose(m_fp);
+		m_fp = NULL;
+	}
+
+	virtual UINT Read(void* lpBuf, UINT nCount) { return (UINT)fread(lpBuf, 1, nCount, m_fp); }
+	virtual UINT Write(const void* lpBuf, UINT nCount) { return (UINT)fwrite(lpBuf, 1, nCount, m_fp); }
+
+private:
+	FILE* m_fp;
+};
+
+CImg::CImg() : m_lpData(this)
 {
 	m_pBMIH = NULL;
 	m_lpvColorTable = NULL;
+	m_nColorTableEntries = 0;
 
-	m_lpData = NULL;
+	m_pBuffer = NULL;
+	m_pBits = NULL;
+	m_nStride = 0;
+	m_nViewType = IMG_VIEW_NONE;
 }
 
-BOOL CImg::operator == (CImg& gray)
+BOOL CImg::operator == (const CImg& gray) const
 {
 	int nHeight = GetHeight();
 	int nWidth = GetWidthPixel();
@@ -34,108 +109,240 @@ BOOL CImg::operator == (CImg& gray)
 		return false;
 
 
-	for(int i=0; i<nHeight; i++)
+	if(m_pBMIH->biBitCount == 1 && gray.m_pBMIH->biBitCount == 1)
 	{
-		for(int j=0; j<nWidth; j++)
+		// ֵͼ񣬰λѹֱȽ
+		int nWords = GetPackedWords();
+		vector<uint64_t> vecFg1(nWords), vecFg2(nWords);
+		for(int i=0; i<nHeight; i++)
 		{
-			if( GetGray(j, i) != gray.GetGray(j, i) )
+			GetPackedRow(i, &vecFg1[0]);
+			gray.GetPackedRow(i, &vecFg2[0]);
+			if( memcmp(&vecFg1[0], &vecFg2[0], nWords * sizeof(uint64_t)) != 0 )
 				return false;
 		}
+		return true;
+	}
+
+	vector<BYTE> vecBuf1(nWidth), vecBuf2(nWidth); //8λͼĻҶл
+
+	for(int i=0; i<nHeight; i++)
+	{
+		const BYTE* pRow1 = GetGrayRow(i, &vecBuf1[0]);
+		const BYTE* pRow2 = gray.GetGrayRow(i, &vecBuf2[0]);
+		if( memcmp(pRow1, pRow2, nWidth) != 0 )
+			return false;
 	}
 
 	return true;
 }
 
-CImg CImg::operator & (CImg& gray)
+CImg CImg::operator & (const CImg& gray) const
 {
 	CImg grayRet = *this;
-	
+	grayRet &= gray;
+	return grayRet;
+}
+
+/*******************
+CImg& CImg::operator &= (const CImg& gray)
+
+ܣͼλ룬ֱд뵱ǰͼ񣬲ʱͼ
+
+
+	const CImg& grayһͬСͼ
+
+ֵ:
+	CImg&ãͼСͬʱֲ
+*******************/
+CImg& CImg::operator &= (const CImg& gray)
+{
 	int nHeight = GetHeight();
 	int nWidth = GetWidthPixel();
 	
 	if(nHeight != gray.GetHeight())
 	{
-		AfxMessageBox("ͼͬĴСʧܣԭͼ");
-		return grayRet;
+		ImgMessage("ͼͬĴСʧܣԭͼ");
+		return *this;
 	}
 
 	if(nWidth != gray.GetWidthPixel())
 	{
-		AfxMessageBox("ͼͬĴСʧܣԭͼ");
-		return grayRet;
+		ImgMessage("ͼͬĴСʧܣԭͼ");
+		return *this;
+	}
+
+
+	if(m_pBMIH->biBitCount == 1)
+	{
+		// ֵͼ64λִgrayΪ255Ϊ
+		int nWords = GetPackedWords();
+		vector<uint64_t> vecFg(nWords), vecFg2(nWords), vecBg2(nWords);
+		for(int i=0; i<nHeight; i++)
+		{
+			GetPackedRow(i, &vecFg[0]);
+			gray.GetPackedRow(i, &vecFg2[0], &vecBg2[0]);
+			for(int w=0; w<nWords; w++)
+				vecFg[w] &= ~vecBg2[w];
+			SetPackedRow(i, &vecFg[0]);
+		}
+		return *this;
 	}
 
+	vector<BYTE> vecBuf(nWidth); //8λͼĻҶл
 
 	// ͼ
 	for(int i=0; i<nHeight; i++)
 	{
-		for(int j=0; j<nWidth; j++)
+		const BYTE* pSrc = gray.GetGrayRow(i, &vecBuf[0]);
+		if(m_pBMIH->biBitCount == 8)
+		{
+			LPBYTE pDst = GetRow(i);
+			for(int j=0; j<nWidth; j++)
+			{
+				if(pSrc[j] == 255)
+					pDst[j] = 255;
+			}
+		}
+		else
 		{
-			if(gray.GetGray(j, i) == 255)
-				grayRet.SetPixel(j, i, RGB(255, 255, 255));
+			for(int j=0; j<nWidth; j++)
+			{
+				if(pSrc[j] == 255)
+					SetPixel(j, i, RGB(255, 255, 255));
+			}
 		}
 	}
 
-	return grayRet;	
+	return *this;
 }
 
-CImg CImg::operator | (CImg& gray)
+CImg CImg::operator | (const CImg& gray) const
 {
 	CImg grayRet = *this;
-	
+	grayRet |= gray;
+	return grayRet;
+}
+
+/*******************
+CImg& CImg::operator |= (const CImg& gray)
+
+ܣͼλ򣬽ֱд뵱ǰͼ񣬲ʱͼ
+
+
+	const CImg& grayһͬСͼ
+
+ֵ:
+	CImg&ãͼСͬʱֲ
+*******************/
+CImg& CImg::operator |= (const CImg& gray)
+{
 	int nHeight = GetHeight();
 	int nWidth = GetWidthPixel();
 	
 	if(nHeight != gray.GetHeight())
 	{
-		AfxMessageBox("ͼͬĴСʧܣԭͼ");
-		return grayRet;
+		ImgMessage("ͼͬĴСʧܣԭͼ");
+		return *this;
 	}
 
 	if(nWidth != gray.GetWidthPixel())
 	{
-		AfxMessageBox("ͼͬĴСʧܣԭͼ");
-		return grayRet;
+		ImgMessage("ͼͬĴСʧܣԭͼ");
+		return *this;
+	}
+
+
+	if(m_pBMIH->biBitCount == 1)
+	{
+		// ֵͼ64λִgrayΪ0Ϊǰ
+		int nWords = GetPackedWords();
+		vector<uint64_t> vecFg(nWords), vecFg2(nWords);
+		for(int i=0; i<nHeight; i++)
+		{
+			GetPackedRow(i, &vecFg[0]);
+			gray.GetPackedRow(i, &vecFg2[0]);
+			for(int w=0; w<nWords; w++)
+				vecFg[w] |= vecFg2[w];
+			SetPackedRow(i, &vecFg[0]);
+		}
+		return *this;
 	}
 
+	vector<BYTE> vecBuf(nWidth); //8λͼĻҶл
 
 	// ͼĻ
 	for(int i=0; i<nHeight; i++)
 	{
-		for(int j=0; j<nWidth; j++)
+		const BYTE* pSrc = gray.GetGrayRow(i, &vecBuf[0]);
+		if(m_pBMIH->biBitCount == 8)
+		{
+			LPBYTE pDst = GetRow(i);
+			for(int j=0; j<nWidth; j++)
+			{
+				if(pSrc[j] == 0)
+					pDst[j] = 0;
+			}
+		}
+		else
 		{
-			if(gray.GetGray(j, i) == 0)
-				grayRet.SetPixel(j, i, RGB(0, 0, 0));
+			for(int j=0; j<nWidth; j++)
+			{
+				if(pSrc[j] == 0)
+					SetPixel(j, i, RGB(0, 0, 0));
+			}
 		}
 	}
 
-	return grayRet;
+	return *this;
 }
 
-CImg CImg::operator ! ()
+CImg CImg::operator ! () const
 {
 	CImg grayRet = *this;
-	grayRet.InitPixels(255); //ͼð
 
 	int nHeight = GetHeight();
 	int nWidth = GetWidthPixel();
 
 	int i,j;
 
+	if(m_pBMIH->biBitCount == 1)
+	{
+		// ֵͼ64λȡβλSetPackedRow
+		int nWords = GetPackedWords();
+		uint64_t nTail = PackedTailMask(nWidth);
+		vector<uint64_t> vecFg(nWords);
+		for(i=0; i<nHeight; i++)
+		{
+			GetPackedRow(i, &vecFg[0]);
+			for(j=0; j<nWords; j++)
+				vecFg[j] = ~vecFg[j];
+			vecFg[nWords - 1] &= nTail;
+			grayRet.SetPackedRow(i, &vecFg[0]);
+		}
+		return grayRet;
+	}
+
+	vector<BYTE> vecBuf(nWidth); //8λͼĻҶл
+	vector<BYTE> vecRow(nWidth); //ɫһ
+
+	grayRet.MakeUnique(FALSE); //ÿһжд踴ԭ
+
 	for(i=0; i<nHeight; i++)
 	{
+		const BYTE* pSrc = GetGrayRow(i, &vecBuf[0]);
 		for(j=0; j<nWidth; j++)
 		{
-			int pixel = 255 - GetGray(j, i);
-			grayRet.SetPixel(j, i, RGB(pixel, pixel, pixel));
+			vecRow[j] = 255 - pSrc[j];
 		}
+		grayRet.SetGrayRow(i, &vecRow[0]);
 	}
 
 	return grayRet;
 }
 
 /*******************
-CImg CImg::operator + (CImg gray)
+CImg CImg::operator + (const CImg& gray)
 
 ܣͼλ
 
@@ -145,10 +352,10 @@ CImg CImg::operator + (CImg gray)
 ֵ:
 	CImg Ӻ CImg ͼ
 *******************/
-CImg CImg::operator + (CImg gray)
+CImg CImg::operator + (const CImg& gray) const
 {
-	CImg grayRet; //ͼ
-	grayRet = *this;
+	CImg grayRet = *this; //ͼ
+	grayRet.MakeUnique(FALSE); //ÿһжд踴ԭ
 
 	//ȡͼĸߺͿ
 	int nHeight = GetHeight();
@@ -157,12 +364,9 @@ CImg CImg::operator + (CImg gray)
 	int i, j;//ѭ
 	
 	//CImgֱӽӣΪӵĽܳ255
-	vector<vector<int>> GrayMat;//ͺݴͼĻҶȵ
-	vector<int> vecRow(nWidth, 0); //GrayMatеһУʼΪ0
-	for(i=0; i<nHeight; i++)
-	{
-		GrayMat.push_back(vecRow);
-	}
+	vector<int> GrayMat(nWidth * nHeight, 0);//ͺݴͼĻҶȵ
+	vector<BYTE> vecBuf1(nWidth), vecBuf2(nWidth); //8λͼĻҶл
+	vector<BYTE> vecRow(nWidth); //һ
 
 	//СҶȺֵ
 	int nMax = 0;
@@ -171,16 +375,19 @@ CImg CImg::operator + (CImg gray)
 	//ɨͼ
 	for(i=0; i<nHeight; i++)
 	{
+		const BYTE* pRow1 = GetGrayRow(i, &vecBuf1[0]);
+		const BYTE* pRow2 = gray.GetGrayRow(i, &vecBuf2[0]);
+		int* pMat = &GrayMat[i * nWidth];
 		for(j=0; j<nWidth; j++)
 		{
 			//λ
-			GrayMat[i][j] = GetGray(j, i) + gray.GetGray(j, i);
+			pMat[j] = pRow1[j] + pRow2[j];
 			
 			//ͳСֵ
-			if( GrayMat[i][j] > nMax)
-				nMax = GrayMat[i][j];
-			if( GrayMat[i][j] < nMin)
-				nMin = GrayMat[i][j];
+			if( pMat[j] > nMax)
+				nMax = pMat[j];
+			if( pMat[j] < nMin)
+				nMin = pMat[j];
 		}// j
 	}// i
 	
@@ -190,20 +397,21 @@ CImg CImg::operator + (CImg gray)
 	
 	for(i=0; i<nHeight; i++)
 	{
+		const int* pMat = &GrayMat[i * nWidth];
 		for(j=0; j<nWidth; j++)
 		{
 			BYTE bt;
 			if(nSpan > 0)
-				bt = (GrayMat[i][j] - nMin)*255/nSpan;
-			else if(GrayMat[i][j] <= 255)
-				bt = GrayMat[i][j] ;
+				bt = (pMat[j] - nMin)*255/nSpan;
+			else if(pMat[j] <= 255)
+				bt = pMat[j] ;
 			else
 				bt = 255;
 				
-				grayRet.SetPixel(j, i, RGB(bt, bt, bt));			
-			
-
+			vecRow[j] = bt;
 		}// for j
+
+		grayRet.SetGrayRow(i, &vecRow[0]);
 	}// for i
 		
 	
@@ -211,8 +419,31 @@ CImg CImg::operator + (CImg gray)
 	return grayRet;
 }
 
-void CImg::operator = (CImg& gray)
+/**************************************************
+CImg& CImg::operator = (const CImg& gray)
+
+ܣ
+	ͼֵϢͷɫдʱʱgrayػ
+	鿽ݡgrayΪͼʱֻΪдͼ
+	grayߴ硢λͬʱдͼ
+
+
+	const CImg& gray
+		Դͼ
+ֵ
+	CImg&ͣ
+***************************************************/
+CImg& CImg::operator = (const CImg& gray)
 {
+	if(this == &gray)
+		return *this;
+
+	if(CanWriteBack(gray))
+	{
+		CopyPixels(gray);
+		return *this;
+	}
+
 	CleanUp();
 
 	m_nColorTableEntries = gray.m_nColorTableEntries;
@@ -229,40 +460,101 @@ void CImg::operator = (CImg& gray)
 		}
 	}
 
-	int nWidthBytes = WIDTHBYTES((m_pBMIH->biWidth)*m_pBMIH->biBitCount);
-	m_lpData = new LPBYTE[m_pBMIH->biHeight];
-	for(int i=0; i<m_pBMIH->biHeight; i++)
+	if(m_pBMIH == NULL || gray.m_pBits == NULL)
+		return *this;
+
+	if(g_bCopyOnWrite)
+	{
+		ShareBits(gray);
+	}
+	else
+	{
+		AllocBits();
+		if(m_nStride == gray.m_nStride && !gray.IsView())
+		{
+			// мͬ鿽ػ
+			memcpy(m_pBits, gray.m_pBits, (size_t)m_nStride * m_pBMIH->biHeight);
+		}
+		else
+		{
+			// ԴͼΪӳػͼм಻ͬп
+			CopyPixels(gray);
+		}
+	}
+
+	return *this;
+}
+
+/**************************************************
+CImg& CImg::operator = (CImg&& gray)
+
+ܣ
+	ͼתƣֱӽӹgrayϢͷɫػڴ棻
+	grayΪͼΪдͼgrayߴ硢λͬʱ
+	Ϊдͼgray
+
+
+	CImg&& gray
+		Դͼʱstd::moveĽ
+ֵ
+	CImg&ͣ
+***************************************************/
+CImg& CImg::operator = (CImg&& gray)
+{
+	if(this == &gray)
+		return *this;
+
+	if(CanWriteBack(gray))
 	{
-		m_lpData[i] = new BYTE[nWidthBytes];
-		memcpy(m_lpData[i], gray.m_lpData[i], nWidthBytes);
+		CopyPixels(gray);
+		return *this;
 	}
+
+	CleanUp();
+
+	m_pBMIH = gray.m_pBMIH;
+	m_lpvColorTable = gray.m_lpvColorTable;
+	m_nColorTableEntries = gray.m_nColorTableEntries;
+	m_pBuffer = gray.m_pBuffer;
+	m_pBits = gray.m_pBits;
+	m_nStride = gray.m_nStride;
+	m_nViewType = gray.m_nViewType;
+
+	gray.m_pBMIH = NULL;
+	gray.m_lpvColorTable = NULL;
+	gray.m_nColorTableEntries = 0;
+	gray.m_pBuffer = NULL;
+	gray.m_pBits = NULL;
+	gray.m_nStride = 0;
+	gray.m_nViewType = IMG_VIEW_NONE;
+
+	return *this;
 }
 
-CImg::CImg(CImg& gray)
+CImg::CImg(const CImg& gray) : m_lpData(this)
 {	
 	m_pBMIH = NULL;
 	m_lpvColorTable = NULL;
+	m_nColorTableEntries = 0;
+	m_pBuffer = NULL;
+	m_pBits = NULL;
+	m_nStride = 0;
+	m_nViewType = IMG_VIEW_NONE;
 
-	m_nColorTableEntries = gray.m_nColorTableEntries;
-	
-	if(gray.m_pBMIH != NULL)
-	{
-		m_pBMIH = (BITMAPINFOHEADER*)new BYTE[sizeof(BITMAPINFOHEADER) + m_nColorTableEntries*4];
-		memcpy(m_pBMIH, gray.m_pBMIH, sizeof(BITMAPINFOHEADER) + m_nColorTableEntries*4);
+	*this = gray;
+}
 
-		if(m_nColorTableEntries != 0)
-		{
-			m_lpvColorTable = m_pBMIH + 1;
-		}
-	}
+CImg::CImg(CImg&& gray) : m_lpData(this)
+{
+	m_pBMIH = NULL;
+	m_lpvColorTable = NULL;
+	m_nColorTableEntries = 0;
+	m_pBuffer = NULL;
+	m_pBits = NULL;
+	m_nStride = 0;
+	m_nViewType = IMG_VIEW_NONE;
 
-	int nWidthBytes = WIDTHBYTES((m_pBMIH->biWidth)*m_pBMIH->biBitCount);
-	m_lpData = new LPBYTE[m_pBMIH->biHeight];
-	for(int i=0; i<m_pBMIH->biHeight; i++)
-	{
-		m_lpData[i] = new BYTE[nWidthBytes];
-		memcpy(m_lpData[i], gray.m_lpData[i], nWidthBytes);
-	}
+	*this = std::move(gray);
 }
 
 CImg::~CImg()
@@ -272,142 +564,895 @@ CImg::~CImg()
 
 void CImg::CleanUp()
 {	
-	if(m_lpData != NULL)
-	{
-		int nWidthBytes = WIDTHBYTES((m_pBMIH->biWidth)*m_pBMIH->biBitCount);
-		for(int i=0; i<m_pBMIH->biHeight; i++)
-		{
-			delete[] m_lpData[i];
-		}
-		delete[] m_lpData;
-	}
+	FreeBits();
 
 	if(m_pBMIH != NULL)
 	{
 		delete[] m_pBMIH;
 		m_pBMIH = NULL;
 	}
+	m_lpvColorTable = NULL;
 }
 
-/**************************************************
-void CImg::ImResize(int nHeight, int nWidth)
+// ϵͳnSizeֽڡ׵ַIMG_ALIGN_BYTESֽڶڴ
+static LPBYTE AllocAlignedBits(size_t nSize)
+{
+	LPBYTE pBits;
+#ifdef _WIN32
+	pBits = (LPBYTE)_aligned_malloc(nSize ? nSize : 1, IMG_ALIGN_BYTES);
+#else
+	void* p = NULL;
+	if(posix_memalign(&p, IMG_ALIGN_BYTES, nSize ? nSize : 1) != 0)
+		p = NULL;
+	pBits = (LPBYTE)p;
+#endif
 
-ܣ
-	øĴС³ʼCImg
+	if(pBits == NULL)
+		throw "out of memory";
+	return pBits;
+}
 
-ƣ
-	CImgѾЧͼݣ򽫳
+static void FreeAlignedBits(LPBYTE pBits)
+{
+#ifdef _WIN32
+	_aligned_free(pBits);
+#else
+	free(pBits);
+#endif
+}
 
-
-	int nHeight
-		³ʼɵĿ
-	int nWidth
-		³ʼɵĸ߶
-ֵ
-	
-***************************************************/
-void CImg::ImResize(int nHeight, int nWidth)
+// ػ
+// 4KBΪ0֮࣬ÿ2(2^e, 2^(e+1)]ٵȷΪ4࣬
+// 䣬ȡɵ˷Ѳ25%
+#define IMG_POOL_MIN_SHIFT  12
+#define IMG_POOL_CLASSES    (1 + ((int)sizeof(size_t) * 8 - IMG_POOL_MIN_SHIFT) * 4)
+
+struct SImgPool
 {
-	int i; //ѭ
-	//ͷͼݿռ
-	for(i=0; i<m_pBMIH->biHeight; i++)
+	SImgPool() : nCached(0) {}
+	~SImgPool();
+
+	std::vector<SImgBuffer*> vecFree[IMG_POOL_CLASSES];	// еĻ
+	size_t nCached;										// лֽ
+};
+
+static std::atomic<bool> g_bBufferPool(true);
+static std::atomic<size_t> g_nPoolLimit(IMG_POOL_LIMIT);
+static std::atomic<unsigned long long> g_nPoolHits(0);
+static std::atomic<unsigned long long> g_nPoolMisses(0);
+static std::atomic<size_t> g_nPoolCached(0);
+static std::atomic<size_t> g_nPoolInUse(0);
+static std::atomic<size_t> g_nPoolPeak(0);
+
+// ÿ̵߳ĳأ߳̽ʱ֮߳ͷŵĻֱӹ黹ϵͳ
+static thread_local SImgPool t_pool;
+static thread_local BOOL t_bPoolClosed = FALSE;
+
+// nSizenCapacityظ
+static int GetPoolClass(size_t nSize, size_t& nCapacity)
+{
+	if(nSize <= ((size_t)1 << IMG_POOL_MIN_SHIFT))
 	{
-		delete[] m_lpData[i];
+		nCapacity = (size_t)1 << IMG_POOL_MIN_SHIFT;
+		return 0;
 	}
-	delete[] m_lpData;
 
-	//ϢͷеӦ
-	m_pBMIH->biHeight = nHeight; //¸߶
-	m_pBMIH->biWidth = nWidth; //¿
+	// 2^e < nSize <= 2^(e+1)
+	int e = IMG_POOL_MIN_SHIFT;
+	while(((nSize - 1) >> (e + 1)) != 0)
+		e++;
 
-	//·ݿռ
-	m_lpData = new LPBYTE [nHeight];
-	int nWidthBytes = WIDTHBYTES((m_pBMIH->biWidth)*m_pBMIH->biBitCount);
-	for(i=0; i<nHeight; i++)
+	size_t nStep = (size_t)1 << (e - 2);
+	size_t k = ((nSize - ((size_t)1 << e)) + nStep - 1) / nStep; // 1..4
+	nCapacity = ((size_t)1 << e) + k * nStep;
+	return 1 + (e - IMG_POOL_MIN_SHIFT) * 4 + (int)(k - 1);
+}
+
+static void UpdatePoolPeak()
+{
+	size_t nTotal = g_nPoolInUse.load(std::memory_order_relaxed) + g_nPoolCached.load(std::memory_order_relaxed);
+	size_t nPeak = g_nPoolPeak.load(std::memory_order_relaxed);
+	while(nTotal > nPeak && !g_nPoolPeak.compare_exchange_weak(nPeak, nTotal, std::memory_order_relaxed))
+		;
+}
+
+// ѳлĻȫ黹ϵͳ
+static void FreePoolBuffers(SImgPool& pool)
+{
+	for(int i=0; i<IMG_POOL_CLASSES; i++)
 	{
-		m_lpData[i] = new BYTE [nWidthBytes];
+		std::vector<SImgBuffer*>& vecFree = pool.vecFree[i];
+		for(size_t j=0; j<vecFree.size(); j++)
+		{
+			g_nPoolCached.fetch_sub(vecFree[j]->nCapacity, std::memory_order_relaxed);
+			FreeAlignedBits(vecFree[j]->pBits);
+			delete vecFree[j];
+		}
+		vecFree.clear();
 	}
+	pool.nCached = 0;
 }
 
-/**************************************************
-void CImg::InitPixels(BYTE color)
-ܣ
-	øɫֵʼͼ
-
-ƣ
-	ֻʹûҶֵṩɫֵֻܳʼΪĳֻɫ
-
-	BYTE colorָʼͼĻҶֵ
-ֵ
-	
-***************************************************/
-void CImg::InitPixels(BYTE color)
+SImgPool::~SImgPool()
 {
-	//ͼߡ
-	int nHeight = GetHeight();
-	int nWidth = GetWidthPixel();
+	FreePoolBuffers(*this);
+	t_bPoolClosed = TRUE;
+}
 
-	int i, j;//Сѭ
+// һüΪ1ػ׵ַIMG_ALIGN_BYTESֽڶ롣
+// شʱȴӵǰ̵߳ĳȡͬһĿлδʼ
+static SImgBuffer* NewImgBuffer(size_t nSize)
+{
+	SImgBuffer* pBuffer = NULL;
 
-	//ɨͼζÿcolorҶ
-	if(m_lpData != NULL)
+	if(!g_bBufferPool.load(std::memory_order_relaxed) || t_bPoolClosed)
 	{
-		for(i=0; i<GetHeight(); i++)
-		{
-			for(j=0; j<GetWidthPixel(); j++)	
-			{
-				SetPixel(j, i, RGB(color, color, color));
-			}//for j
-		}//for i
+		pBuffer = new SImgBuffer;
+		pBuffer->pBits = AllocAlignedBits(nSize);
+		pBuffer->nCapacity = 0; //ɻع
 	}
-}
+	else
+	{
+		size_t nCapacity;
+		std::vector<SImgBuffer*>& vecFree = t_pool.vecFree[GetPoolClass(nSize, nCapacity)];
 
+		if(!vecFree.empty())
+		{
+			pBuffer = vecFree.back();
+			vecFree.pop_back();
+			t_pool.nCached -= nCapacity;
+			g_nPoolCached.fetch_sub(nCapacity, std::memory_order_relaxed);
+			g_nPoolHits.fetch_add(1, std::memory_order_relaxed);
+		}
+		else
+		{
+			LPBYTE pBits = AllocAlignedBits(nCapacity);
+			pBuffer = new SImgBuffer;
+			pBuffer->pBits = pBits;
+			pBuffer->nCapacity = nCapacity;
+			g_nPoolMisses.fetch_add(1, std::memory_order_relaxed);
+		}
 
-/**************************************************
-BOOL CImg::AttachFromFile(LPCTSTR lpcPathName)
+		g_nPoolInUse.fetch_add(nCapacity, std::memory_order_relaxed);
+		UpdatePoolPeak();
+	}
 
-ܣ
-	ָͼļӵCImg
-ƣ
-	ֻܴλͼͼ
+	pBuffer->nSize = nSize;
+	pBuffer->nRef = 1;
+	pBuffer->pMapBase = NULL;
+	pBuffer->nMapSize = 0;
+	return pBuffer;
+}
 
-LPCTSTR lpcPathName
-		ļ·
-ֵ
-	BYTEͣTRUEΪɹFALSEΪʧ
-***************************************************/
-BOOL CImg::AttachFromFile(LPCTSTR lpcPathName)
+// ֻʽļӳ䵽ڴ棬ʧʱNULL
+static LPVOID MapImgFile(LPCTSTR lpcPathName, size_t& nMapSize)
 {
-	// ʹCFile򻯲
-	CFile file;
-	if(!file.Open(lpcPathName, CFile::modeRead|CFile::shareDenyWrite))
-		return FALSE;
+	LPVOID pBase = NULL;
+	nMapSize = 0;
 
-	BOOL bSuc = AttachFromFile(file);
+#if defined(_WIN32) && !defined(DIP_NO_MFC)
+	HANDLE hFile = ::CreateFile(lpcPathName, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(hFile == INVALID_HANDLE_VALUE)
+		return NULL;
 
-	file.Close();
-	return bSuc;
+	LARGE_INTEGER liSize;
+	if(::GetFileSizeEx(hFile, &liSize) && liSize.QuadPart > 0 && (ULONGLONG)liSize.QuadPart <= (size_t)-1)
+	{
+		HANDLE hMap = ::CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if(hMap != NULL)
+		{
+			// ӳͼ󼴿ɹرվͼӳЧ
+			pBase = ::MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0);
+			::CloseHandle(hMap);
+			if(pBase != NULL)
+				nMapSize = (size_t)liSize.QuadPart;
+		}
+	}
+	::CloseHandle(hFile);
+#elif !defined(_WIN32)
+	int fd = open(lpcPathName, O_RDONLY);
+	if(fd < 0)
+		return NULL;
+
+	struct stat st;
+	if(fstat(fd, &st) == 0 && st.st_size > 0)
+	{
+		void* p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(p != MAP_FAILED)
+		{
+			pBase = p;
+			nMapSize = (size_t)st.st_size;
+		}
+	}
+	close(fd);
+#endif
+
+	return pBase;
 }
 
-/**************************************************
-BOOL CImg::AttachFromFile(CFile &file)
+// MapImgFileӳ
+static void UnmapImgFile(LPVOID pBase, size_t nMapSize)
+{
+#if defined(_WIN32) && !defined(DIP_NO_MFC)
+	::UnmapViewOfFile(pBase);
+#elif !defined(_WIN32)
+	munmap(pBase, nMapSize);
+#endif
+}
+
+// ͷһãһͷʱڴļӳ䡣
+// ɻطĻŻصǰ̵߳ĳУʱ黹ϵͳ
+static void ReleaseImgBuffer(SImgBuffer* pBuffer)
+{
+	if(pBuffer == NULL || pBuffer->nRef.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		return;
+
+	if(pBuffer->pMapBase != NULL)
+	{
+		UnmapImgFile(pBuffer->pMapBase, pBuffer->nMapSize);
+		delete pBuffer;
+		return;
+	}
+
+	size_t nCapacity = pBuffer->nCapacity;
+	if(nCapacity != 0)
+	{
+		g_nPoolInUse.fetch_sub(nCapacity, std::memory_order_relaxed);
+
+		if(g_bBufferPool.load(std::memory_order_relaxed) && !t_bPoolClosed &&
+			t_pool.nCached + nCapacity <= g_nPoolLimit.load(std::memory_order_relaxed))
+		{
+			size_t nClassCapacity;
+			t_pool.vecFree[GetPoolClass(nCapacity, nClassCapacity)].push_back(pBuffer);
+			t_pool.nCached += nCapacity;
+			g_nPoolCached.fetch_add(nCapacity, std::memory_order_relaxed);
+			return;
+		}
+	}
+
+	FreeAlignedBits(pBuffer->pBits);
+	delete pBuffer;
+}
+
+// пnHeightСÿnWidthصЧλ1λͼĩֽ
+// nWidthλĿԭֵͼдʱдҲ
+static void CopyRowBits(LPBYTE pDst, int nDstStride, const BYTE* pSrc, int nSrcStride,
+	int nHeight, int nWidth, int nBitCount)
+{
+	size_t nBits = (size_t)nWidth * nBitCount;
+	size_t nBytes = nBits / 8;
+	int nRest = (int)(nBits % 8);
+	BYTE bMask = (BYTE)(0xFF00 >> nRest); //ĩֽЧĸλ
+
+	for(int i=0; i<nHeight; i++)
+	{
+		LPBYTE pD = pDst + (size_t)i * nDstStride;
+		const BYTE* pS = pSrc + (size_t)i * nSrcStride;
+		memmove(pD, pS, nBytes);
+		if(nRest)
+			pD[nBytes] = (BYTE)((pS[nBytes] & bMask) | (pD[nBytes] & ~bMask));
+	}
+}
+
+/**************************************************
+void CImg::AllocBits()
+
+ܣ
+	ϢͷеĿߺλػ
+	׵ַÿ׵ַIMG_ALIGN_BYTESֽڶ
+
+ƣ
+	m_pBMIHЧԭеĻͷţδʼ
+
+
+	
+ֵ
+	
+***************************************************/
+void CImg::AllocBits()
+{
+	int nStride = ALIGNSTRIDE(WIDTHBYTES((m_pBMIH->biWidth)*m_pBMIH->biBitCount));
+
+	m_pBuffer = NewImgBuffer((size_t)nStride * m_pBMIH->biHeight);
+	m_pBits = m_pBuffer->pBits;
+	m_nStride = nStride;
+}
+
+/**************************************************
+void CImg::FreeBits()
+
+ܣ
+	ͷŶػãһͷʱڴ
+***************************************************/
+void CImg::FreeBits()
+{
+	ReleaseImgBuffer(m_pBuffer);
+
+	m_pBuffer = NULL;
+	m_pBits = NULL;
+	m_nStride = 0;
+	m_nViewType = IMG_VIEW_NONE;
+}
+
+/**************************************************
+void CImg::ShareBits(const CImg& img)
+
+ܣ
+	ͷԭлΪimgͬһػ
+
+ƣ
+	ߵϢͷͬͼߴλimgΪͼʱأ
+	ΪռĻ
+***************************************************/
+void CImg::ShareBits(const CImg& img)
+{
+	if(img.IsView())
+	{
+		FreeBits();
+		AllocBits();
+		CopyPixels(img);
+		return;
+	}
+
+	if(m_pBuffer == img.m_pBuffer && !IsView())
+		return;
+
+	FreeBits();
+
+	if(img.m_pBuffer != NULL)
+	{
+		img.m_pBuffer->nRef.fetch_add(1, std::memory_order_relaxed);
+		m_pBuffer = img.m_pBuffer;
+		m_pBits = img.m_pBits;
+		m_nStride = img.m_nStride;
+	}
+}
+
+/**************************************************
+void CImg::Unshare(BOOL bKeepData)
+
+ܣ
+	ΪռػͷŶԹļӳã
+	ͼΪԼĿͼ
+
+ƣ
+	»мఴIMG_ALIGN_BYTES룬ӳصͼ״д
+	GetStride()ܸı䣬֮ǰȡõеַ֮ʧЧ
+
+
+	BOOL bKeepData
+		TRUEʱԭݿ»FALSEʱ»δʼ
+***************************************************/
+void CImg::Unshare(BOOL bKeepData)
+{
+	int nWidthBytes = GetWidthByte();
+	int nStride = ALIGNSTRIDE(nWidthBytes);
+	SImgBuffer* pNew = NewImgBuffer((size_t)nStride * m_pBMIH->biHeight);
+
+	if(bKeepData)
+	{
+		if(IsView())
+		{
+			// ͼβ֮ԭͼأֻЧλ
+			CopyRowBits(pNew->pBits, nStride, m_pBits, m_nStride,
+				m_pBMIH->biHeight, m_pBMIH->biWidth, m_pBMIH->biBitCount);
+		}
+		else if(nStride == m_nStride)
+		{
+			memcpy(pNew->pBits, m_pBits, pNew->nSize);
+		}
+		else
+		{
+			for(int i=0; i<m_pBMIH->biHeight; i++)
+				memcpy(pNew->pBits + (size_t)i * nStride, m_pBits + (size_t)i * m_nStride, nWidthBytes);
+		}
+	}
+
+	ReleaseImgBuffer(m_pBuffer);
+	m_pBuffer = pNew;
+	m_pBits = pNew->pBits;
+	m_nStride = nStride;
+	m_nViewType = IMG_VIEW_NONE;
+}
+
+/**************************************************
+void CImg::CopyPixels(const CImg& img)
+
+ܣ
+	пimgصÿֻдGetWidthPixel()صЧλ
+	1λͼĩֽλֲ䡣ڿдͼд򣬲д
+	֮
+
+ƣ
+	ߵĳߴ硢λͬĻѶռΪдͼ
+***************************************************/
+void CImg::CopyPixels(const CImg& img)
+{
+	CopyRowBits(m_pBits, m_nStride, img.m_pBits, img.m_nStride,
+		m_pBMIH->biHeight, m_pBMIH->biWidth, m_pBMIH->biBitCount);
+}
+
+// ͼǷimg֮ڣ1λͼʼֽ
+static BOOL IsValidViewRect(const CImg& img, int x, int y, int nWidth, int nHeight)
+{
+	if(!img.IsValidate() || img.GetConstBits() == NULL || img.GetFormat() == 0)
+		return FALSE;
+	if(x < 0 || y < 0 || nWidth <= 0 || nHeight <= 0
+		|| nWidth > img.GetWidthPixel() - x || nHeight > img.GetHeight() - y)
+		return FALSE;
+	return ((size_t)x * img.m_pBMIH->biBitCount) % 8 == 0;
+}
+
+/**************************************************
+BOOL CImg::AttachView(const CImg& img, int x, int y, int nWidth, int nHeight)
+
+ܣ
+	ʹΪimgоֻͼء
+	ͼΪ㷨룬㷨ֻȡڵУ״дʱ
+	ΪռͼimgӰ
+
+ƣ
+	ͼimgأʹڼimg뱣ЧҲ·䣻
+	1λͼxΪ8ı
+
+
+	const CImg& img
+		ԭͼ񣬿Ҳͼ
+	int x, int y
+		Ͻǵ꣬y϶¼
+	int nWidth, int nHeight
+		ĿȺ͸߶
+ֵ
+	BOOLͣ򳬳imgimgЧʱFALSE
+***************************************************/
+BOOL CImg::AttachView(const CImg& img, int x, int y, int nWidth, int nHeight)
+{
+	if(!IsValidViewRect(img, x, y, nWidth, nHeight))
+		return FALSE;
+
+	return SetView(img, x, y, nWidth, nHeight, IMG_VIEW_READ);
+}
+
+/**************************************************
+BOOL CImg::AttachWritableView(CImg& img, int x, int y, int nWidth, int nHeight)
+
+ܣ
+	ʹΪimgоĿдͼдֱӸıimgĶӦء
+	Ϊ㷨ʱͼߴ硢λͬĽд
+
+ƣ
+	imgĻΪļӳʱȸƳռһݣ
+	ͬAttachView
+***************************************************/
+BOOL CImg::AttachWritableView(CImg& img, int x, int y, int nWidth, int nHeight)
+{
+	if(!IsValidViewRect(img, x, y, nWidth, nHeight))
+		return FALSE;
+
+	img.MakeUnique();
+	return SetView(img, x, y, nWidth, nHeight, IMG_VIEW_WRITE);
+}
+
+BOOL CImg::SetView(const CImg& img, int x, int y, int nWidth, int nHeight, int nViewType)
+{
+	if(this == &img)
+		return FALSE;
+
+	// imgǱͼͷűػʹʧЧ
+	if(!IsView() && m_pBits != NULL && img.m_pBits >= m_pBits && img.m_pBits < m_pBits + (size_t)m_nStride * m_pBMIH->biHeight)
+		return FALSE;
+
+	// Ͻλ¶ϵĵ(nImgHeight - y - 1)Уͼĵ0һ
+	LPBYTE pBits = img.m_pBits + (size_t)(img.GetHeight() - y - nHeight) * img.m_nStride
+		+ (size_t)x * img.m_pBMIH->biBitCount / 8;
+	int nStride = img.m_nStride;
+
+	CleanUp();
+
+	m_nColorTableEntries = img.m_nColorTableEntries;
+	m_pBMIH = (BITMAPINFOHEADER*)new BYTE[sizeof(BITMAPINFOHEADER) + m_nColorTableEntries*4];
+	memcpy(m_pBMIH, img.m_pBMIH, sizeof(BITMAPINFOHEADER) + m_nColorTableEntries*4);
+	if(m_nColorTableEntries != 0)
+	{
+		m_lpvColorTable = m_pBMIH + 1;
+	}
+	m_pBMIH->biWidth = nWidth;
+	m_pBMIH->biHeight = nHeight;
+
+	m_pBits = pBits;
+	m_nStride = nStride;
+	m_nViewType = nViewType;
+	return TRUE;
+}
+
+/**************************************************
+void CImg::EnableCopyOnWrite(BOOL bEnable)
+
+ܣ
+	ÿͼʱǷػرպ󿽱͸ֵ
+	ݣѾĻ԰дʱƴ
+***************************************************/
+void CImg::EnableCopyOnWrite(BOOL bEnable)
+{
+	g_bCopyOnWrite = bEnable;
+}
+
+BOOL CImg::IsCopyOnWriteEnabled()
+{
+	return g_bCopyOnWrite;
+}
+
+/**************************************************
+void CImg::EnableBufferPool(BOOL bEnable)
+
+ܣ
+	򿪻رػأĬϴ򿪣رպ·Ļֱϵͳ
+	룬ͷʱֱӹ黹ѻĻTrimBufferPool߳̽
+***************************************************/
+void CImg::EnableBufferPool(BOOL bEnable)
+{
+	g_bBufferPool.store(bEnable != FALSE, std::memory_order_relaxed);
+}
+
+BOOL CImg::IsBufferPoolEnabled()
+{
+	return g_bBufferPool.load(std::memory_order_relaxed) ? TRUE : FALSE;
+}
+
+void CImg::SetBufferPoolLimit(size_t nBytes)
+{
+	g_nPoolLimit.store(nBytes, std::memory_order_relaxed);
+}
+
+size_t CImg::GetBufferPoolLimit()
+{
+	return g_nPoolLimit.load(std::memory_order_relaxed);
+}
+
+/**************************************************
+void CImg::TrimBufferPool()
+
+ܣ
+	ѵǰ̳߳лĿлȫ黹ϵͳ̵߳ĳزӰ
+***************************************************/
+void CImg::TrimBufferPool()
+{
+	if(!t_bPoolClosed)
+		FreePoolBuffers(t_pool);
+}
+
+/**************************************************
+void CImg::GetBufferPoolStats(SImgPoolStats* pStats)
+
+ܣ
+	ȡ߳ۼƵĻͳơֱʱ˴֮
+	֤ͬһʱ̵ֵ
+***************************************************/
+void CImg::GetBufferPoolStats(SImgPoolStats* pStats)
+{
+	pStats->nHits = g_nPoolHits.load(std::memory_order_relaxed);
+	pStats->nMisses = g_nPoolMisses.load(std::memory_order_relaxed);
+	pStats->nCachedBytes = g_nPoolCached.load(std::memory_order_relaxed);
+	pStats->nInUseBytes = g_nPoolInUse.load(std::memory_order_relaxed);
+	pStats->nPeakBytes = g_nPoolPeak.load(std::memory_order_relaxed);
+}
+
+void CImg::ResetBufferPoolStats()
+{
+	g_nPoolHits.store(0, std::memory_order_relaxed);
+	g_nPoolMisses.store(0, std::memory_order_relaxed);
+	g_nPoolPeak.store(g_nPoolInUse.load(std::memory_order_relaxed) + g_nPoolCached.load(std::memory_order_relaxed),
+		std::memory_order_relaxed);
+}
+
+/**************************************************
+void CImg::ImResize(int nHeight, int nWidth)
+
+ܣ
+	øĴС³ʼCImg
+
+ƣ
+	CImgѾЧͼݣ򽫳
+
+
+	int nHeight
+		³ʼɵĿ
+	int nWidth
+		³ʼɵĸ߶
+ֵ
+	
+***************************************************/
+void CImg::ImResize(int nHeight, int nWidth)
+{
+	//ߴ粻δļӳʱԭݿռ
+	if(m_pBits != NULL && !IsShared() && !IsMapped() && m_pBMIH->biHeight == nHeight && m_pBMIH->biWidth == nWidth)
+		return;
+
+	//ͷͼݿռ
+	FreeBits();
+
+	//ϢͷеӦ
+	m_pBMIH->biHeight = nHeight; //¸߶
+	m_pBMIH->biWidth = nWidth; //¿
+
+	//·ݿռ
+	AllocBits();
+}
+
+/**************************************************
+void CImg::CreateLike(const CImg& img, int nHeight, int nWidth)
+
+ܣ
+	imgϢͷɫĴСػ
+	ݣڴimgʽͬдͼ
+
+ƣ
+	imgЧͼ»δʼ
+
+
+	const CImg& img
+		ṩʽͼ񣬿
+	int nHeight
+		ͼĸ߶
+	int nWidth
+		ͼĿ
+ֵ
+	
+***************************************************/
+void CImg::CreateLike(const CImg& img, int nHeight, int nWidth)
+{
+	if(this == &img)
+	{
+		ImResize(nHeight, nWidth);
+		return;
+	}
+
+	CleanUp();
+
+	m_nColorTableEntries = img.m_nColorTableEntries;
+	m_pBMIH = (BITMAPINFOHEADER*)new BYTE[sizeof(BITMAPINFOHEADER) + m_nColorTableEntries*4];
+	memcpy(m_pBMIH, img.m_pBMIH, sizeof(BITMAPINFOHEADER) + m_nColorTableEntries*4);
+	if(m_nColorTableEntries != 0)
+	{
+		m_lpvColorTable = m_pBMIH + 1;
+	}
+
+	m_pBMIH->biHeight = nHeight;
+	m_pBMIH->biWidth = nWidth;
+
+	AllocBits();
+}
+
+// ظʽĬϵɫ8λΪҶȵɫ壬1λΪڡɫ
+// ʽûɫɫֵ֧ĸʽ-1
+static int MakeDefaultColorTable(int nFormat, RGBQUAD* pTable)
+{
+	int nEntries;
+	if(nFormat == IMG_FMT_GRAY8)
+		nEntries = 256;
+	else if(nFormat == IMG_FMT_BINARY)
+		nEntries = 2;
+	else if(nFormat == IMG_FMT_RGB24 || nFormat == IMG_FMT_GRAY16 || nFormat == IMG_FMT_FLOAT32)
+		nEntries = 0;
+	else
+		return -1;
+
+	for(int i=0; i<nEntries; i++)
+	{
+		BYTE bGray = (BYTE)(i * 255 / (nEntries - 1));
+		pTable[i].rgbBlue = pTable[i].rgbGreen = pTable[i].rgbRed = bGray;
+		pTable[i].rgbReserved = 0;
+	}
+
+	return nEntries;
+}
+
+// ظʽϢͷbiCompressionеȡֵ
+static DWORD GetFormatCompression(int nFormat)
+{
+	if(nFormat == IMG_FMT_GRAY16)
+		return BI_DIP_GRAY16;
+	if(nFormat == IMG_FMT_FLOAT32)
+		return BI_DIP_FLOAT32;
+	return BI_RGB;
+}
+
+/**************************************************
+BOOL CImg::Create(int nHeight, int nWidth, int nFormat)
+
+ܣ
+	ָߴظʽͼ8λͼҶȵɫ壬
+	1λͼڰ׵ɫ
+
+ƣ
+	δʼҪʱInitPixels
+
+
+	int nHeight
+		ͼ߶
+	int nWidth
+		ͼ
+	int nFormat
+		ظʽIMG_FMT_*֮һ
+ֵ
+	BOOLͣʽֻ֧ߴǷʱFALSE
+***************************************************/
+BOOL CImg::Create(int nHeight, int nWidth, int nFormat)
+{
+	RGBQUAD rgbTable[256];
+	int nColorTableEntries = MakeDefaultColorTable(nFormat, rgbTable);
+	if(nColorTableEntries < 0 || nHeight <= 0 || nWidth <= 0)
+		return FALSE;
+
+	CleanUp();
+
+	m_nColorTableEntries = nColorTableEntries;
+	m_pBMIH = (BITMAPINFOHEADER*)new BYTE[sizeof(BITMAPINFOHEADER) + m_nColorTableEntries*4];
+	memset(m_pBMIH, 0, sizeof(BITMAPINFOHEADER));
+	m_pBMIH->biSize = sizeof(BITMAPINFOHEADER);
+	m_pBMIH->biWidth = nWidth;
+	m_pBMIH->biHeight = nHeight;
+	m_pBMIH->biPlanes = 1;
+	m_pBMIH->biBitCount = (WORD)nFormat;
+	m_pBMIH->biCompression = GetFormatCompression(nFormat);
+	if(m_nColorTableEntries != 0)
+	{
+		m_lpvColorTable = m_pBMIH + 1;
+		memcpy(m_lpvColorTable, rgbTable, m_nColorTableEntries*4);
+	}
+
+	AllocBits();
+	return TRUE;
+}
+
+/**************************************************
+BOOL CImg::ConvertFormat(CImg* pTo, int nFormat, double dScale, double dOffset) const
+
+ܣ
+	ͼתΪ8λ16λ򸡵㵥ͨͼĿֵ = ԴֵdScale + dOffset
+	12λݴΪ16λͼdScale = 1/16תΪ8λʾ
+	мҲҪı
+
+ƣ
+	ԴͼΪֵͼʱȡҶֵĿʽ벢ضϵ
+	ȡֵΧ
+
+
+	CImg* pTo
+		ͼ񣬿
+	int nFormat
+		ĿʽIMG_FMT_GRAY8IMG_FMT_GRAY16IMG_FMT_FLOAT32
+	double dScale, double dOffset
+		Ա任ϵ
+ֵ
+	BOOLͣʽ֧ʱFALSE
+***************************************************/
+BOOL CImg::ConvertFormat(CImg* pTo, int nFormat, double dScale, double dOffset) const
+{
+	if(!IsValidate() || GetFormat() == 0
+		|| (nFormat != IMG_FMT_GRAY8 && nFormat != IMG_FMT_GRAY16 && nFormat != IMG_FMT_FLOAT32))
+		return FALSE;
+
+	int nHeight = GetHeight();
+	int nWidth = GetWidthPixel();
+
+	CImg imgRet;
+	imgRet.Create(nHeight, nWidth, nFormat);
+
+	BOOL bLinear = (dScale != 1.0 || dOffset != 0.0);
+	vector<float> vecBuf(nWidth);
+	for(int i=0; i<nHeight; i++)
+	{
+		const float* pSrc = GetFloatRow(i, &vecBuf[0]);
+		if(bLinear)
+		{
+			for(int j=0; j<nWidth; j++)
+				vecBuf[j] = (float)(pSrc[j] * dScale + dOffset);
+			pSrc = &vecBuf[0];
+		}
+		imgRet.SetFloatRow(i, pSrc);
+	}
+
+	*pTo = std::move(imgRet);
+	return TRUE;
+}
+
+/**************************************************
+void CImg::InitPixels(BYTE color)
+ܣ
+	øɫֵʼͼ
+
+ƣ
+	ֻʹûҶֵṩɫֵֻܳʼΪĳֻɫ
+
+	BYTE colorָʼͼĻҶֵ
+ֵ
+	
+***************************************************/
+void CImg::InitPixels(BYTE color)
+{
+	//ͼߡ
+	int nHeight = GetHeight();
+	int nWidth = GetWidthPixel();
+
+	int i;//ѭ
+
+	//ɨͼζÿһcolorҶ
+	if(m_pBits != NULL && m_pBMIH->biBitCount == 1 && (color == 0 || color == 255))
+	{
+		// ֵͼа64λд
+		int nWords = GetPackedWords();
+		vector<uint64_t> vecFg(nWords, color == 0 ? ~(uint64_t)0 : 0);
+		vecFg[nWords - 1] &= PackedTailMask(nWidth);
+		for(i=0; i<nHeight; i++)
+		{
+			SetPackedRow(i, &vecFg[0]);
+		}//for i
+	}
+	else if(m_pBits != NULL)
+	{
+		MakeUnique(FALSE); //ȫضд
+
+		vector<BYTE> vecRow(nWidth, color);
+		for(i=0; i<nHeight; i++)
+		{
+			SetGrayRow(i, &vecRow[0]);
+		}//for i
+	}
+}
+
+
+/**************************************************
+BOOL CImg::AttachFromFile(LPCTSTR lpcPathName, BOOL bMapFile)
 
 ܣ
 	ָͼļӵCImg
+ƣ
+	ֻܴλͼͼӳ䷽ʽֻδѹ¶ϴŵλͼ
+	λͼ԰ͨʽ
+
+LPCTSTR lpcPathName
+		ļ·
+	BOOL bMapFile
+		TRUEʱֻڴӳ䷽ʽأֱָļӳ䣬ڴ棬
+		״дʱŸƳռĻʺֻĴͼ
+		ӳڼ䲻Ӧдļ
+ֵ
+	BYTEͣTRUEΪɹFALSEΪʧ
+***************************************************/
+BOOL CImg::AttachFromFile(LPCTSTR lpcPathName, BOOL bMapFile)
+{
+	if(bMapFile && AttachFromMapping(lpcPathName))
+		return TRUE;
+
+	CImgFileStream file;
+	if(!file.Open(lpcPathName, FALSE))
+		return FALSE;
+
+	BOOL bSuc = AttachFromStream(file);
+
+	file.Close();
+	return bSuc;
+}
+
+/**************************************************
+BOOL CImg::AttachFromStream(CImgStream &file)
+
+ܣ
+	ֽжȡλͼӵCImg
 ƣ
 	ֻܴλͼͼ
 
 
-	CFile &file
-		򿪵CFile
+	CImgStream &file
+		ȡֽǰλӦΪλͼļͷ
 ֵ
 	BYTEͣTRUEΪɹFALSEΪʧ
 ***************************************************/
 
-BOOL CImg::AttachFromFile(CFile &file)
+BOOL CImg::AttachFromStream(CImgStream &file)
 {
-	// ļ
-	LPBYTE  *lpData;
 	// λͼϢͷ
 	BITMAPINFOHEADER *pBMIH;
 	// ɫָ
@@ -432,7 +1477,7 @@ BOOL CImg::AttachFromFile(CFile &file)
 	pBMIH = (BITMAPINFOHEADER*)new BYTE[bmfHeader.bfOffBits - sizeof(bmfHeader)];
 	if(!file.Read(pBMIH, bmfHeader.bfOffBits - sizeof(bmfHeader)))
 	{
-		delete pBMIH;
+		delete[] (BYTE*)pBMIH;
 		return FALSE;
 	}
 
@@ -446,25 +1491,100 @@ BOOL CImg::AttachFromFile(CFile &file)
 
 	pBMIH->biHeight = abs(pBMIH->biHeight);
 
+	// 
+	CleanUp();
+
+	m_pBMIH = pBMIH;
+	m_lpvColorTable = lpvColorTable;
+	m_nColorTableEntries = nColorTableEntries;
+
 	// ȡͼ,WIDTHBYTESÿֽ
 	int nWidthBytes = WIDTHBYTES((pBMIH->biWidth)*pBMIH->biBitCount);
 
-	// biHeightΪbiWidthBytes,λͼ
-	lpData = new LPBYTE[(pBMIH->biHeight)];
-	for(int i=0; i<(pBMIH->biHeight); i++)
+	// ػ,мļегͬʱһζ
+	AllocBits();
+	if(m_nStride == nWidthBytes)
+	{
+		file.Read(m_pBits, (UINT)((size_t)nWidthBytes * pBMIH->biHeight));
+	}
+	else
 	{
-		lpData[i] = new BYTE[nWidthBytes];
-		file.Read(lpData[i], nWidthBytes);	
+		for(int i=0; i<(pBMIH->biHeight); i++)
+		{
+			file.Read(m_pBits + (size_t)i * m_nStride, nWidthBytes);	
+		}
 	}
+	
+
+	return TRUE;
+}
+
+/**************************************************
+BOOL CImg::AttachFromMapping(LPCTSTR lpcPathName)
+
+ܣ
+	ֻڴӳ䷽ʽλͼϢͷɫػֱ
+	ָӳеλͼݣмļег
+ƣ
+	ֻδѹBI_RGB16λ㵥ͨʽ¶ϴλͼ
+	ʱıFALSE
+
+LPCTSTR lpcPathName
+		ļ·
+ֵ
+	BOOLͣTRUEΪɹFALSEΪʧ
+***************************************************/
+BOOL CImg::AttachFromMapping(LPCTSTR lpcPathName)
+{
+	size_t nMapSize;
+	LPBYTE pBase = (LPBYTE)MapImgFile(lpcPathName, nMapSize);
+	if(pBase == NULL)
+		return FALSE;
+
+	BITMAPFILEHEADER bmfHeader;
+	BITMAPINFOHEADER bmih;
+	BOOL bSuc = FALSE;
+	if(nMapSize >= sizeof(bmfHeader) + sizeof(bmih))
+	{
+		memcpy(&bmfHeader, pBase, sizeof(bmfHeader));
+		memcpy(&bmih, pBase + sizeof(bmfHeader), sizeof(bmih));
+
+		bSuc = bmfHeader.bfType == MAKEWORD('B', 'M')
+			&& bmfHeader.bfOffBits >= sizeof(bmfHeader) + sizeof(bmih)
+			&& (bmih.biCompression == BI_RGB || bmih.biCompression == BI_DIP_GRAY16 || bmih.biCompression == BI_DIP_FLOAT32)
+			&& bmih.biWidth > 0 && bmih.biHeight > 0 && bmih.biBitCount > 0
+			&& bmfHeader.bfOffBits + WIDTHBYTES((size_t)bmih.biWidth*bmih.biBitCount) * (size_t)bmih.biHeight <= nMapSize;
+	}
+	if(!bSuc)
+	{
+		UnmapImgFile(pBase, nMapSize);
+		return FALSE;
+	}
+
+	// Ϣͷɫ
+	BITMAPINFOHEADER *pBMIH = (BITMAPINFOHEADER*)new BYTE[bmfHeader.bfOffBits - sizeof(bmfHeader)];
+	memcpy(pBMIH, pBase + sizeof(bmfHeader), bmfHeader.bfOffBits - sizeof(bmfHeader));
+
+	int nColorTableEntries = 
+		(bmfHeader.bfOffBits - sizeof(bmfHeader) - sizeof(BITMAPINFOHEADER))/sizeof(RGBQUAD);
 
-	// 
 	CleanUp();
 
-	m_lpData = lpData;
 	m_pBMIH = pBMIH;
-	m_lpvColorTable = lpvColorTable;
+	m_lpvColorTable = (nColorTableEntries > 0) ? (LPVOID)(pBMIH + 1) : NULL;
 	m_nColorTableEntries = nColorTableEntries;
-	
+
+	// ֱָӳеλͼ
+	int nWidthBytes = GetWidthByte();
+	m_pBuffer = new SImgBuffer;
+	m_pBuffer->pBits = pBase + bmfHeader.bfOffBits;
+	m_pBuffer->nSize = (size_t)nWidthBytes * pBMIH->biHeight;
+	m_pBuffer->nRef = 1;
+	m_pBuffer->pMapBase = pBase;
+	m_pBuffer->nMapSize = nMapSize;
+	m_pBuffer->nCapacity = 0;
+	m_pBits = m_pBuffer->pBits;
+	m_nStride = nWidthBytes;
 
 	return TRUE;
 }
@@ -474,33 +1594,37 @@ BOOL CImg::SaveToFile(LPCTSTR lpcPathName)
 	if(!IsValidate())
 		return FALSE;
 
-	CFile file;
-	if(!file.Open(lpcPathName, CFile::modeRead|CFile::modeWrite|CFile::modeCreate))
+	// ĿǱӳԴļȸƳռĻٸд
+	if(IsMapped())
+		Unshare(TRUE);
+
+	CImgFileStream file;
+	if(!file.Open(lpcPathName, TRUE))
 	{
 		return FALSE;
 	}
 
-	BOOL bSuc = SaveToFile(file);
+	BOOL bSuc = SaveToStream(file);
 	file.Close();
 
 	return bSuc;
 }
 
 /**************************************************
-BOOL CImg::SaveToFile(CFile &file)
+BOOL CImg::SaveToStream(CImgStream &file)
 
 ܣ
-	CImgʵеͼݱ浽ָͼļ
+	CImgʵеͼλͼʽдֽ
 ƣ
 	ֻܴλͼͼ
 
 
-	CFile &file
-		浽CFile
+	CImgStream &file
+		дֽ
 ֵ
 	BYTEͣTRUEΪɹFALSEΪʧ
 ***************************************************/
-BOOL CImg::SaveToFile(CFile &file)
+BOOL CImg::SaveToStream(CImgStream &file)
 {	
 	// жǷЧ
 	if(!IsValidate())
@@ -508,7 +1632,7 @@ BOOL CImg::SaveToFile(CFile &file)
 	
 		
 	// BITMAPFILEHEADERṹ
-	BITMAPFILEHEADER bmfHeader = { 0 };
+	BITMAPFILEHEADER bmfHeader = {};
 	int nWidthBytes = WIDTHBYTES((m_pBMIH->biWidth)*m_pBMIH->biBitCount);
 
 
@@ -522,196 +1646,495 @@ BOOL CImg::SaveToFile(CFile &file)
 	file.Write(&bmfHeader, sizeof(bmfHeader));
 	file.Write(m_pBMIH, sizeof(BITMAPINFOHEADER) + m_nColorTableEntries*4);
 
-	for(int i=0; i<m_pBMIH->biHeight; i++)
+	if(m_nStride == nWidthBytes && !IsView())
+	{
+		file.Write(m_pBits, (UINT)((size_t)nWidthBytes * m_pBMIH->biHeight));
+	}
+	else if(IsView())
+	{
+		// ͼβ֮ԭͼأлдֽΪ0
+		vector<BYTE> vecRow(nWidthBytes, 0);
+		for(int i=0; i<m_pBMIH->biHeight; i++)
+		{
+			CopyRowBits(&vecRow[0], nWidthBytes, m_pBits + (size_t)i * m_nStride, m_nStride,
+				1, m_pBMIH->biWidth, m_pBMIH->biBitCount);
+			file.Write(&vecRow[0], nWidthBytes);
+		}
+	}
+	else
+	{
+		for(int i=0; i<m_pBMIH->biHeight; i++)
+		{
+			file.Write(m_pBits + (size_t)i * m_nStride, nWidthBytes);
+		}
+	}
+	
+
+	return TRUE;
+}
+
+
+/**************************************************
+void CImg::SetPixel(int x, int y, COLORREF color)
+
+ܣ
+	趨ָλصɫֵ
+
+ƣ
+	
+
+
+	int x, int y
+		ָغᡢֵ
+	COLORREF
+		趨ָλõɫֵRGBʽ
+ֵ
+	
+***************************************************/
+void CImg::SetPixel(int x, int y, COLORREF color)
+{
+	LPBYTE pRow = GetRow(y);
+
+	if(m_pBMIH->biBitCount == 8)			// 256ɫͼ
+	{
+		pRow[x] = GetRValue(color);
+	}
+	else if(m_pBMIH->biBitCount == 1)		// ɫͼ
+	{
+		BYTE Color = GetRValue(color);
+
+
+		// 0
+		RGBQUAD *p = (RGBQUAD*)m_lpvColorTable;
+		if(p[0].rgbBlue != 0)
+			Color = !Color;
+
+		BYTE bMask = (BYTE)(0x80 >> (x % 8));
+		if (Color == 0)  // ɫ㣬öӦλΪ0
+			pRow[x/8] &= ~bMask;
+		else // ɫ㣬öӦλΪ1
+			pRow[x/8] |= bMask;
+	}
+	else if(m_pBMIH->biBitCount == 24)
+	{
+		pRow[x*3] = GetBValue(color);
+		pRow[x*3 + 1] = GetGValue(color);
+		pRow[x*3 + 2] = GetRValue(color);
+	}
+	else if(GetFormat() == IMG_FMT_GRAY16)	// 16λͨͼ0255չ065535
+	{
+		((WORD*)pRow)[x] = (WORD)(GetRValue(color) * 257);
+	}
+	else if(GetFormat() == IMG_FMT_FLOAT32)	// 㵥ͨͼ
+	{
+		((float*)pRow)[x] = GetRValue(color);
+	}
+}
+
+
+
+/**************************************************
+const BYTE* CImg::GetGrayRow(int y, BYTE* pBuf) const
+
+ܣ
+	ȡyصĻҶֵGetGrayͬ
+
+ƣ
+	pBufҪGetWidthPixel()ֽ
+
+
+	int y
+		кţ϶¼
+	BYTE* pBuf
+		8λͼʱڴתĻ
+ֵ
+	const BYTE*ͣлҶֵ׵ַ8λͼֱӷλͼݣ
+	пʽpBuf
+***************************************************/
+const BYTE* CImg::GetGrayRow(int y, BYTE* pBuf) const
+{
+	int nWidth = m_pBMIH->biWidth;
+	int j;
+
+	if(m_pBMIH->biBitCount == 8)			// 256ɫͼ
+	{
+		return GetConstRow(y);
+	}
+	else if(m_pBMIH->biBitCount == 1)		// ɫͼ
+	{
+		const BYTE* pRow = GetConstRow(y);
+
+		// 0
+		RGBQUAD *p = (RGBQUAD*)m_lpvColorTable;
+		BOOL bReverse = (p[0].rgbBlue != 0);
+
+		for(j=0; j<nWidth; j++)
+		{
+			BOOL bWhite = ( (pRow[j/8] & (0x80>>(j%8))) != 0 );
+			pBuf[j] = (bWhite != bReverse) ? 255 : 0;
+		}
+	}
+	else if(m_pBMIH->biBitCount == 24)		// ͼ
+	{
+		const RGBTRIPLE* pRow = GetConstRowRGB(y);
+		for(j=0; j<nWidth; j++)
+		{
+			BYTE r = pRow[j].rgbtRed;
+			BYTE g = pRow[j].rgbtGreen;
+			BYTE b = pRow[j].rgbtBlue;
+
+			if(r == g && r == b)
+				pBuf[j] = r;
+			else
+				pBuf[j] = (int)(0.30*r + 0.59*g + 0.11*b); // GetGrayĻҶȻʽһ
+		}
+	}
+	else if(GetFormat() == IMG_FMT_GRAY16)	// 16λͨͼȡ8λ
+	{
+		const WORD* pRow = GetConstRow16(y);
+		for(j=0; j<nWidth; j++)
+			pBuf[j] = (BYTE)(pRow[j] >> 8);
+	}
+	else if(GetFormat() == IMG_FMT_FLOAT32)	// 㵥ͨͼضϵ0255
+	{
+		const float* pRow = GetConstRowFloat(y);
+		for(j=0; j<nWidth; j++)
+			pBuf[j] = FloatToGray(pRow[j]);
+	}
+	else
+	{
+		throw "not support now";
+	}
+
+	return pBuf;
+}
+
+/**************************************************
+void CImg::SetGrayRow(int y, const BYTE* pGray)
+
+ܣ
+	øĻҶֵõyеأ
+	SetPixel(x, y, RGB(gray, gray, gray))ͬ
+
+
+	int y
+		кţ϶¼
+	const BYTE* pGray
+		иصĻҶֵΪGetWidthPixel()
+ֵ
+	
+***************************************************/
+void CImg::SetGrayRow(int y, const BYTE* pGray)
+{
+	int nWidth = m_pBMIH->biWidth;
+	int j;
+
+	if(m_pBMIH->biBitCount == 8)			// 256ɫͼ
+	{
+		memcpy(GetRow(y), pGray, nWidth);
+	}
+	else if(m_pBMIH->biBitCount == 1)		// ɫͼ
+	{
+		LPBYTE pRow = GetRow(y);
+
+		// 0
+		RGBQUAD *p = (RGBQUAD*)m_lpvColorTable;
+		BOOL bReverse = (p[0].rgbBlue != 0);
+
+		for(j=0; j<nWidth; j++)
+		{
+			BOOL bWhite = (pGray[j] != 0);
+			if(bWhite != bReverse)
+				pRow[j/8] |= (0x80>>(j%8));
+			else
+				pRow[j/8] &= ~(0x80>>(j%8));
+		}
+	}
+	else if(m_pBMIH->biBitCount == 24)		// ͼ
+	{
+		RGBTRIPLE* pRow = GetRowRGB(y);
+		for(j=0; j<nWidth; j++)
+		{
+			pRow[j].rgbtBlue = pGray[j];
+			pRow[j].rgbtGreen = pGray[j];
+			pRow[j].rgbtRed = pGray[j];
+		}
+	}
+	else if(GetFormat() == IMG_FMT_GRAY16)	// 16λͨͼ0255չ065535
+	{
+		WORD* pRow = GetRow16(y);
+		for(j=0; j<nWidth; j++)
+			pRow[j] = (WORD)(pGray[j] * 257);
+	}
+	else if(GetFormat() == IMG_FMT_FLOAT32)	// 㵥ͨͼ
+	{
+		float* pRow = GetRowFloat(y);
+		for(j=0; j<nWidth; j++)
+			pRow[j] = pGray[j];
+	}
+}
+
+/**************************************************
+void CImg::GetPackedRow(int y, uint64_t* pFg, uint64_t* pBg) const
+
+ܣ
+	ȡyеλѹʾ1λͼֱӰֽƴ64λ֣ÿδ64
+	أʽжϻҶǷΪ0255
+
+ƣ
+	pFgpBgҪGetPackedWords()
+
+
+	int y
+		кţ϶¼
+	uint64_t* pFg
+		ǰλҶΪ0
+	uint64_t* pBg
+		λҶΪ255ΪNULLʱȡ
+ֵ
+	
+***************************************************/
+void CImg::GetPackedRow(int y, uint64_t* pFg, uint64_t* pBg) const
+{
+	int nWidth = m_pBMIH->biWidth;
+	int nWords = GetPackedWords();
+	int w, j;
+
+	if(m_pBMIH->biBitCount != 1)
+	{
+		vector<BYTE> vecBuf;
+		const BYTE* pGray;
+		if(m_pBMIH->biBitCount == 8)
+		{
+			pGray = GetConstRow(y);
+		}
+		else
+		{
+			vecBuf.resize(nWidth);
+			pGray = GetGrayRow(y, &vecBuf[0]);
+		}
+
+		for(w=0; w<nWords; w++)
+		{
+			uint64_t nFg = 0, nBg = 0;
+			int nEnd = min(nWidth, (w + 1) * 64);
+			for(j=w*64; j<nEnd; j++)
+			{
+				nFg = (nFg << 1) | (pGray[j] == 0);
+				nBg = (nBg << 1) | (pGray[j] == 255);
+			}
+
+			// ĩֲ64ʱ
+			int nShift = (w + 1) * 64 - nEnd;
+			if(nShift > 0)
+			{
+				nFg <<= nShift;
+				nBg <<= nShift;
+			}
+
+			pFg[w] = nFg;
+			if(pBg != NULL)
+				pBg[w] = nBg;
+		}
+		return;
+	}
+
+	// 1λͼ0ڣɫ0ΪɫʱλΪ1ʾɫ
+	const BYTE* pRow = GetConstRow(y);
+	int nBytes = (nWidth + 7) / 8;
+	RGBQUAD *p = (RGBQUAD*)m_lpvColorTable;
+	uint64_t nFlip = (p[0].rgbBlue != 0) ? 0 : ~(uint64_t)0;
+
+	for(w=0; w<nWords; w++)
 	{
-		file.Write(m_lpData[i], nWidthBytes);
+		uint64_t nBits = 0;
+		const BYTE* pSrc = pRow + w * 8;
+		if(w * 8 + 8 <= nBytes)
+		{
+			for(j=0; j<8; j++)
+				nBits = (nBits << 8) | pSrc[j];
+		}
+		else
+		{
+			for(j=0; j<8; j++)
+				nBits = (nBits << 8) | ((w * 8 + j < nBytes) ? pSrc[j] : 0);
+		}
+		pFg[w] = nBits ^ nFlip;
 	}
-	
 
-	return TRUE;
-}
+	uint64_t nTail = PackedTailMask(nWidth);
+	pFg[nWords - 1] &= nTail;
 
+	if(pBg != NULL)
+	{
+		// ֵͼзǰ
+		for(w=0; w<nWords; w++)
+			pBg[w] = ~pFg[w];
+		pBg[nWords - 1] &= nTail;
+	}
+}
 
 /**************************************************
-BOOL CImg::Draw(CDC* pDC)
+void CImg::SetPackedRow(int y, const uint64_t* pFg)
 
 ܣ
-	ڸ豸ĻнCImgд洢ͼƵĻ
-
-ƣ
-	
+	λѹǰλõyУǰΪ0Ϊ255
+	1λͼֱֽд룬βһֽʱλ
 
 
-	CDC * pDC
-		ָ豸Ļָ
+	int y
+		кţ϶¼
+	const uint64_t* pFg
+		ǰλGetPackedWords()
 ֵ
-	ͣTRUEΪɹFALSEΪʧ
+	
 ***************************************************/
-BOOL CImg::Draw(CDC* pDC)
+void CImg::SetPackedRow(int y, const uint64_t* pFg)
 {
-	if(m_pBMIH == NULL)
-		return FALSE;
+	int nWidth = m_pBMIH->biWidth;
+	int j;
 
-	for(int i=0; i<m_pBMIH->biHeight; i++)
+	if(m_pBMIH->biBitCount != 1)
 	{
-	
-		::SetDIBitsToDevice(*pDC, 0, 0, m_pBMIH->biWidth, 
-			m_pBMIH->biHeight, 0, 0, i, 1, m_lpData[i], (BITMAPINFO*)m_pBMIH, DIB_RGB_COLORS);
+		vector<BYTE> vecBuf;
+		LPBYTE pGray;
+		if(m_pBMIH->biBitCount == 8)
+		{
+			pGray = GetRow(y);
+		}
+		else
+		{
+			vecBuf.resize(nWidth);
+			pGray = &vecBuf[0];
+		}
+
+		for(j=0; j<nWidth; j++)
+			pGray[j] = ((pFg[j >> 6] >> (63 - (j & 63))) & 1) ? 0 : 255;
+
+		if(m_pBMIH->biBitCount != 8)
+			SetGrayRow(y, pGray);
+		return;
 	}
 
-	return TRUE;
+	LPBYTE pRow = GetRow(y);
+	RGBQUAD *p = (RGBQUAD*)m_lpvColorTable;
+	uint64_t nFlip = (p[0].rgbBlue != 0) ? 0 : ~(uint64_t)0;
+
+	// ֽ
+	int nFullBytes = nWidth / 8;
+	for(j=0; j<nFullBytes; j++)
+	{
+		uint64_t nBits = pFg[j >> 3] ^ nFlip;
+		pRow[j] = (BYTE)(nBits >> (56 - 8 * (j & 7)));
+	}
+
+	// βһֽڵ
+	int nRest = nWidth % 8;
+	if(nRest)
+	{
+		BYTE bMask = (BYTE)(0xFF << (8 - nRest));
+		uint64_t nBits = pFg[nFullBytes >> 3] ^ nFlip;
+		BYTE bByte = (BYTE)(nBits >> (56 - 8 * (nFullBytes & 7)));
+		pRow[nFullBytes] = (BYTE)((pRow[nFullBytes] & ~bMask) | (bByte & bMask));
+	}
 }
 
+/**************************************************
+const float* CImg::GetFloatRow(int y, float* pBuf) const
+
+ܣ
+	Ըȡyصֵ16λͼȡԭֵʧȣ
+	ʽȡGetGrayRowĻҶֵ
+
+ƣ
+	pBufҪGetWidthPixel()float
 
-BOOL CImg::Draw(CDC* pDC, CRect rt)
+
+	int y
+		кţ϶¼
+	float* pBuf
+		ǸͼʱڴתĻ
+ֵ
+	const float*ͣиֵ׵ַͼֱӷλͼݣ
+	пʽpBuf
+***************************************************/
+const float* CImg::GetFloatRow(int y, float* pBuf) const
 {
-	if(m_pBMIH == NULL)
-		return FALSE;
+	int nWidth = m_pBMIH->biWidth;
+	int j;
 
-	if(rt.IsRectNull())
+	int nFormat = GetFormat();
+	if(nFormat == IMG_FMT_FLOAT32)
 	{
-		rt.right = m_pBMIH->biWidth;
-		rt.bottom = m_pBMIH->biHeight;
+		return GetConstRowFloat(y);
 	}
-
-	if(rt.Width() > m_pBMIH->biWidth)
+	else if(nFormat == IMG_FMT_GRAY16)
 	{
-		rt.right = rt.left + m_pBMIH->biWidth;
+		const WORD* pRow = GetConstRow16(y);
+		for(j=0; j<nWidth; j++)
+			pBuf[j] = pRow[j];
 	}
-
-	if(rt.Height() > m_pBMIH->biHeight)
+	else if(nFormat == IMG_FMT_GRAY8)
 	{
-		rt.bottom = rt.top + m_pBMIH->biHeight;
+		const BYTE* pRow = GetConstRow(y);
+		for(j=0; j<nWidth; j++)
+			pBuf[j] = pRow[j];
 	}
-
-	for(int i=0; i<m_pBMIH->biHeight; i++)
+	else
 	{
-	
-			::SetDIBitsToDevice(*pDC, rt.left, rt.top, rt.Width(), 
-				rt.Height(), 0, 0, i, 1, m_lpData[i], (BITMAPINFO*)m_pBMIH, DIB_RGB_COLORS);
-	
+		vector<BYTE> vecGray(nWidth);
+		const BYTE* pGray = GetGrayRow(y, &vecGray[0]);
+		for(j=0; j<nWidth; j++)
+			pBuf[j] = pGray[j];
 	}
 
-	return TRUE;
+	return pBuf;
 }
 
 /**************************************************
-void CImg::SetPixel(int x, int y, COLORREF color)
+void CImg::SetFloatRow(int y, const float* pValue)
 
 ܣ
-	趨ָλصɫֵ
-
-ƣ
-	
+	øõyеءͼֱӱ棻8λ16λͼ
+	벢ضϵ0255065535ֵͼ񰴻Ҷֵ
 
 
-	int x, int y
-		ָغᡢֵ
-	COLORREF
-		趨ָλõɫֵRGBʽ
+	int y
+		кţ϶¼
+	const float* pValue
+		иصֵΪGetWidthPixel()
 ֵ
 	
 ***************************************************/
-void CImg::SetPixel(int x, int y, COLORREF color)
+void CImg::SetFloatRow(int y, const float* pValue)
 {
-	if(m_pBMIH->biBitCount == 8)			// 256ɫͼ
+	int nWidth = m_pBMIH->biWidth;
+	int j;
+
+	int nFormat = GetFormat();
+	if(nFormat == IMG_FMT_FLOAT32)
 	{
-		m_lpData[m_pBMIH->biHeight - y - 1][x] = GetRValue(color);
+		memcpy(GetRowFloat(y), pValue, nWidth * sizeof(float));
 	}
-	else if(m_pBMIH->biBitCount == 1)		// ɫͼ
+	else if(nFormat == IMG_FMT_GRAY16)
 	{
-		BYTE Color = GetRValue(color);
-
-
-		// 0
-		RGBQUAD *p = (RGBQUAD*)m_lpvColorTable;
-		if(p[0].rgbBlue != 0)
-			Color = !Color;
-
-		y = m_pBMIH->biHeight - y - 1;
-		
-		// ɫ
-		if (Color == 0)  // öӦλΪ0
-		{
-			if(x % 8==0)
-			{
-				m_lpData[y][x/8] &= 0x7F;  
-			}
-			else if(x % 8==1)
-			{
-				m_lpData[y][x/8] &= 0xBF;
-			}
-			else if(x % 8==2)
-			{
-				m_lpData[y][x/8] &= 0xDF;
-			}
-			else if(x % 8==3)
-			{
-				m_lpData[y][x/8] &= 0xEF;
-			}
-			else if(x % 8==4)
-			{
-				m_lpData[y][x/8] &= 0xF7;
-			}
-			else if(x % 8==5)
-			{
-				m_lpData[y][x/8] &= 0xFB;
-			}
-			else if(x % 8==6)
-			{
-				m_lpData[y][x/8] &= 0xFD;
-			}
-			else if(x % 8==7)
-			{
-				m_lpData[y][x/8] &= 0xFE;
-			}
-		}
-		else // ɫ
+		WORD* pRow = GetRow16(y);
+		for(j=0; j<nWidth; j++)
 		{
-			if(x % 8==0)
-			{
-				m_lpData[y][x/8] |= 0x80;
-			}
-			else if(x % 8==1)
-			{
-				m_lpData[y][x/8] |= 0x40;
-			}
-			else if(x % 8==2)
-			{
-				m_lpData[y][x/8] |= 0x20;
-			}
-			else if(x % 8==3)
-			{
-				m_lpData[y][x/8] |= 0x10;
-			}
-			else if(x % 8==4)
-			{
-				m_lpData[y][x/8] |= 0x08;
-			}
-			else if(x % 8==5)
-			{
-				m_lpData[y][x/8] |= 0x04;
-			}
-			else if(x % 8==6)
-			{
-				m_lpData[y][x/8] |= 0x02;
-			}
-			else if(x % 8==7)
-			{
-				m_lpData[y][x/8] |= 0x01;
-			}
+			float fValue = pValue[j];
+			pRow[j] = fValue <= 0 ? 0 : (fValue >= 65535 ? 65535 : (WORD)(fValue + 0.5f));
 		}
 	}
-	else if(m_pBMIH->biBitCount == 24)
+	else
 	{
-		m_lpData[m_pBMIH->biHeight - y - 1][x*3] = GetBValue(color);
-		m_lpData[m_pBMIH->biHeight - y - 1][x*3 + 1] = GetGValue(color);
-		m_lpData[m_pBMIH->biHeight - y - 1][x*3 + 2] = GetRValue(color);
+		vector<BYTE> vecGray(nWidth);
+		for(j=0; j<nWidth; j++)
+			vecGray[j] = FloatToGray(pValue[j]);
+		SetGrayRow(y, &vecGray[0]);
 	}
 }
 
 
-
 void CImg::Rectangle(POINT ptLT, POINT ptRB)
 {
 	if(m_pBMIH->biBitCount == 8)
@@ -908,7 +2331,7 @@ bool CImg::Index2Gray()
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 /*******************
-CImg CImg::operator - (CImg gray)
+CImg CImg::operator - (const CImg& gray)
 
 ܣͼλ
 
@@ -918,9 +2341,10 @@ CImg CImg::operator - (CImg gray)
 ֵ:
 	CImg  CImg ͼ
 *******************/
-CImg CImg::operator - (CImg &gray)
+CImg CImg::operator - (const CImg& gray) const
 {
 	CImg grayRet = *this; //ͼ
+	grayRet.MakeUnique(FALSE); //ÿһжд踴ԭ
 
 	//ȡͼĸߺͿ
 	int nHeight = GetHeight();
@@ -929,12 +2353,9 @@ CImg CImg::operator - (CImg &gray)
 	int i, j;//ѭ
 	
 	//CImgֱӽΪĽС0
-	vector< vector<int> > GrayMat;//ݴͼĻҶȵ
-	vector<int> vecRow(nWidth, 0); //GrayMatеһУʼΪ0
-	for(i=0; i<nHeight; i++)
-	{
-		GrayMat.push_back(vecRow);
-	}
+	vector<int> GrayMat(nWidth * nHeight, 0);//ݴͼĻҶȵ
+	vector<BYTE> vecBuf1(nWidth), vecBuf2(nWidth); //8λͼĻҶл
+	vector<BYTE> vecRow(nWidth); //һ
 
 	//СҶȺֵ
 	int nMax = -255;
@@ -943,16 +2364,19 @@ CImg CImg::operator - (CImg &gray)
 	//ɨͼ
 	for(i=0; i<nHeight; i++)
 	{
+		const BYTE* pRow1 = GetGrayRow(i, &vecBuf1[0]);
+		const BYTE* pRow2 = gray.GetGrayRow(i, &vecBuf2[0]);
+		int* pMat = &GrayMat[i * nWidth];
 		for(j=0; j<nWidth; j++)
 		{
 			//λ
-			GrayMat[i][j] = GetGray(j, i) - gray.GetGray(j, i);
+			pMat[j] = pRow1[j] - pRow2[j];
 			
 			//ͳСֵ
-			if( GrayMat[i][j] > nMax)
-				nMax = GrayMat[i][j];
-			if( GrayMat[i][j] < nMin)
-				nMin = GrayMat[i][j];
+			if( pMat[j] > nMax)
+				nMax = pMat[j];
+			if( pMat[j] < nMin)
+				nMin = pMat[j];
 		}// j
 	}// i
 	
@@ -962,20 +2386,21 @@ CImg CImg::operator - (CImg &gray)
 	
 	for(i=0; i<nHeight; i++)
 	{
+		const int* pMat = &GrayMat[i * nWidth];
 		for(j=0; j<nWidth; j++)
 		{
 			BYTE bt;
 			if(nSpan > 0)
-				bt = (GrayMat[i][j] - nMin)*255/nSpan;
-			else if(GrayMat[i][j] <= 255)
-				bt = GrayMat[i][j] ;
+				bt = (pMat[j] - nMin)*255/nSpan;
+			else if(pMat[j] <= 255)
+				bt = pMat[j] ;
 			else
 				bt = 255;
 				
-			grayRet.SetPixel(j, i, RGB(bt, bt, bt));			
-			
-
+			vecRow[j] = bt;
 		}// for j
+
+		grayRet.SetGrayRow(i, &vecRow[0]);
 	}// for i
 		
 	
@@ -983,3 +2408,313 @@ CImg CImg::operator - (CImg &gray)
 	return grayRet;
 }
 
+
+
+//////////////////////////////////////////////////////////////////////
+// CImgWriter
+//////////////////////////////////////////////////////////////////////
+
+// λļеľλãֳ֧2GBļ
+static BOOL SeekImgFile(FILE* fp, long long nPos)
+{
+#ifdef _WIN32
+	return _fseeki64(fp, nPos, SEEK_SET) == 0;
+#else
+	return fseeko(fp, (off_t)nPos, SEEK_SET) == 0;
+#endif
+}
+
+CImgWriter::CImgWriter()
+{
+	m_fp = NULL;
+	memset(&m_bmih, 0, sizeof(m_bmih));
+	m_dwOffBits = 0;
+	m_nWidthBytes = 0;
+	m_nTileBudget = IMG_TILE_BUDGET;
+	m_nBufStart = 0;
+	m_nBufRows = 0;
+	m_nNextRow = 0;
+	m_bError = FALSE;
+}
+
+CImgWriter::~CImgWriter()
+{
+	Close();
+}
+
+void CImgWriter::SetTileBudget(size_t nBytes)
+{
+	// ѻаԭдд
+	if(m_nBufRows > 0)
+		FlushRows();
+
+	m_nTileBudget = nBytes;
+	m_vecBuf.clear();
+}
+
+int CImgWriter::GetTileRows() const
+{
+	if(m_nWidthBytes <= 0)
+		return 1;
+
+	size_t nRows = m_nTileBudget / m_nWidthBytes;
+	if(nRows > (size_t)m_bmih.biHeight)
+		nRows = m_bmih.biHeight;
+
+	return nRows > 0 ? (int)nRows : 1;
+}
+
+/**************************************************
+BOOL CImgWriter::Open(LPCTSTR lpcPathName, const CImg& imgFormat, int nWidth, int nHeight)
+
+ܣ
+	λͼļдļͷϢͷɫԤnWidthnHeight
+	֮WriteRowWriteTile
+ƣ
+	λɫȡimgFormatimgFormatͬС
+	δдΪ0
+
+
+	LPCTSTR lpcPathName
+		ļ·
+	const CImg& imgFormat
+		ṩظʽͼ
+	int nWidth, int nHeight
+		ͼĿȺ͸߶
+ֵ
+	BOOLͣTRUEΪɹFALSEΪʧ
+***************************************************/
+BOOL CImgWriter::Open(LPCTSTR lpcPathName, const CImg& imgFormat, int nWidth, int nHeight)
+{
+	if(!imgFormat.IsValidate() || nWidth <= 0 || nHeight <= 0)
+		return FALSE;
+
+	Close();
+
+	m_bmih = *imgFormat.m_pBMIH;
+	m_bmih.biSize = sizeof(BITMAPINFOHEADER);
+	m_bmih.biCompression = GetFormatCompression(imgFormat.GetFormat());
+	m_bmih.biWidth = nWidth;
+	m_bmih.biHeight = nHeight;
+
+	return Create(lpcPathName, (const RGBQUAD*)imgFormat.GetColorTable(), imgFormat.GetColorTableEntriesNum());
+}
+
+BOOL CImgWriter::Open(LPCTSTR lpcPathName, int nWidth, int nHeight, int nFormat)
+{
+	// Ĭϵɫ
+	RGBQUAD rgbTable[256];
+	int nEntries = MakeDefaultColorTable(nFormat, rgbTable);
+	if(nEntries < 0 || nWidth <= 0 || nHeight <= 0)
+		return FALSE;
+
+	Close();
+
+	memset(&m_bmih, 0, sizeof(m_bmih));
+	m_bmih.biSize = sizeof(BITMAPINFOHEADER);
+	m_bmih.biWidth = nWidth;
+	m_bmih.biHeight = nHeight;
+	m_bmih.biPlanes = 1;
+	m_bmih.biBitCount = (WORD)nFormat;
+	m_bmih.biCompression = GetFormatCompression(nFormat);
+
+	return Create(lpcPathName, rgbTable, nEntries);
+}
+
+BOOL CImgWriter::Create(LPCTSTR lpcPathName, const RGBQUAD* pColorTable, int nColorTableEntries)
+{
+	m_nWidthBytes = WIDTHBYTES(m_bmih.biWidth * m_bmih.biBitCount);
+	m_bmih.biSizeImage = (DWORD)((size_t)m_nWidthBytes * m_bmih.biHeight);
+	m_bmih.biClrUsed = 0;
+	m_dwOffBits = sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER) + nColorTableEntries * sizeof(RGBQUAD);
+
+	m_fp = fopen(lpcPathName, "wb");
+	if(m_fp == NULL)
+		return FALSE;
+
+	BITMAPFILEHEADER bmfHeader = {};
+	bmfHeader.bfType = MAKEWORD('B', 'M');
+	bmfHeader.bfOffBits = m_dwOffBits;
+	bmfHeader.bfSize = (DWORD)(m_dwOffBits + (size_t)m_nWidthBytes * m_bmih.biHeight);
+
+	long long nFileSize = (long long)m_dwOffBits + (long long)m_nWidthBytes * m_bmih.biHeight;
+	BYTE bZero = 0;
+
+	m_bError = fwrite(&bmfHeader, sizeof(bmfHeader), 1, m_fp) != 1
+		|| fwrite(&m_bmih, sizeof(m_bmih), 1, m_fp) != 1
+		|| (nColorTableEntries > 0 && fwrite(pColorTable, sizeof(RGBQUAD), nColorTableEntries, m_fp) != (size_t)nColorTableEntries)
+		// дһֽڣԤ
+		|| !SeekImgFile(m_fp, nFileSize - 1)
+		|| fwrite(&bZero, 1, 1, m_fp) != 1;
+
+	m_vecBuf.clear();
+	m_nBufStart = 0;
+	m_nBufRows = 0;
+	m_nNextRow = 0;
+
+	if(m_bError)
+	{
+		fclose(m_fp);
+		m_fp = NULL;
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+BOOL CImgWriter::Close()
+{
+	if(m_fp == NULL)
+		return FALSE;
+
+	FlushRows();
+
+	if(fclose(m_fp) != 0)
+		m_bError = TRUE;
+	m_fp = NULL;
+
+	std::vector<BYTE>().swap(m_vecBuf);
+
+	return !m_bError;
+}
+
+BOOL CImgWriter::WriteAt(int y, int nOffset, const BYTE* pData, size_t nBytes)
+{
+	long long nPos = (long long)m_dwOffBits + (long long)(m_bmih.biHeight - 1 - y) * m_nWidthBytes + nOffset;
+
+	if(!SeekImgFile(m_fp, nPos) || fwrite(pData, 1, nBytes, m_fp) != nBytes)
+	{
+		m_bError = TRUE;
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**************************************************
+BOOL CImgWriter::FlushRows()
+
+ܣ
+	WriteRowдļڽͼڣ
+	¶ϴŵļҲһΣд
+***************************************************/
+BOOL CImgWriter::FlushRows()
+{
+	if(m_nBufRows == 0)
+		return TRUE;
+
+	int nLast = m_nBufStart + m_nBufRows - 1;
+	long long nPos = (long long)m_dwOffBits + (long long)(m_bmih.biHeight - 1 - nLast) * m_nWidthBytes;
+
+	BOOL bSuc = SeekImgFile(m_fp, nPos);
+	for(int i=m_nBufRows-1; i>=0 && bSuc; i--)
+	{
+		bSuc = fwrite(&m_vecBuf[(size_t)i * m_nWidthBytes], 1, m_nWidthBytes, m_fp) == (size_t)m_nWidthBytes;
+	}
+
+	if(!bSuc)
+		m_bError = TRUE;
+
+	m_nBufStart += m_nBufRows;
+	m_nBufRows = 0;
+
+	return bSuc;
+}
+
+/**************************************************
+BOOL CImgWriter::WriteRow(const BYTE* pRow)
+
+ܣ
+	϶µ˳׷һءȷ뻺棬
+	ﵽGetTileRows()ʱдļ
+
+
+	const BYTE* pRow
+		һݣʽCImg::GetConstRowͬGetWidthByte()ֽ
+ֵ
+	BOOLͣдȫлļʱFALSE
+***************************************************/
+BOOL CImgWriter::WriteRow(const BYTE* pRow)
+{
+	if(m_fp == NULL || m_nNextRow >= m_bmih.biHeight)
+		return FALSE;
+
+	int nTileRows = GetTileRows();
+	if(m_vecBuf.empty())
+		m_vecBuf.resize((size_t)nTileRows * m_nWidthBytes);
+
+	memcpy(&m_vecBuf[(size_t)m_nBufRows * m_nWidthBytes], pRow, m_nWidthBytes);
+	m_nBufRows++;
+	m_nNextRow++;
+
+	if(m_nBufRows == nTileRows || m_nNextRow == m_bmih.biHeight)
+		return FlushRows();
+
+	return !m_bError;
+}
+
+/**************************************************
+BOOL CImgWriter::WriteTile(const CImg& img, int x, int y, int nSrcY, int nRows)
+
+ܣ
+	imgеһдͼУдп˳
+	WriteRowӰ죨ͬһλдΪ׼
+	дǰȰWriteRowдļ󸲸һ
+ƣ
+	imgλͬдܳͼ
+	xλΪ8ıȲʱλҲΪ8ı
+
+
+	const CImg& img
+		Դͼ
+	int x, int y
+		дλã϶¼
+	int nSrcY
+		imgĵnSrcYпʼ
+	int nRows
+		д-1ʾimgĩ
+ֵ
+	BOOLͣTRUEΪɹFALSEΪʧ
+***************************************************/
+BOOL CImgWriter::WriteTile(const CImg& img, int x, int y, int nSrcY, int nRows)
+{
+	if(m_fp == NULL || !img.IsValidate() || img.m_pBMIH->biBitCount != m_bmih.biBitCount)
+		return FALSE;
+
+	if(nRows < 0)
+		nRows = img.GetHeight() - nSrcY;
+
+	int nWidth = img.GetWidthPixel();
+	int nBitCount = m_bmih.biBitCount;
+	if(x < 0 || y < 0 || nSrcY < 0 || nRows <= 0 || nSrcY + nRows > img.GetHeight()
+		|| x + nWidth > m_bmih.biWidth || y + nRows > m_bmih.biHeight
+		|| (x * nBitCount) % 8 != 0 || (x + nWidth < m_bmih.biWidth && (nWidth * nBitCount) % 8 != 0))
+		return FALSE;
+
+	if(!FlushRows())
+		return FALSE;
+
+	if(x == 0 && nWidth == m_bmih.biWidth)
+	{
+		// УļһΣһпʼ˳д
+		BOOL bSuc = SeekImgFile(m_fp, (long long)m_dwOffBits + (long long)(m_bmih.biHeight - y - nRows) * m_nWidthBytes);
+		for(int i=nRows-1; i>=0 && bSuc; i--)
+		{
+			bSuc = fwrite(img.GetConstRow(nSrcY + i), 1, m_nWidthBytes, m_fp) == (size_t)m_nWidthBytes;
+		}
+
+		if(!bSuc)
+			m_bError = TRUE;
+		return bSuc;
+	}
+
+	// Ужλд
+	size_t nBytes = ((size_t)nWidth * nBitCount + 7) / 8;
+	for(int i=0; i<nRows; i++)
+	{
+		if(!WriteAt(y + i, x * nBitCount / 8, img.GetConstRow(nSrcY + i), nBytes))
+			return FALSE;
+	}
+
+	return TRUE;
+}
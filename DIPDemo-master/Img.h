@@ -8,7 +8,11 @@
 #ifndef __GRAY_H__
 #define __GRAY_H__
 
+#include "ImgPlatform.h"
 #include "math.h"
+#include <stdio.h>
+#include <atomic>
+#include <vector>
 
 // ͼ
 
@@ -19,25 +23,121 @@
 // biWidth'
 #define WIDTHBYTES(bits)    (((bits) + 31) / 32 * 4)
 
+// ػĶֽмࣨstrideҲ˶룬
+// ʹÿһе׵ַڻб߽
+#define IMG_ALIGN_BYTES     64
+#define ALIGNSTRIDE(bytes)  (((bytes) + IMG_ALIGN_BYTES - 1) / IMG_ALIGN_BYTES * IMG_ALIGN_BYTES)
+
+// ظʽȡֵΪÿصλ
+#define IMG_FMT_BINARY      1   // 1λֵͼ
+#define IMG_FMT_GRAY8       8   // 8λҶȣ256ɫͼ
+#define IMG_FMT_GRAY16      16  // 16λ޷ŵͨͼ
+#define IMG_FMT_RGB24       24  // 24λɫͼ
+#define IMG_FMT_FLOAT32     32  // 32λ㵥ͨͼ
+
+// 16λ㵥ͨͼϢͷbiCompressionеıǡָʽ
+// ׼λͼļֻCImgأʾ򽻸ǰ
+// ConvertFormatת8λͼ
+#define BI_DIP_GRAY16       0x36315947  // "GY16"
+#define BI_DIP_FLOAT32      0x32335446  // "FT32"
+
+// CImgWriterĬϵĻԤ㣨ֽڣ
+#define IMG_TILE_BUDGET     (16 * 1024 * 1024)
+
+// ÿ̵߳ػĬ໺Ŀֽ
+#define IMG_POOL_LIMIT      (256 * 1024 * 1024)
+
+// ͼͣCImg::AttachView
+#define IMG_VIEW_NONE       0   // ͼĻ
+#define IMG_VIEW_READ       1   // ֻͼ״дʱƳռ
+#define IMG_VIEW_WRITE      2   // дͼдֱԭͼ
+
 //////  0 -> 255  ->
 
+// ֵ벢ضΪ0255ĻҶ
+inline BYTE FloatToGray(float fValue)
+{
+	return fValue <= 0 ? 0 : (fValue >= 255 ? 255 : (BYTE)(fValue + 0.5f));
+}
+
+
+class CImg;
+
+// λͼдõֽʹCImgļдļ
+// MFCCFileCпFILE*ȣ
+class CImgStream
+{
+public:
+	virtual ~CImgStream() {}
+
+	// ȡnCountֽڣʵʶȡֽ
+	virtual UINT Read(void* lpBuf, UINT nCount) = 0;
+	// дnCountֽڣʵдֽ
+	virtual UINT Write(const void* lpBuf, UINT nCount) = 0;
+};
+
+// ػɶCImgдǰƣcopy-on-write
+struct SImgBuffer
+{
+	LPBYTE pBits;			// IMG_ALIGN_BYTESֽڶ
+	size_t nSize;			// ݵֽ
+	std::atomic<long> nRef;	// ü
+	LPVOID pMapBase;		// ӳʱΪֻļӳ׵ַpBitsָУΪNULL
+	size_t nMapSize;		// ļӳֽ
+	size_t nCapacity;		// pBitsʵʷֽСȡӳʱΪ0
+};
+
+// ػصͳƣ߳ۼƣ
+struct SImgPoolStats
+{
+	unsigned long long nHits;	// ӳȡûĴ
+	unsigned long long nMisses;	// ûкʵĻϵͳĴ
+	size_t nCachedBytes;		// ǰڳеĿֽ
+	size_t nInUseBytes;			// ǰͼռõֽ
+	size_t nPeakBytes;			// ռ뻺ֽ֮͵ķֵ
+};
+
+// ָݷ
+// ɴ밴LPBYTE*бķʽʹm_lpData[i]¶ϵiУ!m_lpData
+// ظΪźɸ׵ַмеַ
+class CImgRowTable
+{
+public:
+	CImgRowTable(CImg* pImg) : m_pImg(pImg) {}
+
+	LPBYTE operator [] (int i) const;
+	BOOL operator ! () const;
+
+private:
+	// ͼ񿽱ʼָCImg
+	CImgRowTable(const CImgRowTable&);
+	CImgRowTable& operator = (const CImgRowTable&);
+
+	CImg* m_pImg;
+};
+
 
 class CImg  
 {
 public:
 	// 캯
 	CImg();
-	// Copy캯
-	CImg(CImg& gray);
+	// Copy캯дʱʱֻػ
+	CImg(const CImg& gray);
+	// Move캯ӹgrayȫ
+	CImg(CImg&& gray);
 	// ء=µĶ
-	void operator = (CImg& gray); //ͼֵ
-
-	BOOL operator == (CImg& gray); //ж2ͼǷͬ
-	CImg operator & (CImg& gray); //ͼλ
-	CImg operator | (CImg& gray); //ͼλ
-	CImg operator + (CImg gray); //ͼ
-	CImg operator - (CImg& gray); //ͼ
-	CImg operator ! (); //ͼɫ
+	CImg& operator = (const CImg& gray); //ͼֵ
+	CImg& operator = (CImg&& gray); //ͼת
+
+	BOOL operator == (const CImg& gray) const; //ж2ͼǷͬ
+	CImg operator & (const CImg& gray) const; //ͼλ
+	CImg operator | (const CImg& gray) const; //ͼλ
+	CImg operator + (const CImg& gray) const; //ͼ
+	CImg operator - (const CImg& gray) const; //ͼ
+	CImg operator ! () const; //ͼɫ
+	CImg& operator &= (const CImg& gray); //ͼλ룬д
+	CImg& operator |= (const CImg& gray); //ͼλ򣬽д
 	
 
 	// 
@@ -46,39 +146,135 @@ public:
 public:	
 	
 	// жλͼǷЧ
-	BOOL IsValidate() { return m_pBMIH != NULL; }
+	BOOL IsValidate() const { return m_pBMIH != NULL; }
 
 	// صֵʼΪcolor
 	void InitPixels(BYTE color);
 
-	// ļλͼ
-	BOOL AttachFromFile(LPCTSTR lpcPathName);
-	BOOL AttachFromFile(CFile &file);
+	// ָߴ͸ʽIMG_FMT_*ͼδʼ
+	BOOL Create(int nHeight, int nWidth, int nFormat);
+	// ظʽIMG_FMT_*ֵ֧ĸʽ0
+	int GetFormat() const;
+	// ǷΪ16λ򸡵ĸ߾ȵͨͼ
+	BOOL IsHighPrecision() const { int nFmt = GetFormat(); return nFmt == IMG_FMT_GRAY16 || nFmt == IMG_FMT_FLOAT32; }
+	// תΪ8λ16λ򸡵㵥ͨͼĿֵ = ԴֵdScale + dOffset
+	BOOL ConvertFormat(CImg* pTo, int nFormat, double dScale = 1.0, double dOffset = 0.0) const;
+
+	// ļλͼbMapFileΪTRUEʱֻڴӳ䷽ʽ
+	BOOL AttachFromFile(LPCTSTR lpcPathName, BOOL bMapFile = FALSE);
+	BOOL AttachFromStream(CImgStream &stream);
 	// λͼ浽ļ
 	BOOL SaveToFile(LPCTSTR lpcPathName);
+	BOOL SaveToStream(CImgStream &stream);
+
+#ifndef DIP_NO_MFC
+	// MFC䲿֣ʵּImgMFC.cpp
+	// CFileλͼλͼCFile
+	BOOL AttachFromFile(CFile &file);
 	BOOL SaveToFile(CFile &file);
 
 	// DCϻλͼ
 	BOOL Draw(CDC* pDC);
 	BOOL Draw(CDC* pDC, CRect rt);
+#endif
 
 	// صֵ
 	void SetPixel(int x, int y, COLORREF color);
 	// ȡصֵ
-	COLORREF GetPixel(int x, int y);
+	COLORREF GetPixel(int x, int y) const;
 	// ȡҶֵ
-	BYTE GetGray(int x, int y);
-
+	BYTE GetGray(int x, int y) const;
+
+	// зʺкyGetPixel/SetPixelһ£϶¼
+	// ȡһݵ׵ַд
+	LPBYTE GetRow(int y);
+	// ȡһݵ׵ַֻ
+	const BYTE* GetConstRow(int y) const;
+	// RGBԪ24λͼһ
+	RGBTRIPLE* GetRowRGB(int y);
+	const RGBTRIPLE* GetConstRowRGB(int y) const;
+	// ȡһеĻҶֵ
+	const BYTE* GetGrayRow(int y, BYTE* pBuf) const;
+	// ûҶֵһ
+	void SetGrayRow(int y, const BYTE* pGray);
+	// 16λ㵥ͨͼз
+	WORD* GetRow16(int y) { return (WORD*)GetRow(y); }
+	const WORD* GetConstRow16(int y) const { return (const WORD*)GetConstRow(y); }
+	float* GetRowFloat(int y) { return (float*)GetRow(y); }
+	const float* GetConstRowFloat(int y) const { return (const float*)GetConstRow(y); }
+	// ֵͼλѹУÿ64λִ64أҴλʼţ
+	// ͼȵλΪ0ڶֵ̬ѧ߼֣64أ
+	// ÿ
+	int GetPackedWords() const { return (m_pBMIH->biWidth + 63) / 64; }
+	// ȡһеǰλҶΪ0ɫͱλҶΪ255pBgΪNULL
+	void GetPackedRow(int y, uint64_t* pFg, uint64_t* pBg = NULL) const;
+	// ǰλһУǰΪ0Ϊ255
+	void SetPackedRow(int y, const uint64_t* pFg);
+	// Ըȡһصֵ߾ͼʧ
+	const float* GetFloatRow(int y, float* pBuf) const;
+	// øһأʽ벢ضϵȡֵΧ
+	void SetFloatRow(int y, const float* pValue);
+
+
+	// ػ׵ַ¶ϴŵĵ0Уд
+	LPBYTE GetBits() { MakeUnique(); return m_pBits; }
+	// ػ׵ַֻ
+	const BYTE* GetConstBits() const { return m_pBits; }
+	// ׵ַֽ֮СGetWidthByte()
+	// ӳصͼļегͬ״дŰIMG_ALIGN_BYTES
+	int GetStride() const { return m_nStride; }
+
+	// дʱ
+	// 򿪻رտʱػĬϴ򿪣ֻӰ֮Ŀ
+	static void EnableCopyOnWrite(BOOL bEnable);
+	static BOOL IsCopyOnWriteEnabled();
+	// ػ
+	// ÿ߳һСĳأͷŵػڵǰ̵߳ĳУ
+	// ֮ͬһֱӸãͬߴͼʱϵͳڴ
+	static void EnableBufferPool(BOOL bEnable);
+	static BOOL IsBufferPoolEnabled();
+	// ÿ߳໺ĿֽʱͷŵĻֱӹ黹ϵͳ
+	static void SetBufferPoolLimit(size_t nBytes);
+	static size_t GetBufferPoolLimit();
+	// ѵǰ̳߳лĻȫ黹ϵͳ
+	static void TrimBufferPool();
+	static void GetBufferPoolStats(SImgPoolStats* pStats);
+	// СδдֵΪǰֵ
+	static void ResetBufferPoolStats();
+
+	// ͼ
+	// ʹΪimgо(x, y, nWidth, nHeight)ͼأ׵ַ
+	// ָimgĻмimgͬ㷨ֻʸڴ档ͼimg
+	// أʹڼimg뱣ЧҲ·䣨ıߴ硢дʱƵȣ
+	// 1λͼxΪ8ı򳬳imgimgΪʱFALSE
+	// ֻͼ״дʱΪռͼ񣬲Ӱimg
+	BOOL AttachView(const CImg& img, int x, int y, int nWidth, int nHeight);
+	// дͼдֱimgϣΪ㷨ʱߴ硢λͬĽ
+	// дظ򣬷ͼimgΪͨͼ
+	BOOL AttachWritableView(CImg& img, int x, int y, int nWidth, int nHeight);
+	// ͼͣIMG_VIEW_*֮һ
+	int GetViewType() const { return m_nViewType; }
+	BOOL IsView() const { return m_nViewType != IMG_VIEW_NONE; }
+
+	// ػǷCImg
+	BOOL IsShared() const { return m_pBuffer != NULL && m_pBuffer->nRef.load(std::memory_order_acquire) > 1; }
+	// Ƿֱָֻļӳ䣨AttachFromFile
+	BOOL IsMapped() const { return m_pBuffer != NULL && m_pBuffer->pMapBase != NULL; }
+	// дǰãָļӳΪֻͼƳռһݣ
+	// bKeepDataΪFALSEʾдֻ䲻
+	void MakeUnique(BOOL bKeepData = TRUE) { if(IsShared() || IsMapped() || m_nViewType == IMG_VIEW_READ) Unshare(bKeepData); }
 
 	// ȡһеֽ
-	int GetWidthByte();
+	int GetWidthByte() const;
 	// ȡһе
-	int GetWidthPixel();
+	int GetWidthPixel() const;
 	// ȡ߶
-	int GetHeight();
+	int GetHeight() const;
 
 	//ıλͼĳߴ
 	void ImResize(int nHeight, int nWidth);
+	// imgĸʽϢͷɫָߴͼδʼ
+	void CreateLike(const CImg& img, int nHeight, int nWidth);
 public:
 
 	// 滭	
@@ -99,24 +295,118 @@ public:
 	// 256ɫͼתҶͼ
 	bool Index2Gray();
 
-	LPVOID GetColorTable(){return m_lpvColorTable;}
-	int GetColorTableEntriesNum(){return m_nColorTableEntries;}
+	LPVOID GetColorTable() const {return m_lpvColorTable;}
+	int GetColorTableEntriesNum() const {return m_nColorTableEntries;}
 private:
 	void CleanUp();	
+	// ǰϢͷĿߺλػ
+	void AllocBits();
+	// ֻڴӳ䷽ʽλͼļʺӳʱFALSE
+	BOOL AttachFromMapping(LPCTSTR lpcPathName);
+	// ͷŶػãһͷʱڴ
+	void FreeBits();
+	// Ƴռػ
+	void Unshare(BOOL bKeepData);
+	// ͼimg׵ַڵǰȷ
+	BOOL SetView(const CImg& img, int x, int y, int nWidth, int nHeight, int nViewType);
+	// пߴ硢λͬimgأֻдеЧλβ֮ڴ
+	void CopyPixels(const CImg& img);
+	// ǷΪдͼҿɰimgд
+	BOOL CanWriteBack(const CImg& img) const
+	{
+		return m_nViewType == IMG_VIEW_WRITE && img.m_pBits != NULL && img.m_pBMIH->biWidth == m_pBMIH->biWidth
+			&& img.m_pBMIH->biHeight == m_pBMIH->biHeight && img.m_pBMIH->biBitCount == m_pBMIH->biBitCount;
+	}
+protected:
+	// imgػ
+	void ShareBits(const CImg& img);
 
 public:
 	// ļ
 	BITMAPINFOHEADER *m_pBMIH;
-	LPBYTE  *m_lpData;
+	// ָݷ´ʹGetRowϵк
+	CImgRowTable m_lpData;
 protected:
+	// ػ
+	SImgBuffer* m_pBuffer;
+	// ׵ַm_pBuffer->pBitsλͼϰ¶д
+	LPBYTE m_pBits;
+	// м
+	int m_nStride;
+	// ͼͣIMG_VIEW_*ͼm_pBufferΪNULLm_pBitsָԭͼе
+	int m_nViewType;
+
 	int m_nColorTableEntries;
 	LPVOID m_lpvColorTable;
 };
 
 
+// ʽλͼд
+// дļͷԤͼ֮л򰴿дأͼ
+// شڴСдȻڲԤд
+// дʱλͼ¶ϵ˳һдļеĶӦλ
+class CImgWriter
+{
+public:
+	CImgWriter();
+	virtual ~CImgWriter();
+
+	// ûԤ㣨ֽڣWriteRowͷִд߶
+	void SetTileBudget(size_t nBytes);
+	size_t GetTileBudget() const { return m_nTileBudget; }
+	// ԤڿɵΪ1
+	int GetTileRows() const;
+
+	// λͼļʽλɫȡimgFormat
+	BOOL Open(LPCTSTR lpcPathName, const CImg& imgFormat, int nWidth, int nHeight);
+	// ָظʽIMG_FMT_*λͼļ8λΪҶȵɫ壬1λΪڰ׵ɫ
+	BOOL Open(LPCTSTR lpcPathName, int nWidth, int nHeight, int nFormat);
+	// дʣĻ沢رļȫдɹʱTRUE
+	BOOL Close();
+	BOOL IsOpen() const { return m_fp != NULL; }
+
+	// ϶µ˳׷һأݸʽCImgͬ
+	BOOL WriteRow(const BYTE* pRow);
+	// imgnSrcYnRowsУ-1ʾĩУдͼ(x, y)
+	// imgλͬxӦλƫΪֽ
+	BOOL WriteTile(const CImg& img, int x, int y, int nSrcY = 0, int nRows = -1);
+
+	int GetWidth() const { return m_bmih.biWidth; }
+	int GetHeight() const { return m_bmih.biHeight; }
+	int GetBitCount() const { return m_bmih.biBitCount; }
+	// WriteRow׷ӵ
+	int GetRowsWritten() const { return m_nNextRow; }
+
+private:
+	// дļͷԤ
+	BOOL Create(LPCTSTR lpcPathName, const RGBQUAD* pColorTable, int nColorTableEntries);
+	// WriteRowдļ
+	BOOL FlushRows();
+	// ϶µĵyСʼֽΪnOffsetnBytesֽдļ
+	BOOL WriteAt(int y, int nOffset, const BYTE* pData, size_t nBytes);
+
+	CImgWriter(const CImgWriter&);
+	CImgWriter& operator = (const CImgWriter&);
+
+	FILE* m_fp;
+	BITMAPINFOHEADER m_bmih;
+	// ļеʼλ
+	DWORD m_dwOffBits;
+	// ļÿеֽ
+	int m_nWidthBytes;
+	size_t m_nTileBudget;
+	// WriteRowл棬0жӦͼĵm_nBufStart
+	std::vector<BYTE> m_vecBuf;
+	int m_nBufStart;
+	int m_nBufRows;
+	int m_nNextRow;
+	BOOL m_bError;
+};
+
+
 /////////////////////////////////// inline functions ///////////////////////////////
 /**************************************************
-inline int CImg::GetWidthByte()
+inline int CImg::GetWidthByte() const
 
 ܣ
 	CImgʵеͼÿռõֽ
@@ -128,13 +418,13 @@ inline int CImg::GetWidthByte()
 ֵ
 	intͣͼÿռõֽ
 ***************************************************/
-inline int CImg::GetWidthByte()
+inline int CImg::GetWidthByte() const
 {
 	return WIDTHBYTES((m_pBMIH->biWidth)*m_pBMIH->biBitCount);
 }
 
 /**************************************************
-inline int CImg::GetWidthPixel()
+inline int CImg::GetWidthPixel() const
 
 ܣ
 	CImgʵеͼÿеĿֱʻ
@@ -146,13 +436,13 @@ inline int CImg::GetWidthPixel()
 ֵ
 	intͣͼÿеĿ
 ***************************************************/
-inline int CImg::GetWidthPixel()
+inline int CImg::GetWidthPixel() const
 {
 	return m_pBMIH->biWidth;
 }
 
 /**************************************************
-inline int CImg::GetHeight()
+inline int CImg::GetHeight() const
 
 ܣ
 	CImgʵеͼÿеĿֱʻ߶
@@ -164,11 +454,42 @@ inline int CImg::GetHeight()
 ֵ
 	intͣͼÿеĿ
 ***************************************************/
-inline int CImg::GetHeight()
+inline int CImg::GetHeight() const
 {
 	return m_pBMIH->biHeight;
 }
 
+/**************************************************
+inline int CImg::GetFormat() const
+
+ܣ
+	ͼظʽ
+ƣ
+	16λ32λͼֻдBI_DIP_GRAY16BI_DIP_FLOAT32ʱ
+	ͨʽ׼λͼе16λ32λɫʽ֧
+
+
+	
+ֵ
+	intͣIMG_FMT_*֮һֵ֧ĸʽ0
+***************************************************/
+inline int CImg::GetFormat() const
+{
+	switch(m_pBMIH->biBitCount)
+	{
+	case 1:
+	case 8:
+	case 24:
+		return m_pBMIH->biBitCount;
+	case 16:
+		return (m_pBMIH->biCompression == BI_DIP_GRAY16) ? IMG_FMT_GRAY16 : 0;
+	case 32:
+		return (m_pBMIH->biCompression == BI_DIP_FLOAT32) ? IMG_FMT_FLOAT32 : 0;
+	default:
+		return 0;
+	}
+}
+
 /**************************************************
 inline BYTE CImg::GetGray(int x, int y)
 
@@ -181,7 +502,7 @@ inline BYTE CImg::GetGray(int x, int y)
 ֵ
 	λõĻҶֵ
 ***************************************************/
-inline BYTE CImg::GetGray(int x, int y)
+inline BYTE CImg::GetGray(int x, int y) const
 {
 	COLORREF ref = GetPixel(x, y);
 	BYTE r, g, b, byte;
@@ -200,6 +521,69 @@ inline BYTE CImg::GetGray(int x, int y)
 	return byte;
 }
 
+/**************************************************
+inline LPBYTE CImg::GetRow(int y)
+
+ܣ
+	صyݵ׵ַдͼ
+	ÿصGetPixel/SetPixel
+ƣ
+	԰λͼʽţ8λͼÿ1ֽڣ
+	24λͼÿ3ֽڣBGR1λͼÿ1λ
+	ʱȸƳռһݣֻGetConstRow
+
+
+	int y
+		кţ϶¼GetPixel/SetPixelһ
+ֵ
+	LPBYTEͣеһֽڵĵַ
+***************************************************/
+inline LPBYTE CImg::GetRow(int y)
+{
+	MakeUnique();
+	return m_pBits + (size_t)(m_pBMIH->biHeight - y - 1) * m_nStride;
+}
+
+inline const BYTE* CImg::GetConstRow(int y) const
+{
+	return m_pBits + (size_t)(m_pBMIH->biHeight - y - 1) * m_nStride;
+}
+
+/**************************************************
+inline RGBTRIPLE* CImg::GetRowRGB(int y)
+
+ܣ
+	RGBԪʽ24λͼyе׵ַ
+ƣ
+	ֻ24λͼ
+
+
+	int y
+		кţ϶¼
+ֵ
+	RGBTRIPLE*ͣеһصĵַ
+***************************************************/
+inline RGBTRIPLE* CImg::GetRowRGB(int y)
+{
+	return (RGBTRIPLE*)GetRow(y);
+}
+
+inline const RGBTRIPLE* CImg::GetConstRowRGB(int y) const
+{
+	return (const RGBTRIPLE*)GetConstRow(y);
+}
+
+// ݷдʽȡУĻȸ
+inline LPBYTE CImgRowTable::operator [] (int i) const
+{
+	return m_pImg->GetBits() + (size_t)i * m_pImg->GetStride();
+}
+
+inline BOOL CImgRowTable::operator ! () const
+{
+	return m_pImg->GetConstBits() == NULL;
+}
+
 /**************************************************
 inline COLORREF CImg::GetPixel(int x, int y)
 
@@ -212,16 +596,18 @@ inline COLORREF CImg::GetPixel(int x, int y)
 ֵ
 	COLERREFͣRGBʽʾָλõɫֵ
 ***************************************************/
-inline COLORREF CImg::GetPixel(int x, int y)
+inline COLORREF CImg::GetPixel(int x, int y) const
 {
+	const BYTE* pRow = GetConstRow(y);
+
 	if(m_pBMIH->biBitCount == 8)		// 256ɫͼ
 	{
-		BYTE byte = m_lpData[m_pBMIH->biHeight - y - 1][x];
+		BYTE byte = pRow[x];
 		return RGB(byte, byte, byte);
 	}
 	else if(m_pBMIH->biBitCount == 1)	// ɫͼ
 	{
-		BYTE ret = (1<<(7-x%8) & m_lpData[m_pBMIH->biHeight - y - 1][x/8]);
+		BYTE ret = (1<<(7-x%8) & pRow[x/8]);
 
 		// 0
 		RGBQUAD *p = (RGBQUAD*)m_lpvColorTable;
@@ -235,11 +621,21 @@ inline COLORREF CImg::GetPixel(int x, int y)
 	}
 	else if(m_pBMIH->biBitCount == 24)	// ͼ
 	{
-		COLORREF color = RGB(m_lpData[m_pBMIH->biHeight - y - 1][x*3 + 2], 
-		m_lpData[m_pBMIH->biHeight - y - 1][x*3 + 1],
-		m_lpData[m_pBMIH->biHeight - y - 1][x*3]);
+		COLORREF color = RGB(pRow[x*3 + 2], 
+		pRow[x*3 + 1],
+		pRow[x*3]);
 		return color;
 	}
+	else if(GetFormat() == IMG_FMT_GRAY16)	// 16λͨͼȡ8λ
+	{
+		BYTE byte = (BYTE)(((const WORD*)pRow)[x] >> 8);
+		return RGB(byte, byte, byte);
+	}
+	else if(GetFormat() == IMG_FMT_FLOAT32)	// 㵥ͨͼضϵ0255
+	{
+		BYTE byte = FloatToGray(((const float*)pRow)[x]);
+		return RGB(byte, byte, byte);
+	}
 	else
 	{
 		throw "not support now";
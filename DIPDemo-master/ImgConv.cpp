@@ -0,0 +1,690 @@
+// ImgConv.cpp: implementation of the CImgConv class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "ImgPlatform.h"
+#include "ImgConv.h"
+
+#include <math.h>
+#include <atomic>
+
+// ֻx86ṩʵ֡GCCClangtargetԵΪ⼸
+// ָ̲ؼ-mavx2ʱٰCPUѡ
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define DIP_CONV_X86
+#define DIP_TARGET(isa) __attribute__((target(isa)))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define DIP_CONV_X86
+#define DIP_TARGET(isa)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+#if defined(_DEBUG) && !defined(DIP_NO_MFC)
+#undef THIS_FILE
+static char THIS_FILE[]=__FILE__;
+#define new DEBUG_NEW
+#endif
+
+// еļȨͣpOut[j] =  ppIn[t][j]  pW[t]t0ۼ
+typedef void (*PFN_WEIGHTEDSUM)(float* pOut, const float* const* ppIn, const float* pW, int nTaps, int nCount);
+// 8λҶתΪ
+typedef void (*PFN_GRAYTOFLOAT)(float* pOut, const BYTE* pIn, int nCount);
+// Ȩͳϵȡֵ벢ضΪҶ
+typedef void (*PFN_SUMTOGRAY)(BYTE* pOut, const float* pSum, float fCoef, int nCount);
+// ˲һУ㣬CImgConv::HighBoost
+typedef void (*PFN_HIGHBOOST)(int* pOut, const BYTE* const* ppIn, const int* pW, int nTaps,
+	const BYTE* pCenter, int nCenterW, int nShift, int nCount);
+
+static void WeightedSumScalar(float* pOut, const float* const* ppIn, const float* pW, int nTaps, int nCount)
+{
+	for(int j=0; j<nCount; j++)
+	{
+		float fSum = 0;
+		for(int t=0; t<nTaps; t++)
+			fSum += ppIn[t][j] * pW[t];
+		pOut[j] = fSum;
+	}
+}
+
+static void GrayToFloatScalar(float* pOut, const BYTE* pIn, int nCount)
+{
+	for(int j=0; j<nCount; j++)
+		pOut[j] = pIn[j];
+}
+
+static inline BYTE SumToGrayOne(float fSum, float fCoef)
+{
+	float fResult = (float)fabs(fSum * fCoef);
+	return fResult > 255 ? 255 : (BYTE)(fResult + 0.5);
+}
+
+static void SumToGrayScalar(BYTE* pOut, const float* pSum, float fCoef, int nCount)
+{
+	for(int j=0; j<nCount; j++)
+		pOut[j] = SumToGrayOne(pSum[j], fCoef);
+}
+
+static inline int HighBoostOne(int nSum, int nCenter, int nShift)
+{
+	int nLimit = 255 << nShift;
+	nSum = min(max(nSum, -nLimit), nLimit);
+	int nValue = nCenter + nSum + (1 << (nShift - 1));
+	return nValue >= 0 ? (nValue >> nShift) : -((-nValue) >> nShift);
+}
+
+static void HighBoostScalar(int* pOut, const BYTE* const* ppIn, const int* pW, int nTaps,
+	const BYTE* pCenter, int nCenterW, int nShift, int nCount)
+{
+	for(int j=0; j<nCount; j++)
+	{
+		int nSum = 0;
+		for(int t=0; t<nTaps; t++)
+			nSum += ppIn[t][j] * pW[t];
+		pOut[j] = HighBoostOne(nSum, pCenter[j] * nCenterW, nShift);
+	}
+}
+
+#ifdef DIP_CONV_X86
+
+// ʵʵֵۼӴͬÿһȳ˺ӣFMAλͬ
+
+DIP_TARGET("sse4.1")
+static void WeightedSumSSE41(float* pOut, const float* const* ppIn, const float* pW, int nTaps, int nCount)
+{
+	int j = 0;
+	for(; j + 8 <= nCount; j += 8)
+	{
+		__m128 vSum0 = _mm_setzero_ps(), vSum1 = _mm_setzero_ps();
+		for(int t=0; t<nTaps; t++)
+		{
+			__m128 vW = _mm_set1_ps(pW[t]);
+			const float* p = ppIn[t] + j;
+			vSum0 = _mm_add_ps(vSum0, _mm_mul_ps(_mm_loadu_ps(p), vW));
+			vSum1 = _mm_add_ps(vSum1, _mm_mul_ps(_mm_loadu_ps(p + 4), vW));
+		}
+		_mm_storeu_ps(pOut + j, vSum0);
+		_mm_storeu_ps(pOut + j + 4, vSum1);
+	}
+	for(; j + 4 <= nCount; j += 4)
+	{
+		__m128 vSum = _mm_setzero_ps();
+		for(int t=0; t<nTaps; t++)
+			vSum = _mm_add_ps(vSum, _mm_mul_ps(_mm_loadu_ps(ppIn[t] + j), _mm_set1_ps(pW[t])));
+		_mm_storeu_ps(pOut + j, vSum);
+	}
+	for(; j<nCount; j++)
+	{
+		float fSum = 0;
+		for(int t=0; t<nTaps; t++)
+			fSum += ppIn[t][j] * pW[t];
+		pOut[j] = fSum;
+	}
+}
+
+DIP_TARGET("sse4.1")
+static void GrayToFloatSSE41(float* pOut, const BYTE* pIn, int nCount)
+{
+	int j = 0;
+	for(; j + 4 <= nCount; j += 4)
+	{
+		int nPacked;
+		memcpy(&nPacked, pIn + j, 4);
+		__m128i vInt = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(nPacked));
+		_mm_storeu_ps(pOut + j, _mm_cvtepi32_ps(vInt));
+	}
+	for(; j<nCount; j++)
+		pOut[j] = pIn[j];
+}
+
+// 4ľֵضϵ255루0.5λΪ
+// ּСǷС0.5㣬(BYTE)(f + 0.5)λͬ
+DIP_TARGET("sse4.1")
+static inline __m128i RoundGray4(__m128 vSum, __m128 vCoef)
+{
+	const __m128 vAbsMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	__m128 v = _mm_min_ps(_mm_and_ps(_mm_mul_ps(vSum, vCoef), vAbsMask), _mm_set1_ps(255.0f));
+	__m128 vInt = _mm_round_ps(v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+	__m128 vUp = _mm_and_ps(_mm_cmpge_ps(_mm_sub_ps(v, vInt), _mm_set1_ps(0.5f)), _mm_set1_ps(1.0f));
+	return _mm_cvttps_epi32(_mm_add_ps(vInt, vUp));
+}
+
+DIP_TARGET("sse4.1")
+static void SumToGraySSE41(BYTE* pOut, const float* pSum, float fCoef, int nCount)
+{
+	__m128 vCoef = _mm_set1_ps(fCoef);
+	int j = 0;
+	for(; j + 16 <= nCount; j += 16)
+	{
+		__m128i v0 = RoundGray4(_mm_loadu_ps(pSum + j), vCoef);
+		__m128i v1 = RoundGray4(_mm_loadu_ps(pSum + j + 4), vCoef);
+		__m128i v2 = RoundGray4(_mm_loadu_ps(pSum + j + 8), vCoef);
+		__m128i v3 = RoundGray4(_mm_loadu_ps(pSum + j + 12), vCoef);
+		__m128i vBytes = _mm_packus_epi16(_mm_packs_epi32(v0, v1), _mm_packs_epi32(v2, v3));
+		_mm_storeu_si128((__m128i*)(pOut + j), vBytes);
+	}
+	for(; j<nCount; j++)
+		pOut[j] = SumToGrayOne(pSum[j], fCoef);
+}
+
+// 48λչΪ32λ
+DIP_TARGET("sse4.1")
+static inline __m128i LoadGray4(const BYTE* p)
+{
+	int nPacked;
+	memcpy(&nPacked, p, 4);
+	return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(nPacked));
+}
+
+DIP_TARGET("sse4.1")
+static void HighBoostSSE41(int* pOut, const BYTE* const* ppIn, const int* pW, int nTaps,
+	const BYTE* pCenter, int nCenterW, int nShift, int nCount)
+{
+	__m128i vLimit = _mm_set1_epi32(255 << nShift);
+	__m128i vNegLimit = _mm_set1_epi32(-(255 << nShift));
+	__m128i vCenterW = _mm_set1_epi32(nCenterW);
+	__m128i vHalf = _mm_set1_epi32(1 << (nShift - 1));
+	__m128i vShift = _mm_cvtsi32_si128(nShift);
+	int j = 0;
+	for(; j + 4 <= nCount; j += 4)
+	{
+		__m128i vSum = _mm_setzero_si128();
+		for(int t=0; t<nTaps; t++)
+			vSum = _mm_add_epi32(vSum, _mm_mullo_epi32(LoadGray4(ppIn[t] + j), _mm_set1_epi32(pW[t])));
+		vSum = _mm_min_epi32(_mm_max_epi32(vSum, vNegLimit), vLimit);
+		__m128i v = _mm_add_epi32(_mm_add_epi32(vSum, vHalf), _mm_mullo_epi32(LoadGray4(pCenter + j), vCenterW));
+		// ȡֵƺָ
+		v = _mm_sign_epi32(_mm_srl_epi32(_mm_abs_epi32(v), vShift), v);
+		_mm_storeu_si128((__m128i*)(pOut + j), v);
+	}
+	for(; j<nCount; j++)
+	{
+		int nSum = 0;
+		for(int t=0; t<nTaps; t++)
+			nSum += ppIn[t][j] * pW[t];
+		pOut[j] = HighBoostOne(nSum, pCenter[j] * nCenterW, nShift);
+	}
+}
+
+DIP_TARGET("avx2")
+static void WeightedSumAVX2(float* pOut, const float* const* ppIn, const float* pW, int nTaps, int nCount)
+{
+	int j = 0;
+	for(; j + 16 <= nCount; j += 16)
+	{
+		__m256 vSum0 = _mm256_setzero_ps(), vSum1 = _mm256_setzero_ps();
+		for(int t=0; t<nTaps; t++)
+		{
+			__m256 vW = _mm256_set1_ps(pW[t]);
+			const float* p = ppIn[t] + j;
+			vSum0 = _mm256_add_ps(vSum0, _mm256_mul_ps(_mm256_loadu_ps(p), vW));
+			vSum1 = _mm256_add_ps(vSum1, _mm256_mul_ps(_mm256_loadu_ps(p + 8), vW));
+		}
+		_mm256_storeu_ps(pOut + j, vSum0);
+		_mm256_storeu_ps(pOut + j + 8, vSum1);
+	}
+	for(; j + 8 <= nCount; j += 8)
+	{
+		__m256 vSum = _mm256_setzero_ps();
+		for(int t=0; t<nTaps; t++)
+			vSum = _mm256_add_ps(vSum, _mm256_mul_ps(_mm256_loadu_ps(ppIn[t] + j), _mm256_set1_ps(pW[t])));
+		_mm256_storeu_ps(pOut + j, vSum);
+	}
+	for(; j<nCount; j++)
+	{
+		float fSum = 0;
+		for(int t=0; t<nTaps; t++)
+			fSum += ppIn[t][j] * pW[t];
+		pOut[j] = fSum;
+	}
+}
+
+DIP_TARGET("avx2")
+static void GrayToFloatAVX2(float* pOut, const BYTE* pIn, int nCount)
+{
+	int j = 0;
+	for(; j + 8 <= nCount; j += 8)
+	{
+		__m256i vInt = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(pIn + j)));
+		_mm256_storeu_ps(pOut + j, _mm256_cvtepi32_ps(vInt));
+	}
+	for(; j<nCount; j++)
+		pOut[j] = pIn[j];
+}
+
+DIP_TARGET("avx2")
+static void SumToGrayAVX2(BYTE* pOut, const float* pSum, float fCoef, int nCount)
+{
+	const __m256 vAbsMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+	__m256 vCoef = _mm256_set1_ps(fCoef);
+	int j = 0;
+	for(; j + 16 <= nCount; j += 16)
+	{
+		__m256i vInt[2];
+		for(int h=0; h<2; h++)
+		{
+			__m256 v = _mm256_min_ps(_mm256_and_ps(_mm256_mul_ps(_mm256_loadu_ps(pSum + j + h * 8), vCoef), vAbsMask),
+				_mm256_set1_ps(255.0f));
+			__m256 vTrunc = _mm256_round_ps(v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+			__m256 vUp = _mm256_and_ps(_mm256_cmp_ps(_mm256_sub_ps(v, vTrunc), _mm256_set1_ps(0.5f), _CMP_GE_OQ),
+				_mm256_set1_ps(1.0f));
+			vInt[h] = _mm256_cvttps_epi32(_mm256_add_ps(vTrunc, vUp));
+		}
+		// packs128λͨڽУźõ˳16ֽ
+		__m256i vWords = _mm256_packs_epi32(vInt[0], vInt[1]);
+		__m256i vBytes = _mm256_packus_epi16(vWords, vWords);
+		vBytes = _mm256_permutevar8x32_epi32(vBytes, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+		_mm_storeu_si128((__m128i*)(pOut + j), _mm256_castsi256_si128(vBytes));
+	}
+	for(; j<nCount; j++)
+		pOut[j] = SumToGrayOne(pSum[j], fCoef);
+}
+
+DIP_TARGET("avx2")
+static void HighBoostAVX2(int* pOut, const BYTE* const* ppIn, const int* pW, int nTaps,
+	const BYTE* pCenter, int nCenterW, int nShift, int nCount)
+{
+	__m256i vLimit = _mm256_set1_epi32(255 << nShift);
+	__m256i vNegLimit = _mm256_set1_epi32(-(255 << nShift));
+	__m256i vCenterW = _mm256_set1_epi32(nCenterW);
+	__m256i vHalf = _mm256_set1_epi32(1 << (nShift - 1));
+	__m128i vShift = _mm_cvtsi32_si128(nShift);
+	int j = 0;
+	for(; j + 8 <= nCount; j += 8)
+	{
+		__m256i vSum = _mm256_setzero_si256();
+		for(int t=0; t<nTaps; t++)
+		{
+			__m256i vGray = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(ppIn[t] + j)));
+			vSum = _mm256_add_epi32(vSum, _mm256_mullo_epi32(vGray, _mm256_set1_epi32(pW[t])));
+		}
+		vSum = _mm256_min_epi32(_mm256_max_epi32(vSum, vNegLimit), vLimit);
+		__m256i vCenter = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(pCenter + j)));
+		__m256i v = _mm256_add_epi32(_mm256_add_epi32(vSum, vHalf), _mm256_mullo_epi32(vCenter, vCenterW));
+		v = _mm256_sign_epi32(_mm256_srl_epi32(_mm256_abs_epi32(v), vShift), v);
+		_mm256_storeu_si256((__m256i*)(pOut + j), v);
+	}
+	for(; j<nCount; j++)
+	{
+		int nSum = 0;
+		for(int t=0; t<nTaps; t++)
+			nSum += ppIn[t][j] * pW[t];
+		pOut[j] = HighBoostOne(nSum, pCenter[j] * nCenterW, nShift);
+	}
+}
+
+#endif // DIP_CONV_X86
+
+// CPUͲϵͳֵָ֧
+static int DetectSimdLevel()
+{
+#if defined(DIP_CONV_X86) && defined(_MSC_VER)
+	int nInfo[4];
+	__cpuid(nInfo, 0);
+	int nMaxId = nInfo[0];
+
+	__cpuid(nInfo, 1);
+	BOOL bSSE41 = (nInfo[2] >> 19) & 1;
+	// AVXĴϵͳ棨OSXSAVEXCR0ĵ12λ
+	BOOL bAVX = ((nInfo[2] >> 27) & 1) && ((nInfo[2] >> 28) & 1) && (_xgetbv(0) & 6) == 6;
+	BOOL bAVX2 = FALSE;
+	if(bAVX && nMaxId >= 7)
+	{
+		__cpuidex(nInfo, 7, 0);
+		bAVX2 = (nInfo[1] >> 5) & 1;
+	}
+
+	if(bAVX2)
+		return IMG_SIMD_AVX2;
+	if(bSSE41)
+		return IMG_SIMD_SSE41;
+#elif defined(DIP_CONV_X86)
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2"))
+		return IMG_SIMD_AVX2;
+	if(__builtin_cpu_supports("sse4.1"))
+		return IMG_SIMD_SSE41;
+#endif
+	return IMG_SIMD_NONE;
+}
+
+static const int g_nSimdSupported = DetectSimdLevel();
+// SetSimdLevel̵߳˲ͬʱãֻԶһֵ
+static std::atomic<int> g_nSimdLevel(g_nSimdSupported);
+
+static PFN_WEIGHTEDSUM GetWeightedSum()
+{
+#ifdef DIP_CONV_X86
+	int nLevel = g_nSimdLevel.load(std::memory_order_relaxed);
+	if(nLevel >= IMG_SIMD_AVX2)
+		return WeightedSumAVX2;
+	if(nLevel >= IMG_SIMD_SSE41)
+		return WeightedSumSSE41;
+#endif
+	return WeightedSumScalar;
+}
+
+static PFN_GRAYTOFLOAT GetGrayToFloat()
+{
+#ifdef DIP_CONV_X86
+	int nLevel = g_nSimdLevel.load(std::memory_order_relaxed);
+	if(nLevel >= IMG_SIMD_AVX2)
+		return GrayToFloatAVX2;
+	if(nLevel >= IMG_SIMD_SSE41)
+		return GrayToFloatSSE41;
+#endif
+	return GrayToFloatScalar;
+}
+
+static PFN_SUMTOGRAY GetSumToGray()
+{
+#ifdef DIP_CONV_X86
+	int nLevel = g_nSimdLevel.load(std::memory_order_relaxed);
+	if(nLevel >= IMG_SIMD_AVX2)
+		return SumToGrayAVX2;
+	if(nLevel >= IMG_SIMD_SSE41)
+		return SumToGraySSE41;
+#endif
+	return SumToGrayScalar;
+}
+
+static PFN_HIGHBOOST GetHighBoost()
+{
+#ifdef DIP_CONV_X86
+	int nLevel = g_nSimdLevel.load(std::memory_order_relaxed);
+	if(nLevel >= IMG_SIMD_AVX2)
+		return HighBoostAVX2;
+	if(nLevel >= IMG_SIMD_SSE41)
+		return HighBoostSSE41;
+#endif
+	return HighBoostScalar;
+}
+
+/**************************************************
+void CImgConv::SumToGray(BYTE* pOut, const float* pSum, FLOAT fCoef, int nCount)
+
+ܣ
+	nCountȨͳģϵȡֵ255ĽضΪ255
+	ΪҶȣTemplateԭͬ
+***************************************************/
+void CImgConv::SumToGray(BYTE* pOut, const float* pSum, FLOAT fCoef, int nCount)
+{
+	GetSumToGray()(pOut, pSum, fCoef, nCount);
+}
+
+/**************************************************
+void CImgConv::WeightedSum(float* pOut, const float* const* ppIn, const float* pW, int nTaps, int nCount)
+
+ܣ
+	nTapsеļȨͣCPUѡAVX2SSE4.1ʵ֡
+	ppIn[t]ͬһдtԪصĵַһά
+***************************************************/
+void CImgConv::WeightedSum(float* pOut, const float* const* ppIn, const float* pW, int nTaps, int nCount)
+{
+	GetWeightedSum()(pOut, ppIn, pW, nTaps, nCount);
+}
+
+/**************************************************
+void CImgConv::HighBoost(int* pOut, const BYTE* const* ppIn, const int* pW, int nTaps,
+	const BYTE* pCenter, int nCenterW, int nShift, int nCount)
+
+ܣ
+	˲һеĶ㣬CImgProcess::EnhanceFilterڲѭ
+	ȨpWnCenterWΪŴ2^nShiftȡĶnShift1
+	ģӦضϵ255㣩ԭذӣ0.5ȡ
+	ԭdoubleֻڶȨصڿ1
+	뱣֤мintΧ
+***************************************************/
+void CImgConv::HighBoost(int* pOut, const BYTE* const* ppIn, const int* pW, int nTaps,
+	const BYTE* pCenter, int nCenterW, int nShift, int nCount)
+{
+	GetHighBoost()(pOut, ppIn, pW, nTaps, pCenter, nCenterW, nShift, nCount);
+}
+
+int CImgConv::GetSimdLevel()
+{
+	return g_nSimdLevel.load(std::memory_order_relaxed);
+}
+
+void CImgConv::SetSimdLevel(int nLevel)
+{
+	g_nSimdLevel.store(min(max(nLevel, (int)IMG_SIMD_NONE), g_nSimdSupported), std::memory_order_relaxed);
+}
+
+static int Gcd(int a, int b)
+{
+	while(b != 0)
+	{
+		int r = a % b;
+		a = b;
+		b = r;
+	}
+	return a;
+}
+
+/**************************************************
+CImgConv::CImgConv(const FLOAT* pfArray, int nTempH, int nTempW, int nTempMY, int nTempMX)
+
+ܣ
+	ģ壺ֽܷΪuv֮A[k][l] = u[k]v[l]
+	ֽ˼Ӵʱɷ뷽ʽ㣬򰴶άʽ㡣
+	ģֽΪ˹ģ1 2 1/2 4 2/1 2 1ֽΪ1 2 11 2 1
+	8λͼϵĽάȫͬ
+
+
+	const FLOAT* pfArray
+		nTempHnTempWģ壬д
+	int nTempH, int nTempW
+		ģĸ߶ȺͿ
+	int nTempMY, int nTempMX
+		ģԪصС
+***************************************************/
+CImgConv::CImgConv(const FLOAT* pfArray, int nTempH, int nTempW, int nTempMY, int nTempMX)
+{
+	m_nTempH = nTempH;
+	m_nTempW = nTempW;
+	m_nTempMY = nTempMY;
+	m_nTempMX = nTempMX;
+	m_bSeparable = FALSE;
+	m_pSrc = NULL;
+	m_nWidth = 0;
+	m_nStartX = m_nEndX = 0;
+	m_nNextRow = m_nNextLoad = 0;
+
+	int k, l;
+
+	// ԾֵԪA[r][c]ڵСֽ
+	int r = 0, c = 0;
+	float fMax = 0;
+	BOOL bInteger = TRUE;
+	int nNonZero = 0;
+	for(k=0; k<nTempH; k++)
+	{
+		for(l=0; l<nTempW; l++)
+		{
+			float f = pfArray[k * nTempW + l];
+			if(fabs(f) > fMax)
+			{
+				fMax = (float)fabs(f);
+				r = k;
+				c = l;
+			}
+			if(f != 0)
+				nNonZero++;
+			if(f != floor(f) || fabs(f) > (1 << 20))
+				bInteger = FALSE;
+		}
+	}
+
+	std::vector<float> vecU(nTempH), vecV(nTempW);
+	if(fMax > 0 && nTempH + nTempW < nNonZero)
+	{
+		float fPivot = pfArray[r * nTempW + c];
+		int nGcd = 0;
+		if(bInteger)
+		{
+			// гԼгԸùԼٳԪģõ
+			for(k=0; k<nTempH; k++)
+				nGcd = Gcd(nGcd, abs((int)pfArray[k * nTempW + c]));
+		}
+
+		for(k=0; k<nTempH; k++)
+			vecU[k] = bInteger ? pfArray[k * nTempW + c] / nGcd : pfArray[k * nTempW + c];
+		for(l=0; l<nTempW; l++)
+			vecV[l] = bInteger ? pfArray[r * nTempW + l] * nGcd / fPivot : pfArray[r * nTempW + l] / fPivot;
+
+		m_bSeparable = TRUE;
+		float fTol = bInteger ? 0 : fMax * 1e-6f;
+		for(k=0; k<nTempH && m_bSeparable; k++)
+		{
+			for(l=0; l<nTempW; l++)
+			{
+				if(fabs(vecU[k] * vecV[l] - pfArray[k * nTempW + l]) > fTol)
+				{
+					m_bSeparable = FALSE;
+					break;
+				}
+			}
+		}
+	}
+
+	if(m_bSeparable)
+	{
+		for(k=0; k<nTempH; k++)
+		{
+			if(vecU[k] != 0)
+			{
+				m_vecColWeight.push_back(vecU[k]);
+				m_vecColTap.push_back(k);
+			}
+		}
+		for(l=0; l<nTempW; l++)
+		{
+			if(vecV[l] != 0)
+			{
+				m_vecRowWeight.push_back(vecV[l]);
+				m_vecRowTap.push_back(l);
+			}
+		}
+		m_vecIn.resize(max(m_vecColWeight.size(), m_vecRowWeight.size()));
+	}
+	else
+	{
+		// ԭĴͬкУԪضԺûйף
+		for(k=0; k<nTempH; k++)
+		{
+			for(l=0; l<nTempW; l++)
+			{
+				if(pfArray[k * nTempW + l] != 0)
+				{
+					m_vecWeight.push_back(pfArray[k * nTempW + l]);
+					m_vecTapRow.push_back(k);
+					m_vecTapCol.push_back(l);
+				}
+			}
+		}
+		m_vecIn.resize(m_vecWeight.size());
+	}
+}
+
+/**************************************************
+void CImgConv::Begin(const CImg& imgSrc, int nFirstRow)
+
+ܣ
+	ʼimgSrcԵnFirstRowΪĵУԴͼNext
+	룺8λͼֱתΪ㣬16λͼȡԭֵʽȡҶ
+
+
+	const CImg& imgSrc
+		Դͼ
+	int nFirstRow
+		һекţСģĵnTempMY
+***************************************************/
+void CImgConv::Begin(const CImg& imgSrc, int nFirstRow)
+{
+	m_pSrc = &imgSrc;
+	m_nWidth = imgSrc.GetWidthPixel();
+	m_nStartX = m_nTempMX;
+	m_nEndX = max(m_nStartX, m_nWidth - (m_nTempW - m_nTempMX) + 1);
+	m_nNextRow = nFirstRow;
+	m_nNextLoad = nFirstRow - m_nTempMY;
+
+	m_vecRows.resize((size_t)m_nTempH * m_nWidth);
+	m_vecSum.assign(m_nWidth, 0.0f);
+	m_vecLine.resize(m_bSeparable || imgSrc.IsHighPrecision() ? m_nWidth : 0);
+	m_vecGray.resize(imgSrc.GetFormat() == IMG_FMT_GRAY8 || imgSrc.IsHighPrecision() ? 0 : m_nWidth);
+}
+
+void CImgConv::LoadRow(int y)
+{
+	float* pDest = &m_vecRows[(size_t)(y % m_nTempH) * m_nWidth];
+	float* pLine = m_bSeparable ? &m_vecLine[0] : pDest;
+
+	if(m_pSrc->IsHighPrecision())
+	{
+		const float* pSrc = m_pSrc->GetFloatRow(y, &m_vecLine[0]);
+		if(pSrc != pLine)
+			memcpy(pLine, pSrc, m_nWidth * sizeof(float));
+	}
+	else
+	{
+		const BYTE* pGray = m_pSrc->GetGrayRow(y, m_vecGray.empty() ? NULL : &m_vecGray[0]);
+		GetGrayToFloat()(pLine, pGray, m_nWidth);
+	}
+
+	if(!m_bSeparable || m_nEndX <= m_nStartX)
+		return;
+
+	// зһάֻ
+	int nTaps = (int)m_vecRowWeight.size();
+	for(int t=0; t<nTaps; t++)
+		m_vecIn[t] = pLine + m_nStartX + m_vecRowTap[t] - m_nTempMX;
+	GetWeightedSum()(pDest + m_nStartX, &m_vecIn[0], &m_vecRowWeight[0], nTaps, m_nEndX - m_nStartX);
+}
+
+/**************************************************
+const float* CImgConv::Next()
+
+ܣ
+	ԴͼУһеļȨ͡
+	ɷʱѭзĸзļȨͣ
+	ԸģԪضӦƽƺȨ
+
+ֵ
+	const float*ͣΪͼȵ飬GetStartX()GetEndX()-1Ч
+***************************************************/
+const float* CImgConv::Next()
+{
+	int nTop = m_nNextRow - m_nTempMY; //ģ0жӦԴͼ
+	m_nNextRow++;
+
+	while(m_nNextLoad < nTop + m_nTempH)
+		LoadRow(m_nNextLoad++);
+
+	int nCount = m_nEndX - m_nStartX;
+	if(nCount <= 0)
+		return &m_vecSum[0];
+
+	const float* pRows = &m_vecRows[0];
+	int nTaps;
+	const float* pWeight;
+	if(m_bSeparable)
+	{
+		nTaps = (int)m_vecColWeight.size();
+		for(int t=0; t<nTaps; t++)
+			m_vecIn[t] = pRows + (size_t)((nTop + m_vecColTap[t]) % m_nTempH) * m_nWidth + m_nStartX;
+		pWeight = nTaps ? &m_vecColWeight[0] : NULL;
+	}
+	else
+	{
+		nTaps = (int)m_vecWeight.size();
+		for(int t=0; t<nTaps; t++)
+			m_vecIn[t] = pRows + (size_t)((nTop + m_vecTapRow[t]) % m_nTempH) * m_nWidth
+				+ m_nStartX + m_vecTapCol[t] - m_nTempMX;
+		pWeight = nTaps ? &m_vecWeight[0] : NULL;
+	}
+
+	GetWeightedSum()(&m_vecSum[m_nStartX], nTaps ? &m_vecIn[0] : NULL, pWeight, nTaps, nCount);
+	return &m_vecSum[0];
+}
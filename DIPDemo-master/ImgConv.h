@@ -0,0 +1,88 @@
+// ImgConv.h: interface for the CImgConv class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#ifndef __IMG_CONV_H__
+#define __IMG_CONV_H__
+
+#include "Img.h"
+#include <vector>
+
+// ָ
+#define IMG_SIMD_NONE       0   // ʵ
+#define IMG_SIMD_SSE41      1   // SSE4.1ÿ4
+#define IMG_SIMD_AVX2       2   // AVX2ÿ8
+
+// ģ棬CImgProcess::Templateʵ
+// ģɷ루Ϊ1˹ֵģ壩ʱֽΪкһά
+// ÿصĳ˼ӴnTempHnTempWΪnTempH+nTempWɷʱֱ
+// άַʽڲѭеļȨͣCPUֵ֧
+// ָѡAVX2SSE4.1ʵ֣ʵλͬ
+//
+// μ㣬ֻģ߶ȵУ
+//	CImgConv conv(pfArray, nTempH, nTempW, nTempMY, nTempMX);
+//	conv.Begin(img, nFirstRow);
+//	for(i = nFirstRow; i < nLastRow; i++)
+//		const float* pSum = conv.Next(); //iеļȨ
+class CImgConv
+{
+public:
+	// pfArrayΪnTempHnTempWģ壨дţ(nTempMX, nTempMY)ΪԪ
+	CImgConv(const FLOAT* pfArray, int nTempH, int nTempW, int nTempMY, int nTempMX);
+
+	// ģǷ񰴿ɷ뷽ʽ
+	BOOL IsSeparable() const { return m_bSeparable; }
+
+	// ʼimgSrcԵnFirstRowΪĵУ
+	// ֮ÿNextεõһСimgSrcڼڼ뱣ֲ
+	void Begin(const CImg& imgSrc, int nFirstRow);
+	// һеļȨͣδģϵسΪͼȵ飬
+	// ЧԪΪGetStartX()GetEndX()-1Уָ´εǰЧ
+	const float* Next();
+
+	// ЧеķΧģͼʱ
+	int GetStartX() const { return m_nStartX; }
+	int GetEndX() const { return m_nEndX; }
+
+	// ȨͳϵfCoefȡֵضϵ0255ΪҶ
+	static void SumToGray(BYTE* pOut, const float* pSum, FLOAT fCoef, int nCount);
+	// ɸеļȨͣpOut[j] =  ppIn[t][j]  pW[t]Nextõͬһʵ
+	static void WeightedSum(float* pOut, const float* const* ppIn, const float* pW, int nTaps, int nCount);
+	// ˲һУ㣩8λppIn[t]ȨpW[t]ͣضϵ(255 << nShift)
+	// pCenter[j]  nCenterW룬ȡnShiftλpOut[j]
+	static void HighBoost(int* pOut, const BYTE* const* ppIn, const int* pW, int nTaps,
+		const BYTE* pCenter, int nCenterW, int nShift, int nCount);
+
+	// ǰʹõָIMG_SIMD_*SetSimdLevelΪ͵ļ
+	// CPUֵ֧ļʱֵ֧߼ڶԱȲ
+	static int GetSimdLevel();
+	static void SetSimdLevel(int nLevel);
+
+private:
+	// ԴͼһУ㣩ɷʱ漴зľѭ
+	void LoadRow(int y);
+
+	int m_nTempH, m_nTempW;
+	int m_nTempMY, m_nTempMX;
+	BOOL m_bSeparable;
+	// ɷʱΪģԪصȨؼģеС
+	std::vector<float> m_vecWeight;
+	std::vector<int> m_vecTapRow, m_vecTapCol;
+	// ɷʱģ = ֻԪؼ±
+	std::vector<float> m_vecColWeight, m_vecRowWeight;
+	std::vector<int> m_vecColTap, m_vecRowTap;
+
+	const CImg* m_pSrc;
+	int m_nWidth;
+	int m_nStartX, m_nEndX;
+	// һекźһҪԴͼк
+	int m_nNextRow, m_nNextLoad;
+	// nTempHеѭ壬Դͼyдڵy % nTempH
+	std::vector<float> m_vecRows;
+	std::vector<float> m_vecLine;	// ɷʱзǰһ
+	std::vector<BYTE> m_vecGray;	// 8λͼĻҶ
+	std::vector<float> m_vecSum;	// 
+	std::vector<const float*> m_vecIn;	// ȨضӦеַ
+};
+
+#endif // __IMG_CONV_H__
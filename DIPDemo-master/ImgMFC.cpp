@@ -0,0 +1,146 @@
+// ImgMFC.cpp: MFC adapter for the CImg class.
+//
+//////////////////////////////////////////////////////////////////////
+
+// CImgMFCĲ֣CFileдDCϻ
+// ֻDIPDemoMFCб룬ͼⲻļ
+
+#include "stdafx.h"
+#include "Img.h"
+
+#ifdef _DEBUG
+#undef THIS_FILE
+static char THIS_FILE[]=__FILE__;
+#define new DEBUG_NEW
+#endif
+
+// CFileΪ˵ֽ
+class CImgCFileStream : public CImgStream
+{
+public:
+	CImgCFileStream(CFile &file) : m_file(file) {}
+
+	virtual UINT Read(void* lpBuf, UINT nCount) { return m_file.Read(lpBuf, nCount); }
+	virtual UINT Write(const void* lpBuf, UINT nCount) { m_file.Write(lpBuf, nCount); return nCount; }
+
+private:
+	CFile &m_file;
+};
+
+/**************************************************
+BOOL CImg::AttachFromFile(CFile &file)
+
+ܣ
+	ָͼļӵCImg
+ƣ
+	ֻܴλͼͼ
+
+
+	CFile &file
+		򿪵CFile
+ֵ
+	BYTEͣTRUEΪɹFALSEΪʧ
+***************************************************/
+BOOL CImg::AttachFromFile(CFile &file)
+{
+	CImgCFileStream stream(file);
+	return AttachFromStream(stream);
+}
+
+/**************************************************
+BOOL CImg::SaveToFile(CFile &file)
+
+ܣ
+	CImgʵеͼݱ浽ָͼļ
+ƣ
+	ֻܴλͼͼ
+
+
+	CFile &file
+		浽CFile
+ֵ
+	BYTEͣTRUEΪɹFALSEΪʧ
+***************************************************/
+BOOL CImg::SaveToFile(CFile &file)
+{
+	CImgCFileStream stream(file);
+	return SaveToStream(stream);
+}
+
+/**************************************************
+BOOL CImg::Draw(CDC* pDC)
+
+ܣ
+	ڸ豸ĻнCImgд洢ͼƵĻ
+
+ƣ
+	
+
+
+	CDC * pDC
+		ָ豸Ļָ
+ֵ
+	ͣTRUEΪɹFALSEΪʧ
+***************************************************/
+BOOL CImg::Draw(CDC* pDC)
+{
+	if(m_pBMIH == NULL)
+		return FALSE;
+
+	// 16λͼֱӽGDIתΪ8λ
+	if(IsHighPrecision())
+	{
+		CImg imgShow;
+		ConvertFormat(&imgShow, IMG_FMT_GRAY8, (GetFormat() == IMG_FMT_GRAY16) ? 1.0 / 257 : 1.0);
+		return imgShow.Draw(pDC);
+	}
+
+	for(int i=0; i<m_pBMIH->biHeight; i++)
+	{
+	
+		::SetDIBitsToDevice(*pDC, 0, 0, m_pBMIH->biWidth, 
+			m_pBMIH->biHeight, 0, 0, i, 1, m_pBits + (size_t)i * m_nStride, (BITMAPINFO*)m_pBMIH, DIB_RGB_COLORS);
+	}
+
+	return TRUE;
+}
+
+
+BOOL CImg::Draw(CDC* pDC, CRect rt)
+{
+	if(m_pBMIH == NULL)
+		return FALSE;
+
+	if(IsHighPrecision())
+	{
+		CImg imgShow;
+		ConvertFormat(&imgShow, IMG_FMT_GRAY8, (GetFormat() == IMG_FMT_GRAY16) ? 1.0 / 257 : 1.0);
+		return imgShow.Draw(pDC, rt);
+	}
+
+	if(rt.IsRectNull())
+	{
+		rt.right = m_pBMIH->biWidth;
+		rt.bottom = m_pBMIH->biHeight;
+	}
+
+	if(rt.Width() > m_pBMIH->biWidth)
+	{
+		rt.right = rt.left + m_pBMIH->biWidth;
+	}
+
+	if(rt.Height() > m_pBMIH->biHeight)
+	{
+		rt.bottom = rt.top + m_pBMIH->biHeight;
+	}
+
+	for(int i=0; i<m_pBMIH->biHeight; i++)
+	{
+	
+			::SetDIBitsToDevice(*pDC, rt.left, rt.top, rt.Width(), 
+				rt.Height(), 0, 0, i, 1, m_pBits + (size_t)i * m_nStride, (BITMAPINFO*)m_pBMIH, DIB_RGB_COLORS);
+	
+	}
+
+	return TRUE;
+}
@@ -0,0 +1,246 @@
+// ImgParallel.cpp: implementation of the CImgParallel class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include "ImgPlatform.h"
+#include "ImgParallel.h"
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+
+#if defined(_DEBUG) && !defined(DIP_NO_MFC)
+#undef THIS_FILE
+static char THIS_FILE[]=__FILE__;
+#define new DEBUG_NEW
+#endif
+
+#define IMG_BANDS_PER_THREAD	4	// ÿ߳ƽֵдмھ
+
+// ȫ߳0ʾCPU
+static std::atomic<int> g_nThreadCount(0);
+
+// ǰ߳ǷִдٵForʱִ
+static thread_local BOOL t_bInBand = FALSE;
+
+// ִдڼλt_bInBandд׳쳣ʱҲָܻ
+class CInBandGuard
+{
+public:
+	CInBandGuard() : m_bPrev(t_bInBand) { t_bInBand = TRUE; }
+	~CInBandGuard() { t_bInBand = m_bPrev; }
+
+private:
+	BOOL m_bPrev;
+};
+
+// ִд̳߳ء߳ڵһõʱ֮פ˳ʱ
+// ͬһʱִֻһɵ߳m_mtxSubmit
+class CBandPool
+{
+public:
+	CBandPool();
+	~CBandPool();
+
+	// õ̺߳nThreads - 1ִ߳[nBegin, nEnd)УÿдnBandRows
+	void Run(int nBegin, int nEnd, int nBandRows, int nThreads, PFN_ROWBAND pfnBand, LPVOID pParam);
+
+	std::mutex m_mtxSubmit;
+
+private:
+	void WorkerProc();
+	// ȡִдֱȫꣻд쳣m_excFirst׳
+	void RunBands();
+
+	std::mutex m_mtx;
+	std::condition_variable m_cvWork;	// Ҫ˳
+	std::condition_variable m_cvDone;	// Ĺ̶߳
+	std::vector<std::thread> m_vecWorkers;
+	BOOL m_bStop;
+
+	// ǰm_mtxֻ̼߳
+	unsigned m_nJobId;
+	int m_nWanted;		// ԼĹ߳
+	int m_nRunning;		// ִеĹ߳
+	PFN_ROWBAND m_pfnBand;
+	LPVOID m_pParam;
+	int m_nEnd, m_nBandRows;
+	std::atomic<int> m_nNextRow;	// һȡд
+	std::exception_ptr m_excFirst;	// д׳ĵһ쳣m_mtx
+};
+
+static CBandPool g_bandPool;
+
+CBandPool::CBandPool()
+	: m_bStop(FALSE), m_nJobId(0), m_nWanted(0), m_nRunning(0),
+	  m_pfnBand(NULL), m_pParam(NULL), m_nEnd(0), m_nBandRows(1), m_nNextRow(0)
+{
+}
+
+CBandPool::~CBandPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		m_bStop = TRUE;
+	}
+	m_cvWork.notify_all();
+
+	for(size_t i=0; i<m_vecWorkers.size(); i++)
+		m_vecWorkers[i].join();
+}
+
+void CBandPool::RunBands()
+{
+	CInBandGuard guard;
+	try
+	{
+		for(;;)
+		{
+			int nBegin = m_nNextRow.fetch_add(m_nBandRows);
+			if(nBegin >= m_nEnd)
+				break;
+			m_pfnBand(nBegin, min(nBegin + m_nBandRows, m_nEnd), m_pParam);
+		}
+	}
+	catch(...)
+	{
+		// µһ쳣ʣµдȡRun߳ͣº׳
+		std::lock_guard<std::mutex> lock(m_mtx);
+		if(!m_excFirst)
+			m_excFirst = std::current_exception();
+		m_nNextRow = m_nEnd;
+	}
+}
+
+void CBandPool::WorkerProc()
+{
+	unsigned nSeen = 0; //Ѽ
+
+	std::unique_lock<std::mutex> lock(m_mtx);
+	for(;;)
+	{
+		while(!m_bStop && (m_nJobId == nSeen || m_nWanted == 0))
+			m_cvWork.wait(lock);
+		if(m_bStop)
+			return;
+
+		nSeen = m_nJobId;
+		m_nWanted--;
+		m_nRunning++;
+
+		lock.unlock();
+		RunBands();
+		lock.lock();
+
+		if(--m_nRunning == 0)
+			m_cvDone.notify_all();
+	}
+}
+
+void CBandPool::Run(int nBegin, int nEnd, int nBandRows, int nThreads, PFN_ROWBAND pfnBand, LPVOID pParam)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+
+		while((int)m_vecWorkers.size() < nThreads - 1)
+			m_vecWorkers.push_back(std::thread(&CBandPool::WorkerProc, this));
+
+		m_pfnBand = pfnBand;
+		m_pParam = pParam;
+		m_nEnd = nEnd;
+		m_nBandRows = nBandRows;
+		m_nNextRow = nBegin;
+		m_excFirst = nullptr;
+		m_nJobId++;
+		m_nWanted = nThreads - 1;
+	}
+	m_cvWork.notify_all();
+
+	RunBands();
+
+	// дȫ꣬ûĹ̲߳ټ룬ȼ˵ꡣ
+	// ʹд׳쳣ҲҪȣ߳ʹõջϵpParam
+	std::unique_lock<std::mutex> lock(m_mtx);
+	m_nWanted = 0;
+	while(m_nRunning > 0)
+		m_cvDone.wait(lock);
+
+	std::exception_ptr exc = m_excFirst;
+	m_excFirst = nullptr;
+	lock.unlock();
+
+	if(exc)
+		std::rethrow_exception(exc);
+}
+
+/**************************************************
+void CImgParallel::For(int nBegin, int nEnd, PFN_ROWBAND pfnBand, LPVOID pParam, int nThreads, int nMinRows)
+
+ܣ
+	[nBegin, nEnd)гдɶִ̲߳pfnBand
+
+
+	int nBegin, int nEnd
+		Ҫ
+	PFN_ROWBAND pfnBand
+		дֻдд
+	LPVOID pParam
+		pfnBandĲ
+	int nThreads
+		߳0Ϊȫ߳1Ϊ
+	int nMinRows
+		д
+
+ֵ
+	ޣдִ󷵻ءpfnBand׳쳣ʱ߳ͣº
+	ڵ߳׳һ쳣δȡдִ
+***************************************************/
+void CImgParallel::For(int nBegin, int nEnd, PFN_ROWBAND pfnBand, LPVOID pParam, int nThreads, int nMinRows)
+{
+	int nRows = nEnd - nBegin;
+	if(nRows <= 0)
+		return;
+
+	if(nThreads <= 0)
+		nThreads = GetThreadCount();
+	if(nMinRows < 1)
+		nMinRows = 1;
+
+	int nMaxBands = (nRows + nMinRows - 1) / nMinRows;
+	if(nThreads > nMaxBands)
+		nThreads = nMaxBands;
+
+	if(nThreads <= 1 || t_bInBand)
+	{
+		pfnBand(nBegin, nEnd, pParam);
+		return;
+	}
+
+	// һ߳ʹ̳߳ʱȴֱӴִ
+	std::unique_lock<std::mutex> submit(g_bandPool.m_mtxSubmit, std::try_to_lock);
+	if(!submit.owns_lock())
+	{
+		pfnBand(nBegin, nEnd, pParam);
+		return;
+	}
+
+	int nBands = min(nThreads * IMG_BANDS_PER_THREAD, nMaxBands);
+	int nBandRows = (nRows + nBands - 1) / nBands;
+	g_bandPool.Run(nBegin, nEnd, nBandRows, nThreads, pfnBand, pParam);
+}
+
+void CImgParallel::SetThreadCount(int nThreads)
+{
+	g_nThreadCount = nThreads > 0 ? nThreads : 0;
+}
+
+int CImgParallel::GetThreadCount()
+{
+	int nThreads = g_nThreadCount;
+	if(nThreads <= 0)
+		nThreads = (int)std::thread::hardware_concurrency();
+	return nThreads > 0 ? nThreads : 1;
+}
@@ -0,0 +1,34 @@
+// ImgParallel.h: interface for the CImgParallel class.
+//
+//////////////////////////////////////////////////////////////////////
+
+#ifndef __IMG_PARALLEL_H__
+#define __IMG_PARALLEL_H__
+
+#include "ImgPlatform.h"
+
+// д[nBegin, nEnd)
+typedef void (*PFN_ROWBAND)(int nBegin, int nEnd, LPVOID pParam);
+
+// дִCImgProcessĸ㹲
+// [nBegin, nEnd)гдɳפĹ̺߳͵̴߳ӹļ
+// ȡִУ߳̽ȡʣµд̵߳ĸԶ⡣
+// ÿдֻдԵСֻԴͼ¼ɴ
+// ԼȡԽ봮ִȫͬ߳зַʽ޹أ
+//	CImgParallel::For(nFirstRow, nLastRow, BandProc, &param);
+//
+// ٵForǶףһ߳ʹִʱֱڵǰ̴ִ߳С
+// ׳쳣߳ͣºForڵ߳׳
+class CImgParallel
+{
+public:
+	// ִpfnBandnThreadsΪ0ʱSetThreadCount趨߳1ΪУ
+	// дnMinRowsУд̫խʱظȡĿ
+	static void For(int nBegin, int nEnd, PFN_ROWBAND pfnBand, LPVOID pParam, int nThreads = 0, int nMinRows = 16);
+
+	// ọ̈̄߳߳0ʾCPUĬΪ0
+	static void SetThreadCount(int nThreads);
+	static int GetThreadCount();
+};
+
+#endif // __IMG_PARALLEL_H__
@@ -0,0 +1,123 @@
+// ImgPlatform.h: platform definitions for the image processing library.
+//
+//////////////////////////////////////////////////////////////////////
+
+#ifndef __IMG_PLATFORM_H__
+#define __IMG_PLATFORM_H__
+
+// ͼ⣨CImgCImgProcessƽ̨صĶ
+//
+// DIPDemoMFCֱʹstdafx.hṩWindows/MFCͣ
+// DIP_NO_MFCʱWindowsƽ̨Զ壩ֻ׼C++⣬
+// ɱļ㷨õλͼṹͻ͵ĵȼ۶
+
+#if !defined(DIP_NO_MFC) && !defined(_WIN32)
+#define DIP_NO_MFC
+#endif
+
+#ifndef DIP_NO_MFC
+
+#include "stdafx.h"
+
+#else // DIP_NO_MFC
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+using std::max;
+using std::min;
+
+typedef unsigned char	BYTE;
+typedef unsigned short	WORD;
+typedef uint32_t		DWORD;
+typedef int32_t			LONG;
+typedef unsigned int	UINT;
+typedef int				BOOL;
+typedef float			FLOAT;
+typedef BYTE*			LPBYTE;
+typedef void*			LPVOID;
+typedef const char*		LPCTSTR;
+typedef DWORD			COLORREF;
+
+#ifndef TRUE
+#define TRUE	1
+#endif
+#ifndef FALSE
+#define FALSE	0
+#endif
+
+#define RGB(r, g, b)	((COLORREF)(((BYTE)(r) | ((WORD)((BYTE)(g)) << 8)) | (((DWORD)(BYTE)(b)) << 16)))
+#define GetRValue(rgb)	((BYTE)(rgb))
+#define GetGValue(rgb)	((BYTE)(((WORD)(rgb)) >> 8))
+#define GetBValue(rgb)	((BYTE)((rgb) >> 16))
+#define MAKEWORD(a, b)	((WORD)(((BYTE)(a)) | ((WORD)((BYTE)(b))) << 8))
+
+#define BI_RGB			0L
+
+struct POINT
+{
+	LONG x;
+	LONG y;
+};
+
+struct RGBQUAD
+{
+	BYTE rgbBlue;
+	BYTE rgbGreen;
+	BYTE rgbRed;
+	BYTE rgbReserved;
+};
+
+struct RGBTRIPLE
+{
+	BYTE rgbtBlue;
+	BYTE rgbtGreen;
+	BYTE rgbtRed;
+};
+
+// Windowsһ£ļͷ2ֽڶ
+#pragma pack(push, 2)
+struct BITMAPFILEHEADER
+{
+	WORD	bfType;
+	DWORD	bfSize;
+	WORD	bfReserved1;
+	WORD	bfReserved2;
+	DWORD	bfOffBits;
+};
+#pragma pack(pop)
+
+struct BITMAPINFOHEADER
+{
+	DWORD	biSize;
+	LONG	biWidth;
+	LONG	biHeight;
+	WORD	biPlanes;
+	WORD	biBitCount;
+	DWORD	biCompression;
+	DWORD	biSizeImage;
+	LONG	biXPelsPerMeter;
+	LONG	biYPelsPerMeter;
+	DWORD	biClrUsed;
+	DWORD	biClrImportant;
+};
+
+#endif // DIP_NO_MFC
+
+#include <stdint.h>
+
+
+// ʾϢ
+// 㷨еĴ;棨ǷͳһImgMessageĬMFCе
+// Ϣڶдstderr÷ImgSetMessageHandlerΪԼĴ
+typedef void (*PFN_IMGMESSAGE)(LPCTSTR lpszMsg);
+
+// ʾϢĴԭĴNULLָĬϴ
+PFN_IMGMESSAGE ImgSetMessageHandler(PFN_IMGMESSAGE pfnHandler);
+// һʾϢ
+void ImgMessage(LPCTSTR lpszMsg);
+
+#endif // __IMG_PLATFORM_H__
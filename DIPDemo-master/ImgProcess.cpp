@@ -2,14 +2,21 @@
 //
 //////////////////////////////////////////////////////////////////////
 
-#include "stdafx.h"
+#include "ImgPlatform.h"
 
 #include "ImgProcess.h"
+#include "ImgConv.h"
+#include "ImgParallel.h"
 
 #include <vector>
 
 #include <queue>
+#include <algorithm>
+#include <thread>
+#include <mutex>
 #include <math.h>
+#include <limits.h>
+#include <string.h>
 
 
 #define _EdgeAll 0;
@@ -18,7 +25,7 @@
 #define _EdgeCW 3;
 #define _EdgeCCW 4;
 
-#ifdef _DEBUG
+#if defined(_DEBUG) && !defined(DIP_NO_MFC)
 #undef THIS_FILE
 static char THIS_FILE[]=__FILE__;
 #define new DEBUG_NEW
@@ -88,11 +95,35 @@ CImgProcess::CImgProcess()
 	m_nBasePt = 4;
 }
 
+CImgProcess::CImgProcess(const CImgProcess& img) : CImg(img)
+{
+	m_nBasePt = img.m_nBasePt;
+}
+
+CImgProcess::CImgProcess(CImgProcess&& img) : CImg(std::move(img))
+{
+	m_nBasePt = img.m_nBasePt;
+}
+
 CImgProcess::~CImgProcess()
 {
 	
 }
 
+CImgProcess& CImgProcess::operator = (const CImgProcess& img)
+{
+	CImg::operator = (img);
+	m_nBasePt = img.m_nBasePt;
+	return *this;
+}
+
+CImgProcess& CImgProcess::operator = (CImgProcess&& img)
+{
+	CImg::operator = (std::move(img));
+	m_nBasePt = img.m_nBasePt;
+	return *this;
+}
+
 /**************************************************
 void CImgProcess::AutoThreshold(CImgProcess *pTo)
 
@@ -126,6 +157,99 @@ void CImgProcess::AutoThreshold(CImgProcess *pTo)
 
 
 
+// MorphPacked3x3ддʱĲ
+struct SMorphParam
+{
+	const CImg* pSrc;
+	CImg* pTo;
+	int (*se)[3];
+	BOOL bErode;
+};
+
+// 3*3ṹԪλѹϵĻ㣬ÿδ64أ[nBegin, nEnd)С
+// bErodeΪTRUEʱǰ/ǰʴһǰ㼴ǰͣ
+// ʵͬһؿĿձ
+static void MorphPacked3x3Rows(int nBegin, int nEnd, LPVOID pParam)
+{
+	const SMorphParam& param = *(const SMorphParam*)pParam;
+	const CImg& imgSrc = *param.pSrc;
+	CImg* pTo = param.pTo;
+	int (*se)[3] = param.se;
+	BOOL bErode = param.bErode;
+
+	int nWidth = imgSrc.GetWidthPixel();
+
+	int nWords = imgSrc.GetPackedWords();
+	int i, k, l, w;
+
+	// ѭʹõ3ǰλ
+	vector<uint64_t> vecFg(3 * nWords), vecBg(3 * nWords);
+	vector<uint64_t> vecDest(nWords);
+
+	// ЧĿΪ1..nWidth-2
+	vector<uint64_t> vecMask(nWords, ~(uint64_t)0);
+	vecMask[0] &= ~((uint64_t)1 << 63);
+	vecMask[(nWidth - 1) / 64] &= ~((uint64_t)1 << (63 - (nWidth - 1) % 64));
+	if(nWidth % 64)
+		vecMask[nWords - 1] &= ~(uint64_t)0 << (64 - nWidth % 64);
+
+	imgSrc.GetPackedRow(nBegin - 1, &vecFg[(nBegin - 1) % 3 * nWords], &vecBg[(nBegin - 1) % 3 * nWords]);
+	imgSrc.GetPackedRow(nBegin, &vecFg[nBegin % 3 * nWords], &vecBg[nBegin % 3 * nWords]);
+
+	for(i=nBegin; i<nEnd; i++)
+	{
+		int nNext = (i + 1) % 3;
+		imgSrc.GetPackedRow(i + 1, &vecFg[nNext * nWords], &vecBg[nNext * nWords]);
+
+		for(w=0; w<nWords; w++)
+			vecDest[w] = bErode ? ~(uint64_t)0 : 0;
+
+		for(k=0; k<3; k++)
+		{
+			int nRow = (i - 1 + k) % 3;
+			for(l=0; l<3; l++)
+			{
+				if( se[k][l] == -1 || (!bErode && se[k][l] != 1) )
+					continue;
+
+				const uint64_t* p = (se[k][l] == 1) ? &vecFg[nRow * nWords] : &vecBg[nRow * nWords];
+				for(w=0; w<nWords; w++)
+				{
+					uint64_t nTap;
+					if(l == 0) //
+						nTap = (p[w] >> 1) | (w > 0 ? p[w - 1] << 63 : 0);
+					else if(l == 1)
+						nTap = p[w];
+					else //
+						nTap = (p[w] << 1) | (w + 1 < nWords ? p[w + 1] >> 63 : 0);
+
+					if(bErode)
+						vecDest[w] &= nTap;
+					else
+						vecDest[w] |= nTap;
+				}
+			}//for l
+		}//for k
+
+		for(w=0; w<nWords; w++)
+			vecDest[w] &= vecMask[w];
+
+		pTo->SetPackedRow(i, &vecDest[0]);
+	}// for i
+}
+
+static void MorphPacked3x3(const CImg& imgSrc, CImg* pTo, int se[3][3], BOOL bErode)
+{
+	int nHeight = imgSrc.GetHeight();
+	int nWidth = imgSrc.GetWidthPixel();
+	if(nHeight < 3 || nWidth < 3)
+		return;
+
+	SMorphParam param = {&imgSrc, pTo, se, bErode};
+	CImgParallel::For(1, nHeight - 1, MorphPacked3x3Rows, &param);
+}
+
+
 /******************* 
 void CImgProcessProcessing::Erode(CImgProcess* pTo, int se[3][3])
  
@@ -145,64 +269,25 @@ void CImgProcessProcessing::Erode(CImgProcess* pTo, int se[3][3])
 *******************/
 void CImgProcess::Erode(CImgProcess *pTo, int se[3][3])
 {
-
-	int nHeight = GetHeight();
-	int nWidth = GetWidthPixel();
-
-	int i, j; //ͼѭ
 	int k, l; //ṹԪѭ
 
-	BOOL bMatch; //ṹԪǷֲͼƥ
-
 
 	pTo->InitPixels(255); //Ŀͼ
 
-	//ɨͼΪֹԽ磬һؿĿձ
-	for(i=1; i<nHeight-1; i++)
+	//ṹԪصȡֵ
+	for(k=0; k<3; k++)
 	{
-		for(j=1; j<nWidth-1; j++)
+		for(l=0; l<3; l++)
 		{
-			//ʹõ3*3ĽṹԪأΪֹԽ磬ϺµԼҵ
-			bMatch = true;
-			for(k=0; k<3; k++)
+			if( (se[k][l] != -1) && (se[k][l] != 1) && (se[k][l] != 0) )
 			{
-				for(l=0; l<3; l++)
-				{
-					if( se[k][l] == -1 ) //
-						continue;
-
-					if( se[k][l] == 1 ) //ǰ
-					{
-						if( GetGray(j-1+l, i-1+k) != 0 )
-						{
-							bMatch = false;
-							break;
-						}
-					}
-					else if( se[k][l] == 0 ) //
-					{
-						if( GetGray(j-1+l, i-1+k) != 255 )
-						{
-							bMatch = false;
-							break;
-						}
-					}
-					else
-					{
-						AfxMessageBox("ṹԪغзǷֵ趨");
-						return;
-					}
-					
-				}//for l
-			}//for k
-			
-			if( bMatch )
-				pTo->SetPixel(j, i, RGB(0, 0, 0));
-
-		}// for j
-	}// for i
-
+				ImgMessage("ṹԪغзǷֵ趨");
+				return;
+			}
+		}
+	}
 
+	MorphPacked3x3(*this, pTo, se, TRUE);
 }
 
 
@@ -226,3573 +311,6799 @@ void CImgProcess::Dilate(CImgProcess* pTo, int se[3][3])
 *******************/
 void CImgProcess::Dilate(CImgProcess *pTo, int se[3][3])
 {
-
-	int nHeight = GetHeight();
-	int nWidth = GetWidthPixel();
-
-	int i, j; //ͼѭ
 	int k, l; //ṹԪѭ
 
 
-	//seĵĶԳƼ
-	int nTmp;
-	for(i=0; i<2; i++)
+	//seĵĶԳƼĶߵse
+	int seRef[3][3];
+	for(k=0; k<3; k++)
 	{
-		for(j=0; j<3-i; j++)
-		{
-			nTmp = se[i][j];
-			se[i][j] = se[2-i][2-j];
-			se[2-i][2-j] = nTmp;
-		}
+		for(l=0; l<3; l++)
+			seRef[k][l] = se[2-k][2-l];
 	}
 
 	
 	pTo->InitPixels(255); //Ŀͼ
 
-	//ɨͼΪֹԽ磬һؿĿձ
-	for(i=1; i<nHeight-1; i++)
+	//ṹԪصȡֵ
+	for(k=0; k<3; k++)
 	{
-		for(j=1; j<nWidth-1; j++)
+		for(l=0; l<3; l++)
 		{
-			//ʹõ3*3ĽṹԪأΪֹԽ磬ϺµԼҵ
-
-			for(k=0; k<3; k++)
+			if( (seRef[k][l] != -1) && (seRef[k][l] != 1) )
 			{
-				for(l=0; l<3; l++)
-				{
-					if( se[k][l] == -1 ) // 
-						continue;
+				ImgMessage("ṹԪغзǷֵ趨");
+				return;
+			}
+		}
+	}
 
-					if( se[k][l] == 1 )
-					{
-						if( GetGray(j-1+l, i-1+k) ==  0)
-						{
-							//ԭͼжӦṹԪصľֲһΪ1ͽĿͼӦڽṹԪĵ0
+	MorphPacked3x3(*this, pTo, seRef, FALSE);
+}
 
-							pTo->SetPixel(j, i, RGB(0, 0, 0));
-							break;
-						}
-					}
-					else
-					{
-						AfxMessageBox("ṹԪغзǷֵ趨");
-						return;
-					}
+// ִֿʱÿддͬԼΪnTileBytesֽڣ
+// ܴʱȡ2nHaloУظ򲻳
+static int GetTileRows(int nWidthBytes, int nHalo, size_t nTileBytes)
+{
+	int nRows = (int)(nTileBytes / (size_t)ALIGNSTRIDE(nWidthBytes)) - 2 * nHalo;
+	return max(nRows, max(2 * nHalo, 1));
+}
 
-				}//for l
-			}//for k
-			
-		}// for j
-	}// for i
+// ǷִֿУͼֻһдʱ
+static BOOL UseTiles(const CImg& img, int nTileMode, int nHalo)
+{
+	if(nTileMode == IMG_TILE_DEFAULT)
+		nTileMode = CImgProcess::GetTileMode();
+
+	return nTileMode != IMG_TILE_OFF
+		&& img.GetHeight() > GetTileRows(img.GetWidthByte(), nHalo, CImgProcess::GetTileBytes());
+}
+
+// ṹԪǷֻ1-1ǷֵʱErode/Dilateʾһ
+static BOOL IsValidDilateSE(int se[3][3])
+{
+	for(int k=0; k<3; k++)
+		for(int l=0; l<3; l++)
+			if( (se[k][l] != -1) && (se[k][l] != 1) )
+				return FALSE;
+	return TRUE;
+}
+
+// ִֿе̬ѧ
+#define MORPH_CHAIN_OPEN		0
+#define MORPH_CHAIN_CLOSE		1
+#define MORPH_CHAIN_GRAYOPEN	2
+#define MORPH_CHAIN_GRAYCLOSE	3
 
+struct SMorphChainParam
+{
+	int nChain;			// MORPH_CHAIN_*
+	int (*pSe3)[3];		// ֵ33ṹԪ
+	int nTempH, nTempW, nTempMY, nTempMX;
+	int** se;			// ҶȿĽṹԪ
+};
 
+// һдִдڲٷֿ
+static void MorphChainBand(CImgProcess* pIn, CImgProcess* pOut, LPVOID pParam)
+{
+	SMorphChainParam& param = *(SMorphChainParam*)pParam;
+
+	switch(param.nChain)
+	{
+	case MORPH_CHAIN_OPEN:
+		pIn->Open(pOut, param.pSe3, IMG_TILE_OFF);
+		break;
+	case MORPH_CHAIN_CLOSE:
+		pIn->Close(pOut, param.pSe3, IMG_TILE_OFF);
+		break;
+	case MORPH_CHAIN_GRAYOPEN:
+		pIn->GrayOpen(pOut, param.nTempH, param.nTempW, param.nTempMY, param.nTempMX, param.se, IMG_TILE_OFF);
+		break;
+	case MORPH_CHAIN_GRAYCLOSE:
+		pIn->GrayClose(pOut, param.nTempH, param.nTempW, param.nTempMY, param.nTempMX, param.se, IMG_TILE_OFF);
+		break;
+	}
 }
 
 /******************* 
-void CImgProcessProcessing::Open(CImgProcess* pTo, int se[3][3])
+void CImgProcessProcessing::Open(CImgProcess* pTo, int se[3][3], int nTileMode)
  
  ܣ
 	3*3ṹԪصĶֵͼ
  ע
-	ֻܴ2ֵͼ
+	ֻܴ2ֵͼͼϴʱдִֿУProcessTiled
+	ͬ
 
  
 	Image* pTo: Ŀͼ CImgProcess ָ
 	se[3][3]: 3*3ĽṹԪأԪصĺϷȡֵΪ: 
 		1 --- ǰ
 	   -1 --- 
+	int nTileMode: ִֿģʽIMG_TILE_*
 	 
  ֵ
 	
 	
 *******************/
-void CImgProcess::Open(CImgProcess* pTo, int se[3][3])
+void CImgProcess::Open(CImgProcess* pTo, int se[3][3], int nTileMode)
 {
+	if(IsValidDilateSE(se) && UseTiles(*this, nTileMode, 2))
+	{
+		SMorphChainParam param = {MORPH_CHAIN_OPEN, se, 0, 0, 0, 0, NULL};
+		ProcessTiled(pTo, 2, MorphChainBand, &param);
+		return;
+	}
+
 	pTo->InitPixels(255);
 
 	Erode(pTo, se);
 
-	*this = *pTo;
+	CImgProcess tmpImg = *pTo; //ݴ港ʴͼ
 
-	Dilate(pTo, se);
+	tmpImg.Dilate(pTo, se);
 }
 
 
 /******************* 
-void CImgProcessProcessing::Close(CImgProcess* pTo, int se[3][3])
+void CImgProcessProcessing::Close(CImgProcess* pTo, int se[3][3], int nTileMode)
  
  ܣ
 	3*3ṹԪصĶֵͼ
  ע
-	ֻܴ2ֵͼ
+	ֻܴ2ֵͼͼϴʱдִֿУProcessTiled
+	ͬ
 
  
 	Image* pTo: Ŀͼ CImgProcess ָ
 	se[3][3]: 3*3ĽṹԪأԪصĺϷȡֵΪ: 
 		1 --- ǰ
 	   -1 --- 
+	int nTileMode: ִֿģʽIMG_TILE_*
 	 
  ֵ
 	
 	
 *******************/
-void CImgProcess::Close(CImgProcess* pTo, int se[3][3])
+void CImgProcess::Close(CImgProcess* pTo, int se[3][3], int nTileMode)
 {
+	if(IsValidDilateSE(se) && UseTiles(*this, nTileMode, 2))
+	{
+		SMorphChainParam param = {MORPH_CHAIN_CLOSE, se, 0, 0, 0, 0, NULL};
+		ProcessTiled(pTo, 2, MorphChainBand, &param);
+		return;
+	}
+
 	pTo->InitPixels(255);
 
 
 
 	Dilate(pTo, se);
 	
-	*this = *pTo;
+	CImgProcess tmpImg = *pTo; //ݴͼ
 
-	Erode(pTo, se);
+	tmpImg.Erode(pTo, se);
 }
 
 
+// СṹԪصĶֵ̬ѧṹԪصÿһзֽΪˮƽ߶Σ
+// ʴǸ߶θʴĽǸ߶ͽĲΪnLen߶
+// һеĸʴͣǸnLenλ루򣩣ɱõ
+// Ϊ124Ľⳤβ2ݴνƴɡ
+// ÿԴͼеЩֻһΣѭйڽʹã
+// ÿֻԽṹԪصÿ߶һλ루򣩣ÿδ64ء
+// Բ̡ε͹νṹԪÿֻһ߶Σθ߶ͬ
 
+// λѹе㣬ΪBinMorphRowsȵģ
+struct SPackedAnd
+{
+	static inline uint64_t Op(uint64_t a, uint64_t b) { return a & b; }
+	static inline uint64_t Init() { return ~(uint64_t)0; }
+};
 
-/******************* 
-void CImgProcessProcessing::Convex(CImgProcess* pTo, BOOL bConstrain)
- 
- ܣ
-	ͼǰ͹
- ע
-	ֻܴ2ֵͼ
+struct SPackedOr
+{
+	static inline uint64_t Op(uint64_t a, uint64_t b) { return a | b; }
+	static inline uint64_t Init() { return 0; }
+};
 
- 
-	Image* pTo: Ŀͼ CImgProcess ָ
-	BOOL bConstrain: Ƿ͹ǵڰС֮
-		 
- ֵ
-	
-	
-*******************/
-void CImgProcess::Convex(CImgProcess* pTo, BOOL bConstrain)
+// λѹеwƽnShiftкֵĵjΪpInĵj + nShiftУеΪ0
+static inline uint64_t ShiftedWord(const uint64_t* pIn, int nWords, int w, int nShift)
 {
-	//͹Ҫ4ṹԪ
-	/*
-	se1 = 1 -1 -1	se2 = 1  1  1	se3 = -1 -1  1	se4 = -1 -1 -1
-		  1	 0 -1		 -1  0 -1		  -1  0  1		  -1  0 -1
-		  1 -1  1		 -1 -1 -1		  -1 -1  1		   1  1  1
-	*/
-	int se1[3][3] = {{1, -1, -1}, {1, 0, -1}, {1, -1, -1}}; //ֲҲ͹ȱ
-	int se2[3][3] = {{1, 1, 1}, {-1, 0, -1}, {-1, -1, -1}}; //ֲ²͹ȱ
-	int se3[3][3] = {{-1, -1, 1}, {-1, 0, 1}, {-1, -1, 1}}; //ֲ͹ȱ
-	int se4[3][3] = {{-1, -1, -1}, {-1, 0, -1}, {1, 1, 1}}; //ֲϲ͹ȱ
-	
-	int nHeight = GetHeight();
-	int nWidth = GetWidthPixel();
-	int i, j; //ͼѭ
+	int q, r;
+	uint64_t nHi = 0, nLo = 0;
+	if(nShift >= 0)
+	{
+		q = nShift >> 6;
+		r = nShift & 63;
+		if(w + q < nWords)
+			nHi = pIn[w + q] << r;
+		if(r && w + q + 1 < nWords)
+			nLo = pIn[w + q + 1] >> (64 - r);
+	}
+	else
+	{
+		q = (-nShift) >> 6;
+		r = (-nShift) & 63;
+		if(w - q >= 0)
+			nHi = pIn[w - q] >> r;
+		if(r && w - q - 1 >= 0)
+			nLo = pIn[w - q - 1] << (64 - r);
+	}
+	return nHi | nLo;
+}
 
-	
-	pTo->InitPixels(255); //Ŀͼ
+// pAcc[j] = pAcc[j] op pIn[j + nShift]jΪ
+template <class TOp>
+static void AccumShifted(uint64_t* pAcc, const uint64_t* pIn, int nWords, int nShift)
+{
+	int w;
+	int q = (nShift >= 0 ? nShift : -nShift) >> 6;
+	int r = (nShift >= 0 ? nShift : -nShift) & 63;
 
+	// мԴڣж
+	int nBegin = (nShift >= 0) ? 0 : q + 1;
+	int nEnd = (nShift >= 0) ? nWords - q - 1 : nWords;
+	nBegin = min(nBegin, nWords);
+	nEnd = max(nEnd, nBegin);
 
-	// õ1ṹԪ
-	CImgProcess tmpImg1 = *this; //ݴһε
-	
+	for(w=0; w<nBegin; w++)
+		pAcc[w] = TOp::Op(pAcc[w], ShiftedWord(pIn, nWords, w, nShift));
 
-	while(true)
+	if(r == 0)
 	{
-		tmpImg1.Erode(pTo, se1); //ȫΧĻлб任
-		*pTo = *pTo | tmpImg1;
-				
-		if(tmpImg1 == *pTo)
-			break; //㷨ֹ
-		
-		tmpImg1 = *pTo;
+		int d = (nShift >= 0) ? q : -q;
+		for(w=nBegin; w<nEnd; w++)
+			pAcc[w] = TOp::Op(pAcc[w], pIn[w + d]);
 	}
-	
-
-	// õ2ṹԪ
-	CImgProcess tmpImg2 = *this; //ݴһε
-	
-	while(true)
+	else if(nShift >= 0)
 	{
-		tmpImg2.Erode(pTo, se2); //ȫΧĻлб任
-		*pTo = *pTo | tmpImg2;
-
-		if(tmpImg2 == *pTo)
-			break; //㷨ֹ
-
-		tmpImg2 = *pTo;
+		for(w=nBegin; w<nEnd; w++)
+			pAcc[w] = TOp::Op(pAcc[w], (pIn[w + q] << r) | (pIn[w + q + 1] >> (64 - r)));
 	}
-
-	// õ3ṹԪ
-	CImgProcess tmpImg3 = *this; //ݴһε
-	
-	while(true)
+	else
 	{
-		tmpImg3.Erode(pTo, se3); //ȫΧĻлб任
-		*pTo = *pTo | tmpImg3;
-		
-		if(tmpImg3 == *pTo)
-			break; //㷨ֹ
-		
-		tmpImg3 = *pTo;
+		for(w=nBegin; w<nEnd; w++)
+			pAcc[w] = TOp::Op(pAcc[w], (pIn[w - q] >> r) | (pIn[w - q - 1] << (64 - r)));
 	}
 
+	for(w=nEnd; w<nWords; w++)
+		pAcc[w] = TOp::Op(pAcc[w], ShiftedWord(pIn, nWords, w, nShift));
+}
 
-	// õ4ṹԪ
-	CImgProcess tmpImg4 = *this; //ݴһε
-	
-	while(true)
+// ṹԪطֽɵˮƽ߶μйԼ
+struct SBinMorphParam
+{
+	const CImg* pSrc;
+	CImg* pTo;
+	int nStartY, nEndY;		// СеķΧṹԪȫͼ
+	int nStartX, nEndX;
+	int nRowMin, nRowMax;	// ߶ԴͼеƫƷΧ
+
+	// ߶εԴͼƫơƫƣ߶ˣõйԼ
+	vector<int> vecRunDY, vecRunDX, vecRunKey;
+	// йԼǰ򱳾λnLenλ루򣩣nLenΪ1ʱб
+	vector<int> vecKeyLen;
+	vector<BOOL> vecKeyFg;
+	BOOL bNeedBg;			// ǷõλʴĽṹԪغ0
+};
+
+// һеĸйԼpOutδšpPowΪʱ
+template <class TOp>
+static void ReduceRuns(const SBinMorphParam& param, const uint64_t* pFg, const uint64_t* pBg,
+	int nWords, uint64_t* pOut, vector<uint64_t>& vecPow)
+{
+	for(int nPlane=0; nPlane<2; nPlane++)
 	{
-		tmpImg4.Erode(pTo, se4); //ȫΧĻлб任
-		*pTo = *pTo | tmpImg4;
-		
-		if(tmpImg4 == *pTo)
-			break; //㷨ֹ
-		
-		tmpImg4 = *pTo;
+		BOOL bFg = (nPlane == 0);
+		const uint64_t* pPlane = bFg ? pFg : pBg;
+		int nLevels = 0; //ımΪ2^mĽ
+
+		for(size_t n=0; n<param.vecKeyLen.size(); n++)
+		{
+			if(param.vecKeyFg[n] != bFg)
+				continue;
+
+			int nLen = param.vecKeyLen[n];
+			int m = 0;
+			while((2 << m) <= nLen)
+				m++;
+
+			if(vecPow.size() < (size_t)(m + 1) * nWords)
+				vecPow.resize((size_t)(m + 1) * nWords);
+			if(nLevels == 0)
+			{
+				memcpy(&vecPow[0], pPlane, nWords * sizeof(uint64_t));
+				nLevels = 1;
+			}
+			for(; nLevels<=m; nLevels++)
+			{
+				uint64_t* pCur = &vecPow[(size_t)nLevels * nWords];
+				const uint64_t* pPrev = pCur - nWords;
+				memcpy(pCur, pPrev, nWords * sizeof(uint64_t));
+				AccumShifted<TOp>(pCur, pPrev, nWords, 1 << (nLevels - 1));
+			}
+
+			// nLen = [0, 2^m)  [nLen - 2^m, nLen)
+			uint64_t* pDst = pOut + n * nWords;
+			const uint64_t* pPow = &vecPow[(size_t)m * nWords];
+			memcpy(pDst, pPow, nWords * sizeof(uint64_t));
+			if(nLen > (1 << m))
+				AccumShifted<TOp>(pDst, pPow, nWords, nLen - (1 << m));
+		}
 	}
+}
+
+// [nBegin, nEnd)УTOpΪSPackedAndʱǸʴSPackedOrʱ
+template <class TOp>
+static void BinMorphRows(int nBegin, int nEnd, LPVOID pParam)
+{
+	const SBinMorphParam& param = *(const SBinMorphParam*)pParam;
+	const CImg& imgSrc = *param.pSrc;
 
+	int nWords = imgSrc.GetPackedWords();
+	int nKeys = (int)param.vecKeyLen.size();
+	int nSpan = param.nRowMax - param.nRowMin + 1;
+	size_t nSlot = (size_t)nKeys * nWords;
 
+	// ѭ壬ԴͼyеĸйԼڵy % nSpanλ
+	vector<uint64_t> vecRing(nSpan * nSlot);
+	vector<uint64_t> vecFg(nWords), vecBg(nWords), vecPow;
+	vector<uint64_t> vecDest(nWords);
 
-	// 4Ĳ
-	pTo->InitPixels(255);
+	// ЧĿ
+	vector<uint64_t> vecMask(nWords, 0);
+	for(int j=param.nStartX; j<param.nEndX; j++)
+		vecMask[j >> 6] |= (uint64_t)1 << (63 - (j & 63));
 
-	for(i=0; i<nHeight; i++)
+	for(int i=nBegin; i<nEnd; i++)
 	{
-		for(j=0; j<nWidth; j++)
+		for(int y=(i == nBegin ? i + param.nRowMin : i + param.nRowMax); y<=i + param.nRowMax; y++)
+		{
+			imgSrc.GetPackedRow(y, &vecFg[0], param.bNeedBg ? &vecBg[0] : NULL);
+			ReduceRuns<TOp>(param, &vecFg[0], &vecBg[0], nWords, &vecRing[(y % nSpan) * nSlot], vecPow);
+		}
+
+		for(int w=0; w<nWords; w++)
+			vecDest[w] = TOp::Init();
+
+		for(size_t n=0; n<param.vecRunDY.size(); n++)
 		{
-			if( (tmpImg1.GetGray(j, i) == 0) || (tmpImg2.GetGray(j, i) == 0) || (tmpImg3.GetGray(j, i) == 0) || (tmpImg4.GetGray(j, i) == 0) )
-				pTo->SetPixel(j, i, RGB(0, 0, 0));			
+			const uint64_t* pRun = &vecRing[((i + param.vecRunDY[n]) % nSpan) * nSlot + param.vecRunKey[n] * nWords];
+			AccumShifted<TOp>(&vecDest[0], pRun, nWords, param.vecRunDX[n]);
 		}
+
+		for(int w=0; w<nWords; w++)
+			vecDest[w] &= vecMask[w];
+
+		param.pTo->SetPackedRow(i, &vecDest[0]);
 	}
-	
+}
 
-	
-	// Ҫ͹ǵ
-	
-	// ҵԭͼķΧСΣ
-	int nTop = nHeight;
-	int nBottom = 0;
-	int nLeft = nWidth;
-	int nRight = 0;
-	for(i=0; i<nHeight; i++)
-	{
-		for(j=0; j<nWidth; j++)
+// ṹԪصȡֵʴɺ10-1ֻܺ1-1
+static BOOL IsValidBinarySE(int nTempH, int nTempW, int** se, BOOL bErode)
+{
+	for(int k=0; k<nTempH; k++)
+		for(int l=0; l<nTempW; l++)
+			if( (se[k][l] != -1) && (se[k][l] != 1) && (!bErode || se[k][l] != 0) )
+				return FALSE;
+	return TRUE;
+}
+
+// ѽṹԪطֽΪˮƽ߶Σλѹϲм㡣
+// ͰṹԪعĵĶԳƼ㣬33Dilateͬ
+static void BinaryMorph(const CImg& imgSrc, CImg* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se, BOOL bErode)
+{
+	int nHeight = imgSrc.GetHeight();
+	int nWidth = imgSrc.GetWidthPixel();
+
+	SBinMorphParam param;
+	param.pSrc = &imgSrc;
+	param.pTo = pTo;
+	param.bNeedBg = FALSE;
+
+	// ģ帲ǵԴͼСصƫ
+	int nOffY0 = bErode ? -nTempMY : nTempMY - (nTempH - 1);
+	int nOffX0 = bErode ? -nTempMX : nTempMX - (nTempW - 1);
+	param.nStartY = -nOffY0;
+	param.nEndY = nHeight - (nOffY0 + nTempH - 1);
+	param.nStartX = -nOffX0;
+	param.nEndX = nWidth - (nOffX0 + nTempW - 1);
+	param.nRowMin = nTempH;
+	param.nRowMax = -nTempH;
+
+	for(int k=0; k<nTempH; k++)
+	{
+		for(int l=0; l<nTempW; )
 		{
-			if(GetGray(j, i) == 0)
+			int nValue = se[k][l];
+			if(nValue == -1)
+			{
+				l++;
+				continue;
+			}
+
+			int nLen = 1;
+			while(l + nLen < nTempW && se[k][l + nLen] == nValue)
+				nLen++;
+
+			BOOL bFg = (nValue == 1);
+			size_t n = 0;
+			while(n < param.vecKeyLen.size() && (param.vecKeyLen[n] != nLen || param.vecKeyFg[n] != bFg))
+				n++;
+			if(n == param.vecKeyLen.size())
 			{
-				if(i < nTop)
-					nTop = i;
-				if(i > nBottom)
-					nBottom = i;
-				if(j < nLeft)
-					nLeft = j;
-				if(j > nRight)
-					nRight = j;
+				param.vecKeyLen.push_back(nLen);
+				param.vecKeyFg.push_back(bFg);
 			}
+			if(!bFg)
+				param.bNeedBg = TRUE;
+
+			int nDY = bErode ? k - nTempMY : nTempMY - k;
+			int nDX = bErode ? l - nTempMX : nTempMX - (l + nLen - 1);
+			param.vecRunDY.push_back(nDY);
+			param.vecRunDX.push_back(nDX);
+			param.vecRunKey.push_back((int)n);
+			param.nRowMin = min(param.nRowMin, nDY);
+			param.nRowMax = max(param.nRowMax, nDY);
+
+			l += nLen;
 		}
 	}
 
-	if(bConstrain)
+	if(param.nEndY <= param.nStartY || param.nEndX <= param.nStartX)
+		return;
+
+	if(param.vecRunDY.empty())
 	{
-		for(i=0; i<nHeight; i++)
+		// ṹԪȫΪ-1ʴ㣬ʹ
+		if(bErode)
 		{
-			for(j=0; j<nWidth; j++)
-			{
-				if( (i<nTop) || (i>nBottom) || (j<nLeft) || (j>nRight) )
-					pTo->SetPixel(j, i, RGB(255, 255, 255));
-			}
+			vector<uint64_t> vecDest(imgSrc.GetPackedWords(), 0);
+			for(int j=param.nStartX; j<param.nEndX; j++)
+				vecDest[j >> 6] |= (uint64_t)1 << (63 - (j & 63));
+			for(int i=param.nStartY; i<param.nEndY; i++)
+				pTo->SetPackedRow(i, &vecDest[0]);
 		}
-	}//if(bConstrain)
+		return;
+	}
 
+	CImgParallel::For(param.nStartY, param.nEndY, bErode ? BinMorphRows<SPackedAnd> : BinMorphRows<SPackedOr>,
+		&param, 0, max(16, 2 * (param.nRowMax - param.nRowMin + 1)));
 }
 
-/*******************
-void CImgProcess::GrayDilate(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se)
-ܣҶͼ
-
-עֻƽ̹ĽṹԪ
+/******************* 
+void CImgProcess::Erode(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se)
+ 
+ ܣ
+	СṹԪصĶֵͼʴ
+ ע
+	ֻܴ2ֵͼ󡣽ṹԪصÿһзֽΪˮƽ߶Σλѹ
+	д̼߳㣬ÿ߶εļ䳤޹أ
+	뾶20ԲҲֻÿ4164λֵ㡣
+	ṹԪزȫͼڵΪ
 
-
-	CImgProcess* pToĿͼ CImgProcess ָ
-	int   nTempHģĸ߶
-	int   nTempW ģĿ
-	int   nTempMYģԪY ( <= iTempH - 1)
-	int   nTempMXģԪX ( <= iTempW - 1)
-	int** seṹԪ
-ֵ:
-	
+ 
+	CImgProcess* pTo: Ŀͼ CImgProcess ָ
+	int nTempH, int nTempW: ṹԪصĸ߶ȡ
+	int nTempMY, int nTempMX: ṹԪصԪ
+	int** se: ṹԪأԪصĺϷȡֵΪ: 
+		1 --- ǰ
+		0 --- 
+	   -1 --- 	 
+ ֵ
+		
 *******************/
-void CImgProcess::GrayDilate(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se)
+void CImgProcess::Erode(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se)
 {
-	// ѭ
-	int i, j, k, l;
-		
-	int nHeight = GetHeight();
-	int nWidth = GetWidthPixel();
-	
+	pTo->InitPixels(255); //Ŀͼ
 
-	for(i=nTempMY;i<nHeight - nTempH + nTempMY + 1;i++)
+	if(!IsValidBinarySE(nTempH, nTempW, se, TRUE))
 	{
-		for(j=nTempMX;j<nWidth - nTempW + nTempMX +1;j++)
-		{
-			BYTE maxVal = 0; //ֲֵ
-			for(k=0;k<nTempH;k++)
-			{
-				for(l=0;l<nTempW;l++)
-				{
-					if( se[k][l] == 1 )
-					{
-						// ͼi - nTempMY + kУj - nTempMX + lصĻҶ
-						BYTE gray = GetGray(j-nTempMX+l, i-nTempMY+k);
-						
-						//ֲֵ
-						if( gray > maxVal )
-							maxVal = gray;
-					}
-				}//l
-			}//k
-		
-			pTo->SetPixel(j, i, RGB(maxVal, maxVal, maxVal));			
-		}// for j
-	}//for i
+		ImgMessage("ṹԪغзǷֵ趨");
+		return;
+	}
 
+	BinaryMorph(*this, pTo, nTempH, nTempW, nTempMY, nTempMX, se, TRUE);
 }
 
+/******************* 
+void CImgProcess::Dilate(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se)
+ 
+ ܣ
+	СṹԪصĶֵͼ
+ ע
+	ֻܴ2ֵͼ󡣰ṹԪعĵĶԳƼ㣬ʵͬErode
 
-
-/*******************
-void CImgProcess::GrayErode(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se)
-ܣҶͼʴ
-
-עֻƽ̹ĽṹԪ
-
-
-	CImgProcess* pToĿͼ CImgProcess ָ
-	int   nTempHģĸ߶
-	int   nTempWģĿ
-	int   nTempMYģԪY ( <= iTempH - 1)
-	int   nTempMXģԪX ( <= iTempW - 1)
-	int **seṹԪ
-ֵ:
-	
+ 
+	CImgProcess* pTo: Ŀͼ CImgProcess ָ
+	int nTempH, int nTempW: ṹԪصĸ߶ȡ
+	int nTempMY, int nTempMX: ṹԪصԪ
+	int** se: ṹԪأԪصĺϷȡֵΪ: 
+		1 --- ǰ
+	   -1 --- 
+ ֵ
+		
 *******************/
-void CImgProcess::GrayErode(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se)
+void CImgProcess::Dilate(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se)
 {
-	// ѭ
-	int i, j, k, l;
-		
-	int nHeight = GetHeight();
-	int nWidth = GetWidthPixel();
-	
+	pTo->InitPixels(255); //Ŀͼ
 
-	for(i=nTempMY;i<nHeight - nTempH + nTempMY + 1;i++)
+	if(!IsValidBinarySE(nTempH, nTempW, se, FALSE))
 	{
-		for(j=nTempMX;j<nWidth - nTempW + nTempMX +1;j++)
-		{
-			BYTE minVal = 255; //ֲСֵ
-			for(k=0;k<nTempH;k++)
-			{
-				for(l=0;l<nTempW;l++)
-				{
-					if( se[k][l] == 1 )
-					{
-						// ͼi - nTempMY + kУj - nTempMX + lصĻҶ
-						BYTE gray = GetGray(j-nTempMX+l, i-nTempMY+k);
-						
-						//ֲֵ
-						if( gray < minVal )
-							minVal = gray;
-					}
-				}//l
-			}//k
-		
-			pTo->SetPixel(j, i, RGB(minVal, minVal, minVal));			
-		}// for j
-	}//for i
+		ImgMessage("ṹԪغзǷֵ趨");
+		return;
+	}
 
+	BinaryMorph(*this, pTo, nTempH, nTempW, nTempMY, nTempMX, se, FALSE);
 }
 
+/******************* 
+void CImgProcess::Open(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se)
+ 
+ ܣ
+	СṹԪصĶֵͼ
+ ע
+	ֻܴ2ֵͼλѹ㹻գṹԪؽϴʱִֿ
+	ظ̫࣬Բֿ
 
-/*******************
-void CImgProcess::GrayOpen(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se)
-ܣҶȿ
-
-עֻƽ̹ĽṹԪ
-
-
-	CImgProcess* pToĿͼ CImgProcess ָ
-	int   nTempHģĸ߶
-	int   nTempWģĿ
-	int   nTempMYģԪY ( <= iTempH - 1)
-	int   nTempMXģԪX ( <= iTempW - 1)
-	int **seṹԪ
-ֵ:
-	
+ 
+	CImgProcess* pTo: Ŀͼ CImgProcess ָ
+	int nTempH, int nTempW: ṹԪصĸ߶ȡ
+	int nTempMY, int nTempMX: ṹԪصԪ
+	int** se: ṹԪأϷȡֵΪ1ǰ-1ģ
+ ֵ
+		
 *******************/
-void CImgProcess::GrayOpen(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se)
+void CImgProcess::Open(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se)
 {
-	pTo->InitPixels(255);
-
-	GrayErode(pTo, nTempH, nTempW, nTempMY, nTempMX, se);
+	Erode(pTo, nTempH, nTempW, nTempMY, nTempMX, se);
 
 	CImgProcess tmpImg = *pTo; //ݴ港ʴͼ
 
-	tmpImg.GrayDilate(pTo, nTempH, nTempW, nTempMY, nTempMX, se);	
+	tmpImg.Dilate(pTo, nTempH, nTempW, nTempMY, nTempMX, se);
 }
 
-/*******************
-void CImgProcess::GrayClose(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se)
-ܣҶȿ
-
-עֻƽ̹ĽṹԪ
+/******************* 
+void CImgProcess::Close(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se)
+ 
+ ܣ
+	СṹԪصĶֵͼ
+ ע
+	ֻܴ2ֵͼλѹ㹻գṹԪؽϴʱִֿ
+	ظ̫࣬Բֿ
 
-
-	CImgProcess* pToĿͼ CImgProcess ָ
-	int   nTempHģĸ߶
-	int   nTempWģĿ
-	int   nTempMYģԪY ( <= iTempH - 1)
-	int   nTempMXģԪX ( <= iTempW - 1)
-	int **seṹԪ
-ֵ:
-	
+ 
+	CImgProcess* pTo: Ŀͼ CImgProcess ָ
+	int nTempH, int nTempW: ṹԪصĸ߶ȡ
+	int nTempMY, int nTempMX: ṹԪصԪ
+	int** se: ṹԪأϷȡֵΪ1ǰ-1ģ
+ ֵ
+		
 *******************/
-void CImgProcess::GrayClose(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se)
+void CImgProcess::Close(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se)
 {
-	pTo->InitPixels(255);
-
-	GrayDilate(pTo, nTempH, nTempW, nTempMY, nTempMX, se);
+	Dilate(pTo, nTempH, nTempW, nTempMY, nTempMX, se);
 
 	CImgProcess tmpImg = *pTo; //ݴͼ
 
-	tmpImg.GrayErode(pTo, nTempH, nTempW, nTempMY, nTempMX, se);	
+	tmpImg.Erode(pTo, nTempH, nTempW, nTempMY, nTempMX, se);
 }
 
 
 
+/******************* 
+void CImgProcessProcessing::Convex(CImgProcess* pTo, BOOL bConstrain)
+ 
+ ܣ
+	ͼǰ͹
+ ע
+	ֻܴ2ֵͼ
 
-
-
-/*******************
-void CImgProcess::Tophat(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se)
-ܣñ任
-
-עֻƽ̹ĽṹԪ
-
-
-	CImgProcess* pToĿͼ CImgProcess ָ
-	int   nTempHģĸ߶
-	int   nTempWģĿ
-	int   nTempMYģԪY ( <= iTempH - 1)
-	int   nTempMXģԪX ( <= iTempW - 1)
-	int **seṹԪ
-ֵ:
+ 
+	Image* pTo: Ŀͼ CImgProcess ָ
+	BOOL bConstrain: Ƿ͹ǵڰС֮
+		 
+ ֵ
 	
+	
 *******************/
-void CImgProcess::Tophat(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se)
+void CImgProcess::Convex(CImgProcess* pTo, BOOL bConstrain)
 {
-	GrayOpen(pTo, nTempH, nTempW, nTempMY, nTempMX, se); //Ҷȿ
+	//͹Ҫ4ṹԪ
+	/*
+	se1 = 1 -1 -1	se2 = 1  1  1	se3 = -1 -1  1	se4 = -1 -1 -1
+		  1	 0 -1		 -1  0 -1		  -1  0  1		  -1  0 -1
+		  1 -1  1		 -1 -1 -1		  -1 -1  1		   1  1  1
+	*/
+	int se1[3][3] = {{1, -1, -1}, {1, 0, -1}, {1, -1, -1}}; //ֲҲ͹ȱ
+	int se2[3][3] = {{1, 1, 1}, {-1, 0, -1}, {-1, -1, -1}}; //ֲ²͹ȱ
+	int se3[3][3] = {{-1, -1, 1}, {-1, 0, 1}, {-1, -1, 1}}; //ֲ͹ȱ
+	int se4[3][3] = {{-1, -1, -1}, {-1, 0, -1}, {1, 1, 1}}; //ֲϲ͹ȱ
+	
+	int nHeight = GetHeight();
+	int nWidth = GetWidthPixel();
+	int i, j; //ͼѭ
 
-		
-	*pTo = (*this) - (*pTo); //ñ任ԭͼȥͼ
-		
-}
+	
+	pTo->InitPixels(255); //Ŀͼ
 
 
-/*******************
-void CImgProcess::Template(CImgProcess *pTo, 
-						 int nTempH, int nTempW, 
-						 int nTempMY, int nTempMX, FLOAT *pfArray, FLOAT fCoef)
+	// õ1ṹԪ
+	CImgProcess tmpImg1 = *this; //ݴһε
+	
 
-ܣģ
+	while(true)
+	{
+		tmpImg1.Erode(pTo, se1); //ȫΧĻлб任
+		*pTo = *pTo | tmpImg1;
+				
+		if(tmpImg1 == *pTo)
+			break; //㷨ֹ
+		
+		tmpImg1 = *pTo;
+	}
+	
 
-עúָģ壨СͼвiTempHָģ
-	ĸ߶ȣiTempWָģĿȣiTempMXiTempMYָģ
-	Ԫ꣬fpArrayָģԪأfCoefָϵ
+	// õ2ṹԪ
+	CImgProcess tmpImg2 = *this; //ݴһε
+	
+	while(true)
+	{
+		tmpImg2.Erode(pTo, se2); //ȫΧĻлб任
+		*pTo = *pTo | tmpImg2;
 
-
-	CImgProcess* pToͼ CImgProcess ָ
-	int   nTempHģĸ߶
-	int   nTempW ģĿ
-	int   nTempMYģԪY ( <= iTempH - 1)
-	int   nTempMXģԪX ( <= iTempW - 1)
-	FLOAT * fpArrayָģָ
-	FLOAT fCoefģϵ
+		if(tmpImg2 == *pTo)
+			break; //㷨ֹ
 
-ֵ:
-	
-*******************/
-void CImgProcess::Template(CImgProcess *pTo, 
-						 int nTempH, int nTempW, 
-						 int nTempMY, int nTempMX, FLOAT *pfArray, FLOAT fCoef)
-{
-	pTo->InitPixels(0); //Ŀͼʼ
-	
-	int i, j; //ѭ
+		tmpImg2 = *pTo;
+	}
 
-	//ɨͼģ
-	for(i=nTempMY; i<GetHeight() - (nTempH - nTempMY) + 1; i++)
+	// õ3ṹԪ
+	CImgProcess tmpImg3 = *this; //ݴһε
+	
+	while(true)
 	{
-		for(j=nTempMX; j<GetWidthPixel() - (nTempW - nTempMX) + 1; j++)
-		{
-			// (j,i)Ϊĵ
-			float fResult = 0;
-			for(int k=0; k<nTempH; k++)
-			{
-				for(int l=0; l<nTempW; l++)
-				{
-					//Ȩ
-					fResult += GetGray(j + l - nTempMX, i + k - nTempMY) * pfArray[k * nTempW + l];
-				}
-			}
-			
-			// ϵ
-			fResult *= fCoef;
-			
-			// ȡ
-			fResult = (FLOAT)fabs(fResult); //ʱпֵָܳ
-			
-			BYTE byte;
-			if(fResult > 255)
-				byte = 255;
-			else
-				byte = fResult + 0.5; //
-			
-			pTo->SetPixel(j, i, RGB(byte, byte, byte));
-		}//for j
-	}//for i
-}
+		tmpImg3.Erode(pTo, se3); //ȫΧĻлб任
+		*pTo = *pTo | tmpImg3;
+		
+		if(tmpImg3 == *pTo)
+			break; //㷨ֹ
+		
+		tmpImg3 = *pTo;
+	}
 
 
-/*******************
- int CImgProcess::GetMedianValue(int * pAryGray, int nFilterLen)
- 
- ܣðݷ򣬲Ԫصֵ
+	// õ4ṹԪ
+	CImgProcess tmpImg4 = *this; //ݴһε
+	
+	while(true)
+	{
+		tmpImg4.Erode(pTo, se4); //ȫΧĻлб任
+		*pTo = *pTo | tmpImg4;
+		
+		if(tmpImg4 == *pTo)
+			break; //㷨ֹ
+		
+		tmpImg4 = *pTo;
+	}
 
- :
-	int * pAryGrayҪȡֵ
-    int nFilterLen鳤
- 
- ֵ:
-    int ֵ
- 
-*******************/
 
-int CImgProcess::GetMedianValue(int * pAryGray, int nFilterLen)
-{
-	int i, j;	
-	int nMedianValue;
-	int nTemp; //м
+
+	// 4Ĳλѹִ
+	int nWords = GetPackedWords();
+	vector<uint64_t> vecRow(nWords), vecTmp(nWords);
+	vector<uint64_t> vecCols(nWords, 0); //ԭͼгֹ
 	
-	//
-	for (j=0; j < nFilterLen - 1; j++)
-	{
-		for (i=0; i < nFilterLen - j - 1; i++)
-		{
-			if (pAryGray[i] > pAryGray[i + 1])
-			{
-				// λ
-				nTemp = pAryGray[i];
-				pAryGray[i] = pAryGray[i + 1];
-				pAryGray[i + 1] = nTemp;
-			}//if
-		}//for i
-	}//for j
+	// Ҫ͹ǵ
 	
-	// ֵ
-	if ((nFilterLen & 1) > 0)
+	// ҵԭͼķΧСΣ
+	int nTop = nHeight;
+	int nBottom = 0;
+	for(i=0; i<nHeight; i++)
 	{
-		// ԪأмһԪ
-		nMedianValue = pAryGray[(nFilterLen + 1) / 2];
+		GetPackedRow(i, &vecTmp[0]);
+
+		uint64_t nAny = 0;
+		for(j=0; j<nWords; j++)
+		{
+			vecCols[j] |= vecTmp[j];
+			nAny |= vecTmp[j];
+		}
+
+		if(nAny)
+		{
+			if(i < nTop)
+				nTop = i;
+			if(i > nBottom)
+				nBottom = i;
+		}
 	}
-	else
+
+	int nLeft = nWidth;
+	int nRight = 0;
+	for(j=0; j<nWidth; j++)
 	{
-		// żԪأмԪƽֵ
-		nMedianValue = (pAryGray[nFilterLen / 2] + pAryGray[nFilterLen / 2 + 1]) / 2;
+		if( (vecCols[j >> 6] >> (63 - (j & 63))) & 1 )
+		{
+			if(j < nLeft)
+				nLeft = j;
+			nRight = j;
+		}
 	}
-	
-	// ֵ
-	return nMedianValue;
-}
-
 
+	// ηΧ
+	vector<uint64_t> vecMask(nWords, 0);
+	for(j=nLeft; j<=nRight; j++)
+		vecMask[j >> 6] |= (uint64_t)1 << (63 - (j & 63));
 
+	for(i=0; i<nHeight; i++)
+	{
+		tmpImg1.GetPackedRow(i, &vecRow[0]);
+		tmpImg2.GetPackedRow(i, &vecTmp[0]);
+		for(j=0; j<nWords; j++)
+			vecRow[j] |= vecTmp[j];
+		tmpImg3.GetPackedRow(i, &vecTmp[0]);
+		for(j=0; j<nWords; j++)
+			vecRow[j] |= vecTmp[j];
+		tmpImg4.GetPackedRow(i, &vecTmp[0]);
+		for(j=0; j<nWords; j++)
+			vecRow[j] |= vecTmp[j];
+
+		if(bConstrain)
+		{
+			if( (i<nTop) || (i>nBottom) )
+			{
+				for(j=0; j<nWords; j++)
+					vecRow[j] = 0;
+			}
+			else
+			{
+				for(j=0; j<nWords; j++)
+					vecRow[j] &= vecMask[j];
+			}
+		}//if(bConstrain)
 
-/*******************
-void CImgProcess::MedianFilter(CImgProcess *pTo, int nFilterH, int nFilterW, int nFilterMY, int nFilterMX)
+		pTo->SetPackedRow(i, &vecRow[0]);
+	}
 
-ܣֵ˲
+}
 
-עͻ罷нϺõЧ
+// GrayErodeGrayDilateддʱĲ
+struct SGrayMorphParam
+{
+	const CImg* pSrc;
+	CImg* pTo;
+	int nTempH, nTempW;
+	int nTempMY, nTempMX;
+	int** se;
+	BOOL bDilate;
+};
 
-:
-	CImgProcess* pToĿͼ CImgProcess ָ
-    int   nFilterH˲ĸ߶
-    int   nFilterW˲Ŀ
-    int   nFilterMX˲ԪY
-    int   nFilterMY˲ԪX
- 
-ֵ:
-     
-*******************/
-void CImgProcess::MedianFilter(CImgProcess *pTo, int nFilterH, int nFilterW, int nFilterMY, int nFilterMX)
+// ƽ̹ṹԪصĻҶȸʴȡСֵͣȡֵ[nBegin, nEnd)С
+// ԽṹԪصÿԪأӦƽƵԴͼȡСȡڲѭ
+// ֻдģȫͼڵأرĿͼԭֵ
+static void GrayMorphRows(int nBegin, int nEnd, LPVOID pParam)
 {
-	pTo->InitPixels(0); //ʼĿͼ
-	
-	int i, j, k, l;
+	const SGrayMorphParam& param = *(const SGrayMorphParam*)pParam;
+	int nTempH = param.nTempH, nTempW = param.nTempW;
+	int nTempMY = param.nTempMY, nTempMX = param.nTempMX;
 
-	int nHeight = GetHeight();
-	int nWidth = GetWidthPixel();
+	int i, j, k, l;
 
-	int nGray;
+	int nWidth = param.pSrc->GetWidthPixel();
+	int nStartX = nTempMX;
+	int nEndX = nWidth - nTempW + nTempMX + 1;
+	BOOL bGray8 = (param.pTo->GetFormat() == IMG_FMT_GRAY8);
 
-	int* pAryGray; //
-	pAryGray = new int[nFilterH * nFilterW];
+	vector<const BYTE*> vecRows(nTempH);
+	vector<BYTE> vecRowBuf((size_t)nTempH * nWidth); //8λͼĻҶл
+	vector<BYTE> vecDest(nWidth);
 
-	// ɨͼ񣬽ֵ˲	
-	for(i = nFilterMY; i < nHeight - nFilterH + nFilterMY + 1; i++)// (ȥԵ)
+	for(i=nBegin; i<nEnd; i++)
 	{
-		for(j = nFilterMX; j < nWidth - nFilterW + nFilterMX + 1; j++)// (ȥԵ)
+		for(k=0; k<nTempH; k++)
+			vecRows[k] = param.pSrc->GetGrayRow(i - nTempMY + k, &vecRowBuf[(size_t)k * nWidth]);
+
+		BYTE* pDest = &vecDest[0];
+		memset(pDest + nStartX, param.bDilate ? 0 : 255, nEndX - nStartX);
+		for(k=0; k<nTempH; k++)
 		{
-			// ȡ˲
-			for (k = 0; k < nFilterH; k++)
+			for(l=0; l<nTempW; l++)
 			{
-				for (l = 0; l < nFilterW; l++)
+				if( param.se[k][l] != 1 )
+					continue;
+
+				// ͼi - nTempMY + kУԵl - nTempMX
+				const BYTE* pIn = vecRows[k] + l - nTempMX;
+				if(param.bDilate)
 				{
-					//ԭͼi + k - nFilterMYУj + l - nFilterMXеֵ
-					nGray = GetGray(j + l - nFilterMX, i + k -nFilterMY);					
-					
-					// ֵ
-					pAryGray[k * nFilterW + l] = nGray;
-				}//l
-			}//k
-			
-			nGray = GetMedianValue(pAryGray, nFilterH * nFilterW); //ͨȡֵ
-	
-			pTo->SetPixel(j, i, RGB(nGray, nGray, nGray)); //ֵΪӦ			
-		}//j
-	}//i
+					for(j=nStartX; j<nEndX; j++)
+						pDest[j] = pIn[j] > pDest[j] ? pIn[j] : pDest[j];
+				}
+				else
+				{
+					for(j=nStartX; j<nEndX; j++)
+						pDest[j] = pIn[j] < pDest[j] ? pIn[j] : pDest[j];
+				}
+			}//l
+		}//k
 
-	delete [] pAryGray;
+		if(bGray8)
+			memcpy(param.pTo->GetRow(i) + nStartX, pDest + nStartX, nEndX - nStartX);
+		else
+		{
+			for(j=nStartX; j<nEndX; j++)
+				param.pTo->SetPixel(j, i, RGB(pDest[j], pDest[j], pDest[j]));
+		}
+	}//for i
 }
 
+#define GRAY_MORPH_RECT_MIN	32	// νṹԪزڴԪʱvan Herk/Gil-Werman㷨СԪرȽϸ
 
+// ȡСʴȡͣΪRectMorphRowsģ
+struct SPickMin
+{
+	static inline BYTE Pick(BYTE a, BYTE b) { return a < b ? a : b; }
+};
 
-/*******************
-void CImgProcess::AdaptiveMedianFilter(CImgProcess *pTo, int nFilterH, int nFilterW, int nFilterMY, int nFilterMX)
+struct SPickMax
+{
+	static inline BYTE Pick(BYTE a, BYTE b) { return a > b ? a : b; }
+};
 
-ܣĽֵ˲
+// ṹԪΪ1ԪǷǡùһΣСе߶Σ
+// 򷵻ؾϽģеС(nRectY, nRectX)ߡ
+static BOOL GetFlatRect(int nTempH, int nTempW, int** se, int& nRectY, int& nRectX, int& nRectH, int& nRectW)
+{
+	int nTop = nTempH, nBottom = -1, nLeft = nTempW, nRight = -1;
+	int nOnes = 0;
+	for(int k=0; k<nTempH; k++)
+	{
+		for(int l=0; l<nTempW; l++)
+		{
+			if( se[k][l] != 1 )
+				continue;
+			nOnes++;
+			nTop = min(nTop, k);
+			nBottom = max(nBottom, k);
+			nLeft = min(nLeft, l);
+			nRight = max(nRight, l);
+		}
+	}
+	if(nOnes == 0)
+		return FALSE;
+
+	nRectY = nTop;
+	nRectX = nLeft;
+	nRectH = nBottom - nTop + 1;
+	nRectW = nRight - nLeft + 1;
+	return nOnes == nRectH * nRectW;
+}
 
-עڱ׼ֵ˲ĻϣÿһʱжϸǷ˲صļ߼Сֵ
-	ǣֵ˲أǣ账
+// һάvan Herk/Gil-WermanpOut[q]ΪpIn[q]pIn[q + nLen - 1]еСֵq = 0nCount-1
+// pInnLenһΣǰ׺pG׺pSһαȽϣÿٱȽһΣnLen޹
+template <class TPick>
+static void RunPick(BYTE* pOut, const BYTE* pIn, int nCount, int nLen, BYTE* pG, BYTE* pS)
+{
+	int i;
+	int n = nCount + nLen - 1;
 
-:
-	CImgProcess* pToĿͼ CImgProcess ָ
-    int   nFilterH˲ĸ߶
-    int   nFilterW˲Ŀ
-    int   nFilterMX˲ԪY
-    int   nFilterMY˲ԪX
- 
-ֵ:
-     
-*******************/
-void CImgProcess::AdaptiveMedianFilter(CImgProcess *pTo, int nFilterH, int nFilterW, int nFilterMY, int nFilterMX)
+	if(nLen == 1)
+	{
+		memcpy(pOut, pIn, nCount);
+		return;
+	}
+
+	for(int b=0; b<n; b+=nLen)
+	{
+		int e = min(b + nLen, n) - 1; //һԪ
+
+		pG[b] = pIn[b];
+		for(i=b+1; i<=e; i++)
+			pG[i] = TPick::Pick(pG[i - 1], pIn[i]);
+
+		pS[e] = pIn[e];
+		for(i=e-1; i>=b; i--)
+			pS[i] = TPick::Pick(pS[i + 1], pIn[i]);
+	}
+
+	for(i=0; i<nCount; i++)
+		pOut[i] = TPick::Pick(pS[i], pG[i + nLen - 1]);
+}
+
+// νṹԪصĻҶȸʴͣ[nBegin, nEnd)СοɷֽΪСһά㣺
+// ȶÿԴͼзvan Herk/Gil-WermanзnRectHΪһΣ
+// ڵĺ׺һεǰ׺ÿȡСһεõ
+// зебȽϣڲѭÿصıȽϴδС޹
+struct SRectMorphParam
 {
-	pTo->InitPixels(0); //ʼĿͼ
-	
-	int i, j, k, l;
+	const SGrayMorphParam* pMorph;
+	int nRectY, nRectX;
+	int nRectH, nRectW;
+};
 
-	int nHeight = GetHeight();
-	int nWidth = GetWidthPixel();
+template <class TPick>
+static void RectMorphRows(int nBegin, int nEnd, LPVOID pParam)
+{
+	const SRectMorphParam& rect = *(const SRectMorphParam*)pParam;
+	const SGrayMorphParam& param = *rect.pMorph;
+	int nRectH = rect.nRectH;
 
-	int nGray;
+	int j, t;
+
+	int nWidth = param.pSrc->GetWidthPixel();
+	int nStartX = param.nTempMX;
+	int nCount = nWidth - param.nTempW + 1;		//
+	int nInX = nStartX - param.nTempMX + rect.nRectX;	//з
+	int nLen = nCount + rect.nRectW - 1;
+	BOOL bGray8 = (param.pTo->GetFormat() == IMG_FMT_GRAY8);
+
+	int nOut = nEnd - nBegin;
+	int nRows = nOut + nRectH - 1;	//ҪԴͼ
+	int y0 = nBegin - param.nTempMY + rect.nRectY;	//һԴͼ
 
-	int* pAryGray; //
-	pAryGray = new int[nFilterH * nFilterW];
+	vector<BYTE> vecRowBuf(nWidth);
+	vector<BYTE> vecG(nLen), vecS(nLen);
+	// ǰΡһθnRectHезԼһεǰ׺
+	vector<BYTE> vecCur((size_t)nRectH * nCount), vecNext((size_t)nRectH * nCount), vecPrefix((size_t)nRectH * nCount);
+	vector<BYTE> vecDest(nCount);
 
-	// ɨͼ񣬽ֵ˲	
-	for(i = nFilterMY; i < nHeight - nFilterH + nFilterMY + 1; i++)// (ȥԵ)
+	for(t=0; t<nRectH; t++)
 	{
-		for(j = nFilterMX; j < nWidth - nFilterW + nFilterMX + 1; j++)// (ȥԵ)
+		const BYTE* pSrc = param.pSrc->GetGrayRow(y0 + t, &vecRowBuf[0]) + nInX;
+		RunPick<TPick>(&vecCur[(size_t)t * nCount], pSrc, nCount, rect.nRectW, &vecG[0], &vecS[0]);
+	}
+
+	for(int b=0; b<nOut; b+=nRectH)
+	{
+		int nT = min(nRectH, nOut - b);		//ε
+		int nM = min(nRectH, nRows - b - nRectH);	//һе
+
+		// ǰεĺ׺͵ؼ
+		for(t=nRectH-2; t>=0; t--)
 		{
-			// ȡ˲
-			for (k = 0; k < nFilterH; k++)
+			BYTE* pRow = &vecCur[(size_t)t * nCount];
+			const BYTE* pBelow = pRow + nCount;
+			for(j=0; j<nCount; j++)
+				pRow[j] = TPick::Pick(pRow[j], pBelow[j]);
+		}
+
+		// һεзǰ׺
+		for(t=0; t<nM; t++)
+		{
+			BYTE* pRow = &vecNext[(size_t)t * nCount];
+			const BYTE* pSrc = param.pSrc->GetGrayRow(y0 + b + nRectH + t, &vecRowBuf[0]) + nInX;
+			RunPick<TPick>(pRow, pSrc, nCount, rect.nRectW, &vecG[0], &vecS[0]);
+
+			BYTE* pPrefix = &vecPrefix[(size_t)t * nCount];
+			if(t == 0)
+				memcpy(pPrefix, pRow, nCount);
+			else
 			{
-				for (l = 0; l < nFilterW; l++)
-				{
-					//ԭͼi + k - nFilterMYУj + l - nFilterMXеֵ
-					nGray = GetGray(j + l - nFilterMX, i + k -nFilterMY);					
-					
-					// ֵ
-					pAryGray[k * nFilterW + l] = nGray;
-				}//l
-			}//k
-			
-			nGray = GetMedianValue(pAryGray, nFilterH * nFilterW); //ͨȡֵ
-	
-			//жϵǰǷļСֵ
-			if( (GetGray(j, i) == pAryGray[0]) || (GetGray(j, i) == pAryGray[nFilterH * nFilterW - 1]) )
-				pTo->SetPixel(j, i, RGB(nGray, nGray, nGray)); //ֵΪӦ
+				const BYTE* pAbove = pPrefix - nCount;
+				for(j=0; j<nCount; j++)
+					pPrefix[j] = TPick::Pick(pAbove[j], pRow[j]);
+			}
+		}
+
+		// b + t = ǰεtĺ׺һǰtеǰ׺
+		for(t=0; t<nT; t++)
+		{
+			const BYTE* pSuffix = &vecCur[(size_t)t * nCount];
+			BYTE* pDest = bGray8 ? param.pTo->GetRow(nBegin + b + t) + nStartX : &vecDest[0];
+			if(t == 0)
+				memcpy(pDest, pSuffix, nCount);
 			else
-				pTo->SetPixel(j, i, GetGray(j, i)); //Ǽֵ򲻸ıԭͼֵ
-		}//j
-	}//i
+			{
+				const BYTE* pPrefix = &vecPrefix[(size_t)(t - 1) * nCount];
+				for(j=0; j<nCount; j++)
+					pDest[j] = TPick::Pick(pSuffix[j], pPrefix[j]);
+			}
+
+			if(!bGray8)
+			{
+				for(j=0; j<nCount; j++)
+					param.pTo->SetPixel(nStartX + j, nBegin + b + t, RGB(pDest[j], pDest[j], pDest[j]));
+			}
+		}
 
-	delete [] pAryGray;
+		vecCur.swap(vecNext);
+	}
 }
 
-/******************* 
-void CImgProcess::FilterSobel(CImgProcess *pTo)
- ܣ
-	Sobelݶ
- 
- 
-	ImgProcess* pTo: Ŀͼ CImgProcess ָ
-		 
- ֵ
-		
-*******************/
-void CImgProcess::FilterSobel(CImgProcess *pTo)
+static void GrayMorph(const CImg& imgSrc, CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se, BOOL bDilate)
 {
-	CImgProcess img1, img2;
-	img1 = *pTo;
-	img2 = *pTo;
+	int nHeight = imgSrc.GetHeight();
+	int nWidth = imgSrc.GetWidthPixel();
+	if(nWidth - nTempW + nTempMX + 1 <= nTempMX)
+		return;
 
-	Template(&img1, 3, 3, 1, 1, Template_HSobel, 1);
-	Template(&img2, 3, 3, 1, 1, Template_VSobel, 1);
+	pTo->MakeUnique(); //ֻ߳дԵ
 
-	*pTo = img1 + img2;
-}
+	SGrayMorphParam param = {&imgSrc, pTo, nTempH, nTempW, nTempMY, nTempMX, se, bDilate};
+
+	// Σ߶ΣṹԪؽϴʱvan Herk/Gil-Werman㷨ÿرȽϴС޹
+	SRectMorphParam rect = {&param, 0, 0, 0, 0};
+	if(GetFlatRect(nTempH, nTempW, se, rect.nRectY, rect.nRectX, rect.nRectH, rect.nRectW)
+		&& rect.nRectH * rect.nRectW >= GRAY_MORPH_RECT_MIN)
+	{
+		CImgParallel::For(nTempMY, nHeight - nTempH + nTempMY + 1,
+			bDilate ? RectMorphRows<SPickMax> : RectMorphRows<SPickMin>, &rect, 0, max(16, 2 * rect.nRectH));
+		return;
+	}
 
+	CImgParallel::For(nTempMY, nHeight - nTempH + nTempMY + 1, GrayMorphRows, &param);
+}
 
 /*******************
-void CImgProcess::EnhanceFilter(CImgProcess *pTo, double dProportion,
-						 int nTempH, int nTempW, 
-						 int nTempMY, int nTempMX, FLOAT *pfArray, FLOAT fCoef)
+void CImgProcess::GrayDilate(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se)
+ܣҶͼ
 
-ܣ˲
+עֻƽ̹ĽṹԪءд̴߳
+	ṹԪΪϴľλ߶ʱvan Herk/Gil-Werman㷨ÿص
+	ȽϴṹԪشС޹
 
 
-	CImgProcess* pToͼ CImgProcess ָ
-	double dProportion˲ԭͼĻϱ
+	CImgProcess* pToĿͼ CImgProcess ָ
 	int   nTempHģĸ߶
 	int   nTempW ģĿ
-	int   nTempMYģԪY ( < iTempH - 1)
-	int   nTempMXģԪX ( < iTempW - 1)
-	FLOAT * fpArrayָģָ
-	FLOAT fCoefģϵ
-
+	int   nTempMYģԪY ( <= iTempH - 1)
+	int   nTempMXģԪX ( <= iTempW - 1)
+	int** seṹԪ
 ֵ:
 	
 *******************/
-void CImgProcess::EnhanceFilter(CImgProcess *pTo, double dProportion,
-						 int nTempH, int nTempW, 
-						 int nTempMY, int nTempMX, FLOAT *pfArray, FLOAT fCoef)
+void CImgProcess::GrayDilate(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se)
 {
-	int i, j;
-	int nHeight = GetHeight();
-	int nWidth = GetWidthPixel();
+	GrayMorph(*this, pTo, nTempH, nTempW, nTempMY, nTempMX, se, TRUE);
+}
 
-	*pTo = *this; //Ŀͼʼ
 
-	//GrayMatݴ水ͼ񣨲CImgֱӽӣΪӵĽܳΧ[0,255]
-	vector< vector<int> > GrayMat;
-	vector<int> vecRow(nWidth, 0); //GrayMatеһУʼΪ0
-	for(i=0; i<nHeight; i++)
+
+/*******************
+void CImgProcess::GrayErode(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se)
+ܣҶͼʴ
+
+עֻƽ̹ĽṹԪءд̴߳
+	ṹԪΪϴľλ߶ʱvan Herk/Gil-Werman㷨ÿص
+	ȽϴṹԪشС޹
+
+
+	CImgProcess* pToĿͼ CImgProcess ָ
+	int   nTempHģĸ߶
+	int   nTempWģĿ
+	int   nTempMYģԪY ( <= iTempH - 1)
+	int   nTempMXģԪX ( <= iTempW - 1)
+	int **seṹԪ
+ֵ:
+	
+*******************/
+void CImgProcess::GrayErode(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se)
+{
+	GrayMorph(*this, pTo, nTempH, nTempW, nTempMY, nTempMX, se, FALSE);
+}
+
+
+/*******************
+void CImgProcess::GrayOpen(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se, int nTileMode)
+ܣҶȿ
+
+עֻƽ̹ĽṹԪءͼϴʱдִֿУProcessTiled
+	ͬ
+
+
+	CImgProcess* pToĿͼ CImgProcess ָ
+	int   nTempHģĸ߶
+	int   nTempWģĿ
+	int   nTempMYģԪY ( <= iTempH - 1)
+	int   nTempMXģԪX ( <= iTempW - 1)
+	int **seṹԪ
+	int nTileModeִֿģʽIMG_TILE_*
+ֵ:
+	
+*******************/
+void CImgProcess::GrayOpen(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se, int nTileMode)
+{
+	//ÿϡ¸չģİ뾶
+	int nHalo = 2 * max(nTempMY, nTempH - 1 - nTempMY);
+	if(UseTiles(*this, nTileMode, nHalo))
 	{
-		GrayMat.push_back(vecRow);
+		SMorphChainParam param = {MORPH_CHAIN_GRAYOPEN, NULL, nTempH, nTempW, nTempMY, nTempMX, se};
+		ProcessTiled(pTo, nHalo, MorphChainBand, &param);
+		return;
 	}
 
-	//ͼӦԭͼ񰴱			
-	for(i=nTempMY; i<GetHeight() - (nTempH - nTempMY) + 1; i++)
-	{
-		for(j=nTempMX; j<GetWidthPixel() - (nTempW - nTempMX) + 1; j++)
-		{
-			// (j,i)Ϊĵ
-			float fResult = 0;
-			for(int k=0; k<nTempH; k++)
-			{
-				for(int l=0; l<nTempW; l++)
-				{
-					//Ȩ
-					fResult += GetGray(j + l - nTempMX, i + k - nTempMY) * pfArray[k * nTempW + l];
-				}
-			}
-			
-			// ϵ
-			fResult *= fCoef;
-
-			//ӦֵΧ
-			if(fResult > 255)
-				fResult = 255;
-			if(fResult < -255)
-				fResult = -255;
-			
-			GrayMat[i][j] = dProportion * GetGray(j, i) + fResult + 0.5;//ͣ
-		}//for j
-	}//for i
-	
-	
-	
-	int nMax = 0;//ҶȺֵ
-	int nMin = 65535; //СҶȺֵ
+	pTo->InitPixels(255);
 
-	//ͳСֵ
-	for(i=nTempMY; i<GetHeight() - (nTempH - nTempMY) + 1; i++)
-	{
-		for(j=nTempMX; j<GetWidthPixel() - (nTempW - nTempMX) + 1; j++)
-		{
-			if( GrayMat[i][j] > nMax)
-				nMax = GrayMat[i][j];
-			if( GrayMat[i][j] < nMin)
-				nMin = GrayMat[i][j];
-		}// j
-	}// i
+	GrayErode(pTo, nTempH, nTempW, nTempMY, nTempMX, se);
+
+	CImgProcess tmpImg = *pTo; //ݴ港ʴͼ
+
+	tmpImg.GrayDilate(pTo, nTempH, nTempW, nTempMY, nTempMX, se);	
+}
+
+/*******************
+void CImgProcess::GrayClose(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se, int nTileMode)
+ܣҶȿ
 
-	//GrayMatȡֵΧ¹һ[0, 255]
-	int nSpan = nMax - nMin;
+עֻƽ̹ĽṹԪءͼϴʱдִֿУProcessTiled
+	ͬ
 
-	for(i=nTempMY; i<GetHeight() - (nTempH - nTempMY) + 1; i++)
+
+	CImgProcess* pToĿͼ CImgProcess ָ
+	int   nTempHģĸ߶
+	int   nTempWģĿ
+	int   nTempMYģԪY ( <= iTempH - 1)
+	int   nTempMXģԪX ( <= iTempW - 1)
+	int **seṹԪ
+	int nTileModeִֿģʽIMG_TILE_*
+ֵ:
+	
+*******************/
+void CImgProcess::GrayClose(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se, int nTileMode)
+{
+	//ÿϡ¸չģİ뾶
+	int nHalo = 2 * max(nTempMY, nTempH - 1 - nTempMY);
+	if(UseTiles(*this, nTileMode, nHalo))
 	{
-		for(j=nTempMX; j<GetWidthPixel() - (nTempW - nTempMX) + 1; j++)
-		{
-			BYTE bt;
-			if(nSpan > 0)
-				bt = (GrayMat[i][j] - nMin)*255/nSpan;
-			else if(GrayMat[i][j] <= 255)
-				bt = GrayMat[i][j] ;
-			else
-				bt = 255;
-				
-				pTo->SetPixel(j, i, RGB(bt, bt, bt));			
+		SMorphChainParam param = {MORPH_CHAIN_GRAYCLOSE, NULL, nTempH, nTempW, nTempMY, nTempMX, se};
+		ProcessTiled(pTo, nHalo, MorphChainBand, &param);
+		return;
+	}
 
-		}// for j
-	}// for i
-}
+	pTo->InitPixels(255);
 
+	GrayDilate(pTo, nTempH, nTempW, nTempMY, nTempMX, se);
 
+	CImgProcess tmpImg = *pTo; //ݴͼ
 
+	tmpImg.GrayErode(pTo, nTempH, nTempW, nTempMY, nTempMX, se);	
+}
 
 
 
-/**************************************************
-int CImgProcess::DetectThreshold(int nMaxIter, int &nDiffRet)
 
-ܣ
-	õԶȷֵ
 
-
-	int nMaxIter
-	int &nDiffRet	ʹøֵȷĵ밵ƽҶȵĲֵ
-ֵ
-	intͣ㷨ȷֵ
-***************************************************/
 
-int CImgProcess::DetectThreshold(int nMaxIter, int &nDiffRet)
+// ñ任ԭͼȥͼ񣬰ȫͼֵСֵһ
+// 0255CImg::operator -ĽֵͬΧдpTo
+struct STophatParam
 {
-	int nThreshold;
-	
-	nDiffRet = 0;
-	
-	// ֱͼ
-	int nHistogram[256] = { 0 };
-	int i, j;
-	
-	BYTE bt;
+	const CImg* pSrc;
+	CImgProcess* pTo;		// Ϊñ任
+	std::mutex mtx;
+	int nMin, nMax;			// ֵΧmtx
 
-	int nMin = 255;
-	int nMax = 0;
+	STophatParam(const CImg* pImgSrc, CImgProcess* pImgTo) : pSrc(pImgSrc), pTo(pImgTo), nMin(255), nMax(-255) {}
+};
 
-	// ɨͼ,СҶȺֱͼ
-	for(j = 0; j < GetHeight(); j ++)
+static void TophatRangeRows(int nBegin, int nEnd, LPVOID pParam)
+{
+	STophatParam& param = *(STophatParam*)pParam;
+	int nWidth = param.pSrc->GetWidthPixel();
+
+	int nMin = 255, nMax = -255;
+	for(int i=nBegin; i<nEnd; i++)
 	{
-		for(i=0; i<GetWidthPixel(); i++)
+		const BYTE* pSrc = param.pSrc->GetConstRow(i);
+		const BYTE* pOpen = param.pTo->GetConstRow(i);
+		for(int j=0; j<nWidth; j++)
 		{
-			bt = GetGray(i, j);
-			
-			if(bt < nMin)
-				nMin = bt;
-			if(bt > nMax)
-				nMax = bt;
-			
-			nHistogram[bt] ++;
-			
+			int nDiff = pSrc[j] - pOpen[j];
+			nMin = min(nMin, nDiff);
+			nMax = max(nMax, nDiff);
 		}
 	}
-	
-	int nTotalGray = 0; //Ҷֵĺ
-	int nTotalPixel = 0; //ĺ
-	int nNewThreshold = (nMax + nMin)/2; //ʼֵ
-	
-	nDiffRet = nMax - nMin;
-
-	if (nMax == nMin)
-		nThreshold = nNewThreshold;
 
-	else
-	{
-		nThreshold = 0;
-		
-		// ʼ,ֱﵽ100ֵһֵõֵȣ
-		for(int nIterationTimes = 0; nThreshold != nNewThreshold && nIterationTimes < nMaxIter; nIterationTimes ++)
-		{
-			nThreshold = nNewThreshold;
-			nTotalGray = 0;
-			nTotalPixel = 0;
+	std::lock_guard<std::mutex> lock(param.mtx);
+	param.nMin = min(param.nMin, nMin);
+	param.nMax = max(param.nMax, nMax);
+}
 
-			//ͼСڵǰֵֵƽҶ
-			for(i=nMin; i<nThreshold; i++)
-			{
-				nTotalGray += nHistogram[i]*i;
-				nTotalPixel += nHistogram[i];
-			}
-			int nMean1GrayValue = nTotalGray/nTotalPixel;
+static void TophatDiffRows(int nBegin, int nEnd, LPVOID pParam)
+{
+	STophatParam& param = *(STophatParam*)pParam;
+	int nWidth = param.pSrc->GetWidthPixel();
+	int nSpan = param.nMax - param.nMin;
 
+	//ֵ-255255Ĳұֵͬʱǲֵ
+	BYTE bLut[511];
+	for(int d=-255; d<=255; d++)
+		bLut[d + 255] = (BYTE)(nSpan > 0 ? (d - param.nMin) * 255 / nSpan : d);
 
-			nTotalGray = 0;
-			nTotalPixel = 0;
-			
-			//ͼдڵǰֵֵƽҶ
-			for(i=nThreshold + 1; i<=nMax; i++)
-			{
-				nTotalGray += nHistogram[i]*i;
-				nTotalPixel += nHistogram[i];
-			}
-			int nMean2GrayValue = nTotalGray/nTotalPixel;
-			
-			nNewThreshold = (nMean1GrayValue + nMean2GrayValue)/2; //µֵ
-			nDiffRet = abs(nMean1GrayValue - nMean2GrayValue);
-		}
+	for(int i=nBegin; i<nEnd; i++)
+	{
+		const BYTE* pSrc = param.pSrc->GetConstRow(i);
+		BYTE* pOut = param.pTo->GetRow(i);
+		for(int j=0; j<nWidth; j++)
+			pOut[j] = bLut[pSrc[j] - pOut[j] + 255];
 	}
-	
-	return nThreshold;
 }
 
-/**************************************************
-void CImgProcess::Threshold(CImgProcess *pTo, BYTE bThre)
+/*******************
+void CImgProcess::Tophat(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se, int nTileMode)
+ܣñ任
 
-ܣ
-	ͼֵ任
-ƣ
-	ֻܴҶͼ
+עֻƽ̹ĽṹԪءͼϴʱ㰴дִֿУProcessTiled
+	ͬ
 
 
-	CImgProcess * pTo
-		CImgProcessָ
-	BYTE bThre
-		õĻ׼ֵ
-ֵ
+	CImgProcess* pToĿͼ CImgProcess ָ
+	int   nTempHģĸ߶
+	int   nTempWģĿ
+	int   nTempMYģԪY ( <= iTempH - 1)
+	int   nTempMXģԪX ( <= iTempW - 1)
+	int **seṹԪ
+	int nTileModeִֿģʽIMG_TILE_*
+ֵ:
 	
-***************************************************/
-
-void CImgProcess::Threshold(CImgProcess *pTo, BYTE bThre)
+*******************/
+void CImgProcess::Tophat(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se, int nTileMode)
 {
-	int i, j;
-	BYTE bt;
-	for(j = 0; j < m_pBMIH->biHeight; j ++)
+	GrayOpen(pTo, nTempH, nTempW, nTempMY, nTempMX, se, nTileMode); //Ҷȿ
+
+	if(GetFormat() != IMG_FMT_GRAY8 || pTo->GetFormat() != IMG_FMT_GRAY8)
 	{
-		for(i=0; i<m_pBMIH->biWidth; i++)
-		{
-			bt = GetGray(i, j);
-			if(bt<bThre)
-				bt = 0;
-			else
-				bt = 255;
-			
-			pTo->SetPixel(i, j, RGB(bt, bt, bt));
-		}
+		*pTo = (*this) - (*pTo); //ñ任ԭͼȥͼ
+		return;
 	}
+
+	//8λͼҪĲֵ
+	pTo->MakeUnique();
+	STophatParam param(this, pTo);
+	CImgParallel::For(0, GetHeight(), TophatRangeRows, &param);
+	CImgParallel::For(0, GetHeight(), TophatDiffRows, &param);
 }
 
 
+/*******************
+void CImgProcess::Template(CImgProcess *pTo, 
+						 int nTempH, int nTempW, 
+						 int nTempMY, int nTempMX, FLOAT *pfArray, FLOAT fCoef)
+
+ܣģ
+
+עúָģ壨СͼвiTempHָģ
+	ĸ߶ȣiTempWָģĿȣiTempMXiTempMYָģ
+	Ԫ꣬fpArrayָģԪأfCoefָϵ
 
+
+	CImgProcess* pToͼ CImgProcess ָ
+	int   nTempHģĸ߶
+	int   nTempW ģĿ
+	int   nTempMYģԪY ( <= iTempH - 1)
+	int   nTempMXģԪX ( <= iTempW - 1)
+	FLOAT * fpArrayָģָ
+	FLOAT fCoefģϵ
 
+	ԴͼΪ16λ򸡵ͼʱԭֵ㣻ͼΪͼʱ
+	ź;ȣLoGӦΪ16λͼʱȡֵضϵ065535
+	ʽԭһȡֵضϵ0255
 
+	ȨCImgConv㣺ɷģ壨˹ֵȣкз
+	һάģֱӶάڲѭCPUʹAVX2SSE4.1
+	д̴߳
 
+ֵ:
+	
+*******************/
 
-struct SMaxValue
+// TemplateддʱĲ
+struct STemplateParam
 {
-	int nValue;
-	int nDist;
-	int nAngle;
+	const CImg* pSrc;
+	CImg* pTo;
+	int nTempH, nTempW;
+	int nTempMY, nTempMX;
+	const FLOAT* pfArray;
+	FLOAT fCoef;
 };
 
+// ģ[nBegin, nEnd)УÿдԼľ棬дпʼ
+static void TemplateRows(int nBegin, int nEnd, LPVOID pParam)
+{
+	const STemplateParam& param = *(const STemplateParam*)pParam;
 
+	int i, j; //ѭ
 
-/******************* 
-void CImgProcessProcessing::TraceBoundary(CImgProcess* pTo)
- 
- ܣ
-	ٶֵͼеһҵı߽
- ע
-	ֻܴ2ֵͼ
+	int nWidth = param.pSrc->GetWidthPixel();
 
- 
-	CImgProcess* pTo: Ŀͼ CImgProcess ָ
-	 
- ֵ
-	
-	
-*******************/
-void CImgProcess::TraceBoundary(CImgProcess *pTo)
-{
-	pTo->InitPixels(255);//Ŀͼ
+	int nStartX = param.nTempMX; //ʼ
+	int nEndX = nWidth - (param.nTempW - param.nTempMX) + 1; //ĽУ
 
-	int nHeight = GetHeight();
-	int nWidth = GetWidthPixel();
-	
-	
-	//ѭ
-	int i;
-	int j;
-
-		
-	//ʼ߽뵱ǰ߽
-	POINT ptStart;
-	POINT ptCur;
+	int nDestFormat = param.pTo->GetFormat();
+	BOOL bFloatDest = (nDestFormat == IMG_FMT_GRAY16 || nDestFormat == IMG_FMT_FLOAT32);
 
-	//飬{£££ңϣϣϣ}
-	int Direction[8][2]={ {-1,1}, {0,1}, {1,1}, {1,0}, {1,-1}, {0,-1}, {-1,-1}, {-1,0} }; 
-	
-
-	int nCurDirect = 0; //ǰ̽鷽
-
-	int xPos;
-	int yPos;
+	vector<BYTE> vecDest(nWidth, 0); //ǰУԵΪ0
+	vector<float> vecFDest(bFloatDest ? nWidth : 0, 0.0f); //߾
 
-	BOOL bAtStartPt; //Ϊtrueʾ̽ոʱʼΪptCur == ptStartһֿʼһֽ
+	//ɷģֽΪСһάȨľи
+	CImgConv conv(param.pfArray, param.nTempH, param.nTempW, param.nTempMY, param.nTempMX);
+	conv.Begin(*param.pSrc, nBegin);
 
-	//㷨߽ϵĵ㣬ͼܵһȦ߽ð
-	for(i=0; i<nHeight; i++)
-	{
-		SetPixel(0, i, RGB(255, 255, 255));
-		SetPixel(nWidth-1, i, RGB(255, 255, 255));
-	}
-	for(j=0; j<nWidth; j++)
+	for(i=nBegin; i<nEnd; i++)
 	{
-		SetPixel(j, 0, RGB(255, 255, 255));
-		SetPixel(j, nHeight-1, RGB(255, 255, 255));
-	}
+		const float* pSum = conv.Next();
 
-	//ɨ
-	for(i=0; i<nHeight; i++)
-	{
-		for(j=0; j<nWidth; j++)
+		if(bFloatDest)
 		{
-			if(GetGray(j, i) == 0)//ҵϵĵһ߽
+			// ߾ͼţ16λͼȡֵSetFloatRowض
+			for(j=nStartX; j<nEndX; j++)
 			{
-				ptStart.x = j;
-				ptStart.y = i;
+				float fResult = pSum[j] * param.fCoef;
+				vecFDest[j] = (nDestFormat == IMG_FMT_FLOAT32) ? fResult : (FLOAT)fabs(fResult);
+			}
+			param.pTo->SetFloatRow(i, &vecFDest[0]);
+			continue;
+		}
 
-				ptCur = ptStart;
-				bAtStartPt = true;				
-				while(	( (ptCur.x != ptStart.x) || (ptCur.y != ptStart.y) )	|| bAtStartPt	)
-				{
-					bAtStartPt = false;
+		// ϵȡʱпֵָܳضϵ255
+		CImgConv::SumToGray(&vecDest[nStartX], pSum + nStartX, param.fCoef, nEndX - nStartX);
 
-					//һ̽λ
-					xPos = ptCur.x + Direction[nCurDirect][0];
-					yPos = ptCur.y + Direction[nCurDirect][1];
-					int nSearchTimes = 1;
+		param.pTo->SetGrayRow(i, &vecDest[0]);
+	}//for i
+}
 
-					while( GetGray(xPos, yPos) == 255 )
-					{
-						nCurDirect ++; //ʱת45
-						if(nCurDirect >= 8)
-							nCurDirect -= 8;
+void CImgProcess::Template(CImgProcess *pTo, 
+						 int nTempH, int nTempW, 
+						 int nTempMY, int nTempMX, FLOAT *pfArray, FLOAT fCoef)
+{
+	pTo->InitPixels(0); //Ŀͼʼֻ߳дԵ
+	
+	int nHeight = GetHeight();
+	int nWidth = GetWidthPixel();
 
-						xPos = ptCur.x + Direction[nCurDirect][0];
-						yPos = ptCur.y + Direction[nCurDirect][1];
+	if(nWidth - (nTempW - nTempMX) + 1 <= nTempMX) //û
+		return;
 
-						if( ++nSearchTimes >= 8 ) //8жûб߽㣬˵ǹ
-						{
-							xPos = ptCur.x;
-							yPos = ptCur.y;
-							break;
-						}
-					}
-									
-					//ҵһ߽
-					ptCur.x = xPos;
-					ptCur.y = yPos;
-					pTo->SetPixel(ptCur.x, ptCur.y, RGB(0, 0, 0)); //ͼϱǱ߽
-					/************
-					ڴ˴ʵĴ룬Ҫμ¼±߽ptCur
-					************/
+	STemplateParam param = {this, pTo, nTempH, nTempW, nTempMY, nTempMX, pfArray, fCoef};
+	CImgParallel::For(nTempMY, nHeight - (nTempH - nTempMY) + 1, TemplateRows, &param);
+}
 
-					nCurDirect -= 2; //ǰ̽鷽˳ʱת90Ϊһε̽ʼ
-					if(nCurDirect < 0)
-						nCurDirect += 8;
-				}
-				return;
-			}// if
-			
-			/************
-			ڴ˴ʵĴ룬ȥreturn䣬Ҫͼı߽硣
-			************/
 
-		}// for j
-	}// for i
-	
-}
+// ȡyеֵ߾ͼΪԭֵʽΪҶȡ
+// vecGrayvecValueΪṩл壬صָ´εǰЧ
+static const float* ReadValueRow(const CImg& img, int y, vector<BYTE>& vecGray, vector<float>& vecValue)
+{
+	if(img.IsHighPrecision())
+		return img.GetFloatRow(y, &vecValue[0]);
 
+	const BYTE* pGray = img.GetGrayRow(y, &vecGray[0]);
+	for(size_t j=0; j<vecValue.size(); j++)
+		vecValue[j] = pGray[j];
+	return &vecValue[0];
+}
 
+// BoxFilterȡԴͼһ
+static inline const BYTE* GetBoxRow(const CImg& img, int y, BYTE* pBuf)
+{
+	return img.GetGrayRow(y, pBuf);
+}
 
-/******************* 
-void CImgProcessProcessing::FillRgn(CImgProcess* pTo, POINT ptStart)
- 
- ܣ
-	 ptStart Ϊʼ㣨ӣͼ
- ע
-	ֻܴ2ֵͼ󣬱߽ٶΪ 8 ͨptStartԭͼ *this ı߽֮
+static inline const float* GetBoxRow(const CImg& img, int y, float* pBuf)
+{
+	return img.GetFloatRow(y, pBuf);
+}
 
- 
-	CImgProcess* pTo: Ŀͼ CImgProcess ָ
-	POINT ptStart: ӵ
-	 
- ֵ
-	
-	
-*******************/
+// BoxFilterддʱĲ
+struct SBoxParam
+{
+	const CImg* pSrc;
+	CImg* pTo;
+	int nFilterH, nFilterW;
+	int nFilterMY, nFilterMX;
+};
 
-void CImgProcess::FillRgn(CImgProcess *pTo, POINT ptStart)
+// BoxFilterʵ֣[nBegin, nEnd)СTValueΪԴͼеͣTSumΪۼӺ͵
+template <class TValue, class TSum>
+static void BoxFilterRows(int nBegin, int nEnd, LPVOID pParam)
 {
-	int se[3][3] = {{-1, 1, -1}, {1, 1, 1}, {-1, 1, -1}}; // ʮνṹԪ
+	const SBoxParam& param = *(const SBoxParam*)pParam;
+	const CImg& imgSrc = *param.pSrc;
+	CImg* pTo = param.pTo;
+	int nFilterH = param.nFilterH, nFilterW = param.nFilterW;
+	int nFilterMY = param.nFilterMY, nFilterMX = param.nFilterMX;
 
-	int nHeight = GetHeight();
-	int nWidth = GetWidthPixel();
+	int i, j;
 
-	
-	pTo->InitPixels(255); //Ŀͼ
+	int nHeight = imgSrc.GetHeight();
+	int nWidth = imgSrc.GetWidthPixel();
+	BOOL bFloatDest = pTo->IsHighPrecision();
 
-	CImgProcess revImg = (*this);
-	revImg = !revImg; //ԭͼĲ
+	vector<TValue> vecIn(nWidth), vecOut(nWidth); //롢ƳڵеĻ
+	vector<TSum> vecCol(nWidth, 0); //ÿһϵĺ
+	vector<TSum> vecPrefix(nWidth + 1, 0); //к͵ǰ׺
+	vector<BYTE> vecDest(nWidth);
+	vector<float> vecFDest(nWidth);
 
-	pTo->SetPixel(ptStart.x, ptStart.y, RGB(0, 0, 0)); //ʼĿͼΪֻӵ
-	CImgProcess tmpImg = *pTo; //ݴһε
-	
-	
-	while( true ) //ѭֱͼͲٲ任
+	// ÿдͼڵзΧ[vecX0[j], vecX1[j])
+	vector<int> vecX0(nWidth), vecX1(nWidth);
+	for(j=0; j<nWidth; j++)
 	{
+		int x0 = j - nFilterMX;
+		int x1 = x0 + nFilterW;
+		vecX0[j] = x0 < 0 ? 0 : (x0 > nWidth ? nWidth : x0);
+		vecX1[j] = x1 > nWidth ? nWidth : (x1 < vecX0[j] ? vecX0[j] : x1);
+	}
+	int nInnerL = nFilterMX; //ȫͼڵзΧ[nInnerL, nInnerR)
+	int nInnerR = nWidth - nFilterW + nFilterMX + 1;
+	if(nInnerL < 0 || nInnerR <= nInnerL)
+		nInnerL = nInnerR = 0;
+	vector<int> vecBorder; //
+	for(j=0; j<nWidth; j++)
+		if(j < nInnerL || j >= nInnerR)
+			vecBorder.push_back(j);
+
+	//ۼӵкеΪ[nTop, nBottom)деĴڿʼ
+	int nTop = min(max(nBegin - nFilterMY, 0), nHeight);
+	int nBottom = nTop;
+	for(i=nBegin; i<nEnd; i++)
+	{
+		int y0 = i - nFilterMY;
+		int y1 = y0 + nFilterH;
+		if(y0 < 0)
+			y0 = 0;
+		if(y1 > nHeight)
+			y1 = nHeight;
+
+		// ƣƳгɶԴֻһк
+		while(nBottom < y1 && nTop < y0)
+		{
+			const TValue* pIn = GetBoxRow(imgSrc, nBottom++, &vecIn[0]);
+			const TValue* pOut = GetBoxRow(imgSrc, nTop++, &vecOut[0]);
+			for(j=0; j<nWidth; j++)
+				vecCol[j] += (TSum)pIn[j] - (TSum)pOut[j];
+		}
+		for(; nBottom < y1; nBottom++)
+		{
+			const TValue* pIn = GetBoxRow(imgSrc, nBottom, &vecIn[0]);
+			for(j=0; j<nWidth; j++)
+				vecCol[j] += pIn[j];
+		}
+		for(; nTop < y0; nTop++)
+		{
+			const TValue* pOut = GetBoxRow(imgSrc, nTop, &vecOut[0]);
+			for(j=0; j<nWidth; j++)
+				vecCol[j] -= pOut[j];
+		}
 
-		tmpImg.Dilate(pTo, se); //ʮֽṹԪ
-
-		*pTo = *pTo & revImg;//Ͳᳬԭʼ߽
+		for(j=0; j<nWidth; j++)
+			vecPrefix[j + 1] = vecPrefix[j] + vecCol[j];
 
-		if( *pTo == tmpImg )//ٱ仯ʱֹͣ
-			break;
-		tmpImg = *pTo;
-	}
+		int nRows = y1 - y0;
+		if(bFloatDest)
+		{
+			for(j=0; j<nWidth; j++)
+			{
+				int nArea = (vecX1[j] - vecX0[j]) * nRows;
+				double dSum = (double)(vecPrefix[vecX1[j]] - vecPrefix[vecX0[j]]);
+				vecFDest[j] = nArea > 0 ? (float)(dSum / nArea) : 0;
+			}
+			pTo->SetFloatRow(i, &vecFDest[0]);
+			continue;
+		}
 
-	//յĽΪͽԭʼ߽Ĳ
-	*pTo = *pTo | (*this);
+		// ȫͼڵ[nInnerL, nInnerR)ͬ
+		double dInnerArea = (double)nFilterW * nRows;
+		const TSum* pLeft = &vecPrefix[0] - nFilterMX;
+		const TSum* pRight = pLeft + nFilterW;
+		for(j=nInnerL; j<nInnerR; j++)
+		{
+			double dMean = (double)(pRight[j] - pLeft[j]) / dInnerArea;
+			vecDest[j] = dMean > 255 ? 255 : (dMean < 0 ? 0 : (BYTE)(dMean + 0.5)); //
+		}
+		for(size_t k=0; k<vecBorder.size(); k++)
+		{
+			j = vecBorder[k];
+			int nArea = (vecX1[j] - vecX0[j]) * nRows;
+			double dMean = nArea > 0 ? (double)(vecPrefix[vecX1[j]] - vecPrefix[vecX0[j]]) / nArea : 0;
+			vecDest[j] = dMean > 255 ? 255 : (dMean < 0 ? 0 : (BYTE)(dMean + 0.5));
+		}
+		pTo->SetGrayRow(i, &vecDest[0]);
+	}//for i
 }
 
-
 /*******************
-void CImgProcess::LabelConnRgn(CImgProcess* pTo)
+void CImgProcess::BoxFilter(CImgProcess *pTo, int nFilterH, int nFilterW, int nFilterMY, int nFilterMX)
 
-ܣעͨ
+ܣֵʽ˲
 
-עֵֻܴͼ
+עάڸеĺͣһʱֻ½СȥƳУ
+	к͵ǰ׺͵õÿڵĺͣÿص봰ڴС޹أ
+	ʺϱƽȴ󴰿ڵƽ
+	TemplateͬͼԵڽȡͼڵĲֵ֣ΪӦ
+	ձߡΪ16λ򸡵ͼʱֵľȣΪҶȡ
+	д̴߳ÿдеĴڿʼۼк
 
-
+:
 	CImgProcess* pToĿͼ CImgProcess ָ
-	int nConnȡֵΪ48ʾ4ͨ8ͨĬΪ8
-
+    int   nFilterH˲ĸ߶
+    int   nFilterW˲Ŀ
+    int   nFilterMY˲ԪY
+    int   nFilterMX˲ԪX
+ 
 ֵ:
-	int 
+     
 *******************/
-void CImgProcess::LabelConnRgn(CImgProcess* pTo, int nConn)
+void CImgProcess::BoxFilter(CImgProcess *pTo, int nFilterH, int nFilterW, int nFilterMY, int nFilterMX)
 {
-	int se[3][3] = {{1, 1, 1}, {1, 1, 1}, {1, 1, 1}}; // 8ͨ - 3*3ṹԪ
-	if(nConn == 4)//4ͨ - ʮνṹԪ
-	{
-		se[0][0] = -1;
-		se[0][2] = -1;
-		se[2][0] = -1;
-		se[2][2] = -1;
-	}
+	if(GetWidthPixel() <= 0 || GetHeight() <= 0)
+		return;
 
-	int nHeight = GetHeight();
-	int nWidth = GetWidthPixel();
+	pTo->MakeUnique(FALSE); //ÿһждֻ߳дԵ
 
-	int i, j, k, l; //ѭ
+	// ҶȰȷۼӣ߾ͼdoubleۼ
+	SBoxParam param = {this, pTo, nFilterH, nFilterW, nFilterMY, nFilterMX};
+	if(IsHighPrecision())
+		CImgParallel::For(0, GetHeight(), BoxFilterRows<float, double>, &param);
+	else
+		CImgParallel::For(0, GetHeight(), BoxFilterRows<BYTE, int64_t>, &param);
+}
 
-	CImgProcess backupImg = *this; //ԭͼԱָ
-	CImgProcess tmpImg = *pTo; //ݴһεʱͼ
 
-	int nConnRgn = 1; //ͨı
-	int nGray;
+/*******************
+ int CImgProcess::GetMedianValue(int * pAryGray, int nFilterLen)
+ 
+ ܣ򣬲Ԫصֵ
 
-	//㷨߽ϵĵ㣬ͼܵһȦ߽ð
-	for(i=0; i<nHeight; i++)
+ :
+	int * pAryGrayҪȡֵ
+    int nFilterLen鳤
+ 
+ ֵ:
+    int ֵ
+ 
+*******************/
+
+int CImgProcess::GetMedianValue(int * pAryGray, int nFilterLen)
+{
+	int nMedianValue;
+	
+	//򣨵߻õĩԪأ
+	std::sort(pAryGray, pAryGray + nFilterLen);
+	
+	// ֵ
+	if ((nFilterLen & 1) > 0)
 	{
-		SetPixel(0, i, RGB(255, 255, 255));
-		SetPixel(nWidth-1, i, RGB(255, 255, 255));
+		// ԪأмһԪ
+		nMedianValue = pAryGray[nFilterLen / 2];
 	}
-	for(j=0; j<nWidth; j++)
+	else
 	{
-		SetPixel(j, 0, RGB(255, 255, 255));
-		SetPixel(j, nHeight-1, RGB(255, 255, 255));
+		// żԪأмԪƽֵ
+		nMedianValue = (pAryGray[nFilterLen / 2 - 1] + pAryGray[nFilterLen / 2]) / 2;
 	}
+	
+	// ֵ
+	return nMedianValue;
+}
 
-	for(i=0; i<nHeight; i++)
-	{
-		for(j=0; j<nWidth; j++)
-		{
-			nGray = GetGray(j, i);
-
-			if(nGray == 0)
-			{
-				pTo->InitPixels(255); //Ŀͼ
 
-				//ҵһǰ㣬ȡڵͨ
-				pTo->SetPixel(j, i, RGB(0, 0, 0)); //ʼĿͼΪֻͨеһ
-				tmpImg = *pTo; //ݴͼ
-				
-				while( true ) //ѭֱͼͲٲ任
-				{
 
-					tmpImg.Dilate(pTo, se); //ýṹԪ
+// 33ֵıȽϽ磨19Σڵ4Ԫ
+static const BYTE s_bMedianNet9[][2] = {
+	{1, 2}, {4, 5}, {7, 8}, {0, 1}, {3, 4}, {6, 7}, {1, 2}, {4, 5}, {7, 8},
+	{0, 3}, {5, 8}, {4, 7}, {3, 6}, {1, 4}, {2, 5}, {4, 7}, {4, 2}, {6, 4},
+	{4, 2}
+};
 
-					*pTo = *pTo & backupImg;//ԭͼĽͲᳬ
-					
-					if( *pTo == tmpImg ) //һδͼͬ˵ͨѾȡ
-						break;
-					tmpImg = *pTo; //ݴͼ
-				}
+// 55ֵıȽϽ磨99Σڵ12Ԫ
+static const BYTE s_bMedianNet25[][2] = {
+	{0, 1}, {3, 4}, {2, 4}, {2, 3}, {6, 7}, {5, 7}, {5, 6}, {9, 10}, {8, 10},
+	{8, 9}, {12, 13}, {11, 13}, {11, 12}, {15, 16}, {14, 16}, {14, 15}, {18, 19}, {17, 19},
+	{17, 18}, {21, 22}, {20, 22}, {20, 21}, {23, 24}, {2, 5}, {3, 6}, {0, 6}, {0, 3},
+	{4, 7}, {1, 7}, {1, 4}, {11, 14}, {8, 14}, {8, 11}, {12, 15}, {9, 15}, {9, 12},
+	{13, 16}, {10, 16}, {10, 13}, {20, 23}, {17, 23}, {17, 20}, {21, 24}, {18, 24}, {18, 21},
+	{19, 22}, {8, 17}, {9, 18}, {0, 18}, {0, 9}, {10, 19}, {1, 19}, {1, 10}, {11, 20},
+	{2, 20}, {2, 11}, {12, 21}, {3, 21}, {3, 12}, {13, 22}, {4, 22}, {4, 13}, {14, 23},
+	{5, 23}, {5, 14}, {15, 24}, {6, 24}, {6, 15}, {7, 16}, {7, 19}, {13, 21}, {15, 23},
+	{7, 13}, {7, 15}, {1, 9}, {3, 11}, {5, 17}, {11, 17}, {9, 17}, {4, 10}, {6, 12},
+	{7, 14}, {4, 6}, {4, 7}, {12, 14}, {10, 14}, {6, 7}, {10, 12}, {6, 10}, {6, 17},
+	{12, 17}, {7, 17}, {7, 10}, {12, 18}, {7, 12}, {10, 18}, {12, 20}, {10, 20}, {10, 12}
+};
 
-				//עոҵͨ
-				for(k=0; k<nHeight; k++)
-				{
-					for(l=0; l<nWidth; l++)
-					{
-						nGray = pTo->GetGray(l, k);
-						if(nGray == 0)
-						{
-							SetPixel(l, k, RGB(nConnRgn, nConnRgn, nConnRgn)); //ڵǰͼϱעnConnRgnͨ
-						}
-					}//for l
-				
-				}//for k
+#define MEDIAN_NET_BLOCK	256	// ȽϽÿδ
 
-				nConnRgn ++; //ͨż1
-				if(nConnRgn > 255)
-				{
-					AfxMessageBox("Ŀǰúֱ֧ע255ͨ");
-					i = nHeight; //ǿѭ
-					break;
-				}
-			}//if
-		}//for j
-	}//for i
+// ֵ˲ʵֵĹд
+struct SMedianParam
+{
+	const CImg* pSrc;
+	CImg* pTo;
+	int nFilterH, nFilterW;
+	int nFilterMY, nFilterMX;
+	BOOL bAdaptive;	// Ӧֵ˲ֻ滻ļ󡢼Сֵ
+};
 
+// ñȽϽ3355ֵ[nBegin, nEnd)С
+// ÿԪһУȽϽȡСȡ
+// һεõһ
+static void MedianNetworkRows(const SMedianParam& param, int nBegin, int nEnd)
+{
+	int i, j, k, l, t;
 
-	*pTo = *this; //ĿͼǱע *this
-	*this = backupImg; //ָԭͼ
+	int nFilterH = param.nFilterH, nFilterW = param.nFilterW;
+	int nFilterMY = param.nFilterMY, nFilterMX = param.nFilterMX;
+	int nWidth = param.pSrc->GetWidthPixel();
+	int nLen = nFilterH * nFilterW;
 
-}
+	const BYTE (*pNet)[2] = (nLen == 9) ? s_bMedianNet9 : s_bMedianNet25;
+	int nNetLen = (nLen == 9) ? sizeof(s_bMedianNet9) / sizeof(s_bMedianNet9[0])
+		: sizeof(s_bMedianNet25) / sizeof(s_bMedianNet25[0]);
 
+	vector<BYTE> vecBuf((size_t)nFilterH * nWidth); //8λͼĻҶл
+	vector<const BYTE*> vecRows(nFilterH);
+	vector<BYTE> vecElem((size_t)nLen * MEDIAN_NET_BLOCK); //Ԫصһ
+	vector<BYTE> vecMin(MEDIAN_NET_BLOCK), vecMax(MEDIAN_NET_BLOCK); //ӦʱļСֵ
+	vector<BYTE> vecDest(nWidth, 0); //ԵΪ0
 
+	for(i = nBegin; i < nEnd; i++)
+	{
+		for(k = 0; k < nFilterH; k++)
+			vecRows[k] = param.pSrc->GetGrayRow(i + k - nFilterMY, &vecBuf[(size_t)k * nWidth]);
 
+		for(j = nFilterMX; j < nWidth - nFilterW + nFilterMX + 1; j += MEDIAN_NET_BLOCK)
+		{
+			int nCount = nWidth - nFilterW + nFilterMX + 1 - j;
+			if(nCount > MEDIAN_NET_BLOCK)
+				nCount = MEDIAN_NET_BLOCK;
 
+			// ڵkеlеԪΪƽƺһ
+			for(k = 0; k < nFilterH; k++)
+				for(l = 0; l < nFilterW; l++)
+					memcpy(&vecElem[(size_t)(k * nFilterW + l) * MEDIAN_NET_BLOCK],
+						vecRows[k] + j + l - nFilterMX, nCount);
 
+			if(param.bAdaptive)
+			{
+				memcpy(&vecMin[0], &vecElem[0], nCount);
+				memcpy(&vecMax[0], &vecElem[0], nCount);
+				for(int n = 1; n < nLen; n++)
+				{
+					const BYTE* pElem = &vecElem[(size_t)n * MEDIAN_NET_BLOCK];
+					for(t = 0; t < nCount; t++)
+					{
+						vecMin[t] = pElem[t] < vecMin[t] ? pElem[t] : vecMin[t];
+						vecMax[t] = pElem[t] > vecMax[t] ? pElem[t] : vecMax[t];
+					}
+				}
+			}
 
+			for(int n = 0; n < nNetLen; n++)
+			{
+				BYTE* pA = &vecElem[(size_t)pNet[n][0] * MEDIAN_NET_BLOCK];
+				BYTE* pB = &vecElem[(size_t)pNet[n][1] * MEDIAN_NET_BLOCK];
+				for(t = 0; t < nCount; t++)
+				{
+					BYTE bA = pA[t], bB = pB[t];
+					pA[t] = bA < bB ? bA : bB;
+					pB[t] = bA < bB ? bB : bA;
+				}
+			}
 
+			const BYTE* pMedian = &vecElem[(size_t)(nLen / 2) * MEDIAN_NET_BLOCK];
+			if(param.bAdaptive)
+			{
+				// ǰļֵֵΪӦ
+				const BYTE* pCenter = vecRows[nFilterMY] + j;
+				for(t = 0; t < nCount; t++)
+				{
+					BOOL bExtreme = (pCenter[t] == vecMin[t]) | (pCenter[t] == vecMax[t]);
+					vecDest[j + t] = bExtreme ? pMedian[t] : pCenter[t];
+				}
+			}
+			else
+				memcpy(&vecDest[j], pMedian, nCount);
+		}
 
+		param.pTo->SetGrayRow(i, &vecDest[0]);
+	}
+}
 
+#define MEDIAN_HIST_MIN		9		// Ĵ
+#define MEDIAN_HIST_MAX		65535	// ֱͼ󴰿Ϊ16λ
+#define MEDIAN_HIST_STRIPE	256		// ֱͼÿʹֱͼڻ
+
+// ʱֵ˲Perreault-Hbertֱͼ
+// ÿάڸϵ256ֱͼһʱÿֻӡһأ
+// ֱͼֱͼӵõһʱСȥС
+// 256Ϊ16ּÿ16Ҷȣֻάֱͼϸֱͼֵʱ
+// Ÿµǰλãÿص봰ڴС޹ء
+// Ϊ16λÿ4һuint64_tУֱͼεļӼ64λУ
+// 65535ȥѼĲ֣16λ֮䲻λλ
+class CMedianHist
+{
+public:
+	CMedianHist(int nWidth, int nFilterW)
+		: m_nWidth(nWidth), m_nFilterW(nFilterW),
+		  m_vecColCoarse((size_t)nWidth * 4, 0), m_vecColFine((size_t)nWidth * 64, 0)
+	{
+	}
 
-/******************* 
-void CImgProcess::Thining(CImgProcess* pTo)
- 
- ܣ
-	ϸ
- ע
-	ֻܴ2ֵͼ
+	// һؼ루nSignΪ1ƳnSignΪ-1ֱͼ
+	void AddRow(const BYTE* pRow, int nSign)
+	{
+		for(int x = 0; x < m_nWidth; x++)
+		{
+			int nGray = pRow[x];
+			uint64_t nCoarse = (uint64_t)1 << ((nGray >> 4 & 3) * 16);
+			uint64_t nFine = (uint64_t)1 << ((nGray & 3) * 16);
+			if(nSign > 0)
+			{
+				m_vecColCoarse[x * 4 + (nGray >> 6)] += nCoarse;
+				m_vecColFine[x * 64 + (nGray >> 2)] += nFine;
+			}
+			else
+			{
+				m_vecColCoarse[x * 4 + (nGray >> 6)] -= nCoarse;
+				m_vecColFine[x * 64 + (nGray >> 2)] -= nFine;
+			}
+		}
+	}
 
- 
-	
-	
- ֵ
-		
-*******************/
+	// ƵһеĿͷǵ0nFilterW-1
+	void BeginRow()
+	{
+		memset(m_nCoarse, 0, sizeof(m_nCoarse));
+		for(int x = 0; x < m_nFilterW; x++)
+			AddSegment(m_nCoarse, &m_vecColCoarse[x * 4]);
+		for(int k = 0; k < 16; k++)
+			m_nFineX[k] = -m_nFilterW; //ϸֱͼ¼
+		m_nX = 0;
+	}
 
-void CImgProcess::Thining()
-{
-	
-	int nHeight = GetHeight();
-	int nWidth = GetWidthPixel();
+	// һ
+	void MoveRight()
+	{
+		AddSegment(m_nCoarse, &m_vecColCoarse[(m_nX + m_nFilterW) * 4]);
+		SubSegment(m_nCoarse, &m_vecColCoarse[m_nX * 4]);
+		m_nX++;
+	}
 
-	//ĸ
-	BOOL bCondition1;
-	BOOL bCondition2;
-	BOOL bCondition3;
-	BOOL bCondition4;
+	// ڴСnRank0ʼصĻҶ
+	int GetRank(int nRank)
+	{
+		int nSum = 0;
+		int k = FindBin(m_nCoarse, nRank, nSum);
+		return k * 16 + FindBin(UpdateFine(k), nRank, nSum);
+	}
 
-	//55ֵ
-	unsigned char neighbour[5][5];
+	// СnGraynLessͲnGraynLessEq
+	void CountBelow(int nGray, int& nLess, int& nLessEq)
+	{
+		int k = nGray >> 4;
+		nLess = 0;
+		for(int b = 0; b < k; b++)
+			nLess += GetCount(m_nCoarse, b);
 
-	int i, j;
-	int m, n;
+		const uint64_t* pFine = UpdateFine(k);
+		for(int b = 0; b < (nGray & 15); b++)
+			nLess += GetCount(pFine, b);
+		nLessEq = nLess + GetCount(pFine, nGray & 15);
+	}
 
-	BOOL bModified = TRUE;
+private:
+	// ѵkϸֱͼµǰڣ󲻵һڿʱмӼۼ
+	const uint64_t* UpdateFine(int k)
+	{
+		uint64_t* pFine = m_nFine + k * 4;
+		if(m_nX - m_nFineX[k] >= m_nFilterW)
+		{
+			memset(pFine, 0, 4 * sizeof(uint64_t));
+			for(int x = m_nX; x < m_nX + m_nFilterW; x++)
+				AddSegment(pFine, &m_vecColFine[x * 64 + k * 4]);
+		}
+		else
+		{
+			for(int x = m_nFineX[k]; x < m_nX; x++)
+			{
+				AddSegment(pFine, &m_vecColFine[(x + m_nFilterW) * 64 + k * 4]);
+				SubSegment(pFine, &m_vecColFine[x * 64 + k * 4]);
+			}
+		}
+		m_nFineX[k] = m_nX;
+		return pFine;
+	}
 
+	// 16ֱͼеbļ
+	static int GetCount(const uint64_t* pSeg, int b)
+	{
+		return (int)(pSeg[b >> 2] >> ((b & 3) * 16)) & 0xFFFF;
+	}
 
-	while(bModified)
-	{		
-		bModified = FALSE;
-		CImgProcess pic = *this;
-		pic.InitPixels(255); //Ŀͼ
-		
-		for(j=2; j<nHeight-2; j++)
-		{
-			for(i=2; i<nWidth-2; i++)
-			{				
-				bCondition1 = FALSE;
-				bCondition2 = FALSE;
-				bCondition3 = FALSE;
-				bCondition4 = FALSE;
-				
-				BYTE data = GetGray(i, j);
-				if(data == 255)
-					continue;
-				
-				
-				// õǰڵ55ֵɫ0ɫ1
-				for (m = 0;m < 5;m++ )
-				{
-					for (n = 0;n < 5;n++)
-					{
-						neighbour[m][n] = (GetGray(i + n - 2, j + m - 2) == 0);
-					}
-				}
-				//				neighbour[][]
-				//ж
-				//ж2<=NZ(P1)<=6
-				int nCount =  neighbour[1][1] + neighbour[1][2] + neighbour[1][3] \
-					+ neighbour[2][1] + neighbour[2][3] + \
-					+ neighbour[3][1] + neighbour[3][2] + neighbour[3][3];
-				if ( nCount >= 2 && nCount <=6)
-					bCondition1 = TRUE;
-				
-				//жZ0(P1)=1
-				nCount = 0;
-				if (neighbour[1][2] == 0 && neighbour[1][1] == 1)
-					nCount++;
-				if (neighbour[1][1] == 0 && neighbour[2][1] == 1)
-					nCount++;
-				if (neighbour[2][1] == 0 && neighbour[3][1] == 1)
-					nCount++;
-				if (neighbour[3][1] == 0 && neighbour[3][2] == 1)
-					nCount++;
-				if (neighbour[3][2] == 0 && neighbour[3][3] == 1)
-					nCount++;
-				if (neighbour[3][3] == 0 && neighbour[2][3] == 1)
-					nCount++;
-				if (neighbour[2][3] == 0 && neighbour[1][3] == 1)
-					nCount++;
-				if (neighbour[1][3] == 0 && neighbour[1][2] == 1)
-					nCount++;
-				if (nCount == 1)
-					bCondition2 = TRUE;
-				
-				//жP2*P4*P8=0 or Z0(p2)!=1
-				if (neighbour[1][2]*neighbour[2][1]*neighbour[2][3] == 0)
-					bCondition3 = TRUE;
-				else
-				{
-					nCount = 0;
-					if (neighbour[0][2] == 0 && neighbour[0][1] == 1)
-						nCount++;
-					if (neighbour[0][1] == 0 && neighbour[1][1] == 1)
-						nCount++;
-					if (neighbour[1][1] == 0 && neighbour[2][1] == 1)
-						nCount++;
-					if (neighbour[2][1] == 0 && neighbour[2][2] == 1)
-						nCount++;
-					if (neighbour[2][2] == 0 && neighbour[2][3] == 1)
-						nCount++;
-					if (neighbour[2][3] == 0 && neighbour[1][3] == 1)
-						nCount++;
-					if (neighbour[1][3] == 0 && neighbour[0][3] == 1)
-						nCount++;
-					if (neighbour[0][3] == 0 && neighbour[0][2] == 1)
-						nCount++;
-					if (nCount != 1)
-						bCondition3 = TRUE;
-				}
-				
-				//жP2*P4*P6=0 or Z0(p4)!=1
-				if (neighbour[1][2]*neighbour[2][1]*neighbour[3][2] == 0)
-					bCondition4 = TRUE;
-				else
-				{
-					nCount = 0;
-					if (neighbour[1][1] == 0 && neighbour[1][0] == 1)
-						nCount++;
-					if (neighbour[1][0] == 0 && neighbour[2][0] == 1)
-						nCount++;
-					if (neighbour[2][0] == 0 && neighbour[3][0] == 1)
-						nCount++;
-					if (neighbour[3][0] == 0 && neighbour[3][1] == 1)
-						nCount++;
-					if (neighbour[3][1] == 0 && neighbour[3][2] == 1)
-						nCount++;
-					if (neighbour[3][2] == 0 && neighbour[2][2] == 1)
-						nCount++;
-					if (neighbour[2][2] == 0 && neighbour[1][2] == 1)
-						nCount++;
-					if (neighbour[1][2] == 0 && neighbour[1][1] == 1)
-						nCount++;
-					if (nCount != 1)
-						bCondition4 = TRUE;
-				}
-				
-				if(bCondition1 && bCondition2 && bCondition3 && bCondition4)
-				{
-					pic.SetPixel(i, j, RGB(255, 255, 255));
-					bModified = TRUE;
-				}
-				else
-				{
-					pic.SetPixel(i, j, RGB(0, 0, 0));
-				}
-				
-			} //for i
-		} //for j
-	
-		*this = pic;
-	}//while
-}
+	// 16ֱͼΣ4uint64_tļӼ
+	static void AddSegment(uint64_t* pDest, const uint64_t* pSrc)
+	{
+		pDest[0] += pSrc[0]; pDest[1] += pSrc[1]; pDest[2] += pSrc[2]; pDest[3] += pSrc[3];
+	}
 
+	static void SubSegment(uint64_t* pDest, const uint64_t* pSrc)
+	{
+		pDest[0] -= pSrc[0]; pDest[1] -= pSrc[1]; pDest[2] -= pSrc[2]; pDest[3] -= pSrc[3];
+	}
 
+	// 16ֱͼۼƼnSum𣩳nRankļnSumϴǰļ
+	// Ȱ4һң˷4֮Ƶ16λڲ
+	static int FindBin(const uint64_t* pSeg, int nRank, int& nSum)
+	{
+		int g, b;
+		for(g = 0; g < 3; g++)
+		{
+			int nCount = (int)((pSeg[g] * 0x0001000100010001ULL) >> 48);
+			if(nSum + nCount > nRank)
+				break;
+			nSum += nCount;
+		}
 
+		uint64_t nGroup = pSeg[g];
+		for(b = 0; b < 3; b++)
+		{
+			int nCount = (int)(nGroup & 0xFFFF);
+			if(nSum + nCount > nRank)
+				break;
+			nSum += nCount;
+			nGroup >>= 16;
+		}
+		return g * 4 + b;
+	}
 
-/**************************************************
-BOOL CImgProcess::Hough(SLineInfo *pInfoRet, int nLineRet)
-ܣ
-	任
-ע
-	ֵֻܴͼһӦΪԵͼ񣨺ɫɫǰ
-
-	SLineInfo *pInfoRet
-		ֱϢ
-	int nLineRet
-		ҪѰҵֱĿ
+	int m_nWidth, m_nFilterW;
+	vector<uint64_t> m_vecColCoarse;	// еĴֱͼÿ16
+	vector<uint64_t> m_vecColFine;		// еϸֱͼÿ256
+	uint64_t m_nCoarse[4];				// ڵĴֱͼ
+	uint64_t m_nFine[64];				// ڵϸֱͼηֱ
+	int m_nFineX[16];					// ϸֱͼӦĴʼ
+	int m_nX;							// ڵʼ
+};
 
-ֵ
-	BOOLͣtrueΪɹfalseΪʧ
-***************************************************/
-BOOL CImgProcess::Hough(SLineInfo *pInfoRet, int nLineRet)
+// ֱͼֵ[nBegin, nEnd)С
+// ÿֱͼֻмKBڻУ
+// ĽȴvecResultдĿͼ
+static void MedianHistRows(const SMedianParam& param, int nBegin, int nEnd)
 {
-	int i, j;
-	
-	
-	// еRhoTheta
-	int nMaxDist = sqrt(GetHeight()*GetHeight() + GetWidthPixel()*GetWidthPixel());
-	int nMaxAngle = 90;
+	int i, j, k;
 
-	// Ϊռ
-	int nAreaNum = nMaxAngle * nMaxDist * 2;
-	int *pTransArea = new int[nAreaNum];	
-	memset(pTransArea, 0, nAreaNum * sizeof(int));
-	
-	// ת
-	BYTE bt;
-	int nAngle, nDist; //µĽǶȺͼ
-	double fRadian; //
-	for(i = 0; i < GetHeight(); i ++)
+	int nFilterH = param.nFilterH, nFilterW = param.nFilterW;
+	int nFilterMY = param.nFilterMY, nFilterMX = param.nFilterMX;
+	int nWidth = param.pSrc->GetWidthPixel();
+	int nLen = nFilterH * nFilterW;
+	int nEndX = nWidth - nFilterW + nFilterMX + 1; //ĽУ
+
+	vector<BYTE> vecBuf(nWidth), vecBufOld(nWidth), vecBufCenter(nWidth); //8λͼĻҶл
+	vector<BYTE> vecResult((size_t)(nEnd - nBegin) * nWidth, 0); //ԵΪ0
+
+	for(int nStripeX = nFilterMX; nStripeX < nEndX; nStripeX += MEDIAN_HIST_STRIPE)
 	{
-		for(j=0; j<GetWidthPixel(); j++)
+		int nStripeEnd = nStripeX + MEDIAN_HIST_STRIPE < nEndX ? nStripeX + MEDIAN_HIST_STRIPE : nEndX;
+		int nLeft = nStripeX - nFilterMX; //ֱͼʼ
+		CMedianHist hist(nStripeEnd - nStripeX + nFilterW - 1, nFilterW);
+
+		// ʱмСƳ
+		for(k = 0; k < nFilterH - 1; k++)
+			hist.AddRow(param.pSrc->GetGrayRow(nBegin - nFilterMY + k, &vecBuf[0]) + nLeft, 1);
+
+		for(i = nBegin; i < nEnd; i++)
 		{
-			bt = GetGray(j, i);
-			if(bt == 255)
+			int nTop = i - nFilterMY; //ڵ
+			hist.AddRow(param.pSrc->GetGrayRow(nTop + nFilterH - 1, &vecBuf[0]) + nLeft, 1);
+
+			const BYTE* pCenter = param.bAdaptive ? param.pSrc->GetGrayRow(i, &vecBufCenter[0]) : NULL;
+			BYTE* pResult = &vecResult[(size_t)(i - nBegin) * nWidth];
+			hist.BeginRow();
+			for(j = nStripeX; j < nStripeEnd; j++)
 			{
-				for(nAngle = 0; nAngle < nMaxAngle; nAngle ++)
+				if(j > nStripeX)
+					hist.MoveRight();
+
+				if(param.bAdaptive)
 				{
-					fRadian = nAngle*2*PI/180.0; //תΪ
-					nDist = (j*cos(fRadian) + i*sin(fRadian)); //㼫
-					
-					if(nDist >= 0)//
-					{
-						pTransArea[nDist*nMaxAngle + nAngle] ++;
-					}
-					else//
+					// ǰزļֵ򱣳ֲ
+					int nLess, nLessEq;
+					hist.CountBelow(pCenter[j], nLess, nLessEq);
+					if(nLess > 0 && nLessEq < nLen)
 					{
-						//nDist = fabs(nDist);
-						nDist = nDist > 0 ? nDist : -nDist; //@ran
-						pTransArea[nMaxAngle * nMaxDist + nDist*nMaxAngle + nAngle] ++;
+						pResult[j] = pCenter[j];
+						continue;
 					}
-				}//for nAngle
-			}//if
-		}//for j
-	}//for i
-	
-	
-	SMaxValue MaxValue1;
+				}
 
-	//ʱǶȺͼķΧ
-	int nMaxDisAllow = 20;
-	int nMaxAngleAllow = 5;
+				int nGray = hist.GetRank(nLen / 2);
+				if((nLen & 1) == 0) //żԪȡмƽֵ
+					nGray = (hist.GetRank(nLen / 2 - 1) + nGray) / 2;
+				pResult[j] = (BYTE)nGray;
+			}//j
 
-	for(int nLine=0; nLine<nLineRet; nLine++) //ѰǰnLineRetֵ
-	{	
-		// Ѱ
-		MaxValue1.nValue = 0;
-		for(i=0; i<nAreaNum; i++)
+			hist.AddRow(param.pSrc->GetGrayRow(nTop, &vecBufOld[0]) + nLeft, -1);
+		}//i
+	}
+
+	for(i = nBegin; i < nEnd; i++)
+		param.pTo->SetGrayRow(i, &vecResult[(size_t)(i - nBegin) * nWidth]);
+}
+
+// ֵںС򳬴Ĵڣ[nBegin, nEnd)
+static void MedianSortRows(const SMedianParam& param, int nBegin, int nEnd)
+{
+	int i, j, k, l;
+
+	int nFilterH = param.nFilterH, nFilterW = param.nFilterW;
+	int nFilterMY = param.nFilterMY, nFilterMX = param.nFilterMX;
+	int nWidth = param.pSrc->GetWidthPixel();
+	int nLen = nFilterH * nFilterW;
+
+	vector<int> vecAryGray(nLen); //
+	vector<const BYTE*> vecRows(nFilterH);
+	vector<BYTE> vecRowBuf((size_t)nFilterH * nWidth); //8λͼĻҶл
+	vector<BYTE> vecDest(nWidth, 0); //ԵΪ0
+
+	for(i = nBegin; i < nEnd; i++)
+	{
+		for(k = 0; k < nFilterH; k++)
+			vecRows[k] = param.pSrc->GetGrayRow(i + k - nFilterMY, &vecRowBuf[(size_t)k * nWidth]);
+
+		for(j = nFilterMX; j < nWidth - nFilterW + nFilterMX + 1; j++)
 		{
-			if(pTransArea[i] > MaxValue1.nValue)
+			// ȡ˲
+			for(k = 0; k < nFilterH; k++)
+				for(l = 0; l < nFilterW; l++)
+					vecAryGray[k * nFilterW + l] = vecRows[k][j + l - nFilterMX];
+
+			int nGray = CImgProcess::GetMedianValue(&vecAryGray[0], nLen); //ͨȡֵ
+
+			// ӦʱжϵǰǷļСֵ򱣳ֲ
+			int nCenter = vecRows[nFilterMY][j];
+			if(param.bAdaptive && nCenter != vecAryGray[0] && nCenter != vecAryGray[nLen - 1])
+				nGray = nCenter;
+			vecDest[j] = (BYTE)nGray;
+		}//j
+
+		param.pTo->SetGrayRow(i, &vecDest[0]);
+	}//i
+}
+
+// ڴСѡֵ˲ʵ֣[nBegin, nEnd)
+static void MedianRows(int nBegin, int nEnd, LPVOID pParam)
+{
+	const SMedianParam& param = *(const SMedianParam*)pParam;
+	int nLen = param.nFilterH * param.nFilterW;
+
+	if((param.nFilterH == 3 && param.nFilterW == 3) || (param.nFilterH == 5 && param.nFilterW == 5))
+		MedianNetworkRows(param, nBegin, nEnd);
+	else if(nLen > MEDIAN_HIST_MIN && nLen <= MEDIAN_HIST_MAX)
+		MedianHistRows(param, nBegin, nEnd);
+	else
+		MedianSortRows(param, nBegin, nEnd);
+}
+
+/*******************
+void CImgProcess::MedianFilter(CImgProcess *pTo, int nFilterH, int nFilterW, int nFilterMY, int nFilterMX)
+
+ܣֵ˲
+
+עͻ罷нϺõЧ
+	3355ñȽϽ磬һδһУ
+	ֱͼPerreault-Hbertʱֵ˲
+	ÿص봰ڴС޹أСĴֱ
+	Ϊżʱȡмƽֵ
+	д̴߳
+
+:
+	CImgProcess* pToĿͼ CImgProcess ָ
+    int   nFilterH˲ĸ߶
+    int   nFilterW˲Ŀ
+    int   nFilterMX˲ԪY
+    int   nFilterMY˲ԪX
+ 
+ֵ:
+     
+*******************/
+void CImgProcess::MedianFilter(CImgProcess *pTo, int nFilterH, int nFilterW, int nFilterMY, int nFilterMX)
+{
+	pTo->InitPixels(0); //ʼĿͼ񣬸ֻ߳дԵ
+
+	int nHeight = GetHeight();
+	int nWidth = GetWidthPixel();
+
+	if(nFilterH > nHeight || nFilterW > nWidth || nFilterH * nFilterW <= 0)
+		return;
+
+	SMedianParam param = {this, pTo, nFilterH, nFilterW, nFilterMY, nFilterMX, FALSE};
+	CImgParallel::For(nFilterMY, nHeight - nFilterH + nFilterMY + 1, MedianRows, &param); // (ȥԵ)
+}
+
+
+
+/*******************
+void CImgProcess::AdaptiveMedianFilter(CImgProcess *pTo, int nFilterH, int nFilterW, int nFilterMY, int nFilterMX, int nThreads)
+
+ܣĽֵ˲
+
+עڱ׼ֵ˲ĻϣÿһʱжϸǷ˲صļ߼Сֵ
+	ǣֵ˲أǣ账
+	MedianFilterʵ֣3355ɱȽϽͬʱֵֵ
+	ֱͼͳСڡڵǰصĸжϼֵ
+	ֻԼֱֵֵͼ洰ơ¡
+	ɰд̴߳
+
+:
+	CImgProcess* pToĿͼ CImgProcess ָ
+    int   nFilterH˲ĸ߶
+    int   nFilterW˲Ŀ
+    int   nFilterMX˲ԪY
+    int   nFilterMY˲ԪX
+	int   nThreads߳ĬΪ0CImgParallelȫ߳1Ϊ߳
+ 
+ֵ:
+     
+*******************/
+void CImgProcess::AdaptiveMedianFilter(CImgProcess *pTo, int nFilterH, int nFilterW, int nFilterMY, int nFilterMX, int nThreads)
+{
+	pTo->InitPixels(0); //ʼĿͼ񣬸ֻ߳дԵ
+
+	int nHeight = GetHeight();
+	int nWidth = GetWidthPixel();
+
+	if(nFilterH > nHeight || nFilterW > nWidth || nFilterH * nFilterW <= 0)
+		return;
+
+	SMedianParam param = {this, pTo, nFilterH, nFilterW, nFilterMY, nFilterMX, TRUE};
+	CImgParallel::For(nFilterMY, nHeight - nFilterH + nFilterMY + 1, MedianRows, &param, nThreads); // (ȥԵ)
+}
+
+/******************* 
+void CImgProcess::FilterSobel(CImgProcess *pTo)
+ ܣ
+	Sobelݶ
+ 
+ 
+	ImgProcess* pTo: Ŀͼ CImgProcess ָ
+		 
+ ֵ
+		
+*******************/
+void CImgProcess::FilterSobel(CImgProcess *pTo)
+{
+	CImgProcess img1, img2;
+	img1 = *pTo;
+	img2 = *pTo;
+
+	Template(&img1, 3, 3, 1, 1, Template_HSobel, 1);
+	Template(&img2, 3, 3, 1, 1, Template_VSobel, 1);
+
+	*pTo = img1 + img2;
+}
+
+
+/*******************
+void CImgProcess::EnhanceFilter(CImgProcess *pTo, double dProportion,
+						 int nTempH, int nTempW, 
+						 int nTempMY, int nTempMX, FLOAT *pfArray, FLOAT fCoef)
+
+ܣ˲
+
+
+	CImgProcess* pToͼ CImgProcess ָ
+	double dProportion˲ԭͼĻϱ
+	int   nTempHģĸ߶
+	int   nTempW ģĿ
+	int   nTempMYģԪY ( < iTempH - 1)
+	int   nTempMXģԪX ( < iTempW - 1)
+	FLOAT * fpArrayָģָ
+	FLOAT fCoefģϵ
+
+	ģͼڵĸģӦϵضϵ255ԭҶȰ
+	ӵĺٰͣȫͼֵСֵһ0255ģ岻ͼ
+	ڵıԵرֲ䡣
+	ȨغͱΪCImgConv::HighBoostһɼȨ͡
+	ضϺ͵ӣCPUʹAVX2SSE4.1ԭĸ1Ҷȼ
+	д̴߳
+
+ֵ:
+	
+*******************/
+
+#define ENHANCE_MAX_SHIFT	16	// ȨصСλ
+#define ENHANCE_MIN_SHIFT	8	// СڴλʱȲø
+
+// EnhanceFilterддʱĲ
+struct SEnhanceParam
+{
+	const CImg* pSrc;
+	CImg* pTo;
+	int nTempH, nTempW;
+	int nTempMY, nTempMX;
+	const FLOAT* pfArray;
+	FLOAT fCoef;
+	double dProportion;
+	int nStartX, nEndX;		// еķΧ
+
+	// ʱģԪصĶȨؼģеСУnShiftΪ0ʱø
+	int nShift;
+	int nCenterW;			// ԭͼĶ
+	vector<int> vecWeight, vecTapRow, vecTapCol;
+
+	vector<int> vecSum;		// ӽСд
+	std::mutex mtx;
+	int nMin, nMax;			// ӽķΧmtx
+};
+
+// [nBegin, nEnd)еĵӽͳƷΧкڵһ
+static void EnhanceSumRows(int nBegin, int nEnd, LPVOID pParam)
+{
+	SEnhanceParam& param = *(SEnhanceParam*)pParam;
+	const CImg& imgSrc = *param.pSrc;
+	int nTempH = param.nTempH, nTempW = param.nTempW;
+	int nStartX = param.nStartX;
+	int nCount = param.nEndX - nStartX;
+
+	int i, j, k, l;
+	int nWidth = imgSrc.GetWidthPixel();
+
+	// ģ帲ǵnTempHеĻҶȣԴͼyдڵy % nTempH
+	vector<BYTE> vecRing(nTempH * nWidth);
+	vector<const BYTE*> vecRow(nTempH);
+	vector<const BYTE*> vecIn(param.vecWeight.size());
+
+	int nMin = INT_MAX, nMax = INT_MIN;
+	for(i=nBegin; i<nEnd; i++)
+	{
+		int y0 = i; //ģԴͼек
+		for(k=(i == nBegin ? 0 : nTempH - 1); k<nTempH; k++)
+		{
+			int y = y0 + k;
+			vecRow[y % nTempH] = imgSrc.GetGrayRow(y, &vecRing[(y % nTempH) * nWidth]);
+		}
+
+		const BYTE* pCenter = vecRow[(y0 + param.nTempMY) % nTempH] + nStartX;
+		int* pSum = &param.vecSum[(size_t)i * nCount];
+
+		if(param.nShift > 0)
+		{
+			for(size_t t=0; t<vecIn.size(); t++)
+				vecIn[t] = vecRow[(y0 + param.vecTapRow[t]) % nTempH] + nStartX + param.vecTapCol[t] - param.nTempMX;
+			CImgConv::HighBoost(pSum, vecIn.empty() ? NULL : &vecIn[0], param.vecWeight.empty() ? NULL : &param.vecWeight[0],
+				(int)vecIn.size(), pCenter, param.nCenterW, param.nShift, nCount);
+		}
+		else
+		{
+			// Ȩع󣬶ԭķʽ㸡
+			for(j=0; j<nCount; j++)
 			{
-				MaxValue1.nValue = pTransArea[i];
-				MaxValue1.nAngle = i;
+				float fResult = 0;
+				for(k=0; k<nTempH; k++)
+				{
+					const BYTE* pRow = vecRow[(y0 + k) % nTempH] + nStartX + j - param.nTempMX;
+					for(l=0; l<nTempW; l++)
+						fResult += pRow[l] * param.pfArray[k * nTempW + l];
+				}
+				fResult *= param.fCoef;
+				if(fResult > 255)
+					fResult = 255;
+				if(fResult < -255)
+					fResult = -255;
+				pSum[j] = (int)(param.dProportion * pCenter[j] + fResult + 0.5);
 			}
 		}
-		
-		if(MaxValue1.nValue == 0) //ҲܵĹߵ
+
+		for(j=0; j<nCount; j++)
 		{
-			return FALSE;
+			nMin = min(nMin, pSum[j]);
+			nMax = max(nMax, pSum[j]);
 		}
-		
-		if(MaxValue1.nAngle < nMaxAngle * nMaxDist)
+	}
+
+	std::lock_guard<std::mutex> lock(param.mtx);
+	param.nMin = min(param.nMin, nMin);
+	param.nMax = max(param.nMax, nMax);
+}
+
+// ӽһ0255nMinnSpanԭͳƷʽֵС0Сֵ65535
+static inline BYTE EnhanceToGray(int nSum, int nMin, int nSpan)
+{
+	if(nSpan > 0)
+		return (BYTE)((nSum - nMin) * 255 / nSpan);
+	return (BYTE)(nSum <= 255 ? nSum : 255);
+}
+
+// [nBegin, nEnd)еĵӽһдͼ
+static void EnhanceWriteRows(int nBegin, int nEnd, LPVOID pParam)
+{
+	SEnhanceParam& param = *(SEnhanceParam*)pParam;
+	CImg* pTo = param.pTo;
+	int nStartX = param.nStartX;
+	int nCount = param.nEndX - nStartX;
+
+	int nMin = min(param.nMin, 65535);
+	int nSpan = max(param.nMax, 0) - nMin;
+
+	// ӽȡֵΧʱ
+	vector<BYTE> vecLut;
+	if((double)param.nMax - param.nMin < 65536)
+	{
+		vecLut.resize(param.nMax - param.nMin + 1);
+		for(int v=param.nMin; v<=param.nMax; v++)
+			vecLut[v - param.nMin] = EnhanceToGray(v, nMin, nSpan);
+	}
+
+	BOOL bGray8 = (pTo->GetFormat() == IMG_FMT_GRAY8);
+	vector<BYTE> vecGray(nCount);
+	for(int i=nBegin; i<nEnd; i++)
+	{
+		const int* pSum = &param.vecSum[(size_t)i * nCount];
+		BYTE* pOut = bGray8 ? pTo->GetRow(i + param.nTempMY) + nStartX : &vecGray[0];
+		int j;
+		if(!vecLut.empty())
 		{
-			MaxValue1.nDist = MaxValue1.nAngle/nMaxAngle;
-			MaxValue1.nAngle = MaxValue1.nAngle%nMaxAngle;
+			for(j=0; j<nCount; j++)
+				pOut[j] = vecLut[pSum[j] - param.nMin];
 		}
 		else
 		{
-			MaxValue1.nAngle -= nMaxAngle * nMaxDist;
-			
-			MaxValue1.nDist = MaxValue1.nAngle/nMaxAngle;
-			MaxValue1.nDist *= -1;
-			
-			
-			MaxValue1.nAngle = MaxValue1.nAngle%nMaxAngle;
+			for(j=0; j<nCount; j++)
+				pOut[j] = EnhanceToGray(pSum[j], nMin, nSpan);
 		}
-		
-		// pInfoRetṹָ
-		pInfoRet[nLine].nAngle = MaxValue1.nAngle*2;
-		pInfoRet[nLine].nDist = MaxValue1.nDist;
-		pInfoRet[nLine].nPixels = MaxValue1.nValue;	
-		
-		if(pInfoRet[nLine].nDist < 0)
+
+		// ʽֻдУԵԭ
+		if(!bGray8)
 		{
-			pInfoRet[nLine].nAngle = pInfoRet[nLine].nAngle - 180;
-			pInfoRet[nLine].nDist = pInfoRet[nLine].nDist*(-1);
-			
+			for(j=0; j<nCount; j++)
+				pTo->SetPixel(nStartX + j, i + param.nTempMY, RGB(vecGray[j], vecGray[j], vecGray[j]));
 		}
-		
-		// 㣬ΪѰһֵ׼
-		for(nDist = (-1)*nMaxDisAllow; nDist <= nMaxDisAllow; nDist ++)
+	}
+}
+
+void CImgProcess::EnhanceFilter(CImgProcess *pTo, double dProportion,
+						 int nTempH, int nTempW, 
+						 int nTempMY, int nTempMX, FLOAT *pfArray, FLOAT fCoef)
+{
+	int k, l;
+	int nHeight = GetHeight();
+	int nWidth = GetWidthPixel();
+
+	*pTo = *this; //Ŀͼʼ
+	pTo->MakeUnique();
+
+	int nRows = nHeight - nTempH + 1;
+	int nCount = nWidth - nTempW + 1;
+	if(nRows <= 0 || nCount <= 0) //ģͼû
+		return;
+
+	SEnhanceParam param;
+	param.pSrc = this;
+	param.pTo = pTo;
+	param.nTempH = nTempH;
+	param.nTempW = nTempW;
+	param.nTempMY = nTempMY;
+	param.nTempMX = nTempMX;
+	param.pfArray = pfArray;
+	param.fCoef = fCoef;
+	param.dProportion = dProportion;
+	param.nStartX = nTempMX;
+	param.nEndX = nTempMX + nCount;
+
+	// ѡȡСλȨ͡ضֵԭͼ񲿷֮ͶintΧ
+	double dSumW = 0;
+	for(k=0; k<nTempH * nTempW; k++)
+		dSumW += fabs(pfArray[k] * fCoef);
+
+	param.nShift = 0;
+	for(int nShift=ENHANCE_MAX_SHIFT; nShift>=ENHANCE_MIN_SHIFT; nShift--)
+	{
+		double dScale = (double)(1 << nShift);
+		double dBound = 255 * (dSumW * dScale + 0.5 * nTempH * nTempW); //Ȩص0.5
+		double dTotal = (255 * (fabs(dProportion) + 1) + 1) * dScale;
+		if(dBound < INT_MAX && dTotal < INT_MAX)
 		{
-			for(nAngle = (-1)*nMaxAngleAllow; nAngle <= nMaxAngleAllow; nAngle ++)
+			param.nShift = nShift;
+			break;
+		}
+	}
+
+	if(param.nShift > 0)
+	{
+		double dScale = (double)(1 << param.nShift);
+		param.nCenterW = (int)floor(dProportion * dScale + 0.5);
+		for(k=0; k<nTempH; k++)
+		{
+			for(l=0; l<nTempW; l++)
 			{
-				int nThisDist = MaxValue1.nDist + nDist;
-				int nThisAngle = MaxValue1.nAngle + nAngle;
-				
-				
-				
-				nThisAngle *= 2;
-				
-				if(nThisAngle < 0 && nThisAngle >= -180)
-				{
-					nThisAngle += 180;
-					nThisDist *= -1;
-				}
-				if(nThisAngle >= 180 && nThisAngle < 360)
-				{
-					nThisAngle -= 180; 
-					nThisDist *= -1;
-				}
-				
-				
-				nThisDist = nThisDist>0 ? nThisDist : -nThisDist; //@ran
-				if (/*fabs(nThisDist)*/nThisDist <= nMaxDist
-					&& nThisAngle >= 0 && nThisAngle <= nMaxAngle*2)
-				{
-					nThisAngle /= 2;
-					if(nThisDist >= 0)
-					{
-						pTransArea[nThisDist*nMaxAngle + nThisAngle] = 0;
-					}
-					else
-					{
-						//nThisDist = fabs(nThisDist);
-						nThisDist = nThisDist>0 ? nThisDist : -nThisDist;  //@ran
-						pTransArea[nMaxDist*nMaxAngle + nThisDist*nMaxAngle + nThisAngle] = 0;
-					}
-				}
-			}//for nAngle
-		}//for nDist
-	}//for nLine
+				int nW = (int)floor(pfArray[k * nTempW + l] * fCoef * dScale + 0.5);
+				if(nW == 0)
+					continue;
+				param.vecWeight.push_back(nW);
+				param.vecTapRow.push_back(k);
+				param.vecTapCol.push_back(l);
+			}
+		}
+	}
+
+	param.vecSum.resize((size_t)nRows * nCount);
+	param.nMin = INT_MAX;
+	param.nMax = INT_MIN;
+
+	CImgParallel::For(0, nRows, EnhanceSumRows, &param);
+	CImgParallel::For(0, nRows, EnhanceWriteRows, &param);
+}
+
+
+
+
+
+
+// ֱͼȷֵDetectThresholdEdgeCannyݶͼ
+static int IterateThreshold(const int nHistogram[256], int nMaxIter, int &nDiffRet)
+{
+	int nThreshold;
+	int i;
+	BYTE bt;
+
+	int nMin = 255;
+	int nMax = 0;
+
+	nDiffRet = 0;
+
+	// ֱͼõСҶ
+	for(i=0; i<256; i++)
+	{
+		if(nHistogram[i] > 0)
+		{
+			bt = i;
+			
+			if(bt < nMin)
+				nMin = bt;
+			if(bt > nMax)
+				nMax = bt;
+		}
+	}
+	
+	int nTotalGray = 0; //Ҷֵĺ
+	int nTotalPixel = 0; //ĺ
+	int nNewThreshold = (nMax + nMin)/2; //ʼֵ
+	
+	nDiffRet = nMax - nMin;
+
+	if (nMax == nMin)
+		nThreshold = nNewThreshold;
+
+	else
+	{
+		nThreshold = 0;
+		
+		// ʼ,ֱﵽ100ֵһֵõֵȣ
+		for(int nIterationTimes = 0; nThreshold != nNewThreshold && nIterationTimes < nMaxIter; nIterationTimes ++)
+		{
+			nThreshold = nNewThreshold;
+			nTotalGray = 0;
+			nTotalPixel = 0;
+
+			//ͼСڵǰֵֵƽҶ
+			for(i=nMin; i<nThreshold; i++)
+			{
+				nTotalGray += nHistogram[i]*i;
+				nTotalPixel += nHistogram[i];
+			}
+			int nMean1GrayValue = nTotalGray/nTotalPixel;
+
+
+			nTotalGray = 0;
+			nTotalPixel = 0;
+			
+			//ͼдڵǰֵֵƽҶ
+			for(i=nThreshold + 1; i<=nMax; i++)
+			{
+				nTotalGray += nHistogram[i]*i;
+				nTotalPixel += nHistogram[i];
+			}
+			int nMean2GrayValue = nTotalGray/nTotalPixel;
+			
+			nNewThreshold = (nMean1GrayValue + nMean2GrayValue)/2; //µֵ
+			nDiffRet = abs(nMean1GrayValue - nMean2GrayValue);
+		}
+	}
+	
+	return nThreshold;
+}
+
+/**************************************************
+int CImgProcess::DetectThreshold(int nMaxIter, int &nDiffRet)
+
+ܣ
+	õԶȷֵ
+
+
+	int nMaxIter
+	int &nDiffRet	ʹøֵȷĵ밵ƽҶȵĲֵ
+ֵ
+	intͣ㷨ȷֵ
+***************************************************/
+
+int CImgProcess::DetectThreshold(int nMaxIter, int &nDiffRet)
+{
+	// ֱͼ
+	int nHistogram[256] = { 0 };
+	int i, j;
+	
+	vector<BYTE> vecBuf(GetWidthPixel()); //8λͼĻҶл
+
+	// ɨͼ,ֱͼ
+	for(j = 0; j < GetHeight(); j ++)
+	{
+		const BYTE* pRow = GetGrayRow(j, &vecBuf[0]);
+		for(i=0; i<GetWidthPixel(); i++)
+		{
+			nHistogram[pRow[i]] ++;
+		}
+	}
+
+	return IterateThreshold(nHistogram, nMaxIter, nDiffRet);
+}
+
+/**************************************************
+void CImgProcess::Threshold(CImgProcess *pTo, BYTE bThre)
+
+ܣ
+	ͼֵ任
+ƣ
+	ֻܴҶͼ
+
+
+	CImgProcess * pTo
+		CImgProcessָ
+	BYTE bThre
+		õĻ׼ֵ
+ֵ
+	
+***************************************************/
+
+void CImgProcess::Threshold(CImgProcess *pTo, BYTE bThre)
+{
+	int i, j;
+	BYTE bt;
+
+	vector<BYTE> vecBuf(m_pBMIH->biWidth); //8λͼĻҶл
+	vector<BYTE> vecDest(m_pBMIH->biWidth); //Ŀͼһ
+
+	for(j = 0; j < m_pBMIH->biHeight; j ++)
+	{
+		const BYTE* pRow = GetGrayRow(j, &vecBuf[0]);
+		for(i=0; i<m_pBMIH->biWidth; i++)
+		{
+			bt = pRow[i];
+			if(bt<bThre)
+				bt = 0;
+			else
+				bt = 255;
+			
+			vecDest[i] = bt;
+		}
+		pTo->SetGrayRow(j, &vecDest[0]);
+	}
+}
+
+
+
+
+
+
+
+/**************************************************
+void CImgProcess::AdaptiveThreshold(CImgProcess *pTo, int nWinSize, double dOffset)
+
+ܣ
+	ֲֵӦֵָڹղͼ
+ע
+	nWinSizenWinSizeͼԵȡͼڵĲ֣ľֵ
+	ȥdOffsetΪصֵֵ0255
+	ֵɻͼãʱ봰ڴС޹
+
+
+	CImgProcess * pTo
+		CImgProcessָ
+	int nWinSize
+		򴰿ڵı߳
+	double dOffset
+		ֵԾֲֵƫƣԽԽرΪǰ255
+ֵ
+	
+***************************************************/
+
+void CImgProcess::AdaptiveThreshold(CImgProcess *pTo, int nWinSize, double dOffset)
+{
+	int i, j;
+
+	int nHeight = GetHeight();
+	int nWidth = GetWidthPixel();
+	if(nWinSize < 1)
+		nWinSize = 1;
+
+	SIntegralImage integral;
+	if(!GenIntegral(&integral))
+		return;
+
+	int nHalf = nWinSize / 2;
+	vector<BYTE> vecGray(nWidth);
+	vector<float> vecValue(nWidth);
+	vector<BYTE> vecDest(nWidth);
+
+	for(i=0; i<nHeight; i++)
+	{
+		int y0 = i - nHalf < 0 ? 0 : i - nHalf;
+		int y1 = i - nHalf + nWinSize > nHeight ? nHeight : i - nHalf + nWinSize;
+
+		const float* pRow = ReadValueRow(*this, i, vecGray, vecValue);
+		for(j=0; j<nWidth; j++)
+		{
+			int x0 = j - nHalf < 0 ? 0 : j - nHalf;
+			int x1 = j - nHalf + nWinSize > nWidth ? nWidth : j - nHalf + nWinSize;
+
+			double dThre = integral.GetMean(x0, y0, x1, y1) - dOffset;
+			vecDest[j] = (pRow[j] < dThre) ? 0 : 255;
+		}
+		pTo->SetGrayRow(i, &vecDest[0]);
+	}
+}
+
+
+
+
+struct SMaxValue
+{
+	int nValue;
+	int nDist;
+	int nAngle;
+};
+
+
+
+/******************* 
+void CImgProcessProcessing::TraceBoundary(CImgProcess* pTo)
+ 
+ ܣ
+	ٶֵͼеһҵı߽
+ ע
+	ֻܴ2ֵͼ
+
+ 
+	CImgProcess* pTo: Ŀͼ CImgProcess ָ
+	 
+ ֵ
+	
+	
+*******************/
+void CImgProcess::TraceBoundary(CImgProcess *pTo)
+{
+	pTo->InitPixels(255);//Ŀͼ
+
+	int nHeight = GetHeight();
+	int nWidth = GetWidthPixel();
+	
+	
+	//ѭ
+	int i;
+	int j;
+
+		
+	//ʼ߽뵱ǰ߽
+	POINT ptStart;
+	POINT ptCur;
+
+	//飬{£££ңϣϣϣ}
+	int Direction[8][2]={ {-1,1}, {0,1}, {1,1}, {1,0}, {1,-1}, {0,-1}, {-1,-1}, {-1,0} }; 
+	
+
+	int nCurDirect = 0; //ǰ̽鷽
+
+	int xPos;
+	int yPos;
+
+	BOOL bAtStartPt; //Ϊtrueʾ̽ոʱʼΪptCur == ptStartһֿʼһֽ
+
+	//㷨߽ϵĵ㣬ͼܵһȦ߽ð
+	for(i=0; i<nHeight; i++)
+	{
+		SetPixel(0, i, RGB(255, 255, 255));
+		SetPixel(nWidth-1, i, RGB(255, 255, 255));
+	}
+	for(j=0; j<nWidth; j++)
+	{
+		SetPixel(j, 0, RGB(255, 255, 255));
+		SetPixel(j, nHeight-1, RGB(255, 255, 255));
+	}
+
+	//ɨ
+	for(i=0; i<nHeight; i++)
+	{
+		for(j=0; j<nWidth; j++)
+		{
+			if(GetGray(j, i) == 0)//ҵϵĵһ߽
+			{
+				ptStart.x = j;
+				ptStart.y = i;
+
+				ptCur = ptStart;
+				bAtStartPt = true;				
+				while(	( (ptCur.x != ptStart.x) || (ptCur.y != ptStart.y) )	|| bAtStartPt	)
+				{
+					bAtStartPt = false;
+
+					//һ̽λ
+					xPos = ptCur.x + Direction[nCurDirect][0];
+					yPos = ptCur.y + Direction[nCurDirect][1];
+					int nSearchTimes = 1;
+
+					while( GetGray(xPos, yPos) == 255 )
+					{
+						nCurDirect ++; //ʱת45
+						if(nCurDirect >= 8)
+							nCurDirect -= 8;
+
+						xPos = ptCur.x + Direction[nCurDirect][0];
+						yPos = ptCur.y + Direction[nCurDirect][1];
+
+						if( ++nSearchTimes >= 8 ) //8жûб߽㣬˵ǹ
+						{
+							xPos = ptCur.x;
+							yPos = ptCur.y;
+							break;
+						}
+					}
+									
+					//ҵһ߽
+					ptCur.x = xPos;
+					ptCur.y = yPos;
+					pTo->SetPixel(ptCur.x, ptCur.y, RGB(0, 0, 0)); //ͼϱǱ߽
+					/************
+					ڴ˴ʵĴ룬Ҫμ¼±߽ptCur
+					************/
+
+					nCurDirect -= 2; //ǰ̽鷽˳ʱת90Ϊһε̽ʼ
+					if(nCurDirect < 0)
+						nCurDirect += 8;
+				}
+				return;
+			}// if
+			
+			/************
+			ڴ˴ʵĴ룬ȥreturn䣬Ҫͼı߽硣
+			************/
+
+		}// for j
+	}// for i
+	
+}
+
+
+
+// ɨ䣬FillRgnRegionGrowPixelImageá
+// ɸɶɣڵĶγÿһΣͰ
+// ڵеķΧŽʽĴɨջȡɨ裬ݹ飬
+// ٴҲջÿжһǷжϺ
+// vecMarkУʱΧһȦ
+#define FILL_NONE	0	// δж
+#define FILL_IN		1	// 
+#define FILL_OUT	2	// жϣ
+
+// ɨһΣnYе[nLeft, nRight]
+struct SFillSpan
+{
+	int nY, nLeft, nRight;
+};
+
+struct SScanFill
+{
+	int nWidth;
+	int nLeft, nTop, nRight, nBottom;	// ķΧ߽
+	BOOL b8;			// 8ͨ4ͨ
+	BOOL bKeepOut;		// Ƿ¼ΪFILL_OUT
+	vector<BYTE> vecMark;		// صFILL_*
+	vector<SFillSpan> vecStack;	// ɨĶ
+	vector<int> vecOut;		// ΪFILL_OUT±꣬ıоݺж
+};
+
+// ͼnBorderز
+static void InitScanFill(SScanFill* pFill, int nWidth, int nHeight, int nBorder, BOOL b8, BOOL bKeepOut)
+{
+	pFill->nWidth = nWidth;
+	pFill->nLeft = nBorder;
+	pFill->nTop = nBorder;
+	pFill->nRight = nWidth - 1 - nBorder;
+	pFill->nBottom = nHeight - 1 - nBorder;
+	pFill->b8 = b8;
+	pFill->bKeepOut = bKeepOut;
+	pFill->vecMark.assign((size_t)nWidth * nHeight, FILL_NONE);
+	pFill->vecStack.clear();
+	pFill->vecOut.clear();
+}
+
+// ͼĻҶȣ
+static void ReadGrayImage(const CImg& img, vector<BYTE>& vecGray)
+{
+	int nHeight = img.GetHeight();
+	int nWidth = img.GetWidthPixel();
+	vecGray.resize((size_t)nWidth * nHeight);
+
+	for(int i=0; i<nHeight; i++)
+	{
+		BYTE* pDst = &vecGray[(size_t)i * nWidth];
+		const BYTE* pSrc = img.GetGrayRow(i, pDst);
+		if(pSrc != pDst)
+			memcpy(pDst, pSrc, nWidth);
+	}
+}
+
+template<class TFill>
+static inline BOOL TestFillPixel(SScanFill& fill, TFill& rgn, int p)
+{
+	if(rgn.Test(p))
+	{
+		fill.vecMark[p] = FILL_IN;
+		return TRUE;
+	}
+
+	fill.vecMark[p] = FILL_OUT;
+	if(fill.bKeepOut)
+		fill.vecOut.push_back(p);
+	return FALSE;
+}
+
+// ӵyеxеؿʼ䣬
+// rgn.Test(p)ж±ΪpǷÿһεһ
+// rgn.Span(y, nLeft, nRight)
+template<class TFill>
+static int ScanFill(SScanFill& fill, int x, int y, TFill& rgn)
+{
+	int nWidth = fill.nWidth;
+	int nCount = 0;
+
+	SFillSpan seed = {y, x, x};
+	fill.vecStack.push_back(seed);
+
+	while(!fill.vecStack.empty())
+	{
+		SFillSpan cur = fill.vecStack.back();
+		fill.vecStack.pop_back();
+
+		int nRowPos = cur.nY * nWidth;
+		const BYTE* pMark = &fill.vecMark[nRowPos];
+
+		for(int j=cur.nLeft; j<=cur.nRight; j++)
+		{
+			if(pMark[j] != FILL_NONE || !TestFillPixel(fill, rgn, nRowPos + j))
+				continue;
+
+			// һ
+			int nLeft = j, nRight = j;
+			while(nLeft > fill.nLeft && pMark[nLeft - 1] == FILL_NONE && TestFillPixel(fill, rgn, nRowPos + nLeft - 1))
+				nLeft--;
+			while(nRight < fill.nRight && pMark[nRight + 1] == FILL_NONE && TestFillPixel(fill, rgn, nRowPos + nRight + 1))
+				nRight++;
+
+			nCount += nRight - nLeft + 1;
+			rgn.Span(cur.nY, nLeft, nRight);
+
+			// һڵķΧ8ͨʱбԽ
+			SFillSpan next;
+			next.nLeft = fill.b8 ? max(nLeft - 1, fill.nLeft) : nLeft;
+			next.nRight = fill.b8 ? min(nRight + 1, fill.nRight) : nRight;
+			if(cur.nY > fill.nTop)
+			{
+				next.nY = cur.nY - 1;
+				fill.vecStack.push_back(next);
+			}
+			if(cur.nY < fill.nBottom)
+			{
+				next.nY = cur.nY + 1;
+				fill.vecStack.push_back(next);
+			}
+
+			j = nRight; //nRight + 1жϹڷΧ֮
+		}
+	}
+
+	return nCount;
+}
+
+// FillRgnоݣԭͼз0Ǳ߽磩
+struct SFillNonZero
+{
+	const BYTE* pGray;
+
+	BOOL Test(int p) const { return pGray[p] != 0; }
+	void Span(int, int, int) {}
+};
+
+
+/******************* 
+void CImgProcessProcessing::FillRgn(CImgProcess* pTo, POINT ptStart)
+ 
+ ܣ
+	 ptStart Ϊʼ㣨ӣͼ
+ ע
+	ֻܴ2ֵͼ󣬱߽ٶΪ 8 ͨptStartԭͼ *this ı߽֮
+	ɨ䣬ʱĴСȣͼһȦ
+
+ 
+	CImgProcess* pTo: Ŀͼ CImgProcess ָ
+	POINT ptStart: ӵ
+	 
+ ֵ
+	
+	
+*******************/
+
+void CImgProcess::FillRgn(CImgProcess *pTo, POINT ptStart)
+{
+	int nHeight = GetHeight();
+	int nWidth = GetWidthPixel();
+
+	vector<BYTE> vecGray;
+	ReadGrayImage(*this, vecGray);
+
+	// ߽Ϊ8ͨڲ4ͨ
+	SScanFill fill;
+	InitScanFill(&fill, nWidth, nHeight, 1, FALSE, FALSE);
+
+	// ڱ߽ϻͼһȦʱ4ڵ䣬ԭͽͬ
+	static const int nDX[5] = {0, 0, -1, 1, 0};
+	static const int nDY[5] = {0, -1, 0, 0, 1};
+	if(ptStart.x >= 0 && ptStart.x < nWidth && ptStart.y >= 0 && ptStart.y < nHeight)
+	{
+		SFillNonZero rgn = {&vecGray[0]};
+		for(int k=0; k<5; k++)
+		{
+			int x = ptStart.x + nDX[k];
+			int y = ptStart.y + nDY[k];
+			if(x < fill.nLeft || x > fill.nRight || y < fill.nTop || y > fill.nBottom)
+				continue;
+			if(fill.vecMark[(size_t)y * nWidth + x] == FILL_NONE)
+				ScanFill(fill, x, y, rgn);
+			if(k == 0 && fill.vecMark[(size_t)y * nWidth + x] == FILL_IN)
+				break;
+		}
+	}
+
+	//Ϊԭʼ߽Ĳ
+	vector<BYTE> vecRow(nWidth);
+	for(int i=0; i<nHeight; i++)
+	{
+		const BYTE* pGray = &vecGray[(size_t)i * nWidth];
+		const BYTE* pMark = &fill.vecMark[(size_t)i * nWidth];
+		for(int j=0; j<nWidth; j++)
+			vecRow[j] = (pGray[j] == 0 || pMark[j] == FILL_IN) ? 0 : 255;
+		pTo->SetGrayRow(i, &vecRow[0]);
+	}
+}
+
+
+// ͨŵĲ鼯ͼǰp丸ڵ±1Ϊ0
+// ڵָԼϲʱǰ±ĸӵ±СĸϣԸڵ
+// ±겻ÿĸդ˳ĵһ
+static inline int FindRoot(int* pLabel, int p)
+{
+	while(pLabel[p] - 1 != p)
+	{
+		int q = pLabel[p] - 1;
+		pLabel[p] = pLabel[q]; //·
+		p = q;
+	}
+	return p;
+}
+
+static inline void UnionRoots(int* pLabel, int p, int q)
+{
+	p = FindRoot(pLabel, p);
+	q = FindRoot(pLabel, q);
+	if(p < q)
+		pLabel[q] = p + 1;
+	else if(q < p)
+		pLabel[p] = q + 1;
+}
+
+// GenConnRgnдеĲ
+struct SConnRgnParam
+{
+	const CImg* pSrc;
+	int* pLabel;
+	int nConn;
+	BOOL bSkipBorder;		// ͼһȦذLabelConnRgnԭԼ
+	std::mutex mtx;
+	vector<int> vecBandBegin;	// дУmtx
+};
+
+// һ飺дڵɨ裬ֻڵһУд֮MergeConnRgnBands
+static void ConnRgnBand(int nBegin, int nEnd, LPVOID pParam)
+{
+	SConnRgnParam& param = *(SConnRgnParam*)pParam;
+	const CImg& imgSrc = *param.pSrc;
+	int* pLabel = param.pLabel;
+	BOOL b8 = (param.nConn != 4);
+
+	int nHeight = imgSrc.GetHeight();
+	int nWidth = imgSrc.GetWidthPixel();
+	int nBorder = param.bSkipBorder ? 1 : 0;
+	vector<BYTE> vecGray(nWidth);
+
+	for(int i=nBegin; i<nEnd; i++)
+	{
+		int* pRow = pLabel + (size_t)i * nWidth;
+		const int* pUp = (i > nBegin) ? pRow - nWidth : NULL;
+		memset(pRow, 0, nWidth * sizeof(int));
+		if(i < nBorder || i >= nHeight - nBorder)
+			continue;
+
+		const BYTE* pGray = imgSrc.GetGrayRow(i, &vecGray[0]);
+		for(int j=nBorder; j<nWidth-nBorder; j++)
+		{
+			if(pGray[j] != 0)
+				continue;
+
+			int p = i * nWidth + j;
+			BOOL bLeft = (j > 0 && pRow[j - 1]);
+			BOOL bUp = (pUp && pUp[j]);
+			BOOL bUpLeft = (b8 && pUp && j > 0 && pUp[j - 1]);
+			BOOL bUpRight = (b8 && pUp && j + 1 < nWidth && pUp[j + 1]);
+
+			// Ϸɨڵ㶼ڣʱغϲ
+			if(bUp)
+			{
+				pRow[j] = p - nWidth + 1;
+				if(!b8 && bLeft)
+					UnionRoots(pLabel, p - nWidth, p - 1);
+			}
+			else if(bUpRight)
+			{
+				pRow[j] = p - nWidth + 2;
+				if(bUpLeft)
+					UnionRoots(pLabel, p - nWidth + 1, p - nWidth - 1);
+				else if(bLeft)
+					UnionRoots(pLabel, p - nWidth + 1, p - 1);
+			}
+			else if(bUpLeft)
+				pRow[j] = p - nWidth;
+			else if(bLeft)
+				pRow[j] = p;
+			else
+				pRow[j] = p + 1; //µķ
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(param.mtx);
+	param.vecBandBegin.push_back(nBegin);
+}
+
+// ϲд֮ӣÿдһдĩ
+static void MergeConnRgnBands(SConnRgnParam& param, int nWidth)
+{
+	int* pLabel = param.pLabel;
+	BOOL b8 = (param.nConn != 4);
+
+	for(size_t n=0; n<param.vecBandBegin.size(); n++)
+	{
+		int i = param.vecBandBegin[n];
+		if(i == 0)
+			continue;
+
+		const int* pRow = pLabel + (size_t)i * nWidth;
+		const int* pUp = pRow - nWidth;
+		for(int j=0; j<nWidth; j++)
+		{
+			if(!pRow[j])
+				continue;
+
+			int p = i * nWidth + j;
+			if(pUp[j])
+				UnionRoots(pLabel, p, p - nWidth);
+			else if(b8)
+			{
+				if(j > 0 && pUp[j - 1])
+					UnionRoots(pLabel, p, p - nWidth - 1);
+				if(j + 1 < nWidth && pUp[j + 1])
+					UnionRoots(pLabel, p, p - nWidth + 1);
+			}
+		}
+	}
+}
+
+// դ˳Ѹڵ±껻յıŲͳơڵ±С
+// ɨ赽pʱڵѻձţݴΪֱȡü
+static void NumberConnRgn(SConnRgnLabel* pLabel)
+{
+	int nWidth = pLabel->nWidth;
+	int nHeight = pLabel->nHeight;
+	int* pData = pLabel->vecLabel.empty() ? NULL : &pLabel->vecLabel[0];
+
+	vector<SConnRgnStat>& vecStat = pLabel->vecStat;
+	vector<double> vecSumX, vecSumY;
+	vecStat.clear();
+
+	for(int i=0; i<nHeight; i++)
+	{
+		int* pRow = pData + (size_t)i * nWidth;
+		for(int j=0; j<nWidth; j++)
+		{
+			if(!pRow[j])
+				continue;
+
+			int p = i * nWidth + j;
+			int q = pRow[j] - 1;
+			int n;
+			if(q == p)
+			{
+				SConnRgnStat stat = {0, j, i, j, i, 0, 0};
+				vecStat.push_back(stat);
+				vecSumX.push_back(0);
+				vecSumY.push_back(0);
+				n = (int)vecStat.size();
+			}
+			else
+				n = -pData[q];
+			pRow[j] = -n;
+
+			SConnRgnStat& stat = vecStat[n - 1];
+			stat.nArea++;
+			stat.nLeft = min(stat.nLeft, j);
+			stat.nRight = max(stat.nRight, j);
+			stat.nBottom = i;
+			vecSumX[n - 1] += j;
+			vecSumY[n - 1] += i;
+		}
+	}
+
+	for(size_t k=0; k<pLabel->vecLabel.size(); k++)
+		pData[k] = -pData[k];
+
+	for(size_t n=0; n<vecStat.size(); n++)
+	{
+		vecStat[n].dCenterX = vecSumX[n] / vecStat[n].nArea;
+		vecStat[n].dCenterY = vecSumY[n] / vecStat[n].nArea;
+	}
+	pLabel->nCount = (int)vecStat.size();
+}
+
+static void LabelConnRgnImpl(const CImg& imgSrc, SConnRgnLabel* pLabel, int nConn, BOOL bSkipBorder)
+{
+	int nHeight = imgSrc.GetHeight();
+	int nWidth = imgSrc.GetWidthPixel();
+
+	pLabel->nWidth = nWidth;
+	pLabel->nHeight = nHeight;
+	pLabel->vecLabel.resize((size_t)nWidth * nHeight);
+
+	if(!pLabel->vecLabel.empty())
+	{
+		SConnRgnParam param;
+		param.pSrc = &imgSrc;
+		param.pLabel = &pLabel->vecLabel[0];
+		param.nConn = nConn;
+		param.bSkipBorder = bSkipBorder;
+
+		CImgParallel::For(0, nHeight, ConnRgnBand, &param, 0, 64);
+		MergeConnRgnBands(param, nWidth);
+	}
+
+	NumberConnRgn(pLabel);
+}
+
+/**************************************************
+BOOL CImgProcess::GenConnRgn(SConnRgnLabel* pLabel, int nConn)
+
+ܣ
+	עֵͼͨҶΪ0Ϊǰõ32λͼ
+	ӾΡ
+
+ע
+	ɨĲ鼯㷨һ鰴дУÿֻɨڵ㣬
+	ڵֱӼڱͼУд֮ϲڶ鰴դ
+	˳ţͬʱͳơֻintΧƣ߳޹
+
+
+	SConnRgnLabel* pLabel
+		ıͼͳ
+	int nConn
+		ȡֵΪ48ʾ4ͨ8ͨĬΪ8
+
+ֵ
+	BOOLͣnConn48ʱFALSE
+***************************************************/
+BOOL CImgProcess::GenConnRgn(SConnRgnLabel* pLabel, int nConn)
+{
+	if(nConn != 4 && nConn != 8)
+		return FALSE;
+
+	LabelConnRgnImpl(*this, pLabel, nConn, FALSE);
+	return TRUE;
+}
+
+/*******************
+void CImgProcess::LabelConnRgn(CImgProcess* pTo, int nConn)
+
+ܣעͨ
+
+עֵֻܴͼͼܵһȦزעΪɫ
+	nͨդ˳򣩵ΪҶnע255
+	ԭGenConnRgnĲ鼯㷨ʵ֣Ҫ32λ
+	ͳʱֱӵGenConnRgn
+
+
+	CImgProcess* pToĿͼ CImgProcess ָ
+	int nConnȡֵΪ48ʾ4ͨ8ͨĬΪ8
+
+ֵ:
+	int 
+*******************/
+void CImgProcess::LabelConnRgn(CImgProcess* pTo, int nConn)
+{
+	int i, j;
+	int nHeight = GetHeight();
+	int nWidth = GetWidthPixel();
+
+	SConnRgnLabel label;
+	LabelConnRgnImpl(*this, &label, nConn == 4 ? 4 : 8, TRUE);
+
+	*pTo = *this;
+	pTo->MakeUnique();
+
+	//㷨߽ϵĵ㣬ͼܵһȦ߽ð
+	for(i=0; i<nHeight; i++)
+	{
+		pTo->SetPixel(0, i, RGB(255, 255, 255));
+		pTo->SetPixel(nWidth-1, i, RGB(255, 255, 255));
+	}
+	for(j=0; j<nWidth; j++)
+	{
+		pTo->SetPixel(j, 0, RGB(255, 255, 255));
+		pTo->SetPixel(j, nHeight-1, RGB(255, 255, 255));
+	}
+
+	BOOL bGray8 = (pTo->GetFormat() == IMG_FMT_GRAY8);
+	for(i=0; i<nHeight; i++)
+	{
+		const int* pLabel = label.GetLabel(i);
+		BYTE* pRow = bGray8 ? pTo->GetRow(i) : NULL;
+		for(j=0; j<nWidth; j++)
+		{
+			int n = pLabel[j];
+			if(n == 0 || n > 255)
+				continue;
+
+			if(bGray8)
+				pRow[j] = (BYTE)n;
+			else
+				pTo->SetPixel(j, i, RGB(n, n, n));
+		}
+	}
+
+	if(label.nCount > 255)
+		ImgMessage("Ŀǰúֱ֧ע255ͨ");
+}
+
+
+
+
+
+
+
+
+
+/******************* 
+void CImgProcess::Thining(CImgProcess* pTo)
+ 
+ ܣ
+	ϸ
+ ע
+	ֻܴ2ֵͼ
+
+ 
+	
+	
+ ֵ
+		
+*******************/
+
+void CImgProcess::Thining()
+{
+	
+	int nHeight = GetHeight();
+	int nWidth = GetWidthPixel();
+
+	//ĸ
+	BOOL bCondition1;
+	BOOL bCondition2;
+	BOOL bCondition3;
+	BOOL bCondition4;
+
+	//55ֵ
+	unsigned char neighbour[5][5];
+
+	int i, j;
+	int m, n;
+
+	BOOL bModified = TRUE;
+
+
+	while(bModified)
+	{		
+		bModified = FALSE;
+		CImgProcess pic = *this;
+		pic.InitPixels(255); //Ŀͼ
+		
+		for(j=2; j<nHeight-2; j++)
+		{
+			for(i=2; i<nWidth-2; i++)
+			{				
+				bCondition1 = FALSE;
+				bCondition2 = FALSE;
+				bCondition3 = FALSE;
+				bCondition4 = FALSE;
+				
+				BYTE data = GetGray(i, j);
+				if(data == 255)
+					continue;
+				
+				
+				// õǰڵ55ֵɫ0ɫ1
+				for (m = 0;m < 5;m++ )
+				{
+					for (n = 0;n < 5;n++)
+					{
+						neighbour[m][n] = (GetGray(i + n - 2, j + m - 2) == 0);
+					}
+				}
+				//				neighbour[][]
+				//ж
+				//ж2<=NZ(P1)<=6
+				int nCount =  neighbour[1][1] + neighbour[1][2] + neighbour[1][3] \
+					+ neighbour[2][1] + neighbour[2][3] + \
+					+ neighbour[3][1] + neighbour[3][2] + neighbour[3][3];
+				if ( nCount >= 2 && nCount <=6)
+					bCondition1 = TRUE;
+				
+				//жZ0(P1)=1
+				nCount = 0;
+				if (neighbour[1][2] == 0 && neighbour[1][1] == 1)
+					nCount++;
+				if (neighbour[1][1] == 0 && neighbour[2][1] == 1)
+					nCount++;
+				if (neighbour[2][1] == 0 && neighbour[3][1] == 1)
+					nCount++;
+				if (neighbour[3][1] == 0 && neighbour[3][2] == 1)
+					nCount++;
+				if (neighbour[3][2] == 0 && neighbour[3][3] == 1)
+					nCount++;
+				if (neighbour[3][3] == 0 && neighbour[2][3] == 1)
+					nCount++;
+				if (neighbour[2][3] == 0 && neighbour[1][3] == 1)
+					nCount++;
+				if (neighbour[1][3] == 0 && neighbour[1][2] == 1)
+					nCount++;
+				if (nCount == 1)
+					bCondition2 = TRUE;
+				
+				//жP2*P4*P8=0 or Z0(p2)!=1
+				if (neighbour[1][2]*neighbour[2][1]*neighbour[2][3] == 0)
+					bCondition3 = TRUE;
+				else
+				{
+					nCount = 0;
+					if (neighbour[0][2] == 0 && neighbour[0][1] == 1)
+						nCount++;
+					if (neighbour[0][1] == 0 && neighbour[1][1] == 1)
+						nCount++;
+					if (neighbour[1][1] == 0 && neighbour[2][1] == 1)
+						nCount++;
+					if (neighbour[2][1] == 0 && neighbour[2][2] == 1)
+						nCount++;
+					if (neighbour[2][2] == 0 && neighbour[2][3] == 1)
+						nCount++;
+					if (neighbour[2][3] == 0 && neighbour[1][3] == 1)
+						nCount++;
+					if (neighbour[1][3] == 0 && neighbour[0][3] == 1)
+						nCount++;
+					if (neighbour[0][3] == 0 && neighbour[0][2] == 1)
+						nCount++;
+					if (nCount != 1)
+						bCondition3 = TRUE;
+				}
+				
+				//жP2*P4*P6=0 or Z0(p4)!=1
+				if (neighbour[1][2]*neighbour[2][1]*neighbour[3][2] == 0)
+					bCondition4 = TRUE;
+				else
+				{
+					nCount = 0;
+					if (neighbour[1][1] == 0 && neighbour[1][0] == 1)
+						nCount++;
+					if (neighbour[1][0] == 0 && neighbour[2][0] == 1)
+						nCount++;
+					if (neighbour[2][0] == 0 && neighbour[3][0] == 1)
+						nCount++;
+					if (neighbour[3][0] == 0 && neighbour[3][1] == 1)
+						nCount++;
+					if (neighbour[3][1] == 0 && neighbour[3][2] == 1)
+						nCount++;
+					if (neighbour[3][2] == 0 && neighbour[2][2] == 1)
+						nCount++;
+					if (neighbour[2][2] == 0 && neighbour[1][2] == 1)
+						nCount++;
+					if (neighbour[1][2] == 0 && neighbour[1][1] == 1)
+						nCount++;
+					if (nCount != 1)
+						bCondition4 = TRUE;
+				}
+				
+				if(bCondition1 && bCondition2 && bCondition3 && bCondition4)
+				{
+					pic.SetPixel(i, j, RGB(255, 255, 255));
+					bModified = TRUE;
+				}
+				else
+				{
+					pic.SetPixel(i, j, RGB(0, 0, 0));
+				}
+				
+			} //for i
+		} //for j
+	
+		*this = pic;
+	}//while
+}
+
+
+
+
+/**************************************************
+BOOL CImgProcess::Hough(SLineInfo *pInfoRet, int nLineRet)
+ܣ
+	任
+ע
+	ֵֻܴͼһӦΪԵͼ񣨺ɫɫǰ
+
+	SLineInfo *pInfoRet
+		ֱϢ
+	int nLineRet
+		ҪѰҵֱĿ
+
+ֵ
+	BOOLͣtrueΪɹfalseΪʧ
+***************************************************/
+BOOL CImgProcess::Hough(SLineInfo *pInfoRet, int nLineRet)
+{
+	int i, j;
+	
+	
+	// еRhoTheta
+	int nMaxDist = sqrt(GetHeight()*GetHeight() + GetWidthPixel()*GetWidthPixel());
+	int nMaxAngle = 90;
+
+	// Ϊռ
+	int nAreaNum = nMaxAngle * nMaxDist * 2;
+	int *pTransArea = new int[nAreaNum];	
+	memset(pTransArea, 0, nAreaNum * sizeof(int));
+	
+	// ת
+	BYTE bt;
+	int nAngle, nDist; //µĽǶȺͼ
+	double fRadian; //
+	for(i = 0; i < GetHeight(); i ++)
+	{
+		for(j=0; j<GetWidthPixel(); j++)
+		{
+			bt = GetGray(j, i);
+			if(bt == 255)
+			{
+				for(nAngle = 0; nAngle < nMaxAngle; nAngle ++)
+				{
+					fRadian = nAngle*2*PI/180.0; //תΪ
+					nDist = (j*cos(fRadian) + i*sin(fRadian)); //㼫
+					
+					if(nDist >= 0)//
+					{
+						pTransArea[nDist*nMaxAngle + nAngle] ++;
+					}
+					else//
+					{
+						//nDist = fabs(nDist);
+						nDist = nDist > 0 ? nDist : -nDist; //@ran
+						pTransArea[nMaxAngle * nMaxDist + nDist*nMaxAngle + nAngle] ++;
+					}
+				}//for nAngle
+			}//if
+		}//for j
+	}//for i
+	
+	
+	SMaxValue MaxValue1;
+
+	//ʱǶȺͼķΧ
+	int nMaxDisAllow = 20;
+	int nMaxAngleAllow = 5;
+
+	for(int nLine=0; nLine<nLineRet; nLine++) //ѰǰnLineRetֵ
+	{	
+		// Ѱ
+		MaxValue1.nValue = 0;
+		for(i=0; i<nAreaNum; i++)
+		{
+			if(pTransArea[i] > MaxValue1.nValue)
+			{
+				MaxValue1.nValue = pTransArea[i];
+				MaxValue1.nAngle = i;
+			}
+		}
+		
+		if(MaxValue1.nValue == 0) //ҲܵĹߵ
+		{
+			return FALSE;
+		}
+		
+		if(MaxValue1.nAngle < nMaxAngle * nMaxDist)
+		{
+			MaxValue1.nDist = MaxValue1.nAngle/nMaxAngle;
+			MaxValue1.nAngle = MaxValue1.nAngle%nMaxAngle;
+		}
+		else
+		{
+			MaxValue1.nAngle -= nMaxAngle * nMaxDist;
+			
+			MaxValue1.nDist = MaxValue1.nAngle/nMaxAngle;
+			MaxValue1.nDist *= -1;
+			
+			
+			MaxValue1.nAngle = MaxValue1.nAngle%nMaxAngle;
+		}
+		
+		// pInfoRetṹָ
+		pInfoRet[nLine].nAngle = MaxValue1.nAngle*2;
+		pInfoRet[nLine].nDist = MaxValue1.nDist;
+		pInfoRet[nLine].nPixels = MaxValue1.nValue;	
+		
+		if(pInfoRet[nLine].nDist < 0)
+		{
+			pInfoRet[nLine].nAngle = pInfoRet[nLine].nAngle - 180;
+			pInfoRet[nLine].nDist = pInfoRet[nLine].nDist*(-1);
+			
+		}
+		
+		// 㣬ΪѰһֵ׼
+		for(nDist = (-1)*nMaxDisAllow; nDist <= nMaxDisAllow; nDist ++)
+		{
+			for(nAngle = (-1)*nMaxAngleAllow; nAngle <= nMaxAngleAllow; nAngle ++)
+			{
+				int nThisDist = MaxValue1.nDist + nDist;
+				int nThisAngle = MaxValue1.nAngle + nAngle;
+				
+				
+				
+				nThisAngle *= 2;
+				
+				if(nThisAngle < 0 && nThisAngle >= -180)
+				{
+					nThisAngle += 180;
+					nThisDist *= -1;
+				}
+				if(nThisAngle >= 180 && nThisAngle < 360)
+				{
+					nThisAngle -= 180; 
+					nThisDist *= -1;
+				}
+				
+				
+				nThisDist = nThisDist>0 ? nThisDist : -nThisDist; //@ran
+				if (/*fabs(nThisDist)*/nThisDist <= nMaxDist
+					&& nThisAngle >= 0 && nThisAngle <= nMaxAngle*2)
+				{
+					nThisAngle /= 2;
+					if(nThisDist >= 0)
+					{
+						pTransArea[nThisDist*nMaxAngle + nThisAngle] = 0;
+					}
+					else
+					{
+						//nThisDist = fabs(nThisDist);
+						nThisDist = nThisDist>0 ? nThisDist : -nThisDist;  //@ran
+						pTransArea[nMaxDist*nMaxAngle + nThisDist*nMaxAngle + nThisAngle] = 0;
+					}
+				}
+			}//for nAngle
+		}//for nDist
+	}//for nLine
+
+	
+	delete []pTransArea; //ͷżռ
+	
+	
+	return TRUE;
+}
+/*
+BOOL CImgProcess::Hough(SLineInfo *pInfoRet, int nLineRet)
+{
+	//任ĳߴ
+	int iMaxDist;
+	int iMaxAngleNumber;
+
+	//任
+	int iDist;
+	int iAngleNumber;
+
+	int i, j;//ѭ
+	
+
+	//ֵ
+	unsigned char pixel;
+
+	//洢任еֵ
+	SMaxValue MaxValue1;
+	SMaxValue MaxValue2;
+	
+
+	//任ĳߴ
+	//
+	iMaxDist = (int) sqrt(GetWidthPixel()*GetWidthPixel() + GetHeight()*GetHeight());
+
+	//Ƕȴ0180ÿ2
+	iMaxAngleNumber = 90;
+
+	int nAreaNum = iMaxAngleNumber * iMaxDist;
+	int *pTransArea = new int[nAreaNum];
+	
+	memset(pTransArea, 0, nAreaNum * sizeof(int));
+
+	for(j = 0; j <GetHeight(); j++)
+	{
+		for(i = 0;i <GetWidthPixel(); i++)
+		{
+
+			pixel = GetGray(i, j);
+			// ָԴͼjУiصָ			
+			
+
+			//Ŀͼк0255Ҷֵ
+			if(pixel != 255 && pixel != 0)
+				return FALSE;
+
+			//Ǻڵ㣬ڱ任ĶӦϼ1
+			if(pixel == 0)
+			{
+				//עⲽ2
+				for(iAngleNumber=0; iAngleNumber<iMaxAngleNumber; iAngleNumber++)
+				{
+					iDist = (int) fabs(i*cos(iAngleNumber*2*PI/180.0) + \
+						j*sin(iAngleNumber*2*PI/180.0));
+				
+					//任ĶӦϼ1
+					*(pTransArea+iDist*iMaxAngleNumber+iAngleNumber) = \
+						*(pTransArea+iDist*iMaxAngleNumber+iAngleNumber) +1;
+				}
+			}
+		
+		}
+	}
+				
+	//ҵ任еֵ
+	MaxValue1.nValue=0;
+	MaxValue2.nValue=0;
+	
+	//ҵһֵ
+	for (iDist=0; iDist<iMaxDist;iDist++)
+	{
+		for(iAngleNumber=0; iAngleNumber<iMaxAngleNumber; iAngleNumber++)
+		{
+			if((int)*(pTransArea+iDist*iMaxAngleNumber+iAngleNumber)>MaxValue1.nValue)
+			{
+				MaxValue1.nValue = (int)*(pTransArea+iDist*iMaxAngleNumber+iAngleNumber);
+				MaxValue1.nDist = iDist;
+				MaxValue1.nAngle = iAngleNumber;
+			}
+
+		}
+	}
+
+	//һֵ㸽
+	for (iDist = -9;iDist < 10;iDist++)
+	{
+		for(iAngleNumber=-1; iAngleNumber<2; iAngleNumber++)
+		{
+			if(iDist+MaxValue1.nDist>=0 && iDist+MaxValue1.nDist<iMaxDist \
+				&& iAngleNumber+MaxValue1.nAngle>=0 && iAngleNumber+MaxValue1.nAngle<=iMaxAngleNumber)
+			{
+				*(pTransArea+(iDist+MaxValue1.nDist)*iMaxAngleNumber+\
+					(iAngleNumber+MaxValue1.nAngle))=0;
+			}
+		}
+	}
+
+	
+	pInfoRet[0].nAngle = 2*MaxValue1.nAngle;
+	pInfoRet[0].nDist = MaxValue1.nDist;
+
+	for(j = 0; j <GetHeight(); j++)
+		{
+			for(i = 0;i <GetWidthPixel(); i++)
+			{	
+				
+				// ָ򻺴ͼjУiصָ			
+				
+
+				
+
+				//ڵһֱ
+				iDist = (int) fabs(i*cos(MaxValue1.nAngle*2*PI/180.0) + \
+							j*sin(MaxValue1.nAngle*2*PI/180.0));
+				if (iDist == MaxValue1.nDist)
+					pTo->SetPixel(i, j, RGB(0, 0, 0));
+			}
+	}
+
+	
+
+	// 
+	return TRUE;
+
+}
+
+*/
+
+
+// PixelImageоݣҶΪ0أͬʱۼӸε
+struct SFillCentroid
+{
+	const BYTE* pGray;
+	int64_t nSumX, nSumY;
+
+	BOOL Test(int p) const { return pGray[p] == 0; }
+	void Span(int y, int nLeft, int nRight)
+	{
+		int64_t n = nRight - nLeft + 1;
+		nSumX += (int64_t)(nLeft + nRight) * n / 2;
+		nSumY += (int64_t)y * n;
+	}
+};
+
+/******************* 
+void CImgProcess::PixelImage(CImgProcess* pTo, int lowerThres, int upperThres)
+ 
+ ܣ
+	ػС upperThres  lowerThres ֮ͨػλΪԭģ
+	˳С lowerThres ͨ
+	˳С upperThres ͨ
+ ע
+	ֻܴ2ֵͼ
+	ÿ8ͨɨͳһΣʱͼСȣupperThres
+
+ 
+ CImgProcess* pTo: Ŀͼ CImgProcess ָ 
+	upperThres: ֵ
+	lowerThres: ֵ
+ 
+ ֵ
+	
+	
+*******************/
+void CImgProcess::PixelImage(CImgProcess* pTo, int lowerThres, int upperThres)
+{
+	if(upperThres < lowerThres)
+	{
+		ImgMessage("ֵֵ");
+		return;
+	}
+
+	if(lowerThres < 0)
+		lowerThres = 0;
+
+	int nHeight = GetHeight();
+	int nWidth = GetWidthPixel();
+
+	vector<BYTE> vecGray;
+	ReadGrayImage(*this, vecGray);
+
+	SScanFill fill;
+	InitScanFill(&fill, nWidth, nHeight, 0, TRUE, FALSE);
+
+	pTo->InitPixels(255); //ػͼ񣬳ʼΪɫ
+
+	SFillCentroid rgn;
+	rgn.pGray = vecGray.empty() ? NULL : &vecGray[0];
+
+	for(int i=0; i<nHeight; i++)
+	{
+		for(int j=0; j<nWidth; j++)
+		{
+			int p = i * nWidth + j;
+			if(vecGray[p] != 0 || fill.vecMark[p] != FILL_NONE)
+				continue;
+
+			//ҵ1δʵĺأͨС
+			rgn.nSumX = 0;
+			rgn.nSumY = 0;
+			int nSize = ScanFill(fill, j, i, rgn);
+			if(nSize >= lowerThres && nSize <= upperThres)
+				pTo->SetPixel((int)(rgn.nSumX / nSize), (int)(rgn.nSumY / nSize), RGB(0, 0, 0));
+		}// for j
+	}// for i
+}
+
+
+
+/******************* 
+TestConnRgn(CImgProcess* pImage, LPBYTE lpVisited, int nWidth, int nHeight, int x, int y, POINT ptVisited[], int lowerThres, int upperThres, int &curConnRgnSize)
+ 
+ ܣ
+	ͳƵ (x, y) ͨĴС lowerThres  upperThres ֮Ĺϵ
+ ע
+	ֻܴ2ֵͼ
+	ʽջݹ˳ݹʱͬͨٴҲջ
+	ptVisitedҪ upperThres + 1 
+
+ 
+ CImgProcess* pImage; ͼ CImgProcess ָ 
+ LPBYTE lpVisited     ־λ
+ int nWidth       ͼĿ
+ int nHeigh       ͼĸ߶
+ int x            ǰĺ
+ int y            ǰ
+ Cpoint ptVisited[]     ѿĵ
+ int curConnRgnSize     ǰΪֵֹͨĴС
+ 
+ ֵ
+ int
+	= 0: ͨС lowerThres  upperThres ֮
+	= 1: ͨС upperThres
+	=-1: ͨС lowerThres
+ 
+*******************/
+int CImgProcess::TestConnRgn(CImgProcess* pImage, LPBYTE lpVisited, int nWidth, int nHeight, int x, int y, POINT ptVisited[], int lowerThres, int upperThres, int &curConnRgnSize)
+{ 
+	// 8ڽӵĿ˳ϡϡ¡¡¡ҡ
+	static const int nDX[8] = {0, -1, -1, -1, 0, 1, 1, 1};
+	static const int nDY[8] = {-1, -1, 0, 1, 1, 1, 0, -1};
+
+	// ջÿһΪһڿڽӵĵ㣬nDirΪһҪķ
+	struct SFrame
+	{
+		int x, y, nDir;
+	};
+
+	if(curConnRgnSize > upperThres) //ͨСѳֵupperThres
+	   return 1;
+
+	curConnRgnSize++; //µǰΪֵֹͨĴС
+	lpVisited[nWidth*y+x]=true; //ѷ
+	ptVisited[curConnRgnSize-1].x=x;
+	ptVisited[curConnRgnSize-1].y=y; //¼ѷʵ
+
+	if(curConnRgnSize >= upperThres)
+		return 1;
+
+	vector<SFrame> vecStack;
+	SFrame top = {x, y, 0};
+	vecStack.push_back(top);
+
+	while(!vecStack.empty())
+	{
+		SFrame& cur = vecStack.back();
+		if(cur.nDir == 8)
+		{
+			vecStack.pop_back();
+			continue;
+		}
+
+		int xNext = cur.x + nDX[cur.nDir];
+		int yNext = cur.y + nDY[cur.nDir];
+		cur.nDir++;
+
+		if(xNext < 0 || xNext >= nWidth || yNext < 0 || yNext >= nHeight)
+			continue;
+		if(lpVisited[yNext*nWidth + xNext] || pImage->GetGray(xNext, yNext) != 0)
+			continue;
+
+		//ڽӵΪɫ壩ͨС+1
+		curConnRgnSize++;
+		lpVisited[yNext*nWidth + xNext] = true;
+		ptVisited[curConnRgnSize-1].x = xNext;
+		ptVisited[curConnRgnSize-1].y = yNext;
+
+		if(curConnRgnSize > upperThres)
+			return 1;
+
+		//ﵽֵĵ㲻ٿڽӵ
+		if(curConnRgnSize < upperThres)
+		{
+			SFrame next = {xNext, yNext, 0};
+			vecStack.push_back(next);
+		}
+	}
+
+	if (curConnRgnSize < lowerThres)
+		return -1; //ͨС lowerThres
+
+    return 0;//ͨС lowerThres  upperThres ֮
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+//***************************************ͶӰУ*************************************//
+
+/*******************
+void CImgProcess::ProdMat(double** ppDbMat, double *pDbSrc2, double *pDbDest, int y, int x, int z)
+
+ܣĳ˻
+
+עúˣȻ˵ĽpDbDestС
+    pDbSrc1 *ĴСΪ x*zpDbSrc2ĴСΪ z*ypDbDestĴСΪ x*y
+
+
+double  *pDbSrc1	- ָ˾1ڴ
+double  *pDbSrc2	- ָ˾2ڴ
+double  *pDbDest   - žнڴָ
+int     x		- ĳߴ磬μע
+int     y		- ĳߴ磬μע
+int     z		- ĳߴ磬μע
+ 
+ ֵ:
+	
+ 
+ *******************/
+void CImgProcess::ProdMat(double** ppDbMat, double *pDbSrc2, double *pDbDest, int y, int x, int z)
+{
+	int nCnt = 0;
+	int i,j;
+	double * pDbSrc1 = new double[m_nBasePt * m_nBasePt];
+	for(i=0; i<m_nBasePt; i++)
+	{
+		for(j=0; j<m_nBasePt; j++)
+			pDbSrc1[nCnt++] = ppDbMat[i][j];
+	}
 
-	
-	delete []pTransArea; //ͷżռ
-	
-	
-	return TRUE;
+	for(i=0;i<y;i++)
+	{
+		for(j=0;j<x;j++)
+		{
+			pDbDest[i*x + j] = 0;
+			for(int m=0;m<z;m++)
+				pDbDest[i*x + j] += pDbSrc1[i*z + m]*pDbSrc2[m*x + j];
+		}
+	}
+
+	nCnt = 0;
+	for(i=0; i<m_nBasePt; i++)
+	{
+		for(j=0; j<m_nBasePt; j++)
+			ppDbMat[i][j] = pDbSrc1[nCnt++];
+	}
+
+	delete []pDbSrc1;
 }
-/*
-BOOL CImgProcess::Hough(SLineInfo *pInfoRet, int nLineRet)
-{
-	//任ĳߴ
-	int iMaxDist;
-	int iMaxAngleNumber;
 
-	//任
-	int iDist;
-	int iAngleNumber;
 
-	int i, j;//ѭ
-	
+/*******************
+void CImgProcess::GetProjPara(POINT* pPointBase, POINT* pPointSampl, double* pDbProjPara)
 
-	//ֵ
-	unsigned char pixel;
+ܣݻ׼Զ4Զȷ任
 
-	//洢任еֵ
-	SMaxValue MaxValue1;
-	SMaxValue MaxValue2;
-	
+
+POINT* pPointBase׼ͼĻ׼
+POINT* pPointSamplͼĻ׼
+double* pDbProjPara任
+ 
+ֵ:
+	
+ 
+ *******************/
+void CImgProcess::GetProjPara(POINT* pPointBase, POINT* pPointSampl, double* pDbProjPara)
+{
+	int i;
 
-	//任ĳߴ
-	//
-	iMaxDist = (int) sqrt(GetWidthPixel()*GetWidthPixel() + GetHeight()*GetHeight());
+	//ͶӰԷ̵ϵ
+	double** ppParaMat;
+	ppParaMat = new double*[m_nBasePt];
+	for(i=0; i<m_nBasePt; i++)
+	{
+		ppParaMat[i] = new double[m_nBasePt];	
+	}
 
-	//Ƕȴ0180ÿ2
-	iMaxAngleNumber = 90;
+	for(i=0; i<m_nBasePt; i++)
+	{
+		ppParaMat[i][0] = pPointBase[i].x;
+		ppParaMat[i][1] = pPointBase[i].y;
+		ppParaMat[i][2] = pPointBase[i].x * pPointBase[i].y;
+		ppParaMat[i][3] = 1;
+	}
 
-	int nAreaNum = iMaxAngleNumber * iMaxDist;
-	int *pTransArea = new int[nAreaNum];
+	double* pResMat;//
+	pResMat = new double[m_nBasePt];
+	for(i=0; i<m_nBasePt; i++)//ǰĸϵ c1,c2,c3,c4
+	{
+		pResMat[i] = pPointSampl[i].x; //ͶӰԷ̵ֵx'
+	}
 	
-	memset(pTransArea, 0, nAreaNum * sizeof(int));
+	// ϵķͶӰ任ǰ4ϵ c1,c2,c3,c4
+	InvMat(ppParaMat, m_nBasePt);
+	ProdMat(ppParaMat, pResMat, pDbProjPara, m_nBasePt, 1, m_nBasePt);//ǰ4ϵ
+	
+	for(i=0; i<m_nBasePt; i++)//ĸϵ c5,c6,c7,c8
+	{
+		pResMat[i] = pPointSampl[i].y; //ͶӰԷ̵ֵy'
+	}
+	// ϵķͶӰ任ĺ4ϵ c5,c6,c7,c8
+	ProdMat(ppParaMat, pResMat, pDbProjPara+m_nBasePt, m_nBasePt, 1, m_nBasePt);//4ϵ
 
-	for(j = 0; j <GetHeight(); j++)
+
+	//ͷſռ
+	delete[] pResMat;
+
+	for(i=0; i<m_nBasePt; i++)
 	{
-		for(i = 0;i <GetWidthPixel(); i++)
-		{
+		delete[] ppParaMat[i];	
+	}
+	delete[] ppParaMat;
+}
 
-			pixel = GetGray(i, j);
-			// ָԴͼjУiصָ			
-			
 
-			//Ŀͼк0255Ҷֵ
-			if(pixel != 255 && pixel != 0)
-				return FALSE;
+/*******************
+BOOL CImgProcess::InvMat(double** ppDbMat, int nLen)
 
-			//Ǻڵ㣬ڱ任ĶӦϼ1
-			if(pixel == 0)
+ܣppDbMat
+
+עppDbMatΪ
+
+
+double** ppDbMat
+int nLenppDbMatĳߴ
+
+ֵ:
+	BOOL
+	=trueִгɹ
+	=falseгִ
+*******************/
+BOOL CImgProcess::InvMat(double** ppDbMat, int nLen)
+{
+	double* pDbSrc = new double[nLen * nLen];
+	
+	int *is,*js,i,j,k;
+
+	//Ҫ
+	int nCnt = 0;
+	for(i=0; i<nLen; i++)
+	{
+		for(j=0; j<nLen; j++)
+			pDbSrc[nCnt++] = ppDbMat[i][j];
+	}
+
+	double d,p;
+	is = new int[nLen];
+	js = new int[nLen];
+	for(k=0;k<nLen;k++)
+	{
+		d=0.0;
+		for(i=k;i<nLen;i++)
+			for(j=k;j<nLen;j++)
 			{
-				//עⲽ2
-				for(iAngleNumber=0; iAngleNumber<iMaxAngleNumber; iAngleNumber++)
+				p=fabs(pDbSrc[i*nLen + j]); //ҵֵϵ
+				if(p>d)
 				{
-					iDist = (int) fabs(i*cos(iAngleNumber*2*PI/180.0) + \
-						j*sin(iAngleNumber*2*PI/180.0));
-				
-					//任ĶӦϼ1
-					*(pTransArea+iDist*iMaxAngleNumber+iAngleNumber) = \
-						*(pTransArea+iDist*iMaxAngleNumber+iAngleNumber) +1;
+					d = p; 
+
+					//¼ֵϵС
+					is[k] = i;
+					js[k] = j;
 				}
 			}
-		
+		if(d+1.0==1.0)
+		{//ϵȫ0ϵΪ0 󣬴ʱΪ
+			delete is;
+			delete js;
+			return FALSE;
 		}
-	}
-				
-	//ҵ任еֵ
-	MaxValue1.nValue=0;
-	MaxValue2.nValue=0;
-	
-	//ҵһֵ
-	for (iDist=0; iDist<iMaxDist;iDist++)
-	{
-		for(iAngleNumber=0; iAngleNumber<iMaxAngleNumber; iAngleNumber++)
-		{
-			if((int)*(pTransArea+iDist*iMaxAngleNumber+iAngleNumber)>MaxValue1.nValue)
+		if(is[k] != k) //ǰвԪ
+			for(j=0;j<nLen;j++)
 			{
-				MaxValue1.nValue = (int)*(pTransArea+iDist*iMaxAngleNumber+iAngleNumber);
-				MaxValue1.nDist = iDist;
-				MaxValue1.nAngle = iAngleNumber;
+				//Ԫ
+				p = pDbSrc[k*nLen + j];
+				pDbSrc[k*nLen + j] = pDbSrc[(is[k]*nLen) + j];
+				pDbSrc[(is[k])*nLen + j] = p;
+			}
+		if(js[k] != k) //ǰвԪ
+			for(i=0; i<nLen; i++)
+			{
+				//Ԫ
+				p = pDbSrc[i*nLen + k];
+				pDbSrc[i*nLen + k] = pDbSrc[i*nLen + (js[k])];
+				pDbSrc[i*nLen + (js[k])] = p;
 			}
 
-		}
-	}
+		pDbSrc[k*nLen + k]=1.0/pDbSrc[k*nLen + k]; //Ԫĵ 
+		
+		// a[k,j]a[k,k] -> a[k,j]
+		for(j=0; j<nLen; j++)
+			if(j != k)
+			{
+				pDbSrc[k*nLen + j]*=pDbSrc[k*nLen + k];
+			}
+	
+		// a[i,j] - a[i,k]a[k,j] -> a[i,j]
+		for(i=0; i<nLen; i++)
+			if(i != k)
+				for(j=0; j<nLen; j++)
+					if(j!=k)
+					{
+						pDbSrc[i*nLen + j] -= pDbSrc[i*nLen + k]*pDbSrc[k*nLen + j];
+					}
 
-	//һֵ㸽
-	for (iDist = -9;iDist < 10;iDist++)
+		// -a[i,k]a[k,k] -> a[i,k]
+		for(i=0; i<nLen; i++)
+			if(i != k)
+			{
+				pDbSrc[i*nLen + k] *= -pDbSrc[k*nLen + k];
+			}
+	}
+	for(k=nLen-1; k>=0; k--)
 	{
-		for(iAngleNumber=-1; iAngleNumber<2; iAngleNumber++)
-		{
-			if(iDist+MaxValue1.nDist>=0 && iDist+MaxValue1.nDist<iMaxDist \
-				&& iAngleNumber+MaxValue1.nAngle>=0 && iAngleNumber+MaxValue1.nAngle<=iMaxAngleNumber)
+		//ָ 
+		if(js[k] != k)
+			for(j=0; j<nLen; j++)
 			{
-				*(pTransArea+(iDist+MaxValue1.nDist)*iMaxAngleNumber+\
-					(iAngleNumber+MaxValue1.nAngle))=0;
+				p = pDbSrc[k*nLen + j];
+				pDbSrc[k*nLen + j] = pDbSrc[(js[k])*nLen + j];
+				pDbSrc[(js[k])*nLen + j] = p;
+			}
+		//ָ
+		if(is[k] != k)
+			for(i=0; i<nLen; i++)
+			{
+				p = pDbSrc[i*nLen + k];
+				pDbSrc[i*nLen + k] = pDbSrc[i*nLen +(is[k])];
+				pDbSrc[i*nLen + (is[k])] = p;
 			}
+	}
+
+	//ϵppDbMat
+	nCnt = 0;
+	for(i=0; i<m_nBasePt; i++)
+	{
+		for(j=0; j<m_nBasePt; j++)
+		{
+			ppDbMat[i][j] = pDbSrc[nCnt++];
 		}
 	}
 
-	
-	pInfoRet[0].nAngle = 2*MaxValue1.nAngle;
-	pInfoRet[0].nDist = MaxValue1.nDist;
+	//ͷſռ
+	delete is;
+	delete js;
+	delete[] pDbSrc;
 
-	for(j = 0; j <GetHeight(); j++)
-		{
-			for(i = 0;i <GetWidthPixel(); i++)
-			{	
-				
-				// ָ򻺴ͼjУiصָ			
-				
+	return TRUE;	
 
-				
+}
 
-				//ڵһֱ
-				iDist = (int) fabs(i*cos(MaxValue1.nAngle*2*PI/180.0) + \
-							j*sin(MaxValue1.nAngle*2*PI/180.0));
-				if (iDist == MaxValue1.nDist)
-					pTo->SetPixel(i, j, RGB(0, 0, 0));
-			}
-	}
 
-	
+/*******************
+MYPOINT CImgProcess::ProjTrans(POINT pt, double* pDbProjPara)
 
-	// 
-	return TRUE;
+ܣݱ任ԵptʵʩͶӰ任
+
+
+POINT ptҪͶӰ任ĵ
+double* pDbProjPara任
 
+ֵ:
+	MYPOINT 
+*******************/
+MYPOINT CImgProcess::ProjTrans(POINT pt, double* pDbProjPara)
+{
+	MYPOINT retPt;
+	retPt.x = pDbProjPara[0] * pt.x + pDbProjPara[1] * pt.y + pDbProjPara[2] * pt.x * pt.y + pDbProjPara[3];
+	retPt.y = pDbProjPara[4] * pt.x + pDbProjPara[5] * pt.y + pDbProjPara[6] * pt.x * pt.y + pDbProjPara[7];
+	return retPt;
 }
 
-*/
 
+/*******************
+BOOL CImgProcess::ImProjRestore(CImgProcess* pTo, POINT *pPointBase, POINT *pPointSampl, bool bInterp)
 
-/******************* 
-void CImgProcess::PixelImage(CImgProcess* pTo, int lowerThres, int upperThres)
- 
- ܣ
-	ػС upperThres  lowerThres ֮ͨػλΪԭģ
-	˳С lowerThres ͨ
-	˳С upperThres ͨ
- ע
-	ֻܴ2ֵͼ
+ܣʵʩͶӰУ
 
- 
- CImgProcess* pTo: Ŀͼ CImgProcess ָ 
-	upperThres: ֵ
-	lowerThres: ֵ
- 
- ֵ
-	
-	
+
+CImgProcess* pToУ׼ͼ CImgProcess ָ
+POINT *pPointBase׼ͼĻ׼
+POINT *pPointSamplͼĻ׼
+bool bInterpǷʹ(˫)ֵ
+
+ֵ:
+	MYPOINT 
 *******************/
-void CImgProcess::PixelImage(CImgProcess* pTo, int lowerThres, int upperThres)
+BOOL CImgProcess::ImProjRestore(CImgProcess* pTo, POINT *pPointBase, POINT *pPointSampl, bool bInterp)
 {
-	if(upperThres < lowerThres)
+	double* pDbProjPara = new double[m_nBasePt * 2];
+	GetProjPara(pPointBase, pPointSampl, pDbProjPara);
+
+	//õõı任ϵͼʵʩ任
+	int i, j;
+	pTo->InitPixels(255); //Ŀͼ
+	int nHeight = pTo->GetHeight();
+	int nWidth = pTo->GetWidthPixel();
+	for(i=0; i<nHeight; i++)
 	{
-		AfxMessageBox("ֵֵ");
-		return;
+		for(j=0; j<nWidth; j++)
+		{
+			//ÿ(j, i)ͶӰʧĵptProj
+			POINT pt = {j, i};
+			MYPOINT ptProj = ProjTrans( pt, pDbProjPara );
+			
+			
+			if(bInterp)
+			{
+				int nGray = InterpBilinear(ptProj.x, ptProj.y); //ͼͶӰͼ񣩵ĶӦҶ
+				if(nGray >= 0)
+					pTo->SetPixel(j, i, RGB(nGray, nGray, nGray));
+				else
+					pTo->SetPixel(j, i, RGB(255, 255, 255)); //ͼΧɫ
+			}
+			else
+			{
+				int ii = ptProj.y + 0.5; //ڲֵ
+				int jj = ptProj.x + 0.5;
+				if( ii>0 && ii<GetHeight() && jj>0 && jj<GetWidthPixel() )
+					pTo->SetPixel(j, i, GetPixel(jj, ii));
+				else
+					pTo->SetPixel(j, i, RGB(255, 255, 255)); //ͼΧɫ
+			}
+		}
 	}
 
-	if(lowerThres < 0)
-		lowerThres = 0;
-	if(upperThres > 1000)
-		upperThres = 1000; //Ϊֹȵݹջ洦޶upperThresֵΪ1000
-
-	CImgProcess image_bkp = *this;
-	CImgProcess image_res = *pTo;
-	image_res.InitPixels(255); //ػͼ񣬳ʼΪɫ
+	delete pDbProjPara;
+	return TRUE;
+}
 
-	int nHeight = pTo->GetHeight();
-	int nWidth = pTo->GetWidthPixel();
 
-	int i,j;
-	unsigned char pixel;
+/**************************************************
+BOOL CImgProcess::FFT2(CImgProcess * pTo, BOOL bExpand, complex<double> * pOutput, BYTE bFillColor)
+ܣ
+	άٸҶ任
 
-	LPBYTE lpVisited = new BYTE[nHeight*nWidth]; //ǸλǷѱʹ
+
+	CImgProcess * pTo
+		ָͼָ룬ΪNULLͼ
+	BOOL bExpand
+		ָʹúַͼ߿2ݣ
+		Ϊtrueʹָɫͼ
+		ΪfalseҲ͵ײüͼ
+		Ĭֵȡfalseüͼ
+	complex<double> * pOutput
+		ָԭʼָ룬ĬϲԭʼݣĬΪNULL
+	BYTE bFillColor
+		bExpandΪtrueʱָʹúɫͼ
+		bExpandΪfalseʱԡĬֵΪ255ɫ
 
-	for(i=0;i<nHeight*nWidth;i++)
-		lpVisited[i] = false; //ʼʱ
+ֵ
+	BOOLͣtrueΪɹfalseΪʧ
+***************************************************/
 
-	int curConnRgnSize = 0; //ǰֵͨĴС
+BOOL CImgProcess::FFT2(CImgProcess * pTo, BOOL bExpand, complex<double> * pOutput, BYTE bFillColor)
+{
+	if (m_pBMIH->biBitCount!=8) return false;
 
+	// м
+	double	dTemp;
 	
-	int nPtArySize = upperThres + 10; //¼ʵĴСһС upperThres 
-	CPoint* ptVisited;//¼ͨһ̽зʹĵ
-	ptVisited = new CPoint[nPtArySize]; 
-
-	int k = 0;
+	// ѭ
+	LONG		i;
+	LONG		j;
+	
+	// FFT2ĿȺ͸߶ȣ2η
+	LONG		w;
+	LONG		h;
+	
+	int		wp;
+	int		hp;
+	
+	// ֵ
+	w = 1;
+	h = 1;
+	wp = 0;
+	hp = 0;
+	
+	// иҶ任ĿȺ͸߶ȣ2η
+	while(w * 2 <= GetWidthPixel())
+	{
+		w *= 2;
+		wp++;
+	}
+	
+	while(h * 2 <= GetHeight())
+	{
+		h *= 2;
+		hp++;
+	}
 
-	for(i=0;i<nHeight;i++)
+	// bExpand
+	if ((bExpand) && (w!=GetWidthPixel()) &&(h!=GetHeight())) {
+		w *= 2; wp++;
+		h *= 2; hp++;
+	}
+	
+	// ڴ
+	complex<double> *TD = new complex<double>[w * h];
+	complex<double> *FD = new complex<double>[w * h];
+	
+	// ֱ
+	for(i = 0; i < h; i++)
 	{
-		for(j=0;j<nWidth;j++)
+		// ˮƽ
+		for(j = 0; j < w; j++)
 		{
-			
-			for(k=0;k<curConnRgnSize;k++)
-				lpVisited[ptVisited[k].y*nWidth + ptVisited[k].x] = false;//ԭ lpVisited 
-
-			curConnRgnSize = 0; //Ϊ0
-
-			pixel = image_bkp.GetGray(j, i);
-			
-			if( pixel == 0 ) //ҵ1أ̽ͨĴС
+			// ʱֵ
+			if (bExpand)
 			{
-				int nRet = TestConnRgn(&image_bkp, lpVisited, nWidth, nHeight, j, i, ptVisited, lowerThres, upperThres, curConnRgnSize);
-				if(nRet == 0) // lowerThres<= ... <=upperThres
+				if ((j<GetWidthPixel()) && (i<GetHeight()))
 				{
-					//
-					int xMean = 0;
-					int yMean = 0;
-					for(k=0; k<curConnRgnSize; k++)
-					{
-						image_res.SetPixel(ptVisited[k].x, ptVisited[k].y, RGB(255, 255, 255));
-
-						xMean += ptVisited[k].x;
-						yMean += ptVisited[k].y;
-					}
-					xMean = xMean / curConnRgnSize;
-					yMean = yMean / curConnRgnSize;
-
-					image_res.SetPixel(xMean, yMean, RGB(0, 0, 0));
-		
+					TD[j + w * i] = complex<double>(GetGray(j, i), 0);
 				}
-				else if( (nRet == 1) || (nRet == -1) ) // >upperThres or <lowerThres
+				else
 				{
-					//˳
-					for(k=0; k<curConnRgnSize; k++)
-					{
-						image_res.SetPixel(ptVisited[k].x, ptVisited[k].y, RGB(255, 255, 255));
-					}
+					// ԭͼΧʹøɫ
+					TD[j + w * i] = complex<double>(bFillColor, 0);
 				}
 			}
-
-		}// for j
-	}// for i
-
-	
-	*pTo = image_res;
-
-
-	delete []lpVisited;
-	delete []ptVisited;
-}
-
-
-
-/******************* 
-TestConnRgn(CImgProcess* pImage, LPBYTE lpVisited, int nWidth, int nHeight, int x, int y, CPoint ptVisited[], int lowerThres, int upperThres, int &curConnRgnSize)
- 
- ܣ
-	õݹ㷨ͳƵ (x, y) ͨĴС lowerThres  upperThres ֮Ĺϵ
- ע
-	ֻܴ2ֵͼ
-
- 
- CImgProcess* pImage; ͼ CImgProcess ָ 
- LPBYTE lpVisited     ־λ
- int nWidth       ͼĿ
- int nHeigh       ͼĸ߶
- int x            ǰĺ
- int y            ǰ
- Cpoint ptVisited[]     ѿĵ
- int curConnRgnSize     ǰΪֵֹͨĴС
- 
- ֵ
- int
-	= 0: ͨС lowerThres  upperThres ֮
-	= 1: ͨС upperThres
-	=-1: ͨС lowerThres
- 
-*******************/
-int CImgProcess::TestConnRgn(CImgProcess* pImage, LPBYTE lpVisited, int nWidth, int nHeight, int x, int y, CPoint ptVisited[], int lowerThres, int upperThres, int &curConnRgnSize)
-{ 
+			else
+			{
+				TD[j + w * i] = complex<double>(GetGray(j, i), 0);
+			}
+		}
+	}
 	
-	if(curConnRgnSize > upperThres) //ͨСѳֵupperThres
-	   return 1;
-
-	curConnRgnSize++; //µǰΪֵֹͨĴС
-	lpVisited[nWidth*y+x]=true; //ѷ
-
-    ptVisited[curConnRgnSize-1].x=x;
-    ptVisited[curConnRgnSize-1].y=y; //¼ѷʵ
-
-
-    
-	unsigned char gray;
- 
-    if(curConnRgnSize >= upperThres)
-	   return 1;
-	else
-	{//8ڽӵĵ㣬Ϊɫ壩ݹԼͨС+1ڽӵ8ڽӵ㣩
-
-		//ĵ
-		if(y-1>=0)
+	for(i = 0; i < h; i++)
+	{
+		// yпٸҶ任
+		FFT(&TD[w * i], &FD[w * i], wp);
+	}
+	
+	// 任
+	for(i = 0; i < h; i++)
+	{
+		for(j = 0; j < w; j++)
 		{
-			gray = pImage->GetGray(x, y-1);
-			if(gray==0 && lpVisited[(y-1)*nWidth+x] == false) 
-	  			TestConnRgn(pImage, lpVisited, nWidth, nHeight, x, y-1, ptVisited, lowerThres, upperThres, curConnRgnSize);
+			TD[i + h * j] = FD[j + w * i];
 		}
-        if(curConnRgnSize > upperThres)
-	        return 1;
-
-		//ϵ
-		if(y-1>=0 && x-1>=0)
+	}
+	
+	for(i = 0; i < w; i++)
+	{
+		// xпٸҶ任
+		FFT(&TD[i * h], &FD[i * h], hp);
+	}
+	
+	// 
+	if (pOutput)
+	{
+		// ֱ
+		for(i = 0; i < h; i++)
 		{
-			gray = pImage->GetGray(x-1, y-1);
-			if(gray==0 && lpVisited[(y-1)*nWidth+x-1]==false)
-				TestConnRgn(pImage, lpVisited, nWidth, nHeight,x-1,y-1,ptVisited, lowerThres, upperThres, curConnRgnSize);
+			// ˮƽ
+			for(j = 0; j < w; j++)
+			{
+				pOutput[i * w + j] = FD[j * h + i];
+			}
 		}
-        if(curConnRgnSize > upperThres)
-	        return 1;
+	}
 
-		//
-		if(x-1>=0)
-		{
-			gray = pImage->GetGray(x-1, y);
-			if(gray==0 && lpVisited[y*nWidth+x-1]==false)
-        		TestConnRgn(pImage, lpVisited, nWidth, nHeight, x-1, y, ptVisited, lowerThres, upperThres, curConnRgnSize);
-		}
-        if(curConnRgnSize > upperThres)
-			return 1;
+	// ͼ
+	if (pTo)
+	{
+		// ͼС
+		pTo->ImResize(h, w);
 
-		//
-		if(y+1<nHeight && x-1>=0)
-        {
-			gray = pImage->GetGray(x-1, y+1);
-			if(gray==0 && lpVisited[(y+1)*nWidth+x-1]==false)
-			TestConnRgn(pImage, lpVisited, nWidth, nHeight, x-1, y+1, ptVisited, lowerThres, upperThres, curConnRgnSize);
-		}
-        if(curConnRgnSize > upperThres)
-		   return 1;
+		// Ѱҷ׶任ֵСֵΪŻʾ׼
+		// ׶任ֵСֱֵ
+		double dMax = 0, dMin = 1E+006;
 
-		//·
-		if( y+1<nHeight)
+		for (i=0; i<h; i++)
 		{
-			gray = pImage->GetGray(x, y+1);
-			if(gray==0 &&lpVisited[(y+1)*nWidth+x]==false)
-				TestConnRgn(pImage, lpVisited,nWidth,nHeight,x,y+1,ptVisited,lowerThres, upperThres, curConnRgnSize);
-		}
-        if(curConnRgnSize > upperThres)
-			return 1;
+			for (j=0; j<w; j++)
+			{
+				// 
+				dTemp = sqrt(FD[j * h + i].real() * FD[j * h + i].real() + 
+							 FD[j * h + i].imag() * FD[j * h + i].imag()) / 100;
+				
+				// 任
+				dTemp = log(1+dTemp);
 
-		//
-		if(y+1<nHeight && x+1<nWidth)
-		{
-			gray = pImage->GetGray(x+1, y+1);
-			if(gray==0 && lpVisited[(y+1)*nWidth+x+1]==false)
-				TestConnRgn(pImage, lpVisited,nWidth,nHeight,x+1,y+1,ptVisited,lowerThres, upperThres, curConnRgnSize);
+				// ѰСֵ
+				dMax = max(dMax, dTemp);
+				dMin = min(dMin, dTemp);
+			}
 		}
-        if(curConnRgnSize > upperThres)
-			return 1;
 
-		//ұ
-		if(x+1<nWidth)
+		for (i=0; i<h; i++)
 		{
-			gray = pImage->GetGray(x+1, y);
-			if(gray==0 && lpVisited[y*nWidth+x+1]==false)
-				TestConnRgn(pImage, lpVisited, nWidth, nHeight, x+1, y, ptVisited, lowerThres, upperThres, curConnRgnSize);
-		}
-        if(curConnRgnSize > upperThres)
-			return 1;
+			for (j=0; j<w; j++)
+			{
+				// 
+				dTemp = sqrt(FD[j * h + i].real() * FD[j * h + i].real() + 
+							 FD[j * h + i].imag() * FD[j * h + i].imag()) / 100;
+				
+				// 任
+				dTemp = log(1+dTemp);
 
-		//
-		if(y-1>=0 && x+1<nWidth)
-		{
-			gray = pImage->GetGray(x+1, y-1);
-			if(gray==0 && lpVisited[(y-1)*nWidth+x+1]==false)
-				TestConnRgn(pImage,lpVisited,nWidth,nHeight,x+1,y-1, ptVisited, lowerThres, upperThres, curConnRgnSize);
+				// ı䶯̬Χһ0~255
+				dTemp = (dTemp - dMin) / (dMax - dMin) * 255;
+				
+				// Ŀͼ
+				// ˴ֱȡjiΪ˽任ԭƵ
+				pTo->SetPixel((j<w/2 ? j+w/2 : j-w/2),(i<h/2 ? i+h/2 : i-h/2), RGB(dTemp, dTemp, dTemp));
+			}
 		}
-        if(curConnRgnSize > upperThres)
-			return 1;
-           
-	}//else
-
-	if (curConnRgnSize < lowerThres)
-		return -1; //ͨС lowerThres
+	}
 
+	// ɾʱ
+	delete TD;
+	delete FD;
 
-    return 0;//ͨС lowerThres  upperThres ֮
+	return true;
 }
 
+/**************************************************
+BOOL CImgProcess::IFFT2(CImgProcess * pTo, complex<double> * pInput, long lWidth, long lHeight, long lOutW, long lOutH)
 
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-//***************************************ͶӰУ*************************************//
-
-/*******************
-void CImgProcess::ProdMat(double** ppDbMat, double *pDbSrc2, double *pDbDest, int y, int x, int z)
-
-ܣĳ˻
-
-עúˣȻ˵ĽpDbDestС
-    pDbSrc1 *ĴСΪ x*zpDbSrc2ĴСΪ z*ypDbDestĴСΪ x*y
+ܣ
+	άٷҶ任
 
 
-double  *pDbSrc1	- ָ˾1ڴ
-double  *pDbSrc2	- ָ˾2ڴ
-double  *pDbDest   - žнڴָ
-int     x		- ĳߴ磬μע
-int     y		- ĳߴ磬μע
-int     z		- ĳߴ磬μע
- 
- ֵ:
-	
- 
- *******************/
-void CImgProcess::ProdMat(double** ppDbMat, double *pDbSrc2, double *pDbDest, int y, int x, int z)
+	CImgProcess * pTo
+		ָͼָ
+	complex<double> * pInput
+		ָָ
+	long lWidth
+		ҪзҶ任Ŀ
+	long lHeight
+		ҪзҶ任ĸ߶
+	long lOutW
+		ָͼĿȣʡԣĬͬ
+	long lOutH
+		ָͼĸ߶ȣʡԣĬ߶ͬ
+ֵ
+	BOOLͣtrueΪɹfalseΪʧ
+***************************************************/
+
+BOOL CImgProcess::IFFT2(CImgProcess * pTo, complex<double> * pInput, long lWidth, long lHeight, long lOutW, long lOutH)
 {
-	int nCnt = 0;
-	int i,j;
-	double * pDbSrc1 = new double[m_nBasePt * m_nBasePt];
-	for(i=0; i<m_nBasePt; i++)
-	{
-		for(j=0; j<m_nBasePt; j++)
-			pDbSrc1[nCnt++] = ppDbMat[i][j];
-	}
+	if (m_pBMIH->biBitCount!=8) return false;
 
-	for(i=0;i<y;i++)
+	// м
+	double	dTemp;
+	
+	// ѭ
+	LONG		i;
+	LONG		j;
+	
+	// IFFT2ĿȺ͸߶ȣ2η
+	LONG		w;
+	LONG		h;
+	
+	int		wp;
+	int		hp;
+	
+	// ֵ
+	w = 1;
+	h = 1;
+	wp = 0;
+	hp = 0;
+	
+	// ͼĸ߿
+	if (lOutH == 0) lOutH = lHeight;
+	if (lOutW == 0) lOutW = lWidth;
+	
+	// зҶ任ĿȺ͸߶ȣ2η
+	while(w * 2 <= lWidth)
 	{
-		for(j=0;j<x;j++)
-		{
-			pDbDest[i*x + j] = 0;
-			for(int m=0;m<z;m++)
-				pDbDest[i*x + j] += pDbSrc1[i*z + m]*pDbSrc2[m*x + j];
-		}
+		w *= 2;
+		wp++;
 	}
-
-	nCnt = 0;
-	for(i=0; i<m_nBasePt; i++)
+	
+	while(h * 2 <= lHeight)
 	{
-		for(j=0; j<m_nBasePt; j++)
-			ppDbMat[i][j] = pDbSrc1[nCnt++];
+		h *= 2;
+		hp++;
 	}
+	
+	// ڴ
+	complex<double> *TD = new complex<double>[w * h];
+	complex<double> *FD = new complex<double>[w * h];
+	
+	// 趨ͼС
+	pTo->ImResize(lOutH, lOutW);
 
-	delete []pDbSrc1;
-}
-
-
-/*******************
-void CImgProcess::GetProjPara(CPoint* pPointBase, CPoint* pPointSampl, double* pDbProjPara)
-
-ܣݻ׼Զ4Զȷ任
-
-
-CPoint* pPointBase׼ͼĻ׼
-CPoint* pPointSamplͼĻ׼
-double* pDbProjPara任
- 
-ֵ:
-	
- 
- *******************/
-void CImgProcess::GetProjPara(CPoint* pPointBase, CPoint* pPointSampl, double* pDbProjPara)
-{
-	int i;
-
-	//ͶӰԷ̵ϵ
-	double** ppParaMat;
-	ppParaMat = new double*[m_nBasePt];
-	for(i=0; i<m_nBasePt; i++)
+	// ֱ
+	for(i = 0; i < h; i++)
 	{
-		ppParaMat[i] = new double[m_nBasePt];	
+		// ˮƽ
+		for(j = 0; j < w; j++)
+		{
+			// Ƶֵ
+			FD[j + w * i] = pInput[j + w * i];
+		}
 	}
-
-	for(i=0; i<m_nBasePt; i++)
+	
+	for(i = 0; i < h; i++)
 	{
-		ppParaMat[i][0] = pPointBase[i].x;
-		ppParaMat[i][1] = pPointBase[i].y;
-		ppParaMat[i][2] = pPointBase[i].x * pPointBase[i].y;
-		ppParaMat[i][3] = 1;
+		// yпٷҶ任
+		IFFT(&FD[w * i], &TD[w * i], wp);
 	}
-
-	double* pResMat;//
-	pResMat = new double[m_nBasePt];
-	for(i=0; i<m_nBasePt; i++)//ǰĸϵ c1,c2,c3,c4
+	
+	// 任
+	// ֱ
+	for(i = 0; i < h; i++)
 	{
-		pResMat[i] = pPointSampl[i].x; //ͶӰԷ̵ֵx'
+		// ˮƽ
+		for(j = 0; j < w; j++)
+		{
+			FD[i + h * j] = TD[j + w * i];
+		}
 	}
 	
-	// ϵķͶӰ任ǰ4ϵ c1,c2,c3,c4
-	InvMat(ppParaMat, m_nBasePt);
-	ProdMat(ppParaMat, pResMat, pDbProjPara, m_nBasePt, 1, m_nBasePt);//ǰ4ϵ
-	
-	for(i=0; i<m_nBasePt; i++)//ĸϵ c5,c6,c7,c8
+	for(i = 0; i < w; i++)
 	{
-		pResMat[i] = pPointSampl[i].y; //ͶӰԷ̵ֵy'
+		// xпٷҶ任
+		IFFT(&FD[i * h], &TD[i * h], hp);
 	}
-	// ϵķͶӰ任ĺ4ϵ c5,c6,c7,c8
-	ProdMat(ppParaMat, pResMat, pDbProjPara+m_nBasePt, m_nBasePt, 1, m_nBasePt);//4ϵ
-
-
-	//ͷſռ
-	delete[] pResMat;
+	
+	// Ѱҷ任任ֵСֵΪŻʾ׼
+	// ֵСֱֵ
+	double dMax = 0, dMin = 1E+006;
 
-	for(i=0; i<m_nBasePt; i++)
+	for (i=0; i<lOutH; i++)
 	{
-		delete[] ppParaMat[i];	
+		for (j=0; j<lOutW; j++)
+		{
+			dTemp = TD[j * h + i].real();
+			
+			// ѰСֵ
+			dMax = max(dMax, dTemp);
+			dMin = min(dMin, dTemp);
+		}
 	}
-	delete[] ppParaMat;
-}
 
+	// 
+	for(i = 0; i < lOutH; i++)
+	{
+		// 
+		for(j = 0; j < lOutW; j++)
+		{
+			dTemp = TD[j * h + i].real();
+			
+			// ı䶯̬Χһ0~255
+			dTemp = (dTemp - dMin) / (dMax - dMin) * 255;
+			
+			// Ŀͼ
+			pTo->SetPixel(j, i, RGB(dTemp, dTemp, dTemp));
+		}
+	}
+	
+	// ɾʱ
+	delete TD;
+	delete FD;
 
-/*******************
-BOOL CImgProcess::InvMat(double** ppDbMat, int nLen)
+	return true;
+}
 
-ܣppDbMat
+/**************************************************
+BOOL CImgProcess::FreqFilt(CImgProcess * pTo, double * pdFilter, BYTE bFillColor)
 
-עppDbMatΪ
+ܣ
+	ִƵ˲ʹӦ˾ɺdFilter˾
 
 
-double** ppDbMat
-int nLenppDbMatĳߴ
-
-ֵ:
-	BOOL
-	=trueִгɹ
-	=falseгִ
-*******************/
-BOOL CImgProcess::InvMat(double** ppDbMat, int nLen)
-{
-	double* pDbSrc = new double[nLen * nLen];
-	
-	int *is,*js,i,j,k;
+	CImgProcess * pTo
+		ָͼָ
+	double * pdFilter
+		Ƶ˾
+	BYTE bFillColor
+		ԭͼʹõɫĬΪ255ɫ
+		ͼҲ͵ײԵɫһ¡
 
-	//Ҫ
-	int nCnt = 0;
-	for(i=0; i<nLen; i++)
-	{
-		for(j=0; j<nLen; j++)
-			pDbSrc[nCnt++] = ppDbMat[i][j];
-	}
+ֵ
+	BOOLͣtrueΪɹfalseΪʧ
+***************************************************/
 
-	double d,p;
-	is = new int[nLen];
-	js = new int[nLen];
-	for(k=0;k<nLen;k++)
-	{
-		d=0.0;
-		for(i=k;i<nLen;i++)
-			for(j=k;j<nLen;j++)
-			{
-				p=fabs(pDbSrc[i*nLen + j]); //ҵֵϵ
-				if(p>d)
-				{
-					d = p; 
+BOOL CImgProcess::FreqFilt(CImgProcess * pTo, double * pdFilter, BYTE bFillColor)
+{
+	if (m_pBMIH->biBitCount!=8) return false;
 
-					//¼ֵϵС
-					is[k] = i;
-					js[k] = j;
-				}
-			}
-		if(d+1.0==1.0)
-		{//ϵȫ0ϵΪ0 󣬴ʱΪ
-			delete is;
-			delete js;
-			return FALSE;
-		}
-		if(is[k] != k) //ǰвԪ
-			for(j=0;j<nLen;j++)
-			{
-				//Ԫ
-				p = pDbSrc[k*nLen + j];
-				pDbSrc[k*nLen + j] = pDbSrc[(is[k]*nLen) + j];
-				pDbSrc[(is[k])*nLen + j] = p;
-			}
-		if(js[k] != k) //ǰвԪ
-			for(i=0; i<nLen; i++)
-			{
-				//Ԫ
-				p = pDbSrc[i*nLen + k];
-				pDbSrc[i*nLen + k] = pDbSrc[i*nLen + (js[k])];
-				pDbSrc[i*nLen + (js[k])] = p;
-			}
+	// ˾С
+	LONG w = GetFreqWidth();
+	LONG h = GetFreqHeight();
 
-		pDbSrc[k*nLen + k]=1.0/pDbSrc[k*nLen + k]; //Ԫĵ 
-		
-		// a[k,j]a[k,k] -> a[k,j]
-		for(j=0; j<nLen; j++)
-			if(j != k)
-			{
-				pDbSrc[k*nLen + j]*=pDbSrc[k*nLen + k];
-			}
+	// ʱƵͼ洢
+	complex<double> * cdFreqImg = new complex<double>[w*h];
 	
-		// a[i,j] - a[i,k]a[k,j] -> a[i,j]
-		for(i=0; i<nLen; i++)
-			if(i != k)
-				for(j=0; j<nLen; j++)
-					if(j!=k)
-					{
-						pDbSrc[i*nLen + j] -= pDbSrc[i*nLen + k]*pDbSrc[k*nLen + j];
-					}
+	// ȶԭͼиҶ任
+	FFT2(NULL, 1, cdFreqImg, bFillColor);
 
-		// -a[i,k]a[k,k] -> a[i,k]
-		for(i=0; i<nLen; i++)
-			if(i != k)
-			{
-				pDbSrc[i*nLen + k] *= -pDbSrc[k*nLen + k];
-			}
-	}
-	for(k=nLen-1; k>=0; k--)
+	// Ȼִк˲Ƶͼ˾Ԫ
+	for (LONG i = 0; i<w*h; i++)
 	{
-		//ָ 
-		if(js[k] != k)
-			for(j=0; j<nLen; j++)
-			{
-				p = pDbSrc[k*nLen + j];
-				pDbSrc[k*nLen + j] = pDbSrc[(js[k])*nLen + j];
-				pDbSrc[(js[k])*nLen + j] = p;
-			}
-		//ָ
-		if(is[k] != k)
-			for(i=0; i<nLen; i++)
-			{
-				p = pDbSrc[i*nLen + k];
-				pDbSrc[i*nLen + k] = pDbSrc[i*nLen +(is[k])];
-				pDbSrc[i*nLen + (is[k])] = p;
-			}
+		cdFreqImg[i] = cdFreqImg[i] * pdFilter[i];
 	}
 
-	//ϵppDbMat
-	nCnt = 0;
-	for(i=0; i<m_nBasePt; i++)
-	{
-		for(j=0; j<m_nBasePt; j++)
-		{
-			ppDbMat[i][j] = pDbSrc[nCnt++];
-		}
-	}
+	// ˲иҶ任
+	IFFT2(pTo, cdFreqImg, w, h, GetWidthPixel(), GetHeight());
 
-	//ͷſռ
-	delete is;
-	delete js;
-	delete[] pDbSrc;
+	// ڶ̬Χ⣬ԭͼڽԵĻҶȷֽ磬
+	// ȫ֤˲ڻҶȲԭͼ񱣳ͬ
+	// ˿Ҫͼٽе
 
-	return TRUE;	
+	// ɾʱƵͼ
+	delete cdFreqImg;
 
+	return true;
 }
 
+/**************************************************
+BOOL CImgProcess::FreqIdealLPF(double * pdFilter, int nFreq)
 
-/*******************
-MYPOINT CImgProcess::ProjTrans(CPoint pt, double* pDbProjPara)
-
-ܣݱ任ԵptʵʩͶӰ任
+ܣ
+	ɶӦͼƵͨ˾
 
 
-CPoint ptҪͶӰ任ĵ
-double* pDbProjPara任
-
-ֵ:
-	MYPOINT 
-*******************/
-MYPOINT CImgProcess::ProjTrans(CPoint pt, double* pDbProjPara)
-{
-	MYPOINT retPt;
-	retPt.x = pDbProjPara[0] * pt.x + pDbProjPara[1] * pt.y + pDbProjPara[2] * pt.x * pt.y + pDbProjPara[3];
-	retPt.y = pDbProjPara[4] * pt.x + pDbProjPara[5] * pt.y + pDbProjPara[6] * pt.x * pt.y + pDbProjPara[7];
-	return retPt;
-}
-
-
-/*******************
-BOOL CImgProcess::ImProjRestore(CImgProcess* pTo, CPoint *pPointBase, CPoint *pPointSampl, bool bInterp)
-
-ܣʵʩͶӰУ
+	double * pdFilter
+		ָ˾ָ
+	int nFreq
+		ֹƵ
 
-
-CImgProcess* pToУ׼ͼ CImgProcess ָ
-CPoint *pPointBase׼ͼĻ׼
-CPoint *pPointSamplͼĻ׼
-bool bInterpǷʹ(˫)ֵ
+ֵ
+	BOOLͣtrueΪɹfalseΪʧ
+***************************************************/
 
-ֵ:
-	MYPOINT 
-*******************/
-BOOL CImgProcess::ImProjRestore(CImgProcess* pTo, CPoint *pPointBase, CPoint *pPointSampl, bool bInterp)
+BOOL CImgProcess::FreqIdealLPF(double * pdFilter, int nFreq)
 {
-	double* pDbProjPara = new double[m_nBasePt * 2];
-	GetProjPara(pPointBase, pPointSampl, pDbProjPara);
+	if (m_pBMIH->biBitCount!=8) return false;
+
+	// ˾С
+	LONG w = GetFreqWidth();
+	LONG h = GetFreqHeight();
 
-	//õõı任ϵͼʵʩ任
-	int i, j;
-	pTo->InitPixels(255); //Ŀͼ
-	int nHeight = pTo->GetHeight();
-	int nWidth = pTo->GetWidthPixel();
-	for(i=0; i<nHeight; i++)
+	// ˾
+	for (int i=0; i<h; i++)
 	{
-		for(j=0; j<nWidth; j++)
+		for (int j=0; j<w; j++)
 		{
-			//ÿ(j, i)ͶӰʧĵptProj
-			MYPOINT ptProj = ProjTrans( CPoint(j, i), pDbProjPara );
-			
-			
-			if(bInterp)
+			// ԭĵ˾Լ򻯲Ҫֱ˾ĸ
+			if (sqrt( pow((double)(i-h/2),2) + pow((double)(j-w/2),2) ) > nFreq)
 			{
-				int nGray = InterpBilinear(ptProj.x, ptProj.y); //ͼͶӰͼ񣩵ĶӦҶ
-				if(nGray >= 0)
-					pTo->SetPixel(j, i, RGB(nGray, nGray, nGray));
-				else
-					pTo->SetPixel(j, i, RGB(255, 255, 255)); //ͼΧɫ
+				// дʱ˾бҪMATLABifftshiftԭƽ
+				pdFilter[(i<h/2 ? i+h/2 : i-h/2 ) * w + (j<w/2 ? j+w/2 : j-w/2)] = 0;
 			}
 			else
 			{
-				int ii = ptProj.y + 0.5; //ڲֵ
-				int jj = ptProj.x + 0.5;
-				if( ii>0 && ii<GetHeight() && jj>0 && jj<GetWidthPixel() )
-					pTo->SetPixel(j, i, GetPixel(jj, ii));
-				else
-					pTo->SetPixel(j, i, RGB(255, 255, 255)); //ͼΧɫ
+				pdFilter[(i<h/2 ? i+h/2 : i-h/2 ) * w + (j<w/2 ? j+w/2 : j-w/2)] = 1;
 			}
 		}
 	}
-
-	delete pDbProjPara;
-	return TRUE;
+	
+	return true;
 }
 
-
 /**************************************************
-BOOL CImgProcess::FFT2(CImgProcess * pTo, BOOL bExpand, complex<double> * pOutput, BYTE bFillColor)
+BOOL CImgProcess::FreqGaussLPF(double * pdFilter, double dSigma)
+
 ܣ
-	άٸҶ任
+	ɶӦͼĸ˹ͨ˾
 
 
-	CImgProcess * pTo
-		ָͼָ룬ΪNULLͼ
-	BOOL bExpand
-		ָʹúַͼ߿2ݣ
-		Ϊtrueʹָɫͼ
-		ΪfalseҲ͵ײüͼ
-		Ĭֵȡfalseüͼ
-	complex<double> * pOutput
-		ָԭʼָ룬ĬϲԭʼݣĬΪNULL
-	BYTE bFillColor
-		bExpandΪtrueʱָʹúɫͼ
-		bExpandΪfalseʱԡĬֵΪ255ɫ
+	double * pdFilter
+		ָ˾ָ
+	double dSigma
+		˹˲Sigma
 
 ֵ
 	BOOLͣtrueΪɹfalseΪʧ
 ***************************************************/
 
-BOOL CImgProcess::FFT2(CImgProcess * pTo, BOOL bExpand, complex<double> * pOutput, BYTE bFillColor)
+BOOL CImgProcess::FreqGaussLPF(double * pdFilter, double dSigma)
 {
 	if (m_pBMIH->biBitCount!=8) return false;
 
-	// м
-	double	dTemp;
-	
-	// ѭ
-	LONG		i;
-	LONG		j;
-	
-	// FFT2ĿȺ͸߶ȣ2η
-	LONG		w;
-	LONG		h;
-	
-	int		wp;
-	int		hp;
-	
-	// ֵ
-	w = 1;
-	h = 1;
-	wp = 0;
-	hp = 0;
-	
-	// иҶ任ĿȺ͸߶ȣ2η
-	while(w * 2 <= GetWidthPixel())
-	{
-		w *= 2;
-		wp++;
-	}
-	
-	while(h * 2 <= GetHeight())
-	{
-		h *= 2;
-		hp++;
-	}
+	// ˾С
+	LONG w = GetFreqWidth();
+	LONG h = GetFreqHeight();
 
-	// bExpand
-	if ((bExpand) && (w!=GetWidthPixel()) &&(h!=GetHeight())) {
-		w *= 2; wp++;
-		h *= 2; hp++;
-	}
-	
-	// ڴ
-	complex<double> *TD = new complex<double>[w * h];
-	complex<double> *FD = new complex<double>[w * h];
-	
-	// ֱ
-	for(i = 0; i < h; i++)
+	// ˾
+	for (int i=0; i<h; i++)
 	{
-		// ˮƽ
-		for(j = 0; j < w; j++)
+		for (int j=0; j<w; j++)
 		{
-			// ʱֵ
-			if (bExpand)
-			{
-				if ((j<GetWidthPixel()) && (i<GetHeight()))
-				{
-					TD[j + w * i] = complex<double>(GetGray(j, i), 0);
-				}
-				else
-				{
-					// ԭͼΧʹøɫ
-					TD[j + w * i] = complex<double>(bFillColor, 0);
-				}
-			}
-			else
-			{
-				TD[j + w * i] = complex<double>(GetGray(j, i), 0);
-			}
+			// ԭĵ˾Լ򻯲Ҫֱ˾ĸ
+			// дʱ˾бҪMATLABifftshiftԭƽ
+			pdFilter[(i<h/2 ? i+h/2 : i-h/2 ) * w + (j<w/2 ? j+w/2 : j-w/2)] =
+				exp(-(pow((double)(i-h/2),2)+pow((double)(j-w/2),2))/2/pow(dSigma,2));
 		}
 	}
 	
-	for(i = 0; i < h; i++)
-	{
-		// yпٸҶ任
-		FFT(&TD[w * i], &FD[w * i], wp);
-	}
-	
-	// 任
-	for(i = 0; i < h; i++)
+	return true;
+}
+
+/**************************************************
+BOOL CImgProcess::FreqGaussHPF(double * pdFilter, double dSigma)
+
+ܣ
+	ɶӦͼĸ˹ͨ˾
+
+
+	double * pdFilter
+		ָ˾ָ
+	double dSigma
+		˹˲Sigma
+
+ֵ
+	BOOLͣtrueΪɹfalseΪʧ
+***************************************************/
+
+BOOL CImgProcess::FreqGaussHPF(double * pdFilter, double dSigma)
+{
+	if (m_pBMIH->biBitCount!=8) return false;
+
+	// ˾С
+	LONG w = GetFreqWidth();
+	LONG h = GetFreqHeight();
+
+	// ˾
+	for (int i=0; i<h; i++)
 	{
-		for(j = 0; j < w; j++)
+		for (int j=0; j<w; j++)
 		{
-			TD[i + h * j] = FD[j + w * i];
+			// ԭĵ˾Լ򻯲Ҫֱ˾ĸ
+			// дʱ˾бҪMATLABifftshiftԭƽ
+			pdFilter[(i<h/2 ? i+h/2 : i-h/2 ) * w + (j<w/2 ? j+w/2 : j-w/2)] =
+				1 - exp(-(pow((double)(i-h/2),2)+pow((double)(j-w/2),2))/2/pow(dSigma,2));
 		}
 	}
 	
-	for(i = 0; i < w; i++)
+	return true;
+}
+
+/**************************************************
+BOOL CImgProcess::FreqLaplace(double * pdFilter)
+
+ܣ
+	ɶӦͼƵ˹˲
+
+
+	double * pdFilter
+		ָ˾ָ
+
+ֵ
+	BOOLͣtrueΪɹfalseΪʧ
+***************************************************/
+
+BOOL CImgProcess::FreqLaplace(double * pdFilter)
+{
+	if (m_pBMIH->biBitCount!=8) return false;
+
+	// ˾С
+	LONG w = GetFreqWidth();
+	LONG h = GetFreqHeight();
+
+	// ˾
+	for (int i=0; i<h; i++)
 	{
-		// xпٸҶ任
-		FFT(&TD[i * h], &FD[i * h], hp);
+		for (int j=0; j<w; j++)
+		{
+			// ԭĵ˾Լ򻯲Ҫֱ˾ĸ
+			// дʱ˾бҪMATLABifftshiftԭƽ
+			pdFilter[(i<h/2 ? i+h/2 : i-h/2 ) * w + (j<w/2 ? j+w/2 : j-w/2)] =
+				- (pow((double)(i-h/2),2) + pow((double)(j-w/2),2));
+		}
 	}
 	
-	// 
-	if (pOutput)
-	{
-		// ֱ
-		for(i = 0; i < h; i++)
-		{
-			// ˮƽ
-			for(j = 0; j < w; j++)
-			{
-				pOutput[i * w + j] = FD[j * h + i];
-			}
+	return true;
+}
+
+/**************************************************
+BOOL CImgProcess::FreqGaussBRF(double * pdFilter , int nFreq, int nWidth)
+
+ܣ
+	ɶӦͼĸ˹˲
+
+
+	double * pdFilter
+		ָ˾ָ
+	int nFreq
+		Ƶ
+	int nWidth
+		Ŀ
+
+ֵ
+	BOOLͣtrueΪɹfalseΪʧ
+***************************************************/
+
+BOOL CImgProcess::FreqGaussBRF(double * pdFilter , int nFreq, int nWidth)
+{
+	if (m_pBMIH->biBitCount!=8) return false;
+
+	// ˾С
+	LONG w = GetFreqWidth();
+	LONG h = GetFreqHeight();
+
+	// ˾
+	for (int i=0; i<h; i++)
+	{
+		for (int j=0; j<w; j++)
+		{
+			// ԭĵ˾Լ򻯲Ҫֱ˾ĸ
+			// дʱ˾бҪMATLABifftshiftԭƽ
+			pdFilter[(i<h/2 ? i+h/2 : i-h/2 ) * w + (j<w/2 ? j+w/2 : j-w/2)] =
+				1 - exp(-0.5 * pow( (pow((double)(i - h/2), 2) + pow((double)(j - w/2),2) - pow((double)nFreq, 2))/
+				(sqrt( pow((double)(i - h/2), 2) + pow((double)(j - w/2),2) ) * nWidth ) ,2 ));
 		}
 	}
+	
+	return true;
+}
 
-	// ͼ
-	if (pTo)
+// 33ݶģһϵĸӦģ帲ǵΪabcΪ-101
+// d1 = c[1] - a[-1]d2 = a[1] - c[-1]dx = b[1] - b[-1]dy = c[0] - a[0]
+// мһУУȨΪnCenterSobelΪ1PrewittΪ2ʱ
+//	ˮƽ = d1 - d2 + nCenter*dy		ֱ = d1 + d2 + nCenter*dx
+//	45 = nCenter*d1 + dx + dy		135 = nCenter*d2 + dx - dy
+// ĸĸ֣һpApBpCӵһепʼ
+// ӦΪ4255öͣ
+template <int nCenter>
+static void GradientRow3(const BYTE* pA, const BYTE* pB, const BYTE* pC, short* pSum[4], int nCount)
+{
+	short* pH = pSum[0];
+	short* pV = pSum[1];
+	short* pCW = pSum[2];
+	short* pCCW = pSum[3];
+
+	for (int j=0; j<nCount; j++)
+	{
+		short d1 = pC[j + 2] - pA[j];
+		short d2 = pA[j + 2] - pC[j];
+		short dx = pB[j + 2] - pB[j];
+		short dy = pC[j + 1] - pA[j + 1];
+
+		pH[j] = d1 - d2 + nCenter * dy;
+		pV[j] = d1 + d2 + nCenter * dx;
+		pCW[j] = nCenter * d1 + dx + dy;
+		pCCW[j] = nCenter * d2 + dx - dy;
+	}
+}
+
+// Robertsһϵ45ȡ135ӦpApBΪ
+static void GradientRow2(const BYTE* pA, const BYTE* pB, short* pSum[4], int nCount)
+{
+	short* pCW = pSum[2];
+	short* pCCW = pSum[3];
+
+	for (int j=0; j<nCount; j++)
 	{
-		// ͼС
-		pTo->ImResize(h, w);
+		pCW[j] = pB[j + 1] - pA[j];
+		pCCW[j] = pB[j] - pA[j + 1];
+	}
+}
 
-		// Ѱҷ׶任ֵСֵΪŻʾ׼
-		// ׶任ֵСֱֵ
-		double dMax = 0, dMin = 1E+006;
+// Ӧȡֵضϵ255
+static inline BYTE AbsToGray(short nSum)
+{
+	int nAbs = nSum < 0 ? -nSum : nSum;
+	return (BYTE)(nAbs > 255 ? 255 : nAbs);
+}
 
-		for (i=0; i<h; i++)
+// ĸҪӦʱͬһѭӦȡݶȼ䷽
+// ӦСȽ˳GradientRowsͬˮƽֱ45ȡ135ȣʱȳֵķ
+template <int nCenter>
+static void GradientMaxRow3(const BYTE* pA, const BYTE* pB, const BYTE* pC, BYTE* pMag, BYTE* pDir, int nCount)
+{
+	for (int j=0; j<nCount; j++)
+	{
+		short d1 = pC[j + 2] - pA[j];
+		short d2 = pA[j + 2] - pC[j];
+		short dx = pB[j + 2] - pB[j];
+		short dy = pC[j + 1] - pA[j + 1];
+
+		BYTE bH = AbsToGray(d1 - d2 + nCenter * dy);
+		BYTE bV = AbsToGray(d1 + d2 + nCenter * dx);
+		BYTE bCW = AbsToGray(nCenter * d1 + dx + dy);
+		BYTE bCCW = AbsToGray(nCenter * d2 + dx - dy);
+
+		BYTE bMag = bH;
+		BYTE bDir = bH > 0 ? 1 : 0;
+		bDir = bV > bMag ? 2 : bDir;
+		bMag = bV > bMag ? bV : bMag;
+		bDir = bCW > bMag ? 3 : bDir;
+		bMag = bCW > bMag ? bCW : bMag;
+		bDir = bCCW > bMag ? 4 : bDir;
+		bMag = bCCW > bMag ? bCCW : bMag;
+
+		pMag[j] = bMag;
+		pDir[j] = bDir;
+	}
+}
+
+// GenGradientддʱĲ
+struct SGradientParam
+{
+	const CImg* pSrc;
+	SGradient* pGrad;
+	int nOperator;
+};
+
+// ݶȵ[nBegin, nEnd)УpGradеķͻGenGradient׼
+static void GradientRows(int nBegin, int nEnd, LPVOID pParam)
+{
+	const SGradientParam& param = *(const SGradientParam*)pParam;
+	const CImg& imgSrc = *param.pSrc;
+	SGradient& grad = *param.pGrad;
+
+	BOOL bRoberts = (param.nOperator == GRAD_ROBERTS);
+	int nTempM = bRoberts ? 0 : 1;
+	int nWidth = grad.nWidth;
+	int nHeight = grad.nHeight;
+	BOOL bResponses = !grad.vecResp.empty();
+	BOOL bMaxOnly = !bRoberts && !bResponses && grad.nDirs == 4; // ֻҪ33ĸֵ
+
+	int nStartX = nTempM; //ʼ
+	int nCount = nWidth - (bRoberts ? 2 : 3) + 1;
+
+	// ĸӦ
+	vector<short> vecSum(4 * nCount);
+	short* pSum[4];
+	for (int n=0; n<4; n++)
+		pSum[n] = &vecSum[n * nCount];
+
+	int i, j, n;
+	for (i=nBegin; i<nEnd; i++)
+	{
+		// ģ帲ǵԴͼУӵһжӦģϽǿʼ
+		const BYTE* pA = imgSrc.GetConstRow(i - nTempM) + nStartX - nTempM;
+		const BYTE* pB = imgSrc.GetConstRow(i - nTempM + 1) + nStartX - nTempM;
+		BYTE* pMag = &grad.vecMag[(size_t)i * nWidth + nStartX];
+		BYTE* pDir = &grad.vecDir[(size_t)i * nWidth + nStartX];
+
+		if (bMaxOnly)
 		{
-			for (j=0; j<w; j++)
-			{
-				// 
-				dTemp = sqrt(FD[j * h + i].real() * FD[j * h + i].real() + 
-							 FD[j * h + i].imag() * FD[j * h + i].imag()) / 100;
-				
-				// 任
-				dTemp = log(1+dTemp);
+			const BYTE* pC = imgSrc.GetConstRow(i - nTempM + 2) + nStartX - nTempM;
+			if (param.nOperator == GRAD_SOBEL)
+				GradientMaxRow3<1>(pA, pB, pC, pMag, pDir, nCount);
+			else
+				GradientMaxRow3<2>(pA, pB, pC, pMag, pDir, nCount);
+			continue;
+		}
 
-				// ѰСֵ
-				dMax = max(dMax, dTemp);
-				dMin = min(dMin, dTemp);
-			}
+		if (bRoberts)
+			GradientRow2(pA, pB, pSum, nCount);
+		else
+		{
+			const BYTE* pC = imgSrc.GetConstRow(i - nTempM + 2) + nStartX - nTempM;
+			if (param.nOperator == GRAD_SOBEL)
+				GradientRow3<1>(pA, pB, pC, pSum, nCount);
+			else
+				GradientRow3<2>(pA, pB, pC, pSum, nCount);
 		}
 
-		for (i=0; i<h; i++)
+		// ˮƽֱ45ȡ135ȵ˳ȡݶȣʱȳֵķ
+		for (n=0; n<grad.nDirs; n++)
 		{
-			for (j=0; j<w; j++)
+			const short* pResp = pSum[grad.bDirs[n] - 1];
+			BYTE bDir = grad.bDirs[n];
+
+			if (bResponses)
 			{
-				// 
-				dTemp = sqrt(FD[j * h + i].real() * FD[j * h + i].real() + 
-							 FD[j * h + i].imag() * FD[j * h + i].imag()) / 100;
-				
-				// 任
-				dTemp = log(1+dTemp);
+				BYTE* pOut = &grad.vecResp[((size_t)n * nHeight + i) * nWidth + nStartX];
+				for (j=0; j<nCount; j++)
+					pOut[j] = AbsToGray(pResp[j]);
+			}
 
-				// ı䶯̬Χһ0~255
-				dTemp = (dTemp - dMin) / (dMax - dMin) * 255;
-				
-				// Ŀͼ
-				// ˴ֱȡjiΪ˽任ԭƵ
-				pTo->SetPixel((j<w/2 ? j+w/2 : j-w/2),(i<h/2 ? i+h/2 : i-h/2), RGB(dTemp, dTemp, dTemp));
+			for (j=0; j<nCount; j++)
+			{
+				BYTE bResp = AbsToGray(pResp[j]);
+				pDir[j] = bResp > pMag[j] ? bDir : pDir[j];
+				pMag[j] = bResp > pMag[j] ? bResp : pMag[j];
 			}
 		}
 	}
-
-	// ɾʱ
-	delete TD;
-	delete FD;
-
-	return true;
 }
 
 /**************************************************
-BOOL CImgProcess::IFFT2(CImgProcess * pTo, complex<double> * pInput, long lWidth, long lHeight, long lOutW, long lOutH)
+BOOL CImgProcess::GenGradient(SGradient * pGrad, int nOperator, BYTE bEdgeType, BOOL bResponses)
 
 ܣ
-	άٷҶ任
+	һɨѡݶӦݶȼ䷽
+	ģEdgeRobertsEdgeSobelEdgePrewittԭʹõͬ
+	ӦҲģTemplateĽͬȡֵضϵ255ԵΪ0
+	м㣬صĲֻ֣һԴͼ񣻰д̴߳
 
 
-	CImgProcess * pTo
-		ָͼָ
-	complex<double> * pInput
-		ָָ
-	long lWidth
-		ҪзҶ任Ŀ
-	long lHeight
-		ҪзҶ任ĸ߶
-	long lOutW
-		ָͼĿȣʡԣĬͬ
-	long lOutH
-		ָͼĸ߶ȣʡԣĬ߶ͬ
+	SGradient * pGrad
+		ݶ
+	int nOperator
+		GRAD_ROBERTSGRAD_SOBELGRAD_PREWITT
+	BYTE bEdgeType
+		_EdgeAll-ӵз _EdgeH-ˮƽ _EdgeV-ֱ _EdgeCW-45 _EdgeCCW-135
+	BOOL bResponses
+		Ƿ񱣴ӦΪfalseʱֻݶȼ䷽
+
 ֵ
-	BOOLͣtrueΪɹfalseΪʧ
+	ͣtrueΪɹfalseΪʧܣ8λͼӲ֧ѡ
 ***************************************************/
-
-BOOL CImgProcess::IFFT2(CImgProcess * pTo, complex<double> * pInput, long lWidth, long lHeight, long lOutW, long lOutH)
+BOOL CImgProcess::GenGradient(SGradient * pGrad, int nOperator, BYTE bEdgeType, BOOL bResponses)
 {
 	if (m_pBMIH->biBitCount!=8) return false;
+	if (nOperator < GRAD_ROBERTS || nOperator > GRAD_PREWITT) return false;
 
-	// м
-	double	dTemp;
-	
-	// ѭ
-	LONG		i;
-	LONG		j;
-	
-	// IFFT2ĿȺ͸߶ȣ2η
-	LONG		w;
-	LONG		h;
-	
-	int		wp;
-	int		hp;
-	
-	// ֵ
-	w = 1;
-	h = 1;
-	wp = 0;
-	hp = 0;
-	
-	// ͼĸ߿
-	if (lOutH == 0) lOutH = lHeight;
-	if (lOutW == 0) lOutW = lWidth;
-	
-	// зҶ任ĿȺ͸߶ȣ2η
-	while(w * 2 <= lWidth)
+	// RobertsΪ22ģ壬Ͻǣûˮƽֱ
+	BOOL bRoberts = (nOperator == GRAD_ROBERTS);
+	int nTempSize = bRoberts ? 2 : 3;
+	int nTempM = bRoberts ? 0 : 1;
+
+	// ȷҪķ
+	int nDirs = 0;
+	BYTE bDirs[4];
+	if (bEdgeType == 0)
 	{
-		w *= 2;
-		wp++;
+		for (BYTE bDir = bRoberts ? 3 : 1; bDir <= 4; bDir++)
+			bDirs[nDirs++] = bDir;
 	}
-	
-	while(h * 2 <= lHeight)
+	else if (bEdgeType <= 4 && (!bRoberts || bEdgeType >= 3))
+		bDirs[nDirs++] = bEdgeType;
+	else
+		return false;
+
+	int nHeight = GetHeight();
+	int nWidth = GetWidthPixel();
+	size_t nSize = (size_t)nWidth * nHeight;
+
+	pGrad->nWidth = nWidth;
+	pGrad->nHeight = nHeight;
+	pGrad->nDirs = nDirs;
+	memcpy(pGrad->bDirs, bDirs, nDirs);
+	pGrad->vecResp.assign(bResponses ? nDirs * nSize : 0, 0);
+	pGrad->vecMag.assign(nSize, 0);
+	pGrad->vecDir.assign(nSize, 0);
+
+	int nStartX = nTempM; //ʼ
+	int nEndX = nWidth - (nTempSize - nTempM) + 1; //ĽУ
+	int nCount = nEndX - nStartX;
+	if (nCount <= 0)
+		return true;
+
+	SGradientParam param = {this, pGrad, nOperator};
+	CImgParallel::For(nTempM, nHeight - (nTempSize - nTempM) + 1, GradientRows, &param);
+
+	return true;
+}
+
+// ԵԭķʽϲӦнӣ
+// ÿӺCImg::operator +һԹһ0255
+static void CombineGradient(const SGradient& grad, CImg* pTo)
+{
+	int nHeight = grad.nHeight;
+	int nWidth = grad.nWidth;
+	size_t nSize = (size_t)nWidth * nHeight;
+	int i;
+
+	if (grad.nDirs == 1)
 	{
-		h *= 2;
-		hp++;
+		for (i=0; i<nHeight; i++)
+			pTo->SetGrayRow(i, grad.GetResp(0, i));
+		return;
 	}
-	
-	// ڴ
-	complex<double> *TD = new complex<double>[w * h];
-	complex<double> *FD = new complex<double>[w * h];
-	
-	// 趨ͼС
-	pTo->ImResize(lOutH, lOutW);
 
-	// ֱ
-	for(i = 0; i < h; i++)
+	vector<BYTE> vecAcc(grad.vecResp.begin(), grad.vecResp.begin() + nSize);
+	vector<short> vecSum(nSize);
+	for (int n=1; n<grad.nDirs; n++)
 	{
-		// ˮƽ
-		for(j = 0; j < w; j++)
+		const BYTE* pResp = &grad.vecResp[n * nSize];
+		int nMax = 0;
+		int nMin = 255*2;
+		size_t k;
+		for (k=0; k<nSize; k++)
 		{
-			// Ƶֵ
-			FD[j + w * i] = pInput[j + w * i];
+			short nSum = vecAcc[k] + pResp[k];
+			vecSum[k] = nSum;
+			nMax = max(nMax, (int)nSum);
+			nMin = min(nMin, (int)nSum);
+		}
+
+		int nSpan = nMax - nMin;
+		for (k=0; k<nSize; k++)
+		{
+			if (nSpan > 0)
+				vecAcc[k] = (vecSum[k] - nMin) * 255 / nSpan;
+			else
+				vecAcc[k] = vecSum[k] <= 255 ? vecSum[k] : 255;
 		}
 	}
+
+	for (i=0; i<nHeight; i++)
+		pTo->SetGrayRow(i, &vecAcc[(size_t)i * nWidth]);
+}
+
+/**************************************************
+BOOL CImgProcess::EdgeRoberts(CImgProcess * pTo, BYTE bThre, BYTE bEdgeType, BOOL bThinning, BOOL bGOnly)
+
+ܣ
+	ԵѰңʹRoberts
+
+
+	CImgProcess * pTo
+		ָͼָ
+	BYTE bThre
+		϶ԵֵĬΪ0Զȷֵ
+	BYTE bEdgeType
+		_EdgeAll-бԵ _EdgeH-Ч _EdgeV-Ч _EdgeCW-45ȱԵ _EdgeCCW-135ȱԵ -Ч
+	BOOL bThinning
+		ǷбԵϸĬΪtrueִбԵϸ
+	BOOL bGOnly
+		ǷݶͼĬΪfalseֵĶֵͼ
+		˲ΪtrueʱbThrebThinning
+
+ֵ
+	ͣtrueΪɹfalseΪʧ
+***************************************************/
+
+BOOL CImgProcess::EdgeRoberts(CImgProcess * pTo, BYTE bThre, BYTE bEdgeType, BOOL bThinning, BOOL bGOnly)
+{
+	if (m_pBMIH->biBitCount!=8) return false;
+
+	// һѡӦԭķʽϲ
+	SGradient grad;
+	if (!GenGradient(&grad, GRAD_ROBERTS, bEdgeType)) return false;
+
+	CImgProcess imgTemp = *this;
+	CombineGradient(grad, &imgTemp);
 	
-	for(i = 0; i < h; i++)
+	if (bGOnly)
 	{
-		// yпٷҶ任
-		IFFT(&FD[w * i], &TD[w * i], wp);
+		// ݶ
+		*pTo = imgTemp;
 	}
-	
-	// 任
-	// ֱ
-	for(i = 0; i < h; i++)
+	else
 	{
-		// ˮƽ
-		for(j = 0; j < w; j++)
+		// ֵֵָ
+		if (bThre)
 		{
-			FD[i + h * j] = TD[j + w * i];
+			imgTemp.Threshold(pTo, bThre);
+		}
+		else			// Զֵ
+		{
+			imgTemp.AutoThreshold(pTo);
+		};
+
+		if (bThinning)
+		{
+			// һηɫΪԵϸ׼
+			pTo->LinTran(&imgTemp, -1, 255);
+
+			// Եϸ
+			imgTemp.Thining();
+
+			// ڶηɫõս
+			imgTemp.LinTran(pTo, -1, 255);
 		}
 	}
+
+	return true;
+}
+
+/**************************************************
+BOOL CImgProcess::EdgeSobel(CImgProcess * pTo, BYTE bThre, BYTE bEdgeType, BOOL bThinning, BOOL bGOnly)
+
+ܣ
+	ԵѰңʹSobel
+
+
+	CImgProcess * pTo
+		ָͼָ
+	BYTE bThre
+		϶ԵֵĬΪ0Զȷֵ
+	BYTE bEdgeType
+		_EdgeAll-бԵ _EdgeH-ˮƽԵ _EdgeV-ֱԵ _EdgeCW-45ȱԵ _EdgeCCW-135ȱԵ -Ч
+	BOOL bThinning
+		ǷбԵϸĬΪtrueִбԵϸ
+	BOOL bGOnly
+		ǷݶͼĬΪfalseֵĶֵͼ
+		˲ΪtrueʱbThrebThinning
+
+ֵ
+	ͣtrueΪɹfalseΪʧ
+***************************************************/
+BOOL CImgProcess::EdgeSobel(CImgProcess * pTo, BYTE bThre, BYTE bEdgeType, BOOL bThinning, BOOL bGOnly)
+{
+	if (m_pBMIH->biBitCount!=8) return false;
+
+	// һѡӦԭķʽϲ
+	SGradient grad;
+	if (!GenGradient(&grad, GRAD_SOBEL, bEdgeType)) return false;
+
+	CImgProcess imgTemp = *this;
+	CombineGradient(grad, &imgTemp);
 	
-	for(i = 0; i < w; i++)
+	if (bGOnly)
 	{
-		// xпٷҶ任
-		IFFT(&FD[i * h], &TD[i * h], hp);
+		// ݶ
+		*pTo = imgTemp;
 	}
-	
-	// Ѱҷ任任ֵСֵΪŻʾ׼
-	// ֵСֱֵ
-	double dMax = 0, dMin = 1E+006;
-
-	for (i=0; i<lOutH; i++)
+	else
 	{
-		for (j=0; j<lOutW; j++)
+		// ֵֵָ
+		if (bThre)
 		{
-			dTemp = TD[j * h + i].real();
-			
-			// ѰСֵ
-			dMax = max(dMax, dTemp);
-			dMin = min(dMin, dTemp);
+			imgTemp.Threshold(pTo, bThre);
 		}
-	}
+		else			// Զֵ
+		{
+			imgTemp.AutoThreshold(pTo);
+		};
 
-	// 
-	for(i = 0; i < lOutH; i++)
-	{
-		// 
-		for(j = 0; j < lOutW; j++)
+		if (bThinning)
 		{
-			dTemp = TD[j * h + i].real();
-			
-			// ı䶯̬Χһ0~255
-			dTemp = (dTemp - dMin) / (dMax - dMin) * 255;
+			// һηɫΪԵϸ׼
+			pTo->LinTran(&imgTemp, -1, 255);
+
+			// Եϸ
+			imgTemp.Thining();
 			
-			// Ŀͼ
-			pTo->SetPixel(j, i, RGB(dTemp, dTemp, dTemp));
+			// ڶηɫõս
+			imgTemp.LinTran(pTo, -1, 255);
 		}
 	}
-	
-	// ɾʱ
-	delete TD;
-	delete FD;
 
 	return true;
 }
 
 /**************************************************
-BOOL CImgProcess::FreqFilt(CImgProcess * pTo, double * pdFilter, BYTE bFillColor)
+BOOL CImgProcess::EdgePrewitt(CImgProcess * pTo, BYTE bThre, BYTE bEdgeType, BOOL bThinning, BOOL bGOnly)
 
 ܣ
-	ִƵ˲ʹӦ˾ɺdFilter˾
+	ԵѰңʹPrewitt
 
 
 	CImgProcess * pTo
 		ָͼָ
-	double * pdFilter
-		Ƶ˾
-	BYTE bFillColor
-		ԭͼʹõɫĬΪ255ɫ
-		ͼҲ͵ײԵɫһ¡
+	BYTE bThre
+		϶ԵֵĬΪ0Զȷֵ
+	BYTE bEdgeType
+		_EdgeAll-бԵ _EdgeH-ˮƽԵ _EdgeV-ֱԵ _EdgeCW-45ȱԵ _EdgeCCW-135ȱԵ -Ч
+	BOOL bThinning
+		ǷбԵϸĬΪtrueִбԵϸ
+	BOOL bGOnly
+		ǷݶͼĬΪfalseֵĶֵͼ
+		˲ΪtrueʱbThrebThinning
 
 ֵ
-	BOOLͣtrueΪɹfalseΪʧ
+	ͣtrueΪɹfalseΪʧ
 ***************************************************/
 
-BOOL CImgProcess::FreqFilt(CImgProcess * pTo, double * pdFilter, BYTE bFillColor)
+BOOL CImgProcess::EdgePrewitt(CImgProcess * pTo, BYTE bThre, BYTE bEdgeType, BOOL bThinning, BOOL bGOnly)
 {
 	if (m_pBMIH->biBitCount!=8) return false;
 
-	// ˾С
-	LONG w = GetFreqWidth();
-	LONG h = GetFreqHeight();
+	// һѡӦԭķʽϲ
+	SGradient grad;
+	if (!GenGradient(&grad, GRAD_PREWITT, bEdgeType)) return false;
 
-	// ʱƵͼ洢
-	complex<double> * cdFreqImg = new complex<double>[w*h];
+	CImgProcess imgTemp = *this;
+	CombineGradient(grad, &imgTemp);
 	
-	// ȶԭͼиҶ任
-	FFT2(NULL, 1, cdFreqImg, bFillColor);
-
-	// Ȼִк˲Ƶͼ˾Ԫ
-	for (LONG i = 0; i<w*h; i++)
+	if (bGOnly)
 	{
-		cdFreqImg[i] = cdFreqImg[i] * pdFilter[i];
+		// ݶ
+		*pTo = imgTemp;
 	}
+	else
+	{
+		// ֵֵָ
+		if (bThre)
+		{
+			imgTemp.Threshold(pTo, bThre);
+		}
+		else			// Զֵ
+		{
+			imgTemp.AutoThreshold(pTo);
+		};
 
-	// ˲иҶ任
-	IFFT2(pTo, cdFreqImg, w, h, GetWidthPixel(), GetHeight());
+		if (bThinning)
+		{
+			// һηɫΪԵϸ׼
+			pTo->LinTran(&imgTemp, -1, 255);
 
-	// ڶ̬Χ⣬ԭͼڽԵĻҶȷֽ磬
-	// ȫ֤˲ڻҶȲԭͼ񱣳ͬ
-	// ˿Ҫͼٽе
+			// Եϸ
+			imgTemp.Thining();
 
-	// ɾʱƵͼ
-	delete cdFreqImg;
+			// ڶηɫõս
+			imgTemp.LinTran(pTo, -1, 255);
+		}
+	}
 
 	return true;
 }
 
+// EdgeLoGĺLoGӦľֵԶֵϸ
+static void LoGEdgeThin(CImgProcess * pTo)
+{
+	// ʱCImgProcess
+	CImgProcess imgTemp = *pTo;
+	
+	// Զֵ
+	imgTemp.AutoThreshold(pTo);
+
+	// һηɫΪԵϸ׼
+	pTo->LinTran(&imgTemp, -1, 255);
+
+	// Եϸ
+	imgTemp.Thining();
+		
+	// ڶηɫõս
+	imgTemp.LinTran(pTo, -1, 255);
+}
+
+
 /**************************************************
-BOOL CImgProcess::FreqIdealLPF(double * pdFilter, int nFreq)
+void CImgProcess::EdgeLoG(CImgProcess * pTo)
 
 ܣ
-	ɶӦͼƵͨ˾
+	LoGӵıԵ
 
 
-	double * pdFilter
-		ָ˾ָ
-	int nFreq
-		ֹƵ
+	CImgProcess * pTo
+		ָͼָ
 
 ֵ
-	BOOLͣtrueΪɹfalseΪʧ
+	
 ***************************************************/
 
-BOOL CImgProcess::FreqIdealLPF(double * pdFilter, int nFreq)
+void CImgProcess::EdgeLoG(CImgProcess * pTo)
 {
-	if (m_pBMIH->biBitCount!=8) return false;
+	// Ӧģ嵽ͼ
+	Template(pTo, 5, 5, 2, 2, Template_Log, 1);
 
-	// ˾С
-	LONG w = GetFreqWidth();
-	LONG h = GetFreqHeight();
+	LoGEdgeThin(pTo);
+}
 
-	// ˾
-	for (int i=0; i<h; i++)
+/**************************************************
+void CImgProcess::EdgeLoG(CImgProcess * pTo, double dSigma, int nMode)
+
+ܣ
+	ָ߶ȵLoGԵ⡣LoGӦGenLoG㣬̶55ģ
+	EdgeLoGͬ
+
+
+	CImgProcess * pTo
+		ָͼָ
+	double dSigma
+		˹ı׼
+	int nMode
+		LOG_LAPLACIANLOG_DOGGenLoG
+
+ֵ
+	
+***************************************************/
+void CImgProcess::EdgeLoG(CImgProcess * pTo, double dSigma, int nMode)
+{
+	// LoGӦľֵضϵ0255
+	if(!GenLoG(pTo, &dSigma, 1, nMode))
+		return;
+
+	LoGEdgeThin(pTo);
+}
+
+// GenLoGĸ˹һı׼Сڵǰֱ2LOG_OCTAVE_SIGMAʱ
+// ƽLOG_OCTAVE_SIGMA22ƽ֮һķֱϼƽ
+// ǰ㹻ƽԺԣ߶ȵƽӦСͼϼ
+#define LOG_OCTAVE_SIGMA	4.0
+
+// ׼ΪdSigmaɢ˹ˣ뾶ȡ4ңضϴȨԼΪĵ0.03%ȨغΪ1ذ뾶
+static int MakeGaussKernel(double dSigma, vector<float>& vecW)
+{
+	int nRadius = max(1, (int)ceil(4 * dSigma));
+	vecW.resize(2 * nRadius + 1);
+
+	double dSum = 0;
+	for(int k=-nRadius; k<=nRadius; k++)
+		dSum += exp(-k * k / (2 * dSigma * dSigma));
+	for(int k=-nRadius; k<=nRadius; k++)
+		vecW[k + nRadius] = (float)(exp(-k * k / (2 * dSigma * dSigma)) / dSum);
+
+	return nRadius;
+}
+
+// ͼ±Ա߽ΪԳص[0, n)-1Ӧ0nӦn-1
+// ԳƵĸ˹ƽԱֶԳƣƽһƽڱ߽紦Ҳһ
+static inline int ReflectIndex(int y, int n)
+{
+	while(y < 0 || y >= n)
+		y = (y < 0) ? -y - 1 : 2 * n - 1 - y;
+	return y;
+}
+
+// ˹еһƽ棬
+struct SScalePlane
+{
+	vector<float> vecData;
+	int nWidth, nHeight;
+	int nFactor;		// һضӦԭͼnFactornFactor
+	double dSigma;		// ˹ƽı׼ԭͼؼ
+};
+
+// ƽϿɷ˹ƽд
+struct SGaussParam
+{
+	const float* pSrc;
+	float* pDst;
+	int nWidth, nHeight;
+	const float* pW;	// 2nRadius+1Ȩ
+	int nRadius;
+};
+
+// ˹ƽ[nBegin, nEnd)УзڸеļȨͣ
+// ٶһзһάҪм
+static void GaussRows(int nBegin, int nEnd, LPVOID pParam)
+{
+	const SGaussParam& param = *(const SGaussParam*)pParam;
+	int nWidth = param.nWidth, nHeight = param.nHeight;
+	int nRadius = param.nRadius;
+	int nTaps = 2 * nRadius + 1;
+
+	vector<const float*> vecIn(nTaps);
+	vector<float> vecLine(nWidth + 2 * nRadius); //зƽһУ˸nRadius
+	float* pLine = &vecLine[nRadius];
+
+	for(int i=nBegin; i<nEnd; i++)
 	{
-		for (int j=0; j<w; j++)
+		for(int t=0; t<nTaps; t++)
+			vecIn[t] = param.pSrc + (size_t)ReflectIndex(i - nRadius + t, nHeight) * nWidth;
+		CImgConv::WeightedSum(pLine, &vecIn[0], param.pW, nTaps, nWidth);
+
+		for(int t=1; t<=nRadius; t++)
 		{
-			// ԭĵ˾Լ򻯲Ҫֱ˾ĸ
-			if (sqrt( pow((double)(i-h/2),2) + pow((double)(j-w/2),2) ) > nFreq)
-			{
-				// дʱ˾бҪMATLABifftshiftԭƽ
-				pdFilter[(i<h/2 ? i+h/2 : i-h/2 ) * w + (j<w/2 ? j+w/2 : j-w/2)] = 0;
-			}
-			else
+			pLine[-t] = pLine[ReflectIndex(-t, nWidth)];
+			pLine[nWidth - 1 + t] = pLine[ReflectIndex(nWidth - 1 + t, nWidth)];
+		}
+
+		for(int t=0; t<nTaps; t++)
+			vecIn[t] = &vecLine[t];
+		CImgConv::WeightedSum(param.pDst + (size_t)i * nWidth, &vecIn[0], param.pW, nTaps, nWidth);
+	}
+}
+
+// ƽƽ׼dSigmaԭͼأдpTopToԾpFrom
+static void SmoothPlane(const SScalePlane& planeFrom, SScalePlane* pTo, double dSigma)
+{
+	const float* pSrc = &planeFrom.vecData[0];
+	vector<float> vecDst(planeFrom.vecData.size());
+
+	// ˹ķɼӣֻ貹ϲΪǰֱʵ
+	double dInc = sqrt(max(dSigma * dSigma - planeFrom.dSigma * planeFrom.dSigma, 0.0)) / planeFrom.nFactor;
+	if(dInc < 1e-3)
+		vecDst = planeFrom.vecData;
+	else
+	{
+		vector<float> vecW;
+		SGaussParam param;
+		param.pSrc = pSrc;
+		param.pDst = &vecDst[0];
+		param.nWidth = planeFrom.nWidth;
+		param.nHeight = planeFrom.nHeight;
+		param.nRadius = MakeGaussKernel(dInc, vecW);
+		param.pW = &vecW[0];
+		CImgParallel::For(0, planeFrom.nHeight, GaussRows, &param);
+	}
+
+	pTo->nWidth = planeFrom.nWidth;
+	pTo->nHeight = planeFrom.nHeight;
+	pTo->nFactor = planeFrom.nFactor;
+	pTo->dSigma = max(dSigma, planeFrom.dSigma);
+	pTo->vecData.swap(vecDst);
+}
+
+// 22ƽƽ൱ټϷΪ0.25صƽƽdSigma
+// ĿԾز룬ReflectIndexı߽һ
+static void DecimatePlane(const SScalePlane& planeFrom, SScalePlane* pTo)
+{
+	int nWidth = planeFrom.nWidth, nHeight = planeFrom.nHeight;
+	int nWidth2 = (nWidth + 1) / 2, nHeight2 = (nHeight + 1) / 2;
+	const float* pSrc = &planeFrom.vecData[0];
+
+	vector<float> vecDst((size_t)nWidth2 * nHeight2);
+	for(int i=0; i<nHeight2; i++)
+	{
+		const float* p0 = pSrc + (size_t)(2 * i) * nWidth;
+		const float* p1 = pSrc + (size_t)min(2 * i + 1, nHeight - 1) * nWidth;
+		float* pOut = &vecDst[(size_t)i * nWidth2];
+		for(int j=0; j<nWidth2; j++)
+		{
+			int x1 = min(2 * j + 1, nWidth - 1);
+			pOut[j] = 0.25f * (p0[2 * j] + p0[x1] + p1[2 * j] + p1[x1]);
+		}
+	}
+
+	double dBox = 0.5 * planeFrom.nFactor;
+	pTo->dSigma = sqrt(planeFrom.dSigma * planeFrom.dSigma + dBox * dBox);
+	pTo->nWidth = nWidth2;
+	pTo->nHeight = nHeight2;
+	pTo->nFactor = planeFrom.nFactor * 2;
+	pTo->vecData.swap(vecDst);
+}
+
+// LoGӦд
+struct SLoGParam
+{
+	const SScalePlane* pLevel;	// ˹ƽͼ
+	const SScalePlane* pLevel2;	// LOG_DOGʱ׼ϴһֱpLevelͬ
+	float fScale;				// ߶ȹһϵ
+	float* pResp;				// ƽϵӦΪNULLʱֱдpTo
+	CImg* pTo;
+};
+
+// LoGӦ[nBegin, nEnd)СpLevel2ΪNULLʱΪ5Laplacian
+// ͼⰴReflectIndexأȡı߽أΪ֮
+// дpToʱͼţʽȡֵ
+static void LoGRows(int nBegin, int nEnd, LPVOID pParam)
+{
+	const SLoGParam& param = *(const SLoGParam*)pParam;
+	const SScalePlane& level = *param.pLevel;
+	int nWidth = level.nWidth, nHeight = level.nHeight;
+	float fScale = param.fScale;
+	BOOL bSigned = param.pTo->GetFormat() == IMG_FMT_FLOAT32;
+
+	vector<float> vecRow(param.pResp == NULL ? nWidth : 0);
+	int j;
+
+	for(int i=nBegin; i<nEnd; i++)
+	{
+		float* pOut = (param.pResp != NULL) ? param.pResp + (size_t)i * nWidth : &vecRow[0];
+		const float* pMid = &level.vecData[(size_t)i * nWidth];
+		if(param.pLevel2 != NULL)
+		{
+			const float* p2 = &param.pLevel2->vecData[(size_t)i * nWidth];
+			for(j=0; j<nWidth; j++)
+				pOut[j] = fScale * (p2[j] - pMid[j]);
+		}
+		else
+		{
+			const float* pUp = &level.vecData[(size_t)ReflectIndex(i - 1, nHeight) * nWidth];
+			const float* pDown = &level.vecData[(size_t)ReflectIndex(i + 1, nHeight) * nWidth];
+			for(j=1; j<nWidth-1; j++)
+				pOut[j] = fScale * (pUp[j] + pDown[j] + pMid[j - 1] + pMid[j + 1] - 4 * pMid[j]);
+
+			// β
+			for(j=0; j<nWidth; j+=max(nWidth-1, 1))
 			{
-				pdFilter[(i<h/2 ? i+h/2 : i-h/2 ) * w + (j<w/2 ? j+w/2 : j-w/2)] = 1;
+				float fLeft = pMid[max(j - 1, 0)], fRight = pMid[min(j + 1, nWidth - 1)];
+				pOut[j] = fScale * (pUp[j] + pDown[j] + fLeft + fRight - 4 * pMid[j]);
 			}
 		}
+
+		if(param.pResp != NULL)
+			continue;
+
+		if(!bSigned)
+		{
+			for(j=0; j<nWidth; j++)
+				pOut[j] = (float)fabs(pOut[j]);
+		}
+		param.pTo->SetFloatRow(i, pOut);
+	}
+}
+
+// ƽϵӦ˫ԲֵԭͼߴĲ
+struct SUpsampleParam
+{
+	const float* pResp;
+	int nWidth, nHeight;	// Ӧƽĳߴ
+	int nFactor;
+	const int* pX0;			// кźҵȨ
+	const int* pX1;
+	const float* pWX;
+	CImg* pTo;
+};
+
+static void UpsampleRows(int nBegin, int nEnd, LPVOID pParam)
+{
+	const SUpsampleParam& param = *(const SUpsampleParam*)pParam;
+	int nWidth = param.pTo->GetWidthPixel();
+	BOOL bSigned = param.pTo->GetFormat() == IMG_FMT_FLOAT32;
+
+	vector<float> vecRow(nWidth);
+	for(int i=nBegin; i<nEnd; i++)
+	{
+		// ԭͼiеڽƽеλ
+		float fY = (i + 0.5f) / param.nFactor - 0.5f;
+		int y0 = (int)floor(fY);
+		float fWY = fY - y0;
+		const float* p0 = param.pResp + (size_t)ReflectIndex(y0, param.nHeight) * param.nWidth;
+		const float* p1 = param.pResp + (size_t)ReflectIndex(y0 + 1, param.nHeight) * param.nWidth;
+
+		for(int j=0; j<nWidth; j++)
+		{
+			int x0 = param.pX0[j], x1 = param.pX1[j];
+			float fTop = p0[x0] + (p0[x1] - p0[x0]) * param.pWX[j];
+			float fBottom = p1[x0] + (p1[x1] - p1[x0]) * param.pWX[j];
+			float fValue = fTop + (fBottom - fTop) * fWY;
+			vecRow[j] = bSigned ? fValue : (float)fabs(fValue);
+		}
+		param.pTo->SetFloatRow(i, &vecRow[0]);
 	}
-	
-	return true;
+}
+
+// ɽеһLOG_DOGʱΪLoGӦдpToļֵԭߴ
+static void WriteLoGResponse(const SScalePlane& level, const SScalePlane* pLevel2, float fScale, CImg* pTo)
+{
+	SLoGParam param;
+	param.pLevel = &level;
+	param.pLevel2 = pLevel2;
+	param.fScale = fScale;
+	param.pTo = pTo;
+
+	if(level.nFactor == 1)
+	{
+		param.pResp = NULL;
+		CImgParallel::For(0, level.nHeight, LoGRows, &param);
+		return;
+	}
+
+	vector<float> vecResp(level.vecData.size());
+	param.pResp = &vecResp[0];
+	CImgParallel::For(0, level.nHeight, LoGRows, &param);
+
+	int nWidth = pTo->GetWidthPixel();
+	vector<int> vecX0(nWidth), vecX1(nWidth);
+	vector<float> vecWX(nWidth);
+	for(int j=0; j<nWidth; j++)
+	{
+		float fX = (j + 0.5f) / level.nFactor - 0.5f;
+		int x0 = (int)floor(fX);
+		vecWX[j] = fX - x0;
+		vecX0[j] = ReflectIndex(x0, level.nWidth);
+		vecX1[j] = ReflectIndex(x0 + 1, level.nWidth);
+	}
+
+	SUpsampleParam up = {&vecResp[0], level.nWidth, level.nHeight, level.nFactor,
+		&vecX0[0], &vecX1[0], &vecWX[0], pTo};
+	CImgParallel::For(0, pTo->GetHeight(), UpsampleRows, &up);
+}
+
+// ĸ׼вdSigma
+static int FindScaleLevel(const vector<double>& vecLevel, double dSigma)
+{
+	int l = 0;
+	while(l + 1 < (int)vecLevel.size() && vecLevel[l] < dSigma * (1 - 1e-9))
+		l++;
+	return l;
 }
 
 /**************************************************
-BOOL CImgProcess::FreqGaussLPF(double * pdFilter, double dSigma)
+BOOL CImgProcess::GenLoG(CImgProcess * pTo, const double * pSigmas, int nScales, int nMode)
 
 ܣ
-	ɶӦͼĸ˹ͨ˾
+	߶ȵĳ߶ȹһLoGӦ˹ƽLaplacianԦ^2
+	ڶ߶ȵİߵ⡣
+	˹ƽֽΪСһά߶ĸ˹ͼ񰴱׼
+	𼶼㣬ÿһһ׼Ϊsqrt(2^2-1^2)ƽõ
+	߶ȹá׼ﵽ8ϵļڽĽϼ
+	LOG_OCTAVE_SIGMAӦ˫Բֵԭߴ磬߶Ȳ
+	Ա
+	LOG_LAPLACIANʽԸ˹ͼ5LaplacianLOG_DOGʽԱ׼
+	Ϊ/kͦҡkk = LOG_DOG_RATIO˹ͼ֮ƣ
+	ln(k)ǰߵͬ߶Ȱkȱʱڳ߶ȹһ
+	ͼԱ߽ΪԳأад̴߳
 
 
-	double * pdFilter
-		ָ˾ָ
-	double dSigma
-		˹˲Sigma
+	CImgProcess * pTo
+		nScalesͼ飬ߴ뱾ͼͬͼӦ
+		ţΪʽȡֵض
+	const double * pSigmas
+		߶ȸ˹ı׼0˳
+	int nScales
+		߶
+	int nMode
+		LOG_LAPLACIANLOG_DOG
 
 ֵ
-	BOOLͣtrueΪɹfalseΪʧ
+	BOOLͣϷʱFALSE
 ***************************************************/
-
-BOOL CImgProcess::FreqGaussLPF(double * pdFilter, double dSigma)
+BOOL CImgProcess::GenLoG(CImgProcess * pTo, const double * pSigmas, int nScales, int nMode)
 {
-	if (m_pBMIH->biBitCount!=8) return false;
+	if(!IsValidate() || pTo == NULL || pSigmas == NULL || nScales <= 0)
+		return FALSE;
 
-	// ˾С
-	LONG w = GetFreqWidth();
-	LONG h = GetFreqHeight();
+	int nWidth = GetWidthPixel();
+	int nHeight = GetHeight();
+	int s, l;
 
-	// ˾
-	for (int i=0; i<h; i++)
+	for(s=0; s<nScales; s++)
 	{
-		for (int j=0; j<w; j++)
-		{
-			// ԭĵ˾Լ򻯲Ҫֱ˾ĸ
-			// дʱ˾бҪMATLABifftshiftԭƽ
-			pdFilter[(i<h/2 ? i+h/2 : i-h/2 ) * w + (j<w/2 ? j+w/2 : j-w/2)] =
-				exp(-(pow((double)(i-h/2),2)+pow((double)(j-w/2),2))/2/pow(dSigma,2));
-		}
+		if(!(pSigmas[s] > 0) || !pTo[s].IsValidate()
+			|| pTo[s].GetWidthPixel() != nWidth || pTo[s].GetHeight() != nHeight)
+			return FALSE;
 	}
-	
-	return true;
-}
 
-/**************************************************
-BOOL CImgProcess::FreqGaussHPF(double * pdFilter, double dSigma)
+	// ߶ø˹ͼı׼LoGΪңDoGΪ/kͦҡkk = LOG_DOG_RATIO
+	// ֮ڦҴLoGln(k)
+	double dRootK = sqrt(LOG_DOG_RATIO);
+	vector<double> vecLow(nScales), vecHigh(nScales);
+	for(s=0; s<nScales; s++)
+	{
+		vecLow[s] = (nMode == LOG_DOG) ? pSigmas[s] / dRootK : pSigmas[s];
+		vecHigh[s] = (nMode == LOG_DOG) ? pSigmas[s] * dRootK : pSigmas[s];
+	}
 
-ܣ
-	ɶӦͼĸ˹ͨ˾
+	// ˹ͼı׼ֻͬһ
+	vector<double> vecLevel(vecLow);
+	vecLevel.insert(vecLevel.end(), vecHigh.begin(), vecHigh.end());
+	sort(vecLevel.begin(), vecLevel.end());
+	int nLevels = 0;
+	for(l=0; l<(int)vecLevel.size(); l++)
+	{
+		if(nLevels == 0 || vecLevel[l] > vecLevel[nLevels - 1] * (1 + 1e-9))
+			vecLevel[nLevels++] = vecLevel[l];
+	}
+	vecLevel.resize(nLevels);
+
+	// ߶õļó߶ʱڵļΪvecUse2
+	vector<int> vecUse(nScales), vecUse2(nScales);
+	vector<int> vecLastUse(nLevels); //ÿһõʱڵļ֮󼴿ͷ
+	for(l=0; l<nLevels; l++)
+		vecLastUse[l] = l;
+	for(s=0; s<nScales; s++)
+	{
+		vecUse[s] = FindScaleLevel(vecLevel, vecLow[s]);
+		vecUse2[s] = FindScaleLevel(vecLevel, vecHigh[s]);
+		vecLastUse[vecUse[s]] = max(vecLastUse[vecUse[s]], vecUse2[s]);
+		pTo[s].MakeUnique(FALSE); //ÿһждֻ߳дԵ
+	}
 
-
-	double * pdFilter
-		ָ˾ָ
-	double dSigma
-		˹˲Sigma
+	// ԭͼĸƽ棬֮Žм
+	SScalePlane planeWork;
+	planeWork.nWidth = nWidth;
+	planeWork.nHeight = nHeight;
+	planeWork.nFactor = 1;
+	planeWork.dSigma = 0;
+	planeWork.vecData.resize((size_t)nWidth * nHeight);
+	for(int i=0; i<nHeight; i++)
+	{
+		float* pRow = &planeWork.vecData[(size_t)i * nWidth];
+		const float* pValue = GetFloatRow(i, pRow);
+		if(pValue != pRow)
+			memcpy(pRow, pValue, nWidth * sizeof(float));
+	}
 
-ֵ
-	BOOLͣtrueΪɹfalseΪʧ
-***************************************************/
+	vector<SScalePlane> vecPlanes(nLevels);
+	const SScalePlane* pCur = &planeWork; //һƽõ
+	for(l=0; l<nLevels; l++)
+	{
+		// ׼ѹʱȽ
+		while(vecLevel[l] >= 2 * LOG_OCTAVE_SIGMA * pCur->nFactor
+			&& pCur->nWidth > 1 && pCur->nHeight > 1)
+		{
+			SmoothPlane(*pCur, &planeWork, LOG_OCTAVE_SIGMA * pCur->nFactor);
+			DecimatePlane(planeWork, &planeWork);
+			pCur = &planeWork;
+		}
 
-BOOL CImgProcess::FreqGaussHPF(double * pdFilter, double dSigma)
-{
-	if (m_pBMIH->biBitCount!=8) return false;
+		SmoothPlane(*pCur, &vecPlanes[l], vecLevel[l]);
+		pCur = &vecPlanes[l];
+		vector<float>().swap(planeWork.vecData);
 
-	// ˾С
-	LONG w = GetFreqWidth();
-	LONG h = GetFreqHeight();
+		// ڱĸ߶
+		for(s=0; s<nScales; s++)
+		{
+			if(vecUse2[s] != l)
+				continue;
 
-	// ˾
-	for (int i=0; i<h; i++)
-	{
-		for (int j=0; j<w; j++)
+			const SScalePlane& level = vecPlanes[l];
+			if(nMode != LOG_DOG)
+			{
+				double dSigma = pSigmas[s] / level.nFactor; //ǰֱµı׼
+				WriteLoGResponse(level, NULL, (float)(dSigma * dSigma), &pTo[s]);
+				continue;
+			}
+
+			// ķֱʲͬʱСһҲӵƽ׼
+			const SScalePlane* pLow = &vecPlanes[vecUse[s]];
+			SScalePlane planeLow;
+			while(pLow->nFactor < level.nFactor)
+			{
+				DecimatePlane(*pLow, &planeLow);
+				pLow = &planeLow;
+			}
+			WriteLoGResponse(*pLow, &level, (float)(1 / log(level.dSigma / pLow->dSigma)), &pTo[s]);
+		}
+
+		// ͷŲõļҪƽһ
+		for(int m=0; m<l; m++)
 		{
-			// ԭĵ˾Լ򻯲Ҫֱ˾ĸ
-			// дʱ˾бҪMATLABifftshiftԭƽ
-			pdFilter[(i<h/2 ? i+h/2 : i-h/2 ) * w + (j<w/2 ? j+w/2 : j-w/2)] =
-				1 - exp(-(pow((double)(i-h/2),2)+pow((double)(j-w/2),2))/2/pow(dSigma,2));
+			if(vecLastUse[m] <= l)
+				vector<float>().swap(vecPlanes[m].vecData);
 		}
 	}
-	
-	return true;
+
+	return TRUE;
 }
 
 /**************************************************
-BOOL CImgProcess::FreqLaplace(double * pdFilter)
+CImgProcess& CImgProcess::operator = (const CImg& img)
 
 ܣ
-	ɶӦͼƵ˹˲
+	ӻתϢͷɫߴȡimg
+	λͬдʱʱֱӹػ
 
-
-	double * pdFilter
-		ָ˾ָ
+ƣ
+	ѾЧͼ
 
+
+	const CImg& img
+		Դͼ
 ֵ
-	BOOLͣtrueΪɹfalseΪʧ
+	CImgProcess&ͣ
 ***************************************************/
-
-BOOL CImgProcess::FreqLaplace(double * pdFilter)
+CImgProcess& CImgProcess::operator = (const CImg& img)
 {
-	if (m_pBMIH->biBitCount!=8) return false;
+	if (this == &img)
+		return *this;
 
-	// ˾С
-	LONG w = GetFreqWidth();
-	LONG h = GetFreqHeight();
+	if (IsView())
+	{
+		// дͼд򣬷ֵͨԭͼ
+		CImg::operator = (img);
+		return *this;
+	}
 
-	// ˾
-	for (int i=0; i<h; i++)
+	if ( !IsValidate() )
 	{
-		for (int j=0; j<w; j++)
+		throw "Error in operaor '=': Left hand operand not initialized.";
+		return *this;
+	}
+
+	if (IsCopyOnWriteEnabled() && GetFormat() == img.GetFormat())
+	{
+		// ʽֻͬ³ߴ粢
+		m_pBMIH->biHeight = img.GetHeight();
+		m_pBMIH->biWidth = img.GetWidthPixel();
+		ShareBits(img);
+		return *this;
+	}
+
+	// ͼС
+	ImResize(img.GetHeight(), img.GetWidthPixel());
+
+	// ͼ
+	int nWidthBytes = img.GetWidthByte();
+	if (GetStride() == img.GetStride() && GetWidthByte() == nWidthBytes)
+	{
+		memcpy(GetBits(), img.GetConstBits(), (size_t)GetStride() * GetHeight());
+	}
+	else
+	{
+		for (int i=0; i<GetHeight(); i++)
 		{
-			// ԭĵ˾Լ򻯲Ҫֱ˾ĸ
-			// дʱ˾бҪMATLABifftshiftԭƽ
-			pdFilter[(i<h/2 ? i+h/2 : i-h/2 ) * w + (j<w/2 ? j+w/2 : j-w/2)] =
-				- (pow((double)(i-h/2),2) + pow((double)(j-w/2),2));
+			memcpy(GetRow(i), img.GetConstRow(i), nWidthBytes * sizeof(BYTE));
 		}
 	}
-	
-	return true;
+
+	return *this;
 }
 
 /**************************************************
-BOOL CImgProcess::FreqGaussBRF(double * pdFilter , int nFreq, int nWidth)
+BOOL CImgProcess::ProcessToWriter(CImgWriter& writer, int nHalo, PFN_BANDPROC pfnProc, LPVOID pParam)
 
 ܣ
-	ɶӦͼĸ˹˲
+	ͼзֳдÿд¸ȡnHaloΪ
+	pfnProcдмĽнwriterд
+	дǱͼͼפڴֻд
+	д߶writerĻԤ
 
-
-	double * pdFilter
-		ָ˾ָ
-	int nFreq
-		Ƶ
-	int nWidth
-		Ŀ
+ƣ
+	ֻڽֻnHaloĴ㡢ģ˲
+	ֵ˲33̬ѧȣȫͼͳƵĴֱͼ⡢Զֵ
+	Cannyͺֵͨעȣִͬ
+	writerѴ򿪣ߴ뱾ͼͬλ봦ͬ
 
+
+	CImgWriter& writer
+		д
+	int nHalo
+		33ģΪ1
+	PFN_BANDPROC pfnProc
+		д
+	LPVOID pParam
+		pfnProcĲ
 ֵ
-	BOOLͣtrueΪɹfalseΪʧ
+	BOOLͣTRUEΪɹFALSEΪʧ
 ***************************************************/
+BOOL CImgProcess::ProcessToWriter(CImgWriter& writer, int nHalo, PFN_BANDPROC pfnProc, LPVOID pParam)
+{
+	if (!IsValidate() || !writer.IsOpen() || pfnProc == NULL || nHalo < 0
+		|| writer.GetWidth() != GetWidthPixel() || writer.GetHeight() != GetHeight())
+		return FALSE;
 
-BOOL CImgProcess::FreqGaussBRF(double * pdFilter , int nFreq, int nWidth)
+	int nHeight = GetHeight();
+	int nWidth = GetWidthPixel();
+	int nWidthBytes = GetWidthByte();
+
+	// дǱͼֻͼԤֻд
+	int nBandRows = (int)(writer.GetTileBudget() / (size_t)ALIGNSTRIDE(nWidthBytes)) - 2 * nHalo;
+	if (nBandRows < 1)
+		nBandRows = 1;
+
+	CImgView imgBandIn;
+	CImgProcess imgBandOut;
+	for (int y0 = 0; y0 < nHeight; y0 += nBandRows)
+	{
+		int y1 = min(nHeight, y0 + nBandRows);
+		int nTop = max(0, y0 - nHalo);
+		int nBottom = min(nHeight, y1 + nHalo);
+
+		// д
+		imgBandIn.AttachView(*this, 0, nTop, nWidth, nBottom - nTop);
+
+		imgBandOut = imgBandIn;
+		pfnProc(&imgBandIn, &imgBandOut, pParam);
+
+		// ֻддмy0y1
+		if (!writer.WriteTile(imgBandOut, 0, y0, y0 - nTop, y1 - y0))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+// ִֿеȫ
+static std::atomic<int> g_nTileMode(IMG_TILE_ON);
+static std::atomic<size_t> g_nTileBytes(IMG_TILE_BYTES);
+
+struct STiledParam
 {
-	if (m_pBMIH->biBitCount!=8) return false;
+	const CImgProcess* pSrc;
+	CImgProcess* pTo;
+	int nHalo;
+	int nBandRows;		// ÿд
+	BOOL bSameFormat;	// дpToʽֱͬӸ
+	PFN_BANDPROC pfnProc;
+	LPVOID pParam;
+};
 
-	// ˾С
-	LONG w = GetFreqWidth();
-	LONG h = GetFreqHeight();
+// δnBeginnEnd-1д
+static void TiledBands(int nBegin, int nEnd, LPVOID pParam)
+{
+	STiledParam& param = *(STiledParam*)pParam;
+	int nHeight = param.pSrc->GetHeight();
+	int nWidth = param.pSrc->GetWidthPixel();
+	int nWidthBytes = param.pTo->GetWidthByte();
 
-	// ˾
-	for (int i=0; i<h; i++)
+	CImgView imgBandIn;
+	CImgProcess imgBandOut;
+	vector<BYTE> vecGray(nWidth); //ʽͬʱĻҶ
+	for (int k = nBegin; k < nEnd; k++)
 	{
-		for (int j=0; j<w; j++)
+		int y0 = k * param.nBandRows;
+		int y1 = min(nHeight, y0 + param.nBandRows);
+		int nTop = max(0, y0 - param.nHalo);
+		int nBottom = min(nHeight, y1 + param.nHalo);
+
+		imgBandIn.AttachView(*param.pSrc, 0, nTop, nWidth, nBottom - nTop);
+
+		imgBandOut = imgBandIn;
+		param.pfnProc(&imgBandIn, &imgBandOut, param.pParam);
+
+		// дмy0y1дд֮以ص
+		for (int y = y0; y < y1; y++)
 		{
-			// ԭĵ˾Լ򻯲Ҫֱ˾ĸ
-			// дʱ˾бҪMATLABifftshiftԭƽ
-			pdFilter[(i<h/2 ? i+h/2 : i-h/2 ) * w + (j<w/2 ? j+w/2 : j-w/2)] =
-				1 - exp(-0.5 * pow( (pow((double)(i - h/2), 2) + pow((double)(j - w/2),2) - pow((double)nFreq, 2))/
-				(sqrt( pow((double)(i - h/2), 2) + pow((double)(j - w/2),2) ) * nWidth ) ,2 ));
+			if (param.bSameFormat)
+				memcpy(param.pTo->GetRow(y), imgBandOut.GetConstRow(y - nTop), nWidthBytes);
+			else
+				param.pTo->SetGrayRow(y, imgBandOut.GetGrayRow(y - nTop, &vecGray[0]));
 		}
 	}
-	
-	return true;
 }
 
 /**************************************************
-BOOL CImgProcess::EdgeRoberts(CImgProcess * pTo, BYTE bThre, BYTE bEdgeType, BOOL bThinning, BOOL bGOnly)
+BOOL CImgProcess::ProcessTiled(CImgProcess* pTo, int nHalo, PFN_BANDPROC pfnProc, LPVOID pParam, size_t nTileBytes)
 
 ܣ
-	ԵѰңʹRoberts
+	ֿ飨ֿ飩ִж༶ͼгܷŽд
+	ÿд¸ȡnHaloΪpfnProcд
+	дмĽдpToмֻдСڻУ
+	𼶶дͼ񡣸дCImgParallelд
 
-
-	CImgProcess * pTo
-		ָͼָ
-	BYTE bThre
-		϶ԵֵĬΪ0Զȷֵ
-	BYTE bEdgeType
-		_EdgeAll-бԵ _EdgeH-Ч _EdgeV-Ч _EdgeCW-45ȱԵ _EdgeCCW-135ȱԵ -Ч
-	BOOL bThinning
-		ǷбԵϸĬΪtrueִбԵϸ
-	BOOL bGOnly
-		ǷݶͼĬΪfalseֵĶֵͼ
-		˲ΪtrueʱbThrebThinning
+ƣ
+	ProcessToWriterֻͬڽֻnHaloĴ
+	nHaloǴи뾶֮ͣ33Ϊ2
 
+
+	CImgProcess* pTo
+		ͼ񣬳ߴ뱾ͼͬǱͼ
+	int nHalo
+		
+	PFN_BANDPROC pfnProc
+		дɱ߳ͬʱ
+	LPVOID pParam
+		pfnProcĲ
+	size_t nTileBytes
+		ÿд򣩵ֽ0ΪSetTileBytes趨ֵ
 ֵ
-	ͣtrueΪɹfalseΪʧ
+	BOOLͣTRUEΪɹFALSEΪʧ
 ***************************************************/
+BOOL CImgProcess::ProcessTiled(CImgProcess* pTo, int nHalo, PFN_BANDPROC pfnProc, LPVOID pParam, size_t nTileBytes)
+{
+	if (!IsValidate() || pTo == NULL || pTo == this || !pTo->IsValidate() || pfnProc == NULL || nHalo < 0
+		|| pTo->GetWidthPixel() != GetWidthPixel() || pTo->GetHeight() != GetHeight())
+		return FALSE;
 
-BOOL CImgProcess::EdgeRoberts(CImgProcess * pTo, BYTE bThre, BYTE bEdgeType, BOOL bThinning, BOOL bGOnly)
+	if (nTileBytes == 0)
+		nTileBytes = GetTileBytes();
+
+	STiledParam param;
+	param.pSrc = this;
+	param.pTo = pTo;
+	param.nHalo = nHalo;
+	param.nBandRows = GetTileRows(GetWidthByte(), nHalo, nTileBytes);
+	param.bSameFormat = GetFormat() == pTo->GetFormat() && GetWidthByte() == pTo->GetWidthByte();
+	param.pfnProc = pfnProc;
+	param.pParam = pParam;
+
+	pTo->MakeUnique(FALSE); //ÿһждֻ߳дԵ
+
+	int nBands = (GetHeight() + param.nBandRows - 1) / param.nBandRows;
+	CImgParallel::For(0, nBands, TiledBands, &param, 0, 1);
+
+	return TRUE;
+}
+
+void CImgProcess::SetTileMode(int nMode)
 {
-	if (m_pBMIH->biBitCount!=8) return false;
+	g_nTileMode = (nMode == IMG_TILE_OFF) ? IMG_TILE_OFF : IMG_TILE_ON;
+}
 
-	// ģ
-	// 45ȱԵ
-	const FLOAT cfRobertCW[4] = { -1, 0,
-								   0, 1 };
-	// 135ȱԵ
-	const FLOAT cfRobertCCW[4] = { 0, -1,
-								   1,  0 };
+int CImgProcess::GetTileMode()
+{
+	return g_nTileMode;
+}
 
-	// ʱCImgProcess
-	CImgProcess imgTemp = *this;
-	CImgProcess imgMid = *this;
-
-	// ѡıԵӦģ
-	switch (bEdgeType) {
-		case 0:		// бԵ
-			Template(&imgTemp, 2, 2, 0, 0, (FLOAT*) cfRobertCW, 1);
-			Template(&imgMid, 2, 2, 0, 0, (FLOAT*) cfRobertCCW, 1);
-			imgTemp = imgTemp + imgMid;
-			break;
+void CImgProcess::SetTileBytes(size_t nBytes)
+{
+	g_nTileBytes = nBytes > 0 ? nBytes : IMG_TILE_BYTES;
+}
 
-		case 1:		// ˮƽԵ
-			return false;
+size_t CImgProcess::GetTileBytes()
+{
+	return g_nTileBytes;
+}
 
-		case 2:		// ֱԵ
-			return false;
-		
-		case 3:		// 45ȱԵ
-			Template(&imgTemp, 2, 2, 0, 0, (FLOAT*) cfRobertCW, 1);
-			break;
-		
-		case 4:		// 135ȱԵ
-			Template(&imgTemp, 2, 2, 0, 0, (FLOAT*) cfRobertCCW, 1);
-			break;
-		
-		default:			// 
-			return false;
-	};
-	
-	if (bGOnly)
+// Cannyͺֵıǣ0-ǱԵ 1-ڵֵĺѡ 255-Եڸֵٵĺѡ㣩
+static void CannyMarkRow(BYTE* pRow, int nCount, BYTE bThreL, BYTE bThreH)
+{
+	for (int j=0; j<nCount; j++)
 	{
-		// ݶ
-		*pTo = imgTemp;
+		BYTE bMag = pRow[j];
+		pRow[j] = bMag >= bThreH ? 255 : ((bMag >= bThreL && bMag > 0) ? 1 : 0);
 	}
-	else
-	{
-		// ֵֵָ
-		if (bThre)
-		{
-			imgTemp.Threshold(pTo, bThre);
-		}
-		else			// Զֵ
-		{
-			imgTemp.AutoThreshold(pTo);
-		};
+}
+
+// CannyǼֵƵһУݶȷԵֱȽ㣬
+// Ǿֲĵ0pUppMidpDownΪеݶȣpDirΪԵ
+// ӵ1пʼnCount㡣һȡϸڡһȡڵڣƽֻ̨һ㡣
+// ȶ8ٰѡõȽϵ㣬ûз֧
+static void CannySuppressRow(const BYTE* pUp, const BYTE* pMid, const BYTE* pDown,
+							 const BYTE* pDir, BYTE* pOut, int nCount)
+{
+	for (int j=1; j<=nCount; j++)
+	{
+		BYTE bDir = pDir[j];
+		BYTE bUp = pUp[j], bUpLeft = pUp[j - 1], bUpRight = pUp[j + 1];
+		BYTE bLeft = pMid[j - 1], bRight = pMid[j + 1];
+		BYTE bDown = pDown[j], bDownLeft = pDown[j - 1], bDownRight = pDown[j + 1];
+
+		// ˮƽԵȽ£ֱԵȽң45ȱԵȽϡ£135ȱԵȽϡ
+		BYTE b1 = bDir == 1 ? bUp : (bDir == 2 ? bLeft : (bDir == 3 ? bUpLeft : bUpRight));
+		BYTE b2 = bDir == 1 ? bDown : (bDir == 2 ? bRight : (bDir == 3 ? bDownRight : bDownLeft));
+		BYTE bMag = pMid[j];
+		pOut[j] = (bMag > b1 && bMag >= b2) ? bMag : 0;
+	}
+}
+
+// EdgeCannyддʱĲ
+struct SCannyParam
+{
+	const CImg* pSrc;
+	BYTE* pEdge;			// ıǣnHeightnWidthԵһȦΪ0
+	BYTE bThreL;
+	BYTE bThreH;
+	BOOL bThinning;
+	BOOL bMark;				// ֵ֪һк漴ǣֻͳֱͼһ
+
+	std::mutex mtx;
+	int nHistogram[256];	// ڲݶȵֱͼmtx
+};
+
+// [nBegin, nEnd)УͼĩУPrewittݶȼ䷽
+// ֻеĻλб棬ǼֵƺдpEdgeдβһݶ
+static void CannyRows(int nBegin, int nEnd, LPVOID pParam)
+{
+	SCannyParam& param = *(SCannyParam*)pParam;
+	const CImg& imgSrc = *param.pSrc;
+	int nWidth = imgSrc.GetWidthPixel();
+	int nHeight = imgSrc.GetHeight();
+	int nCount = nWidth - 2;
 
-		if (bThinning)
+	// yеݶȴڵy % 3УĩкĩΪ0
+	vector<BYTE> vecMag(3 * nWidth, 0), vecDir(3 * nWidth, 0);
+	int nHistogram[4][256] = {{ 0 }};
+
+	int i, j, y;
+	for (i=nBegin; i<nEnd; i++)
+	{
+		for (y=(i == nBegin ? i - 1 : i + 1); y<=i+1; y++)
 		{
-			// һηɫΪԵϸ׼
-			pTo->LinTran(&imgTemp, -1, 255);
+			if (y == 0 || y == nHeight - 1)
+			{
+				memset(&vecMag[(y % 3) * nWidth], 0, nWidth);
+				continue;
+			}
 
-			// Եϸ
-			imgTemp.Thining();
+			GradientMaxRow3<2>(imgSrc.GetConstRow(y - 1), imgSrc.GetConstRow(y), imgSrc.GetConstRow(y + 1),
+				&vecMag[(y % 3) * nWidth + 1], &vecDir[(y % 3) * nWidth + 1], nCount);
+		}
 
-			// ڶηɫõս
-			imgTemp.LinTran(pTo, -1, 255);
+		const BYTE* pMid = &vecMag[(i % 3) * nWidth];
+		if (!param.bMark)
+		{
+			// ݶȶ༯ֵϣڵĸֱͼͬһд
+			for (j=1; j+3<=nCount; j+=4)
+			{
+				nHistogram[0][pMid[j]]++;
+				nHistogram[1][pMid[j + 1]]++;
+				nHistogram[2][pMid[j + 2]]++;
+				nHistogram[3][pMid[j + 3]]++;
+			}
+			for (; j<=nCount; j++)
+				nHistogram[0][pMid[j]]++;
+		}
+
+		BYTE* pEdge = param.pEdge + (size_t)i * nWidth;
+		if (param.bThinning)
+		{
+			CannySuppressRow(&vecMag[((i + 2) % 3) * nWidth], pMid, &vecMag[((i + 1) % 3) * nWidth],
+				&vecDir[(i % 3) * nWidth], pEdge, nCount);
 		}
+		else
+			memcpy(pEdge + 1, pMid + 1, nCount);
+
+		if (param.bMark)
+			CannyMarkRow(pEdge + 1, nCount, param.bThreL, param.bThreH);
 	}
 
-	return true;
+	if (param.bMark)
+		return;
+
+	std::lock_guard<std::mutex> lock(param.mtx);
+	for (j=0; j<256; j++)
+		param.nHistogram[j] += nHistogram[0][j] + nHistogram[1][j] + nHistogram[2][j] + nHistogram[3][j];
+}
+
+// ֱֵͼȷ֮󣬶[nBegin, nEnd)
+static void CannyMarkRows(int nBegin, int nEnd, LPVOID pParam)
+{
+	const SCannyParam& param = *(const SCannyParam*)pParam;
+	int nWidth = param.pSrc->GetWidthPixel();
+
+	for (int i=nBegin; i<nEnd; i++)
+		CannyMarkRow(param.pEdge + (size_t)i * nWidth + 1, nWidth - 2, param.bThreL, param.bThreH);
 }
 
 /**************************************************
-BOOL CImgProcess::EdgeSobel(CImgProcess * pTo, BYTE bThre, BYTE bEdgeType, BOOL bThinning, BOOL bGOnly)
+BOOL CImgProcess::EdgeCanny(CImgProcess * pTo, BYTE bThreL, BYTE bThreH, BOOL bThinning)
 
 ܣ
-	ԵѰңʹSobel
+	CannyӵıԵ
+	Prewittÿݶȼ䷽GenGradientͬǼֵƺͺֵ
+	ڸֵĵΪԵٴЩջ8ٸڵֵĵ㡣
+	ݶȡǼֵƺֵǰдͬһɣݶֻеĻУ
+	Զֵʱһͬʱͳݶֱͼٲһǡ
+	ʱвԵڵĺѡ㣬ÿջһΣʱѡ
 
 
 	CImgProcess * pTo
 		ָͼָ
-	BYTE bThre
-		϶ԵֵĬΪ0Զȷֵ
-	BYTE bEdgeType
-		_EdgeAll-бԵ _EdgeH-ˮƽԵ _EdgeV-ֱԵ _EdgeCW-45ȱԵ _EdgeCCW-135ȱԵ -Ч
+	BYTE bThreL, BYTE bThreH
+		϶Եĵֵ͸ֵ
+		һΪ0ᱻԶɣɸֵʱԶǵֵ
+		ĬֵΪ0Զɸߵֵ
 	BOOL bThinning
-		ǷбԵϸĬΪtrueִбԵϸ
-	BOOL bGOnly
-		ǷݶͼĬΪfalseֵĶֵͼ
-		˲ΪtrueʱbThrebThinning
+		ǷбԵϸǼֵƣĬΪtrueִбԵϸ
 
 ֵ
 	ͣtrueΪɹfalseΪʧ
 ***************************************************/
-BOOL CImgProcess::EdgeSobel(CImgProcess * pTo, BYTE bThre, BYTE bEdgeType, BOOL bThinning, BOOL bGOnly)
+
+BOOL CImgProcess::EdgeCanny(CImgProcess * pTo, BYTE bThreL, BYTE bThreH, BOOL bThinning)
 {
+	int i;
+
 	if (m_pBMIH->biBitCount!=8) return false;
 
-	// ģ
-	// ˮƽԵ
-	const float cfSobelH[9] = {
-		-1, -1, -1,
-		 0,  0,  0,
-		 1,  1,  1 };
-	// ֱԵ
-	const float cfSobelV[9] = {
-		-1,  0,  1,
-		-1,  0,  1,
-		-1,  0,  1 };
-	// 45ȱԵ
-	const float cfSobelCW[9] = {
-		-1, -1,  0,
-		-1,  0,  1,
-		 0,  1,  1 };
-	// 135ȱԵ
-	const float cfSobelCCW[9] = {
-		 0,  1,  1,
-		-1,  0,  1,
-		-1, -1,  0 };
-	
-	// ʱCImgProcess
-	CImgProcess imgTemp = *this;
-	CImgProcess imgMid = *this;
-
-	// ѡıԵӦģ
-	switch (bEdgeType) {
-		case 0:		// бԵ
-			Template(&imgTemp, 3, 3, 1, 1, (float*)cfSobelH, 1);
-			Template(&imgMid, 3, 3, 1, 1, (float*)cfSobelV, 1);
-			imgTemp = imgTemp + imgMid;
-			Template(&imgMid, 3, 3, 1, 1, (float*)cfSobelCW, 1);
-			imgTemp = imgTemp + imgMid;
-			Template(&imgMid, 3, 3, 1, 1, (float*)cfSobelCCW, 1);
-			imgTemp = imgTemp + imgMid;
-			break;
-		
-		case 1:		// ˮƽԵ
-			Template(&imgTemp, 3, 3, 1, 1, (float*)cfSobelH, 1);
-			break;
-		
-		case 2:		// ֱԵ
-			Template(&imgTemp, 3, 3, 1, 1, (float*)cfSobelV, 1);
-			break;
-		
-		case 3:		// 45ȱԵ
-			Template(&imgTemp, 3, 3, 1, 1, (float*)cfSobelCW, 1);
-			break;
-		
-		case 4:		// 135ȱԵ
-			Template(&imgTemp, 3, 3, 1, 1, (float*)cfSobelCCW, 1);
-			break;
+	// ֵδֵȡֵ
+	if (bThreL > bThreH) return false;
+
+	if (bThreH != 0 && bThreL == 0) {
+		bThreL = 0.4 * bThreH;
+	}
+
+	int nHeight = GetHeight();
+	int nWidth = GetWidthPixel();
+	size_t nSize = (size_t)nWidth * nHeight;
+
+	// мݶȲǼֵƣͼԵһȦ롣
+	// ֵΪ0ʱͳݶֱͼֵȷٱ
+	vector<BYTE> vecEdge(nSize, 0);
+	SCannyParam param;
+	param.pSrc = this;
+	param.pEdge = &vecEdge[0];
+	param.bThreL = bThreL;
+	param.bThreH = bThreH;
+	param.bThinning = bThinning;
+	param.bMark = (bThreH != 0);
+	memset(param.nHistogram, 0, sizeof(param.nHistogram));
+	if (nWidth > 2)
+		CImgParallel::For(1, nHeight - 1, CannyRows, &param);
+
+	if (bThreH == 0) {
+		const int nMinDiff = 20;
+		int nDiffGray;
+
+		// ݶͼDetectThresholdͬݶͼԵһȦΪ0
+		param.nHistogram[0] += (int)(nSize - (nWidth > 2 && nHeight > 2 ? (size_t)(nWidth - 2) * (nHeight - 2) : 0));
+
+		bThreH = 1.2 * IterateThreshold(param.nHistogram, 100, nDiffGray);
+		bThreL = 0.4 * bThreH;
 		
-		default:			// 
-			return false;
-	};
-	
-	if (bGOnly)
-	{
-		// ݶ
-		*pTo = imgTemp;
+		if(nDiffGray < nMinDiff) return false;
+
+		param.bThreL = bThreL;
+		param.bThreH = bThreH;
+		if (nWidth > 2)
+			CImgParallel::For(1, nHeight - 1, CannyMarkRows, &param);
 	}
-	else
-	{
-		// ֵֵָ
-		if (bThre)
-		{
-			imgTemp.Threshold(pTo, bThre);
-		}
-		else			// Զֵ
-		{
-			imgTemp.AutoThreshold(pTo);
-		};
 
-		if (bThinning)
+	// ͺֵڸֵĵѱΪԵֻ账ѡ㡣вҺѡ㣬
+	// ԵʱΪԵջ8ĺѡ㶼ΪԵ
+	// ѡ㲻ͼԵϣ8򲻻Խ
+	const int nOffset[8] = {-nWidth - 1, -nWidth, -nWidth + 1, -1, 1, nWidth - 1, nWidth, nWidth + 1};
+	BYTE* pEdge = &vecEdge[0];
+	vector<int> vecStack; // ıԵ±
+	int k;
+	for (i=1; i<nHeight-1; i++)
+	{
+		BYTE* pRow = pEdge + (size_t)i * nWidth;
+		BYTE* pEnd = pRow + nWidth;
+		for (BYTE* pCand = pRow; (pCand = (BYTE*)memchr(pCand, 1, pEnd - pCand)) != NULL; pCand++)
 		{
-			// һηɫΪԵϸ׼
-			pTo->LinTran(&imgTemp, -1, 255);
+			for (k=0; k<8; k++)
+			{
+				if (pCand[nOffset[k]] == 255)
+					break;
+			}
+			if (k == 8)
+				continue;
 
-			// Եϸ
-			imgTemp.Thining();
-			
-			// ڶηɫõս
-			imgTemp.LinTran(pTo, -1, 255);
+			*pCand = 255;
+			vecStack.push_back((int)(pCand - pEdge));
+			while (!vecStack.empty())
+			{
+				int nPos = vecStack.back();
+				vecStack.pop_back();
+
+				for (k=0; k<8; k++)
+				{
+					int nNext = nPos + nOffset[k];
+					if (pEdge[nNext] == 1)
+					{
+						pEdge[nNext] = 255;
+						vecStack.push_back(nNext);
+					}
+				}
+			}
 		}
 	}
 
+	// δԵĺѡ
+	for (i=0; i<nHeight; i++)
+	{
+		BYTE* pRow = &vecEdge[(size_t)i * nWidth];
+		for (int j=0; j<nWidth; j++)
+			pRow[j] = pRow[j] == 255 ? 255 : 0;
+		pTo->SetGrayRow(i, pRow);
+	}
+
 	return true;
 }
 
+// RegionGrowоݣӻҶ֮ֵͬʱۼĻҶ
+struct SFillGrow
+{
+	const BYTE* pGray;
+	int nSeed;		// ǰӻҶ
+	int nThre;
+	int64_t nSum;	// Ҷֵ֮
+	int nCount;		// ĵ
+
+	BOOL Test(int p)
+	{
+		if(abs(pGray[p] - nSeed) > nThre)
+			return FALSE;
+		nSum += pGray[p];
+		nCount++;
+		return TRUE;
+	}
+	void Span(int, int, int) {}
+};
+
 /**************************************************
-BOOL CImgProcess::EdgePrewitt(CImgProcess * pTo, BYTE bThre, BYTE bEdgeType, BOOL bThinning, BOOL bGOnly)
+BOOL CImgProcess::RegionGrow(CImgProcess * pTo , int nSeedX, int nSeedY, BYTE bThre)
 
 ܣ
-	ԵѰңʹPrewitt
+	㷨
+
+ע
+	ӵ㰴8ͨɨ䣬ӻҶȹ̶ʱһ䵽Ϊֹ
+	֮ӻҶȸΪƽҶȣֻжΧܾĵ㣬
+	ֱƽҶȲٱ仯ڵĵֻжһΣٷɨͼ
 
 
 	CImgProcess * pTo
 		ָͼָ
+	int nSeedX, int nSeedY
+		ӵֵ
 	BYTE bThre
-		϶ԵֵĬΪ0Զȷֵ
-	BYTE bEdgeType
-		_EdgeAll-бԵ _EdgeH-ˮƽԵ _EdgeV-ֱԵ _EdgeCW-45ȱԵ _EdgeCCW-135ȱԵ -Ч
-	BOOL bThinning
-		ǷбԵϸĬΪtrueִбԵϸ
-	BOOL bGOnly
-		ǷݶͼĬΪfalseֵĶֵͼ
-		˲ΪtrueʱbThrebThinning
-
+		ʱʹõֵ
 ֵ
 	ͣtrueΪɹfalseΪʧ
 ***************************************************/
 
-BOOL CImgProcess::EdgePrewitt(CImgProcess * pTo, BYTE bThre, BYTE bEdgeType, BOOL bThinning, BOOL bGOnly)
+BOOL CImgProcess::RegionGrow(CImgProcess * pTo , int nSeedX, int nSeedY, BYTE bThre)
 {
 	if (m_pBMIH->biBitCount!=8) return false;
 
-	// ģ
-	// ˮƽԵ
-	const float cfPrewittH[9] = {
-		-1, -2, -1,
-		 0,  0,  0,
-		 1,  2,  1 };
-	// ֱԵ
-	const float cfPrewittV[9] = {
-		-1,  0,  1,
-		-2,  0,  2,
-		-1,  0,  1 };
-	// 45ȱԵ
-	const float cfPrewittCW[9] = {
-		-2, -1,  0,
-		-1,  0,  1,
-		 0,  1,  2 };
-	// 135ȱԵ
-	const float cfPrewittCCW[9] = {
-		 0,  1,  2,
-		-1,  0,  1,
-		-2, -1,  0 };
+	int nHeight = GetHeight();
+	int nWidth = GetWidthPixel();
+	if ((nSeedX<0)||(nSeedX>=nWidth)) return false;
+	if ((nSeedY<0)||(nSeedY>=nHeight)) return false;
 
-	// ʱCImgProcess
-	CImgProcess imgTemp = *this;
-	CImgProcess imgMid = *this;
-
-	// ѡıԵӦģ
-	switch (bEdgeType) {
-		case 0:		// бԵ
-			Template(&imgTemp, 3, 3, 1, 1, (float*)cfPrewittH, 1);
-			Template(&imgMid, 3, 3, 1, 1, (float*)cfPrewittV, 1);
-			imgTemp = imgTemp + imgMid;
-			Template(&imgMid, 3, 3, 1, 1, (float*)cfPrewittCW, 1);
-			imgTemp = imgTemp + imgMid;
-			Template(&imgMid, 3, 3, 1, 1, (float*)cfPrewittCW, 1);
-			imgTemp = imgTemp + imgMid;
-			break;
-		
-		case 1:		// ˮƽԵ
-			Template(&imgTemp, 3, 3, 1, 1, (float*)cfPrewittH, 1);
-			break;
-		
-		case 2:		// ֱԵ
-			Template(&imgTemp, 3, 3, 1, 1, (float*)cfPrewittV, 1);
-			break;
-		
-		case 3:		// 45ȱԵ
-			Template(&imgTemp, 3, 3, 1, 1, (float*)cfPrewittCW, 1);
-			break;
-		
-		case 4:		// 135ȱԵ
-			Template(&imgTemp, 3, 3, 1, 1, (float*)cfPrewittCCW, 1);
+	vector<BYTE> vecGray;
+	ReadGrayImage(*this, vecGray);
+
+	SScanFill fill;
+	InitScanFill(&fill, nWidth, nHeight, 0, TRUE, TRUE);
+
+	// ʼҶ
+	SFillGrow grow;
+	grow.pGray = &vecGray[0];
+	grow.nSeed = vecGray[(size_t)nSeedY * nWidth + nSeedX];
+	grow.nThre = bThre;
+	grow.nSum = 0;
+	grow.nCount = 0;
+
+	ScanFill(fill, nSeedX, nSeedY, grow);
+
+	// ֵʹøĽֵ㷨ΪѱƽҶȣ
+	// ֵ仯ΧܾĵܷЩ
+	vector<int> vecRetry;
+	for (;;)
+	{
+		int nSeed = (int)(grow.nSum / grow.nCount);
+		if (nSeed == grow.nSeed)
 			break;
-		
-		default:			// 
-			return false;
-	};
-	
-	if (bGOnly)
+		grow.nSeed = nSeed;
+
+		vecRetry.swap(fill.vecOut);
+		fill.vecOut.clear();
+		for (size_t k=0; k<vecRetry.size(); k++)
+			fill.vecMark[vecRetry[k]] = FILL_NONE;
+
+		for (size_t k=0; k<vecRetry.size(); k++)
+		{
+			int p = vecRetry[k];
+			if (fill.vecMark[p] == FILL_NONE)
+				ScanFill(fill, p % nWidth, p / nWidth, grow);
+		}
+	}
+
+	vector<BYTE> vecRow(nWidth);
+	for (int i=0; i<nHeight; i++)
 	{
-		// ݶ
-		*pTo = imgTemp;
+		const BYTE* pMark = &fill.vecMark[(size_t)i * nWidth];
+		for (int j=0; j<nWidth; j++)
+			vecRow[j] = pMark[j] == FILL_IN ? 255 : 0;
+		pTo->SetGrayRow(i, &vecRow[0]);
 	}
-	else
+
+	return true;
+}
+
+
+// ֲУȼ0255һȽȳͰӵ͵ȡ
+// ȼڵǰȡͰʱ뵱ǰͰȡȼ
+// ͷˮ빲ãʱӴ
+template<class T>
+struct SBucketQueue
+{
+	vector<T> vecBucket[256];
+	size_t nHead;	// ǰͰһҪȡλ
+	int nLevel;		// ǰͰ
+
+	SBucketQueue() : nHead(0), nLevel(0) {}
+
+	void Push(const T& item, int nPriority)
 	{
-		// ֵֵָ
-		if (bThre)
+		vecBucket[max(nPriority, nLevel)].push_back(item);
+	}
+
+	BOOL Pop(T& item)
+	{
+		while(nHead == vecBucket[nLevel].size())
 		{
-			imgTemp.Threshold(pTo, bThre);
+			vecBucket[nLevel].clear();
+			nHead = 0;
+			if(++nLevel == 256)
+			{
+				nLevel = 255;
+				return FALSE;
+			}
 		}
-		else			// Զֵ
-		{
-			imgTemp.AutoThreshold(pTo);
-		};
+		item = vecBucket[nLevel][nHead++];
+		return TRUE;
+	}
 
-		if (bThinning)
-		{
-			// һηɫΪԵϸ׼
-			pTo->LinTran(&imgTemp, -1, 255);
+	// ȡ֮´ȼ0ʼ
+	void Reset()
+	{
+		nHead = 0;
+		nLevel = 0;
+	}
+};
 
-			// Եϸ
-			imgTemp.Thining();
+// ӾΡġûصظӣΪ0
+static void GatherRgnStat(SConnRgnLabel* pLabel)
+{
+	int nWidth = pLabel->nWidth;
+	int nHeight = pLabel->nHeight;
 
-			// ڶηɫõս
-			imgTemp.LinTran(pTo, -1, 255);
+	SConnRgnStat statEmpty = {0, nWidth, nHeight, -1, -1, 0, 0};
+	vector<SConnRgnStat>& vecStat = pLabel->vecStat;
+	vecStat.assign(pLabel->nCount, statEmpty);
+	vector<double> vecSumX(pLabel->nCount, 0), vecSumY(pLabel->nCount, 0);
+
+	for(int i=0; i<nHeight; i++)
+	{
+		const int* pRow = pLabel->GetLabel(i);
+		for(int j=0; j<nWidth; j++)
+		{
+			if(!pRow[j])
+				continue;
+
+			int n = pRow[j] - 1;
+			SConnRgnStat& stat = vecStat[n];
+			stat.nArea++;
+			stat.nLeft = min(stat.nLeft, j);
+			stat.nTop = min(stat.nTop, i);
+			stat.nRight = max(stat.nRight, j);
+			stat.nBottom = i;
+			vecSumX[n] += j;
+			vecSumY[n] += i;
 		}
 	}
 
-	return true;
+	for(size_t n=0; n<vecStat.size(); n++)
+	{
+		if(vecStat[n].nArea == 0)
+			continue;
+		vecStat[n].dCenterX = vecSumX[n] / vecStat[n].nArea;
+		vecStat[n].dCenterY = vecSumY[n] / vecStat[n].nArea;
+	}
 }
 
-/**************************************************
-void CImgProcess::EdgeLoG(CImgProcess * pTo)
+// ׼ͼͻҶܸһȦпΪnWidth + 2
+// Ϊ-1ڱڵ㲻жǷ硣ͼΪʱvecDataΪ
+static BOOL InitSeedGrow(const CImg& imgSrc, SConnRgnLabel* pLabel, const POINT* pSeeds, int nSeeds, int nConn,
+						 vector<int>& vecData, vector<BYTE>& vecGray)
+{
+	int nHeight = imgSrc.GetHeight();
+	int nWidth = imgSrc.GetWidthPixel();
 
-ܣ
-	LoGӵıԵ
+	if(nConn != 4 && nConn != 8)
+		return FALSE;
+	if(nSeeds < 0 || (nSeeds > 0 && pSeeds == NULL))
+		return FALSE;
+	for(int k=0; k<nSeeds; k++)
+	{
+		if(pSeeds[k].x < 0 || pSeeds[k].x >= nWidth || pSeeds[k].y < 0 || pSeeds[k].y >= nHeight)
+			return FALSE;
+	}
 
-
-	CImgProcess * pTo
-		ָͼָ
+	pLabel->nWidth = nWidth;
+	pLabel->nHeight = nHeight;
+	pLabel->nCount = nSeeds;
+	pLabel->vecLabel.resize((size_t)nWidth * nHeight);
+	vecData.clear();
+	vecGray.clear();
+	if(pLabel->vecLabel.empty())
+	{
+		pLabel->vecStat.clear();
+		return TRUE;
+	}
 
-ֵ
-	
-***************************************************/
+	int nStride = nWidth + 2;
+	vecData.assign((size_t)nStride * (nHeight + 2), 0);
+	vecGray.assign(vecData.size(), 0);
+	int* pData = &vecData[0];
 
-void CImgProcess::EdgeLoG(CImgProcess * pTo)
+	for(int j=0; j<nStride; j++)
+	{
+		pData[j] = -1;
+		pData[(size_t)(nHeight + 1) * nStride + j] = -1;
+	}
+	for(int i=1; i<=nHeight; i++)
+	{
+		pData[(size_t)i * nStride] = -1;
+		pData[(size_t)i * nStride + nWidth + 1] = -1;
+
+		BYTE* pDst = &vecGray[(size_t)i * nStride + 1];
+		const BYTE* pSrc = imgSrc.GetGrayRow(i - 1, pDst);
+		if(pSrc != pDst)
+			memcpy(pDst, pSrc, nWidth);
+	}
+	return TRUE;
+}
+
+// ȥܵһȦͼͳƸ
+static void EndSeedGrow(SConnRgnLabel* pLabel, const vector<int>& vecData)
 {
-	// Ӧģ嵽ͼ
-	Template(pTo, 5, 5, 2, 2, Template_Log, 1);
+	int nWidth = pLabel->nWidth;
+	int nStride = nWidth + 2;
+	for(int i=0; i<pLabel->nHeight; i++)
+		memcpy(&pLabel->vecLabel[(size_t)i * nWidth], &vecData[(size_t)(i + 1) * nStride + 1], nWidth * sizeof(int));
 
-	
-	// ʱCImgProcess
-	CImgProcess imgTemp = *pTo;
-	
-	// Զֵ
-	imgTemp.AutoThreshold(pTo);
+	GatherRgnStat(pLabel);
+}
 
-	// һηɫΪԵϸ׼
-	pTo->LinTran(&imgTemp, -1, 255);
+// еһ
+struct SGrowRgn
+{
+	int64_t nSum;		// Ҷֵ֮
+	int nCount;			// ĵ
+	int nSeed;			// õӻҶ
+	vector<int> vecOut;	// ӻҶ֮ֵδڵ
+};
+
+// ĺѡ㣺ؼҪ
+struct SGrowItem
+{
+	int p;
+	int nRgn;
+};
 
-	// Եϸ
-	imgTemp.Thining();
-		
-	// ڶηɫõս
-	imgTemp.LinTran(pTo, -1, 255);
-}
+// ״̬ͼͻҶInitSeedGrow׼
+struct SSeedGrow
+{
+	int* pData;
+	const BYTE* pGray;
+	int nOffset[8];		// 8ڵ±֮ǰ4Ϊ4ڵ
+	int nConn;
+	int nThre;
+	vector<SGrowRgn> vecRgn;
+	SBucketQueue<SGrowItem> queue;
+};
 
-// ӻת
-CImgProcess& CImgProcess::operator = (CImg& img)
+// ӶδŵĵڱͼмΪ-2 - ȼֻȼʱٴ
+#define GROW_QUEUED(nPriority)	(-2 - (nPriority))
+
+// ѵqnӻҶ֮УֵļΪܾĵ㡣Ƿֵ֮
+static BOOL GrowPush(SSeedGrow& grow, int q, int n)
 {
-	// ͼС
-	if ( IsValidate() )
+	SGrowRgn& rgn = grow.vecRgn[n];
+	int nDiff = abs(grow.pGray[q] - rgn.nSeed);
+	if(nDiff > grow.nThre)
 	{
-		ImResize(img.GetHeight(), img.GetWidthPixel());
+		rgn.vecOut.push_back(q);
+		return FALSE;
 	}
-	else
+
+	if(grow.pData[q] == 0 || GROW_QUEUED(nDiff) > grow.pData[q])
 	{
-		throw "Error in operaor '=': Left hand operand not initialized.";
-		return *this;
+		grow.pData[q] = GROW_QUEUED(nDiff);
+		SGrowItem item = {q, n};
+		grow.queue.Push(item, nDiff);
 	}
+	return TRUE;
+}
 
-	// ͼ
-	for (int i=0; i<GetHeight(); i++)
+// nĵpѱţδŵڵ
+static void GrowNeighbors(SSeedGrow& grow, int p, int n)
+{
+	for(int k=0; k<grow.nConn; k++)
 	{
-		memcpy(m_lpData[i], img.m_lpData[i], img.GetWidthByte() * sizeof(BYTE));
+		int q = p + grow.nOffset[k];
+		if(grow.pData[q] > 0 || grow.pData[q] == -1)
+			continue; //ѱŻͼ֮
+		GrowPush(grow, q, n);
 	}
-
-	return *this;
 }
 
 /**************************************************
-BOOL CImgProcess::EdgeCanny(CImgProcess * pTo, BYTE bThreL, BYTE bThreH, BOOL bThinning)
+BOOL CImgProcess::RegionGrow(SConnRgnLabel* pLabel, const POINT* pSeeds, int nSeeds, BYTE bThre, int nConn)
 
 ܣ
-	CannyӵıԵ
+	һͬʱΪ32λͼ
+
+ע
+	뵥ӵRegionGrowͬԹ̶ӻҶΪֹ
+	ٰӻҶȸΪƽҶȣֻжϸΧܾĵ㣬
+	ֱƽҶȲٱ仯һֲͬʱ
+	ѡ㰴ӻҶ֮򣬳ʱŹԼ
+	ĵڻҶӽ򶼲ĵ㲻κ
+	ֻһʱRegionGrowͬӵRegionGrow
 
 
-	CImgProcess * pTo
-		ָͼָ
-	BYTE bThreL, BYTE bThreH
-		϶Եĵֵ͸ֵ
-		һΪ0ᱻԶɣɸֵʱԶǵֵ
-		ĬֵΪ0Զɸߵֵ
-	BOOL bThinning
-		ǷбԵϸĬΪtrueִбԵϸ
+	SConnRgnLabel* pLabel
+		ıͼ͸ͳƣkΪk + 1
+		δĵΪ0ͬһλõظֻеһЧΪ0
+	const POINT* pSeeds, int nSeeds
+		ӵ꼰
+	BYTE bThre
+		ʱʹõֵ
+	int nConn
+		ȡֵΪ48ʾ4ͨ8ͨĬΪ8
 
 ֵ
-	ͣtrueΪɹfalseΪʧ
+	BOOLͣͼ֮nConn48ʱFALSE
 ***************************************************/
 
-BOOL CImgProcess::EdgeCanny(CImgProcess * pTo, BYTE bThreL, BYTE bThreH, BOOL bThinning)
+BOOL CImgProcess::RegionGrow(SConnRgnLabel* pLabel, const POINT* pSeeds, int nSeeds, BYTE bThre, int nConn)
 {
-	int i, j;
-
-	if (m_pBMIH->biBitCount!=8) return false;
-
-	// ݶֵ
-	CImgProcess imgGH = *this, imgGV = *this, imgGCW = *this, imgGCCW = *this, imgGratitude = *this;
-
-	// ʹPrewittģϵݶֵ
-	EdgePrewitt(&imgGH, 0, 1, 0, 1);
-	EdgePrewitt(&imgGV, 0, 2, 0, 1);
-	EdgePrewitt(&imgGCW, 0, 3, 0, 1);
-	EdgePrewitt(&imgGCCW, 0, 4, 0, 1);
-
-	// ݶȷ
-	BYTE * pbDirection = new BYTE [GetHeight() * GetWidthByte()];
-
-	memset(pbDirection, 0, GetHeight() * GetWidthByte() * sizeof(BYTE));
+	vector<int> vecData;
+	vector<BYTE> vecGray;
+	if(!InitSeedGrow(*this, pLabel, pSeeds, nSeeds, nConn, vecData, vecGray))
+		return FALSE;
+	if(vecData.empty())
+		return TRUE;
+
+	int nStride = GetWidthPixel() + 2;
+	SSeedGrow grow;
+	grow.pData = &vecData[0];
+	grow.pGray = &vecGray[0];
+	const int nOffset[8] = {-nStride, -1, 1, nStride, -nStride - 1, -nStride + 1, nStride - 1, nStride + 1};
+	memcpy(grow.nOffset, nOffset, sizeof(nOffset));
+	grow.nConn = nConn;
+	grow.nThre = bThre;
+	grow.vecRgn.resize(nSeeds);
+
+	int* pData = grow.pData;
+	const BYTE* pGray = grow.pGray;
+	int n;
+
+	// ͬһλõֻеһЧ
+	for(n=0; n<nSeeds; n++)
+	{
+		SGrowRgn& rgn = grow.vecRgn[n];
+		rgn.nSum = 0;
+		rgn.nCount = 0;
+		rgn.nSeed = 0;
+		int p = (pSeeds[n].y + 1) * nStride + pSeeds[n].x + 1;
+		if(pData[p])
+			continue;
+		pData[p] = n + 1;
+		rgn.nSeed = pGray[p];
+		rgn.nSum = pGray[p];
+		rgn.nCount = 1;
+	}
+	for(n=0; n<nSeeds; n++)
+	{
+		if(grow.vecRgn[n].nCount > 0)
+			GrowNeighbors(grow, (pSeeds[n].y + 1) * nStride + pSeeds[n].x + 1, n);
+	}
 
-	// ѰÿݶȷдӦݶֵ
-	imgGratitude.InitPixels(0);
-	for (i=0; i<GetHeight(); i++)
+	SGrowItem item;
+	vector<int> vecRetry;
+	for(;;)
 	{
-		for (j=0; j<GetWidthPixel(); j++)
+		// ӻҶȹ̶Ϊֹ
+		while(grow.queue.Pop(item))
 		{
-			BYTE gray = 0;
-
-			if (imgGH.GetGray(j, i) > gray)
-			{
-				gray = imgGH.GetGray(j, i);
-				pbDirection[i * GetWidthPixel() + j] = _EdgeH;
-				imgGratitude.SetPixel(j, i, RGB(gray, gray, gray));
-			}
+			int p = item.p;
+			if(pData[p] > 0)
+				continue; //ѹҶȸӽȵ
+
+			SGrowRgn& rgn = grow.vecRgn[item.nRgn];
+			pData[p] = item.nRgn + 1;
+			rgn.nSum += pGray[p];
+			rgn.nCount++;
+			GrowNeighbors(grow, p, item.nRgn);
+		}
+		grow.queue.Reset();
 
-			if (imgGV.GetGray(j, i) > gray)
-			{
-				gray = imgGV.GetGray(j, i);
-				pbDirection[i * GetWidthPixel() + j] = _EdgeV;
-				imgGratitude.SetPixel(j, i, RGB(gray, gray, gray));
-			}
+		// ӻҶȸΪƽҶȣ仯˵жϱܾĵ
+		BOOL bGrow = FALSE;
+		for(n=0; n<nSeeds; n++)
+		{
+			SGrowRgn& rgn = grow.vecRgn[n];
+			if(rgn.nCount == 0)
+				continue;
+			int nSeed = (int)(rgn.nSum / rgn.nCount);
+			if(nSeed == rgn.nSeed)
+				continue;
+			rgn.nSeed = nSeed;
 
-			if (imgGCW.GetGray(j, i) > gray)
-			{
-				gray = imgGCW.GetGray(j, i);
-				pbDirection[i * GetWidthPixel() + j] = _EdgeCW;
-				imgGratitude.SetPixel(j, i, RGB(gray, gray, gray));
-			}
+			// ͬһܴӼڵ㱻ܾ
+			vecRetry.swap(rgn.vecOut);
+			rgn.vecOut.clear();
+			sort(vecRetry.begin(), vecRetry.end());
+			vecRetry.erase(unique(vecRetry.begin(), vecRetry.end()), vecRetry.end());
 
-			if (imgGCCW.GetGray(j, i) > gray)
+			for(size_t t=0; t<vecRetry.size(); t++)
 			{
-				gray = imgGCCW.GetGray(j, i);
-				pbDirection[i * GetWidthPixel() + j] = _EdgeCCW;
-				imgGratitude.SetPixel(j, i, RGB(gray, gray, gray));
+				if(pData[vecRetry[t]] <= 0 && GrowPush(grow, vecRetry[t], n)) //·
+					bGrow = TRUE;
 			}
 		}
+		if(!bGrow)
+			break;
 	}
 
-	// ֵʱǰĶ
-	CImgProcess *pImgThreL = &imgGH, *pImgThreH = &imgGV;
+	EndSeedGrow(pLabel, vecData);
+	return TRUE;
+}
 
-	// ֵδֵȡֵ
-	if (bThreL > bThreH) return false;
-	
-	if (bThreH == 0) {
-		const int nMinDiff = 20;
-		int nDiffGray;
+/**************************************************
+BOOL CImgProcess::Watershed(SConnRgnLabel* pLabel, const POINT* pSeeds, int nSeeds, int nConn)
 
-		bThreH = 1.2 * imgGratitude.DetectThreshold(100, nDiffGray);
-		bThreL = 0.4 * bThreH;
-		
-		if(nDiffGray < nMinDiff) return false;
-	}
-	
-	if (bThreL == 0) {
-		bThreL = 0.4 * bThreH;
-	}
+ܣ
+	ǿƵķˮָΪ32λͼ
 
-	// ݶͼ񰴸ߵֱֵֵ
-	imgGratitude.Threshold(pImgThreL, bThreL);
-	imgGratitude.Threshold(pImgThreH, bThreH);
+ע
+	Meyerû㷨Ӹǵ÷ֲаҶɵ͵ͬʱû
+	ÿû򣬸ڷˮ봦ͨݶͼ
+	ָǵȡĿڲеĵ㡣ÿֻһΣʱ
+	ȣˮ
 
-	// ʼĿͼ
-	pTo->InitPixels(0);
-	
-	// ݵֵͼڸֵͼϽб߽޲
-	for (i=1; i<GetHeight()-1; i++)
-	{
-		for (j=1; j<GetWidthPixel()-1; j++)
-		{
-			if (pImgThreH->GetGray(j, i))
-			{
-				// ֵͼϷֱֵȷ
-				pTo->SetPixel(j, i, RGB(255, 255, 255));
-				
-				// ݶϵ
-				switch ( pbDirection[i * GetWidthPixel() + j] ) {
-					case 1:	// ˮƽ
-						if (pImgThreL->GetGray(j+1, i))
-						{
-							pImgThreH->SetPixel(j+1, i, RGB(255, 255, 255));
-						}
-						if (pImgThreL->GetGray(j-1, i))
-						{
-							pImgThreH->SetPixel(j-1, i, RGB(255, 255, 255));
-						}
-						break;
+
+	SConnRgnLabel* pLabel
+		ıͼ͸ͳƣkǵûΪk + 1
+		ǵ㲻ͨĵΪ0ͬһλõظǵֻеһЧ
+	const POINT* pSeeds, int nSeeds
+		ǵ꼰
+	int nConn
+		ȡֵΪ48ʾ4ͨ8ͨĬΪ8
 
-					case 2:	// ֱ
-						if (pImgThreL->GetGray(j, i+1))
-						{
-							pImgThreH->SetPixel(j, i+1, RGB(255, 255, 255));
-						}
-						if (pImgThreL->GetGray(j, i-1))
-						{
-							pImgThreH->SetPixel(j, i-1, RGB(255, 255, 255));
-						}
-						break;
+ֵ
+	BOOLͣǵͼ֮nConn48ʱFALSE
+***************************************************/
 
-					case 3:	// 45ȷ
-						if (pImgThreL->GetGray(j+1, i-1))
-						{
-							pImgThreH->SetPixel(j+1, i-1, RGB(255, 255, 255));
-						}
-						if (pImgThreL->GetGray(j-1, i+1))
-						{
-							pImgThreH->SetPixel(j-1, i+1, RGB(255, 255, 255));
-						}
-						break;
+BOOL CImgProcess::Watershed(SConnRgnLabel* pLabel, const POINT* pSeeds, int nSeeds, int nConn)
+{
+	vector<int> vecData;
+	vector<BYTE> vecGray;
+	if(!InitSeedGrow(*this, pLabel, pSeeds, nSeeds, nConn, vecData, vecGray))
+		return FALSE;
+	if(vecData.empty())
+		return TRUE;
+
+	int nStride = GetWidthPixel() + 2;
+	int* pData = &vecData[0];
+	const BYTE* pGray = &vecGray[0];
+	SBucketQueue<int> queue;
+
+	// ͬһλõıǵֻеһЧ
+	for(int k=0; k<nSeeds; k++)
+	{
+		int p = (pSeeds[k].y + 1) * nStride + pSeeds[k].x + 1;
+		if(pData[p])
+			continue;
+		pData[p] = k + 1;
+		queue.Push(p, pGray[p]);
+	}
 
-					case 4:	// 135ȷ
-						if (pImgThreL->GetGray(j+1, i+1))
-						{
-							pImgThreH->SetPixel(j+1, i+1, RGB(255, 255, 255));
-						}
-						if (pImgThreL->GetGray(j-1, i-1))
-						{
-							pImgThreH->SetPixel(j-1, i-1, RGB(255, 255, 255));
-						}
-						break;
-				}
-			}//if
-		}//for j
-	}//for i
+	// 8ڵ±֮ǰ4Ϊ4ڵ
+	const int nOffset[8] = {-nStride, -1, 1, nStride, -nStride - 1, -nStride + 1, nStride - 1, nStride + 1};
 
-	if (bThinning)
+	// ȡҶ͵ĵ㣬δŵڵͬһźӣûõõ
+	int p;
+	while(queue.Pop(p))
 	{
-		// һηɫΪԵϸ׼
-		pImgThreH->LinTran(pImgThreL, -1, 255);
+		int n = pData[p];
 
-		// Եϸ
-		pImgThreL->Thining();
-		
-		// ڶηɫõս
-		pImgThreL->LinTran(pTo, -1, 255);
-	}
-	else
-	{
-		*pTo = *pImgThreH;
-	}
+		for(int k=0; k<nConn; k++)
+		{
+			int q = p + nOffset[k];
+			if(pData[q])
+				continue;
 
-	delete pbDirection;
+			pData[q] = n;
+			queue.Push(q, pGray[q]);
+		}
+	}
 
-	return true;
+	EndSeedGrow(pLabel, vecData);
+	return TRUE;
 }
 
+
+
+
 /**************************************************
-BOOL CImgProcess::RegionGrow(CImgProcess * pTo , int nSeedX, int nSeedY, BYTE bThre)
+BOOL CImgProcess::GenIntegral(SIntegralImage * pIntegral, BOOL bSquare)
 
 ܣ
-	㷨
+	ͼĻͼĺֵ͡ĳʱѯ
+	ֲֲֵԱȶȵͳƣ߾ͼԭֵۼӣʽҶ
 
 
-	CImgProcess * pTo
-		ָͼָ
-	int nSeedX, int nSeedY
-		ӵֵ
-	BYTE bThre
-		ʱʹõֵ
+	SIntegralImage * pIntegral
+		Ļͼ
+	BOOL bSquare
+		Ƿͬʱƽͣ󷽲ʱҪĬΪFALSE
 ֵ
-	ͣtrueΪɹfalseΪʧ
+	BOOLͣtrueΪɹfalseΪʧ
 ***************************************************/
 
-BOOL CImgProcess::RegionGrow(CImgProcess * pTo , int nSeedX, int nSeedY, BYTE bThre)
+BOOL CImgProcess::GenIntegral(SIntegralImage * pIntegral, BOOL bSquare)
 {
-	if (m_pBMIH->biBitCount!=8) return false;
+	int nHeight = GetHeight();
+	int nWidth = GetWidthPixel();
+	if (nWidth <= 0 || nHeight <= 0) return false;
 
-	if ((nSeedX<0)||(nSeedX>GetWidthPixel())) return false;
-	if ((nSeedY<0)||(nSeedY>GetHeight())) return false;
+	size_t nStride = (size_t)nWidth + 1;
+	pIntegral->nWidth = nWidth;
+	pIntegral->nHeight = nHeight;
+	pIntegral->vecSum.assign(nStride * (nHeight + 1), 0.0);
+	pIntegral->vecSqSum.assign(bSquare ? nStride * (nHeight + 1) : 0, 0.0);
 
-	pTo->InitPixels(0);
-	pTo->SetPixel(nSeedX, nSeedY, RGB(255, 255, 255));
+	vector<BYTE> vecGray(nWidth);
+	vector<float> vecValue(nWidth);
+	for (int i=0; i<nHeight; i++)
+	{
+		const float* pRow = ReadValueRow(*this, i, vecGray, vecValue);
 
-	// ʼҶ
-	BYTE bSeed = GetGray(nSeedX, nSeedY);
-	// Ҷֵ֮
-	long int lSum = bSeed;
-	// ĵÿΰз
-	int nSuit = 1, nCount = 1;
-	
-	// ʼѭ
-	while (nCount > 0)
-	{
-		nCount = 0;
-
-		for (int i=1; i<GetHeight()-1; i++)
-		{	// 
-			for (int j=1; j<GetWidthPixel()-1; j++)
-			{	// 
-				if (pTo->GetGray(j, i)==255)
-				{	// ӵ
-					// ʼ8ɨ
-					for (int m=i-1; m<=i+1; m++)
-					{
-						for (int n=j-1; n<=j+1; n++)
-						{
-							// жǷֵδ
-							if ((pTo->GetGray(n, m)==0)&&(abs(GetGray(n, m)-bSeed)<=bThre))
-							{
-								pTo->SetPixel(n, m, RGB(255, 255, 255));
-								nCount++;
-								lSum += GetGray(n, m);
-							}
-						}
-					}
-				}
-			}
+		// еǰ׺ͼһеĻ
+		const double* pPrev = &pIntegral->vecSum[i * nStride];
+		double* pCur = &pIntegral->vecSum[(i + 1) * nStride];
+		double dRowSum = 0;
+		for (int j=0; j<nWidth; j++)
+		{
+			dRowSum += pRow[j];
+			pCur[j + 1] = pPrev[j + 1] + dRowSum;
 		}
 
-		nSuit += nCount;
+		if (!bSquare)
+			continue;
 
-		// ֵʹøĽֵ㷨ΪѱƽҶȣ
-		bSeed = lSum / nSuit;
+		pPrev = &pIntegral->vecSqSum[i * nStride];
+		pCur = &pIntegral->vecSqSum[(i + 1) * nStride];
+		dRowSum = 0;
+		for (int j=0; j<nWidth; j++)
+		{
+			dRowSum += (double)pRow[j] * pRow[j];
+			pCur[j + 1] = pPrev[j + 1] + dRowSum;
+		}
 	}
 
 	return true;
 }
 
-
-
-
 /**************************************************
 BOOL CImgProcess::GenHist(double * pdHist, int n)
 
@@ -3822,15 +7133,24 @@ BOOL CImgProcess::GenHist(double * pdHist, int n)
 	memset(pdHist, 0, n * sizeof(double));
 	dDivider = 256.0 / (double)n;
 	
-	BYTE bGray;	// ʱ,洢ǰصĻҶֵ
+	// ȰҶȼмٺϲҶ
+	UINT nCount[256] = { 0 };
+	const BYTE* pbRow;
+	BYTE * pbBuf = new BYTE[m_pBMIH->biWidth];	// 8λͼĻҶл
 	for (int i=0; i<m_pBMIH->biHeight; i++)
 	{
+		pbRow = GetGrayRow(i, pbBuf);
 		for (int j=0; j<m_pBMIH->biWidth; j++)
 		{
-			bGray = GetGray(j, i);
-			pdHist[(int)(bGray / dDivider)]++;	// ָĻҶԼ
+			nCount[pbRow[j]]++;
 		}
 	};
+	delete [] pbBuf;
+
+	for (int bGray=0; bGray<256; bGray++)
+	{
+		pdHist[(int)(bGray / dDivider)] += nCount[bGray];	// ָĻҶۼ
+	}
 
 	UINT square = m_pBMIH->biWidth * m_pBMIH->biHeight;
 
@@ -3873,37 +7193,35 @@ BOOL CImgProcess::ParLinTran(CImgProcess * pTo, BYTE x1, BYTE x2, BYTE y1, BYTE
 	// Χ
 	if (x1>x2) return false;			// ϵ,ش
 	
-	BYTE gray;		// ʱ,洢ǰصĻҶֵ
-	int target;		// ʱ,洢ǰصĿֵ
+	int gray;		// ʱ,洢ǰҶֵ
+	int target;		// ʱ,洢ǰҶȵĿֵ
+	BYTE bLUT[256];	// ҶֵӦĿֵ
 	
-	for (int i=0; i<m_pBMIH->biHeight; i++)
+	for (gray=0; gray<256; gray++)
 	{
-		for (int j=0; j<m_pBMIH->biWidth; j++)
+		// ʽ
+		if (gray<=x1)
 		{
-			gray = GetGray(j, i);
-
-			// ʽ
-			if (gray<=x1)
-			{
-				target = y1 * gray / x1;
-			}
-			else if (gray<=x2)
-			{
-				target = (y2-y1)*(gray-x1)/(x2-x1) + y1;
-			}
-			else
-			{
-				target = (255-y2)*(gray-x2)/(255-x2) + y2;
-			};
-			
-			if (target < 0) target = 0;
-			if (target > 255) target = 255;
-
-			// дĿͼ
-			pTo->SetPixel(j, i, RGB(target, target, target));
+			target = (x1 == 0) ? y1 : y1 * gray / x1;
+		}
+		else if (gray<=x2)
+		{
+			target = (y2-y1)*(gray-x1)/(x2-x1) + y1;
 		}
+		else
+		{
+			target = (255-y2)*(gray-x2)/(255-x2) + y2;
+		};
+		
+		if (target < 0) target = 0;
+		if (target > 255) target = 255;
+
+		bLUT[gray] = target;
 	}
 
+	// дĿͼ
+	LUTTran(pTo, bLUT);
+
 	return true;
 }
 
@@ -3926,26 +7244,24 @@ BOOL CImgProcess::LogTran(CImgProcess* pTo, double dC)
 	// ȼͼǷ8λҶͼ
 	if (m_pBMIH->biBitCount!=8) return false;
 	
-	BYTE gray;		// ʱ,洢ǰصĻҶֵ
-	int target;		// ʱ,洢ǰصĿֵ
+	int gray;		// ʱ,洢ǰҶֵ
+	int target;		// ʱ,洢ǰҶȵĿֵ
+	BYTE bLUT[256];	// ҶֵӦĿֵ
 	
-	for (int i=0; i<m_pBMIH->biHeight; i++)
+	for (gray=0; gray<256; gray++)
 	{
-		for (int j=0; j<m_pBMIH->biWidth; j++)
-		{
-			gray = GetGray(j, i);
-
-			// ʽ
-			target = dC * log( (double)(gray + 1) );
-			
-			if (target < 0) target = 0;
-			if (target > 255) target = 255;
+		// ʽ
+		target = dC * log( (double)(gray + 1) );
+		
+		if (target < 0) target = 0;
+		if (target > 255) target = 255;
 
-			// дĿͼ
-			pTo->SetPixel(j, i, RGB(target, target, target));
-		}
+		bLUT[gray] = target;
 	};
 
+	// дĿͼ
+	LUTTran(pTo, bLUT);
+
 	return 0;
 }
 
@@ -3972,25 +7288,23 @@ BOOL CImgProcess::GammaTran(CImgProcess* pTo, double gamma, double comp)
 	// ȼͼǷ8λҶͼ
 	if (m_pBMIH->biBitCount!=8) return false;
 	
-	BYTE gray;		// ʱ,洢ǰصĻҶֵ
-	int target;		// ʱ,洢ǰصĿֵ
+	int gray;		// ʱ,洢ǰҶֵ
+	int target;		// ʱ,洢ǰҶȵĿֵ
+	BYTE bLUT[256];	// ҶֵӦĿֵ
 	
-	for (int i=0; i<m_pBMIH->biHeight; i++)
+	for (gray=0; gray<256; gray++)
 	{
-		for (int j=0; j<m_pBMIH->biWidth; j++)
-		{
-			gray = GetGray(j, i);
-
-			target = pow( (gray+comp)/255.0, gamma ) * 255;
-			
-			if (target < 0) target = 0;
-			if (target > 255) target = 255;
+		target = pow( (gray+comp)/255.0, gamma ) * 255;
+		
+		if (target < 0) target = 0;
+		if (target > 255) target = 255;
 
-			// дĿͼ
-			pTo->SetPixel(j, i, RGB(target, target, target));
-		}
+		bLUT[gray] = target;
 	};
 
+	// дĿͼ
+	LUTTran(pTo, bLUT);
+
 	return 0;
 }
 
@@ -4017,36 +7331,34 @@ BOOL CImgProcess::WindowTran(CImgProcess* pTo, BYTE lowThre, BYTE highThre)
 	// ȼͼǷ8λҶͼ
 	if (m_pBMIH->biBitCount!=8) return false;
 	
-	BYTE gray;		// ʱ,洢ǰصĻҶֵ
-	int target;		// ʱ,洢ǰصĿֵ
+	int gray;		// ʱ,洢ǰҶֵ
+	int target;		// ʱ,洢ǰҶȵĿֵ
+	BYTE bLUT[256];	// ҶֵӦĿֵ
 	
-	for (int i=0; i<m_pBMIH->biHeight; i++)
+	for (gray=0; gray<256; gray++)
 	{
-		for (int j=0; j<m_pBMIH->biWidth; j++)
+		if (gray < lowThre)
 		{
-			gray = GetGray(j, i);
-
-			if (gray < lowThre)
-			{
-				target = 0;
-			}
-			else if (gray > highThre)
-			{
-				target = 255;
-			}
-			else
-			{
-				target = gray;
-			};
-			
-			if (target < 0) target = 0;
-			if (target > 255) target = 255;
-
-			// дĿͼ
-			pTo->SetPixel(j, i, RGB(target, target, target));
+			target = 0;
+		}
+		else if (gray > highThre)
+		{
+			target = 255;
 		}
+		else
+		{
+			target = gray;
+		};
+		
+		if (target < 0) target = 0;
+		if (target > 255) target = 255;
+
+		bLUT[gray] = target;
 	};
 
+	// дĿͼ
+	LUTTran(pTo, bLUT);
+
 	return 0;
 }
 
@@ -4073,25 +7385,23 @@ BOOL CImgProcess::LinTran(CImgProcess* pTo, double dFa, double dFb)
 	// ȼͼǷ8λҶͼ
 	if (m_pBMIH->biBitCount!=8) return false;
 	
-	BYTE gray;		// ʱ,洢ǰصĻҶֵ
-	int target;		// ʱ,洢ǰصĿֵ
+	int gray;		// ʱ,洢ǰҶֵ
+	int target;		// ʱ,洢ǰҶȵĿֵ
+	BYTE bLUT[256];	// ҶֵӦĿֵ
 	
-	for (int i=0; i<m_pBMIH->biHeight; i++)
+	for (gray=0; gray<256; gray++)
 	{
-		for (int j=0; j<m_pBMIH->biWidth; j++)
-		{
-			gray = GetGray(j, i);
-
-			target = dFa * gray + dFb;
-			
-			if (target < 0) target = 0;
-			if (target > 255) target = 255;
+		target = dFa * gray + dFb;
+		
+		if (target < 0) target = 0;
+		if (target > 255) target = 255;
 
-			// дĿͼ
-			pTo->SetPixel(j, i, RGB(target, target, target));
-		}
+		bLUT[gray] = target;
 	};
 
+	// дĿͼ
+	LUTTran(pTo, bLUT);
+
 	return true;
 }
 
@@ -4114,8 +7424,9 @@ BOOL CImgProcess::Histeq(CImgProcess * pTo)
 	// ȼͼǷ8λҶͼ
 	if (m_pBMIH->biBitCount!=8) return false;
 	
-	BYTE gray;			// ʱ,洢ǰصĻҶֵ
-	int target;			// ʱ,洢ǰصĿֵ
+	int gray;			// ʱ,洢ǰҶֵ
+	int target;			// ʱ,洢ǰҶȵĿֵ
+	BYTE bLUT[256];		// ҶֵӦĿֵ
 
 	double pdHist[256];	//ʱ,洢Ҷֱͼ
 	
@@ -4123,29 +7434,23 @@ BOOL CImgProcess::Histeq(CImgProcess * pTo)
 
 	this->GenHist(pdHist);
 
-	for (int i=0; i<m_pBMIH->biHeight; i++)
+	// ҶgrayĿֵСgrayĸֱͼۼӵõۼӼȫұ
+	dTemp = 0;
+	for (gray=0; gray<256; gray++)
 	{
-		for (int j=0; j<m_pBMIH->biWidth; j++)
-		{
-			dTemp = 0;
-
-			gray = GetGray(j, i);
-
-			for (BYTE k=0; k<gray; k++)
-			{
-				dTemp+=*(pdHist + k);
-			};
+		target = 255 * dTemp;
+		
+		if (target < 0) target = 0;
+		if (target > 255) target = 255;
 
-			target = 255 * dTemp;
-			
-			if (target < 0) target = 0;
-			if (target > 255) target = 255;
+		bLUT[gray] = target;
 
-			// дĿͼ
-			pTo->SetPixel(j, i, RGB(target, target, target));
-		}
+		dTemp+=*(pdHist + gray);
 	};
 
+	// дĿͼ
+	LUTTran(pTo, bLUT);
+
 	return true;
 }
 
@@ -4172,8 +7477,7 @@ BOOL CImgProcess::Histst(CImgProcess* pTo, double* pdStdHist)
 	// ȼͼǷ8λҶͼ
 	if (m_pBMIH->biBitCount!=8) return false;
 	
-	BYTE gray;			// ʱ,洢ǰصĻҶֵ
-	int target;			// ʱ,洢ǰصĿֵ
+	int target;			// ʱ,洢ǰҶȵĿֵ
 	
 	double pdHist[256];	// ʱ,洢Ҷֱͼ
 	this->GenHist(pdHist);
@@ -4215,29 +7519,23 @@ BOOL CImgProcess::Histst(CImgProcess* pTo, double* pdStdHist)
 	}
 
 	// ԭͼȽлҶȾ⻯ٽй涨
-	for (i=0; i<m_pBMIH->biHeight; i++)
+	BYTE bLUT[256];		// ҶֵӦĿֵ
+	dTemp = 0;
+	for (i=0; i<256; i++)
 	{
-		for (j=0; j<m_pBMIH->biWidth; j++)
-		{
-			dTemp = 0;
-
-			gray = GetGray(j, i);
-
-			for (BYTE k=0; k<gray; k++)
-			{
-				dTemp+=*(pdHist + k);
-			};
+		target = *(pdTran + (int)(255 * dTemp));
+		
+		if (target < 0) target = 0;
+		if (target > 255) target = 255;
 
-			target = *(pdTran + (int)(255 * dTemp));
-			
-			if (target < 0) target = 0;
-			if (target > 255) target = 255;
+		bLUT[i] = target;
 
-			// дĿͼ
-			pTo->SetPixel(j, i, RGB(target, target, target));
-		}
+		dTemp+=*(pdHist + i);
 	};
 
+	// дĿͼ
+	LUTTran(pTo, bLUT);
+
 	return true;
 }
 
@@ -4267,6 +7565,44 @@ BOOL CImgProcess::Histst(CImgProcess* pTo, CImgProcess* pStd)
 	return Histst(pTo, pdStdHist);
 }
 
+/**************************************************
+void CImgProcess::LUTTran(CImgProcess * pTo, const BYTE * pbLUT)
+
+ܣ
+	ұͼлҶȱ任ֵ256Ĳұ
+	ٵñдĿͼ
+
+
+	CImgProcess * pTo
+		CImgProcessָ
+	const BYTE * pbLUT
+		ұpbLUT[g]ΪҶgӦĿֵ
+	
+ֵ
+	
+***************************************************/
+
+void CImgProcess::LUTTran(CImgProcess * pTo, const BYTE * pbLUT)
+{
+	int nHeight = GetHeight();
+	int nWidth = GetWidthPixel();
+
+	vector<BYTE> vecBuf(nWidth);	// 8λͼĻҶл
+	vector<BYTE> vecDest(nWidth);	// Ŀͼһ
+
+	for (int i=0; i<nHeight; i++)
+	{
+		const BYTE* pbRow = GetGrayRow(i, &vecBuf[0]);
+		for (int j=0; j<nWidth; j++)
+		{
+			vecDest[j] = pbLUT[pbRow[j]];
+		}
+
+		// дĿͼ
+		pTo->SetGrayRow(i, &vecDest[0]);
+	}
+}
+
 // FFTIFFT
 
 /**************************************************
@@ -4439,7 +7775,7 @@ void CImgProcess::ImMove(CImgProcess* pTo, int x, int y)
 
 	if(x>nWidth || y>nHeight)
 	{
-		MessageBox(NULL,"ͼƬС","",MB_OK|MB_ICONERROR);
+		ImgMessage("ͼƬС");
 		return;
 	}
   
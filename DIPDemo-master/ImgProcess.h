@@ -122,21 +122,152 @@ struct MYPOINT
 	double y;
 };
 
+// ͼۼ(x, y)Ϊԭͼ[0, x)[0, y)ڵĺͣ
+// ڵĺֵ͡뷽ֻ4αδС޹
+struct SIntegralImage
+{
+	int nWidth;
+	int nHeight;
+	vector<double> vecSum;	 // (nHeight + 1)(nWidth + 1)д
+	vector<double> vecSqSum; // ƽͣʱδҪΪ
+
+	// [x0, x1)[y0, y1)ڵĺ
+	double GetSum(int x0, int y0, int x1, int y1) const
+	{
+		return GetRectSum(vecSum, x0, y0, x1, y1);
+	}
+
+	// [x0, x1)[y0, y1)ڵƽ
+	double GetSqSum(int x0, int y0, int x1, int y1) const
+	{
+		return GetRectSum(vecSqSum, x0, y0, x1, y1);
+	}
+
+	// ڵľֵΪʱ0
+	double GetMean(int x0, int y0, int x1, int y1) const
+	{
+		int nArea = (x1 - x0) * (y1 - y0);
+		return nArea > 0 ? GetSum(x0, y0, x1, y1) / nArea : 0;
+	}
+
+	// ڵķҪƽ
+	double GetVariance(int x0, int y0, int x1, int y1) const
+	{
+		int nArea = (x1 - x0) * (y1 - y0);
+		if(nArea <= 0)
+			return 0;
+
+		double dMean = GetSum(x0, y0, x1, y1) / nArea;
+		double dVar = GetSqSum(x0, y0, x1, y1) / nArea - dMean * dMean;
+		return dVar > 0 ? dVar : 0; //ʹС0
+	}
+
+private:
+	double GetRectSum(const vector<double>& vecTable, int x0, int y0, int x1, int y1) const
+	{
+		const double* pTop = &vecTable[(size_t)y0 * (nWidth + 1)];
+		const double* pBottom = &vecTable[(size_t)y1 * (nWidth + 1)];
+		return pBottom[x1] - pBottom[x0] - pTop[x1] + pTop[x0];
+	}
+};
+
+// ݶӣģEdgeRobertsEdgeSobelEdgePrewittõһ
+#define GRAD_ROBERTS	0	// 22ֻ45ȡ135ȷ
+#define GRAD_SOBEL		1	// 33ȨؾΪ1
+#define GRAD_PREWITT	2	// 33мһУУȨΪ2
+
+// GenGradientһĸݶȣдţyΪ϶µкš
+// ԵbEdgeTypeһ£1-ˮƽ 2-ֱ 3-45 4-135
+struct SGradient
+{
+	int nWidth;
+	int nHeight;
+	int nDirs;				// ˵ķ
+	BYTE bDirs[4];			// ı
+	vector<BYTE> vecResp;	// Ӧľֵضϵ255ÿnHeightnWidthδҪʱΪ
+	vector<BYTE> vecMag;	// Ӧֵ
+	vector<BYTE> vecDir;	// ȡֵķţӦȫΪ0ʱΪ0
+
+	// nĵyӦ
+	const BYTE* GetResp(int n, int y) const
+	{
+		return &vecResp[((size_t)n * nHeight + y) * nWidth];
+	}
+	const BYTE* GetMag(int y) const { return &vecMag[(size_t)y * nWidth]; }
+	const BYTE* GetDir(int y) const { return &vecDir[(size_t)y * nWidth]; }
+};
+
+// һͨͳ
+struct SConnRgnStat
+{
+	int nArea;							// 
+	int nLeft, nTop, nRight, nBottom;	// ӾΣ߽
+	double dCenterX, dCenterY;			// 
+};
+
+// GenConnRgnĽ32λͼ͸ͨͳƣyΪ϶µкš
+// Ϊ0ͨһصĹդ˳1ʼţ
+// ӵRegionGrowWatershedҲӵ˳
+struct SConnRgnLabel
+{
+	int nWidth;
+	int nHeight;
+	int nCount;						// ͨ
+	vector<int> vecLabel;			// nHeightnWidthı
+	vector<SConnRgnStat> vecStat;	// nŷͳvecStat[n - 1]
+
+	const int* GetLabel(int y) const { return &vecLabel[(size_t)y * nWidth]; }
+};
+
+// ߶LoGӦļ㷽ʽCImgProcess::GenLoG
+#define LOG_LAPLACIAN	0	// ˹ƽ5Laplacian
+#define LOG_DOG			1	// ׼֮ΪLOG_DOG_RATIOԦΪе˹ƽ֮
+#define LOG_DOG_RATIO	1.6
+
+class CImgProcess;
+
+// ִĻصдpInִддpOut
+// ǰpOutpInĿʱϰһ£
+typedef void (*PFN_BANDPROC)(CImgProcess* pIn, CImgProcess* pOut, LPVOID pParam);
+
+// ̬ѧ㣬ñ任ķִֿģʽCImgProcess::ProcessTiled
+#define IMG_TILE_DEFAULT	-1	// SetTileMode趨ȫģʽ
+#define IMG_TILE_OFF		0	// ͼ𼶴
+#define IMG_TILE_ON			1	// ͼ񳬳һдʱֿ鴦Ĭϣ
+
+// ִֿʱÿдĬֽмͬʱL2
+#define IMG_TILE_BYTES		(256 * 1024)
+
 // CImgProcessװ˸ͼı׼㷨
 class CImgProcess : public CImg  
 {
 public:
 	CImgProcess();
+	CImgProcess(const CImgProcess& img);
+	CImgProcess(CImgProcess&& img);
 	virtual ~CImgProcess();
 
+	CImgProcess& operator = (const CImgProcess& img);
+	CImgProcess& operator = (CImgProcess&& img);
 	// ӻת
-	CImgProcess& operator = (CImg& img);
+	CImgProcess& operator = (const CImg& img);
+
+	// ִʽдͼ񲻱פڴ
+	BOOL ProcessToWriter(CImgWriter& writer, int nHalo, PFN_BANDPROC pfnProc, LPVOID pParam = NULL);
+	// ִֿУÿдڻдpTo
+	BOOL ProcessTiled(CImgProcess* pTo, int nHalo, PFN_BANDPROC pfnProc, LPVOID pParam = NULL, size_t nTileBytes = 0);
+	// ִֿеȫģʽIMG_TILE_ONIMG_TILE_OFFÿдֽ
+	static void SetTileMode(int nMode);
+	static int GetTileMode();
+	static void SetTileBytes(size_t nBytes);
+	static size_t GetTileBytes();
 
 
 
 
 	//***************3 ͼĵ*****************
 	BOOL GenHist(double * hist, int n = 256);// ɻҶֱͼ
+	BOOL GenIntegral(SIntegralImage * pIntegral, BOOL bSquare = FALSE);// ɻͼ
 	BOOL ParLinTran(CImgProcess * pTo, BYTE x1, BYTE x2, BYTE y1, BYTE y2);//ֶԱ任
 	BOOL LinTran(CImgProcess * pTo, double dFa, double dFb);//Ա任
 	BOOL LogTran(CImgProcess * pTo, double C);//任
@@ -145,6 +276,7 @@ public:
 	BOOL Histeq(CImgProcess * pTo);//ҶȾ⻯
 	BOOL Histst(CImgProcess * pTo, double* pdStdHist);//ֱͼ涨ֱƥֱͼ
 	BOOL Histst(CImgProcess * pTo, CImgProcess* pStd);//ֱͼ涨ƥ׼ͼֱͼ
+	void LUTTran(CImgProcess * pTo, const BYTE * pbLUT);//ұ任
 	
 
 
@@ -159,11 +291,11 @@ public:
 
 	//**************ͶӰ任ԭ***************//////////////////
 	int m_nBasePt; //=4 ׼ԶĿ
-	BOOL ImProjRestore(CImgProcess* pTo, CPoint *pPointBase, CPoint *pPointSampl, bool bInterp);//ͶӰУ
-	void GetProjPara(CPoint *pPointBase, CPoint *pPointSampl, double *pDbProjPara); //4Զ׼ȷ任
+	BOOL ImProjRestore(CImgProcess* pTo, POINT *pPointBase, POINT *pPointSampl, bool bInterp);//ͶӰУ
+	void GetProjPara(POINT *pPointBase, POINT *pPointSampl, double *pDbProjPara); //4Զ׼ȷ任
 	BOOL InvMat(double** ppDbMat, int nLen); //
 	void ProdMat(double** ppDbMat, double* pDbSrc2, double* pDbDest, int y, int x, int z);
-	struct MYPOINT ProjTrans(CPoint pt, double* pDbProjPara); //ݱ任ԵptʵʩͶӰ任
+	struct MYPOINT ProjTrans(POINT pt, double* pDbProjPara); //ݱ任ԵptʵʩͶӰ任
 
 	int InterpBilinear(double x, double y);//(x,y)˫ԲֵĻҶ
 	
@@ -173,9 +305,10 @@ public:
 	
 	// ͨģ
 	void Template(CImgProcess *pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, FLOAT *pfArray, FLOAT fCoef);
-	int GetMedianValue(int * pAryGray, int nFilterLen); //ȡͳֵ
+	void BoxFilter(CImgProcess *pTo, int nFilterH, int nFilterW, int nFilterMY, int nFilterMX); //ֵ˲ʱ봰ڴС޹
+	static int GetMedianValue(int * pAryGray, int nFilterLen); //ȡͳֵ
 	void MedianFilter(CImgProcess *pTo, int nFilterH, int nFilterW, int nFilterMY, int nFilterMX); //ֵ˲
-	void AdaptiveMedianFilter(CImgProcess *pTo, int nFilterH, int nFilterW, int nFilterMY, int nFilterMX); //Ӧֵ˲
+	void AdaptiveMedianFilter(CImgProcess *pTo, int nFilterH, int nFilterW, int nFilterMY, int nFilterMX, int nThreads = 0); //Ӧֵ˲
 	void FilterSobel(CImgProcess *pTo); //Sobelݶ
 	void EnhanceFilter(CImgProcess *pTo, double dProportion,
 						 int nTempH, int nTempW, 
@@ -304,19 +437,25 @@ public:
 	void Erode(CImgProcess* pTo, int se[3][3]); //ʴ㷨
 	void Dilate(CImgProcess* pTo, int se[3][3]); //㷨
 	void Convex(CImgProcess* pTo, BOOL bConstrain); //͹
-	void Open(CImgProcess* pTo, int se[3][3]);//
-	void Close(CImgProcess* pTo, int se[3][3]);//
+	void Open(CImgProcess* pTo, int se[3][3], int nTileMode = IMG_TILE_DEFAULT);//
+	void Close(CImgProcess* pTo, int se[3][3], int nTileMode = IMG_TILE_DEFAULT);//
+	// СĽṹԪأзֽΪˮƽ߶λѹϼ
+	void Erode(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se);
+	void Dilate(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se);
+	void Open(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se);
+	void Close(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se);
 
 	void PixelImage(CImgProcess* pTo, int lowerThres, int upperThres);
-	int TestConnRgn(CImgProcess* pImage,  LPBYTE lpVisited, int nWidth, int nHeight,	int x,int y, CPoint ptVisited[], int lowerThres, int upperThres, int &curLianXuShu);
+	int TestConnRgn(CImgProcess* pImage,  LPBYTE lpVisited, int nWidth, int nHeight,	int x,int y, POINT ptVisited[], int lowerThres, int upperThres, int &curLianXuShu);
 	void LabelConnRgn(CImgProcess* pTo, int nConn = 8); //עͨ
+	BOOL GenConnRgn(SConnRgnLabel* pLabel, int nConn = 8); //ͨ32λͼͳ
 
 	//Ҷ̬ѧ
 	void GrayDilate(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se);//Ҷ
 	void GrayErode(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se);//Ҷȸʴ
-	void GrayOpen(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se);//Ҷȿ
-	void GrayClose(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se);//Ҷȱ
-	void Tophat(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se);//ñ任
+	void GrayOpen(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se, int nTileMode = IMG_TILE_DEFAULT);//Ҷȿ
+	void GrayClose(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se, int nTileMode = IMG_TILE_DEFAULT);//Ҷȱ
+	void Tophat(CImgProcess* pTo, int nTempH, int nTempW, int nTempMY, int nTempMX, int** se, int nTileMode = IMG_TILE_DEFAULT);//ñ任
 
 
 
@@ -330,8 +469,14 @@ public:
 	BOOL EdgePrewitt(CImgProcess * pTo, BYTE bThre = 0, BYTE bEdgeType = 0, BOOL bThinning = true, BOOL bGOnly = false);
 	// ˹˹ԵѰ
 	void EdgeLoG(CImgProcess * pTo);
+	// ָ߶ȵĸ˹˹ԵѰңdSigmaΪ˹ı׼
+	void EdgeLoG(CImgProcess * pTo, double dSigma, int nMode = LOG_LAPLACIAN);
+	// ߶ȵĳ߶ȹһLoGӦ߶ȹһƽĸ˹ͼ
+	BOOL GenLoG(CImgProcess * pTo, const double * pSigmas, int nScales, int nMode = LOG_LAPLACIAN);
 	// Canny㷨
 	BOOL EdgeCanny(CImgProcess * pTo, BYTE bThreL = 0, BYTE bThreH = 0, BOOL bThinning = true);
+	// һݶȡݶȼ䷽
+	BOOL GenGradient(SGradient * pGrad, int nOperator, BYTE bEdgeType = 0, BOOL bResponses = true);
 
 	// Hough任 ֱ
 	BOOL Hough(SLineInfo *pInfoRet, int nLineRet);
@@ -339,10 +484,14 @@ public:
 	void Threshold(CImgProcess *pTo, BYTE bThre);//ֵָ
 	int DetectThreshold(int nMaxIter, int &nDiffRet);// ȡŷֵ
 	void AutoThreshold(CImgProcess *pTo);//Զֵָ
+	void AdaptiveThreshold(CImgProcess *pTo, int nWinSize, double dOffset);//ֲֵӦֵָ
 
 	// 㷨
 	BOOL RegionGrow(CImgProcess * pTo , int nSeedX, int nSeedY, BYTE bThre);
+	// ͬʱΪͼ
+	BOOL RegionGrow(SConnRgnLabel* pLabel, const POINT* pSeeds, int nSeeds, BYTE bThre, int nConn = 8);
 	// ˮ㷨
+	BOOL Watershed(SConnRgnLabel* pLabel, const POINT* pSeeds, int nSeeds, int nConn = 8);
 
 
 
@@ -361,5 +510,30 @@ public:
 };//class CImgProcess
 
 
+// ͼͼ
+// أֱԭͼе׵ַƫ+ԭͼмࣩΪ
+// CImgProcess㷨ͼеļⴰʱֻʴڵڴ档
+// ͼأԭͼͼøڼ䲻·䣻
+// ͼõĶ
+class CImgView : public CImgProcess
+{
+public:
+	CImgView() {}
+	// ֻͼ״дʱƳ
+	CImgView(const CImg& img, int x, int y, int nWidth, int nHeight) { AttachView(img, x, y, nWidth, nHeight); }
+	// bWritableΪTRUEʱΪдͼд㷨ֱimg
+	CImgView(CImg& img, int x, int y, int nWidth, int nHeight, BOOL bWritable)
+	{
+		if (bWritable)
+			AttachWritableView(img, x, y, nWidth, nHeight);
+		else
+			AttachView(img, x, y, nWidth, nHeight);
+	}
+
+	CImgView& operator = (const CImg& img) { CImg::operator = (img); return *this; }
+	CImgView& operator = (const CImgView& img) { CImg::operator = (img); return *this; }
+};
+
+
 
 #endif // !defined(AFX_IMAGE_H__D566CE6A_BA81_4157_8E6A_748DA096668F__INCLUDED_)
@@ -2,7 +2,7 @@
 //
 //////////////////////////////////////////////////////////////////////
 
-#include "stdafx.h"
+#include "ImgPlatform.h"
 #include "Vector2D.h"
 #include <math.h>
 
@@ -166,7 +166,7 @@ BOOL CVector2D::RemoveNeighborPointFromVector(POINT ptToRemove, int nRadius, vec
 		}
 		catch(...)
 		{
-			AfxMessageBox("	pts.erase(index[j]) error ");
+			ImgMessage("	pts.erase(index[j]) error ");
 		}
 	}
 	return bNeighbor;
@@ -5,6 +5,7 @@
 #ifndef __VECTOR2D_H_
 #define __VECTOR2D_H_
 
+#include "ImgPlatform.h"
 #include <vector>
 using namespace std;
 